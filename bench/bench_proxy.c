@@ -0,0 +1,391 @@
+// 代理链接解析与配置生成基准测试：make bench-proxy
+// 单独链接 proxy_parser.c 和 json_writer.c，结果以 JSON 输出到标准输出
+// 用法: bench-proxy [-t 每项秒数] [链接文件...]，链接文件每行一个链接，作为额外的测试集
+
+#include "../include/proxy_parser.h"
+#include "../include/json_writer.h"
+#include "../include/base64_decode.h"
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static guint64 alloc_count;
+
+// 统计分配次数：可执行文件中的 malloc 系列函数覆盖 libc 的实现，GLib 的 g_malloc 也会经过这里
+// 只有 glibc 导出 __libc_* 入口；其他 C 库（musl 等）上不统计，结果中的分配次数为 null
+#ifdef __GLIBC__
+#define BENCH_COUNT_ALLOCS TRUE
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+    alloc_count++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    alloc_count++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    alloc_count++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+#else
+#define BENCH_COUNT_ALLOCS FALSE
+#endif
+
+// 平均分配次数，无法统计时写为 null
+static void member_allocs(JsonWriter *w, const char *key, guint64 allocs, guint64 count) {
+    if (BENCH_COUNT_ALLOCS) {
+        json_writer_member_double(w, key, (double)allocs / (double)count);
+    } else {
+        json_writer_member_string(w, key, NULL);
+    }
+}
+
+#define BENCH_CORPUS_SIZE 1000
+#define BENCH_HUGE_QUERY_BYTES (64 * 1024)
+#define BENCH_SUBSCRIPTION_BYTES (4 * 1024 * 1024)
+
+typedef struct {
+    const char *name;
+    GPtrArray *urls;            // char*
+} Corpus;
+
+static double bench_seconds = 0.5;
+
+static char* b64(const char *text) {
+    return g_base64_encode((const guchar*)text, strlen(text));
+}
+
+static Corpus corpus_new(const char *name) {
+    Corpus corpus = { name, g_ptr_array_new_with_free_func(g_free) };
+    return corpus;
+}
+
+static Corpus corpus_ss(void) {
+    Corpus corpus = corpus_new("ss");
+    for (int i = 0; i < BENCH_CORPUS_SIZE; i++) {
+        char *userinfo = b64(i % 2 ? "aes-256-gcm:password" : "chacha20-ietf-poly1305:p4ss-w0rd");
+        g_ptr_array_add(corpus.urls, g_strdup_printf("ss://%s@198.51.100.%d:%d#%%E8%%8A%%82%%E7%%82%%B9-%d",
+                                                     userinfo, i % 250, 8000 + i, i));
+        g_free(userinfo);
+    }
+    return corpus;
+}
+
+static Corpus corpus_vmess(void) {
+    Corpus corpus = corpus_new("vmess");
+    for (int i = 0; i < BENCH_CORPUS_SIZE; i++) {
+        char *json = g_strdup_printf("{\"v\":\"2\",\"ps\":\"\\u8282\\u70b9-%d\",\"add\":\"v%d.example.com\","
+                                     "\"port\":\"443\",\"id\":\"b831381d-6324-4d53-ad4f-8cda48b3%04d\","
+                                     "\"aid\":\"0\",\"scy\":\"auto\",\"net\":\"ws\",\"type\":\"none\","
+                                     "\"host\":\"cdn.example.com\",\"path\":\"/ray/%d\",\"tls\":\"tls\","
+                                     "\"sni\":\"cdn.example.com\"}", i, i, i, i);
+        char *encoded = b64(json);
+        g_ptr_array_add(corpus.urls, g_strdup_printf("vmess://%s", encoded));
+        g_free(encoded);
+        g_free(json);
+    }
+    return corpus;
+}
+
+static Corpus corpus_vless(void) {
+    Corpus corpus = corpus_new("vless");
+    for (int i = 0; i < BENCH_CORPUS_SIZE; i++) {
+        g_ptr_array_add(corpus.urls, g_strdup_printf(
+            "vless://b831381d-6324-4d53-ad4f-8cda48b3%04d@l%d.example.com:443?encryption=none&security=tls"
+            "&sni=l%d.example.com&type=grpc&serviceName=svc%%2F%d&mode=multi#VLESS%%20%d", i, i, i, i, i));
+    }
+    return corpus;
+}
+
+static Corpus corpus_trojan(void) {
+    Corpus corpus = corpus_new("trojan");
+    for (int i = 0; i < BENCH_CORPUS_SIZE; i++) {
+        g_ptr_array_add(corpus.urls, g_strdup_printf(
+            "trojan://pa%%40ss-%d@[2001:db8::%x]:443?sni=t%d.example.com&type=ws&host=t%d.example.com"
+            "&path=%%2Fws%%3Fed%%3D2048#Trojan-%d", i, i, i, i, i));
+    }
+    return corpus;
+}
+
+static Corpus corpus_malformed(void) {
+    static const char * const bad[] = {
+        "ss://%%%not-base64%%%@host:1",
+        "ss://bm8tY29sb24@host:8388",
+        "vmess://eyJhZGQiOiJ",
+        "vmess://!!!!",
+        "vless://missing-at-sign",
+        "trojan://@empty-password.example.com:443",
+        "trojan://nohost",
+        "http://unsupported.example.com",
+        "",
+    };
+
+    Corpus corpus = corpus_new("malformed");
+    for (int i = 0; i < BENCH_CORPUS_SIZE; i++) {
+        g_ptr_array_add(corpus.urls, g_strdup(bad[i % G_N_ELEMENTS(bad)]));
+    }
+    return corpus;
+}
+
+static Corpus corpus_huge_query(void) {
+    Corpus corpus = corpus_new("huge-query");
+    GString *url = g_string_new("vless://b831381d-6324-4d53-ad4f-8cda48b30000@huge.example.com:443?security=tls");
+    for (int i = 0; url->len < BENCH_HUGE_QUERY_BYTES; i++) {
+        g_string_append_printf(url, "&x%d=%%41%%42%%43padding", i);
+    }
+    g_string_append(url, "&type=ws&path=%2Fend#huge");
+
+    for (int i = 0; i < 16; i++) {
+        g_ptr_array_add(corpus.urls, g_strdup(url->str));
+    }
+    g_string_free(url, TRUE);
+    return corpus;
+}
+
+static Corpus corpus_file(const char *path) {
+    Corpus corpus = corpus_new(path);
+    char *contents = NULL;
+    GError *error = NULL;
+
+    if (!g_file_get_contents(path, &contents, NULL, &error)) {
+        fprintf(stderr, "bench-proxy: %s\n", error->message);
+        g_error_free(error);
+        return corpus;
+    }
+
+    char **lines = g_strsplit(contents, "\n", -1);
+    for (int i = 0; lines[i]; i++) {
+        g_strstrip(lines[i]);
+        if (*lines[i]) {
+            g_ptr_array_add(corpus.urls, g_strdup(lines[i]));
+        }
+    }
+    g_strfreev(lines);
+    g_free(contents);
+    return corpus;
+}
+
+// 反复解析整个测试集，直到超过 bench_seconds
+static void bench_parse(JsonWriter *w, const Corpus *corpus) {
+    if (corpus->urls->len == 0) return;
+
+    guint64 parsed = 0;
+    guint64 failed = 0;
+    guint64 bytes = 0;
+    guint64 rounds = 0;
+    guint64 allocs_before = alloc_count;
+    gint64 start = g_get_monotonic_time();
+    gint64 deadline = start + (gint64)(bench_seconds * G_USEC_PER_SEC);
+    gint64 now;
+
+    do {
+        for (guint i = 0; i < corpus->urls->len; i++) {
+            const char *url = g_ptr_array_index(corpus->urls, i);
+            ProxyConfig *config = proxy_parser_parse(url);
+            if (config) {
+                parsed++;
+                proxy_parser_free(config);
+            } else {
+                failed++;
+            }
+            bytes += strlen(url);
+        }
+        rounds++;
+        now = g_get_monotonic_time();
+    } while (now < deadline);
+
+    guint64 total = rounds * corpus->urls->len;
+    double seconds = (double)(now - start) / G_USEC_PER_SEC;
+
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "corpus", corpus->name);
+    json_writer_member_int(w, "urls", corpus->urls->len);
+    json_writer_member_int(w, "valid", (gint64)(parsed / rounds));
+    json_writer_member_int(w, "invalid", (gint64)(failed / rounds));
+    json_writer_member_int(w, "urls_per_sec", (gint64)(total / seconds));
+    json_writer_member_double(w, "mb_per_sec", (double)bytes / seconds / (1024 * 1024));
+    member_allocs(w, "allocs_per_url", alloc_count - allocs_before, total);
+    json_writer_end_object(w);
+}
+
+// 订阅解码：把所有测试集的链接拼成约 4MB 文本后 base64 编码，反复原地解码
+static void bench_base64(JsonWriter *w, const Corpus *corpora, gsize n_corpora) {
+    GString *plain = g_string_new(NULL);
+    while (plain->len < BENCH_SUBSCRIPTION_BYTES) {
+        for (gsize c = 0; c < n_corpora; c++) {
+            for (guint i = 0; i < corpora[c].urls->len; i++) {
+                g_string_append(plain, g_ptr_array_index(corpora[c].urls, i));
+                g_string_append_c(plain, '\n');
+            }
+        }
+    }
+    char *encoded = b64(plain->str);
+    gsize len = strlen(encoded);
+    char *work = g_malloc(len + 1);
+
+    guint64 rounds = 0;
+    gint64 elapsed = 0;
+    gint64 deadline = g_get_monotonic_time() + (gint64)(bench_seconds * G_USEC_PER_SEC);
+    gssize decoded;
+
+    do {
+        memcpy(work, encoded, len + 1);
+        gint64 start = g_get_monotonic_time();
+        decoded = base64_decode_inplace(work, len);
+        elapsed += g_get_monotonic_time() - start;
+        rounds++;
+    } while (g_get_monotonic_time() < deadline);
+
+    json_writer_begin_object(w);
+    json_writer_member_int(w, "encoded_bytes", (gint64)len);
+    json_writer_member_bool(w, "ok", decoded == (gssize)plain->len && memcmp(work, plain->str, plain->len) == 0);
+    json_writer_member_double(w, "mb_per_sec", (double)len * rounds / ((double)MAX(elapsed, 1) / G_USEC_PER_SEC) / (1024 * 1024));
+    json_writer_end_object(w);
+
+    g_free(work);
+    g_free(encoded);
+    g_string_free(plain, TRUE);
+}
+
+// 大规模分流规则：count 个互不相邻的 /24 直连网段
+static ProxyRouteRules* routes_large(guint count) {
+    ProxyRouteRules *routes = g_new0(ProxyRouteRules, 1);
+    routes->geosite_cn_direct = TRUE;
+    routes->direct_cidrs = g_new(char *, count + 1);
+    for (guint i = 0; i < count; i++) {
+        guint32 network = 0x01000000u + i * 0x200u;
+        routes->direct_cidrs[i] = g_strdup_printf("%u.%u.%u.0/24", network >> 24, (network >> 16) & 0xff,
+                                                  (network >> 8) & 0xff);
+    }
+    routes->direct_cidrs[count] = NULL;
+    return routes;
+}
+
+// 反复生成配置，直到超过 bench_seconds
+static void bench_generate(JsonWriter *w, const char *name, ProxyConfig * const *configs, guint count,
+                           gboolean fakeip, gboolean singbox, const ProxyRouteRules *routes) {
+    ProxyGenOptions opts;
+    proxy_parser_gen_options_init(&opts, 12345);
+    opts.fakeip = fakeip;
+    opts.api_port = singbox ? 0 : PROXY_STATS_API_DEFAULT_PORT;
+    opts.routes = routes;
+
+    guint64 rounds = 0;
+    gsize size = 0;
+    guint64 allocs_before = alloc_count;
+    gint64 start = g_get_monotonic_time();
+    gint64 deadline = start + (gint64)(bench_seconds * G_USEC_PER_SEC);
+    gint64 now;
+
+    do {
+        char *json = singbox ? proxy_parser_generate_singbox_config(configs, count, &opts)
+                             : proxy_parser_generate_v2ray_config_multi(configs, count, &opts);
+        size = json ? strlen(json) : 0;
+        g_free(json);
+        rounds++;
+        now = g_get_monotonic_time();
+    } while (now < deadline);
+
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "case", name);
+    json_writer_member_int(w, "nodes", count);
+    json_writer_member_string(w, "format", singbox ? "sing-box" : "v2ray");
+    json_writer_member_bool(w, "fakeip", fakeip);
+    json_writer_member_int(w, "route_cidrs", routes && routes->direct_cidrs ? g_strv_length(routes->direct_cidrs) : 0);
+    json_writer_member_double(w, "us_per_config", (double)(now - start) / (double)rounds);
+    json_writer_member_int(w, "output_bytes", (gint64)size);
+    member_allocs(w, "allocs_per_config", alloc_count - allocs_before, rounds);
+    json_writer_end_object(w);
+}
+
+int main(int argc, char **argv) {
+    GPtrArray *corpora = g_ptr_array_new();
+    Corpus builtin[] = {
+        corpus_ss(), corpus_vmess(), corpus_vless(), corpus_trojan(), corpus_malformed(), corpus_huge_query(),
+    };
+    for (gsize i = 0; i < G_N_ELEMENTS(builtin); i++) {
+        g_ptr_array_add(corpora, &builtin[i]);
+    }
+
+    GArray *files = g_array_new(FALSE, FALSE, sizeof(Corpus));
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            bench_seconds = g_ascii_strtod(argv[++i], NULL);
+            if (bench_seconds <= 0) bench_seconds = 0.5;
+        } else {
+            Corpus corpus = corpus_file(argv[i]);
+            g_array_append_val(files, corpus);
+        }
+    }
+    for (guint i = 0; i < files->len; i++) {
+        g_ptr_array_add(corpora, &g_array_index(files, Corpus, i));
+    }
+
+    GString *out = g_string_new(NULL);
+    JsonWriter writer;
+    JsonWriter *w = &writer;
+    json_writer_init(w, out, TRUE);
+
+    json_writer_begin_object(w);
+    json_writer_key(w, "parse");
+    json_writer_begin_array(w);
+    for (guint i = 0; i < corpora->len; i++) {
+        bench_parse(w, g_ptr_array_index(corpora, i));
+    }
+    json_writer_end_array(w);
+
+    json_writer_key(w, "base64");
+    bench_base64(w, builtin, 4);
+
+    // 配置生成：每种协议取两个节点，单节点和多节点均衡两种规模
+    ProxyConfig *configs[8];
+    guint count = 0;
+    for (gsize i = 0; i < 4 && count < G_N_ELEMENTS(configs); i++) {
+        for (guint j = 0; j < 2; j++) {
+            ProxyConfig *config = proxy_parser_parse(g_ptr_array_index(builtin[i].urls, j));
+            if (config) configs[count++] = config;
+        }
+    }
+
+    json_writer_key(w, "generate");
+    json_writer_begin_array(w);
+    if (count > 0) {
+        ProxyRouteRules *routes = routes_large(10000);
+        bench_generate(w, "single", configs, 1, FALSE, FALSE, NULL);
+        bench_generate(w, "single-fakeip", configs, 1, TRUE, FALSE, NULL);
+        bench_generate(w, "balanced", configs, count, FALSE, FALSE, NULL);
+        bench_generate(w, "balanced-fakeip", configs, count, TRUE, FALSE, NULL);
+        bench_generate(w, "balanced", configs, count, FALSE, TRUE, NULL);
+        bench_generate(w, "routes-10k", configs, 1, FALSE, FALSE, routes);
+        bench_generate(w, "routes-10k", configs, 1, FALSE, TRUE, routes);
+        proxy_route_rules_free(routes);
+    }
+    json_writer_end_array(w);
+    json_writer_end_object(w);
+
+    puts(out->str);
+
+    for (guint i = 0; i < count; i++) {
+        proxy_parser_free(configs[i]);
+    }
+    g_string_free(out, TRUE);
+    for (guint i = 0; i < corpora->len; i++) {
+        g_ptr_array_unref(((Corpus*)g_ptr_array_index(corpora, i))->urls);
+    }
+    g_array_unref(files);
+    g_ptr_array_unref(corpora);
+    return 0;
+}
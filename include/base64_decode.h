@@ -0,0 +1,16 @@
+#ifndef BASE64_DECODE_H
+#define BASE64_DECODE_H
+
+#include <glib.h>
+
+/**
+ * 原地 Base64 解码并以 NUL 结尾
+ * 同时接受标准 (+/) 和 URL 安全 (-_) 字母表，填充可以省略，跳过空白，遇到 '=' 结束。
+ * 输出总不长于输入，所以写回同一块内存；x86 上长段连续数据走 SSSE3/AVX2 路径。
+ * @param str 编码文本，至少有 len + 1 字节可写
+ * @param len 编码文本长度
+ * @return 解码后的字节数，含非法字符时返回 -1
+ */
+gssize base64_decode_inplace(char *str, gsize len);
+
+#endif // BASE64_DECODE_H
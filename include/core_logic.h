@@ -9,4 +9,6 @@ gboolean test_connection(const char *server, int port, const char *proto);
 void scan_nm_connections(OVPNClient *client);
 void init_v2ray_manager(OVPNClient *client);
 void cleanup_v2ray_manager(OVPNClient *client);
+void init_route_manager(OVPNClient *client);
+void cleanup_route_manager(OVPNClient *client);
 #endif
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef GEO_ASSETS_H
+#define GEO_ASSETS_H
+
+#include <glib.h>
+
+/**
+ * 从完整的 geoip.dat / geosite.dat 中提取指定类别，写成只含这些类别的同格式文件
+ * 两种文件都是 protobuf 列表，每项的字段 1 是类别代码；选中的项原样复制，不重新编码
+ * @param src_path 完整的 .dat 文件
+ * @param dst_path 输出文件，原子替换
+ * @param codes 类别代码，NULL 结尾，不区分大小写（如 "cn"、"category-ads-all"）
+ * @param error 错误信息；文件格式错误或缺少某个类别时失败
+ * @return gboolean 成功返回 TRUE
+ */
+gboolean geo_assets_trim(const char *src_path, const char *dst_path, const char * const *codes, GError **error);
+
+/**
+ * 目标文件不存在、比源文件旧或提取的类别与 codes 不同时重新提取，否则直接返回
+ * 提取的类别记录在目标文件旁的 dst_path.codes 中，每行一个
+ * @param src_path 完整的 .dat 文件
+ * @param dst_path 输出文件
+ * @param codes 类别代码，NULL 结尾
+ * @param error 错误信息
+ * @return gboolean 目标文件可用返回 TRUE
+ */
+gboolean geo_assets_update(const char *src_path, const char *dst_path, const char * const *codes, GError **error);
+
+/**
+ * 查找完整的 geo 数据文件：环境变量 asset_env 指定的目录、内核二进制所在目录、
+ * data/v2ray，以及系统的 share 目录
+ * @param binary 内核二进制路径，可为 NULL
+ * @param asset_env 内核的资源目录环境变量名，可为 NULL
+ * @param name 文件名，如 "geoip.dat"
+ * @return char* 文件路径，需要用 g_free 释放；未找到返回 NULL
+ */
+char* geo_assets_find_source(const char *binary, const char *asset_env, const char *name);
+
+#endif // GEO_ASSETS_H
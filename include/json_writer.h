@@ -0,0 +1,86 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <glib.h>
+
+// 嵌套层数上限，超出后不再缩进
+#define JSON_WRITER_MAX_DEPTH 32
+
+// 流式 JSON 写入器：直接追加到 GString，不建立对象树
+// 调用者负责按顺序成对调用 begin/end，对象中的每个值之前先写键
+typedef struct {
+    GString *buf;
+    gboolean pretty;            // 换行并按两个空格缩进
+    guint depth;
+    gboolean has_items[JSON_WRITER_MAX_DEPTH + 1];  // 每层容器中是否已有元素
+    gboolean after_key;         // 刚写完键，下一个值不需要逗号和换行
+} JsonWriter;
+
+/**
+ * 初始化写入器
+ * @param writer 写入器
+ * @param buf 输出缓冲区，内容追加在末尾
+ * @param pretty 是否缩进
+ */
+void json_writer_init(JsonWriter *writer, GString *buf, gboolean pretty);
+
+void json_writer_begin_object(JsonWriter *writer);
+void json_writer_end_object(JsonWriter *writer);
+void json_writer_begin_array(JsonWriter *writer);
+void json_writer_end_array(JsonWriter *writer);
+
+/**
+ * 写入对象的键
+ * @param writer 写入器
+ * @param key 键，不做转义，只能是 ASCII 常量
+ */
+void json_writer_key(JsonWriter *writer, const char *key);
+
+/**
+ * 写入字符串值，NULL 写为 null
+ * @param writer 写入器
+ * @param value 字符串 (UTF-8)，非法的字节写为 \ufffd
+ */
+void json_writer_string(JsonWriter *writer, const char *value);
+
+void json_writer_int(JsonWriter *writer, gint64 value);
+void json_writer_bool(JsonWriter *writer, gboolean value);
+
+/**
+ * 写入浮点数，保留三位小数，与区域设置无关
+ * @param writer 写入器
+ * @param value 数值，非有限值写为 null
+ */
+void json_writer_double(JsonWriter *writer, double value);
+
+/**
+ * 写入已经是合法 JSON 的值，原样追加
+ * @param writer 写入器
+ * @param json JSON 文本
+ */
+void json_writer_raw(JsonWriter *writer, const char *json);
+
+// 键值对的简写
+void json_writer_member_string(JsonWriter *writer, const char *key, const char *value);
+void json_writer_member_int(JsonWriter *writer, const char *key, gint64 value);
+void json_writer_member_bool(JsonWriter *writer, const char *key, gboolean value);
+void json_writer_member_double(JsonWriter *writer, const char *key, double value);
+
+/**
+ * 字符串非空时才写入键值对
+ * @param writer 写入器
+ * @param key 键
+ * @param value 字符串，NULL 或空串时跳过
+ */
+void json_writer_member_nonempty(JsonWriter *writer, const char *key, const char *value);
+
+/**
+ * 写入字符串数组键值对
+ * @param writer 写入器
+ * @param key 键
+ * @param values 字符串数组
+ * @param count 数量，-1 表示以 NULL 结尾
+ */
+void json_writer_member_strv(JsonWriter *writer, const char *key, const char * const *values, gssize count);
+
+#endif // JSON_WRITER_H
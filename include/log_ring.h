@@ -0,0 +1,104 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <glib.h>
+
+// 单行日志最大长度，超出部分截断
+#define LOG_RING_MAX_LINE_LEN 4096
+
+// 日志来源
+typedef enum {
+    LOG_RING_STREAM_STDOUT,
+    LOG_RING_STREAM_STDERR
+} LogRingStream;
+
+// 日志行
+typedef struct {
+    char *text;                 // 不含换行符
+    gsize len;
+    guint64 seq;                // 单调递增的序号，从 1 开始
+    LogRingStream stream;
+} LogRingEntry;
+
+/**
+ * 遍历日志行的回调
+ * @param entry 日志行
+ * @param user_data 用户数据
+ */
+typedef void (*LogRingFunc)(const LogRingEntry *entry, gpointer user_data);
+
+// 固定容量的日志环形缓冲区：按行数和字节数双重限制，超出时淘汰最旧的行
+typedef struct {
+    LogRingEntry *entries;
+    guint capacity;             // 最大行数
+    gsize max_bytes;            // 所有行文本的最大字节数
+    guint head;                 // 最旧一行的下标
+    guint count;
+    gsize bytes;
+    guint64 next_seq;
+} LogRing;
+
+/**
+ * 创建日志环形缓冲区
+ * @param max_lines 最大行数
+ * @param max_bytes 最大字节数（仅统计文本）
+ * @return LogRing* 缓冲区实例
+ */
+LogRing* log_ring_new(guint max_lines, gsize max_bytes);
+
+/**
+ * 释放日志环形缓冲区
+ * @param ring 缓冲区实例
+ */
+void log_ring_free(LogRing *ring);
+
+/**
+ * 追加一行日志，去掉末尾换行符
+ * @param ring 缓冲区实例
+ * @param stream 日志来源
+ * @param line 日志内容
+ * @param len 长度，-1 表示以 NUL 结尾
+ */
+void log_ring_append(LogRing *ring, LogRingStream stream, const char *line, gssize len);
+
+/**
+ * 获取序号 >= since 的日志行，每行以换行符结尾追加到 out
+ * @param ring 缓冲区实例
+ * @param since 起始序号，0 表示从缓冲区中最旧的一行开始
+ * @param out 输出
+ * @return 下一次调用应传入的序号
+ */
+guint64 log_ring_fetch(LogRing *ring, guint64 since, GString *out);
+
+/**
+ * 按顺序遍历序号 >= since 的日志行
+ * @param ring 缓冲区实例
+ * @param since 起始序号，0 表示从缓冲区中最旧的一行开始
+ * @param func 回调
+ * @param user_data 回调用户数据
+ * @return 下一次调用应传入的序号
+ */
+guint64 log_ring_foreach(LogRing *ring, guint64 since, LogRingFunc func, gpointer user_data);
+
+/**
+ * 获取缓冲区中最旧一行的序号，早于此序号的行已被淘汰
+ * @param ring 缓冲区实例
+ * @return 最旧一行的序号，缓冲区为空时等于下一行的序号
+ */
+guint64 log_ring_first_seq(LogRing *ring);
+
+/**
+ * 调整容量，超出新容量的旧行被淘汰
+ * @param ring 缓冲区实例
+ * @param max_lines 最大行数
+ * @param max_bytes 最大字节数
+ */
+void log_ring_set_limits(LogRing *ring, guint max_lines, gsize max_bytes);
+
+/**
+ * 清空缓冲区，序号继续递增
+ * @param ring 缓冲区实例
+ */
+void log_ring_clear(LogRing *ring);
+
+#endif // LOG_RING_H
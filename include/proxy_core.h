@@ -0,0 +1,88 @@
+#ifndef PROXY_CORE_H
+#define PROXY_CORE_H
+
+#include <glib.h>
+#include "proxy_parser.h"
+
+// 代理内核类型
+typedef enum {
+    PROXY_CORE_V2RAY,
+    PROXY_CORE_XRAY,
+    PROXY_CORE_SINGBOX,
+    PROXY_CORE_COUNT
+} ProxyCoreType;
+
+// 代理内核后端：二进制查找、命令行、配置格式、版本和就绪检查
+typedef struct {
+    ProxyCoreType type;
+    const char *id;                         // "v2ray" / "xray" / "sing-box"
+    const char *display_name;
+    const char *binary_name;                // 在 PATH 中查找时使用的文件名
+    const char * const *binary_paths;       // 优先使用的安装位置，NULL 结尾
+    const char *version_arg;
+    const char *stats_path;                 // StatsService.QueryStats 的 gRPC 路径，NULL 表示不支持统计 API
+    const char *asset_env;                  // geo 数据目录的环境变量，NULL 表示不支持 ext: 引用
+    gboolean xtls;                          // 支持 VLESS XTLS Vision、REALITY 和 uTLS 指纹
+
+    /**
+     * 构造运行参数
+     * @param binary 二进制路径
+     * @param config_path 配置文件
+     * @return char** 参数数组，需要用 g_strfreev 释放
+     */
+    char** (*build_argv)(const char *binary, const char *config_path);
+
+    /**
+     * 生成配置文件内容
+     * @param configs 代理配置数组
+     * @param count 节点数量
+     * @param opts 生成选项
+     * @return char* 配置内容，需要用 g_free 释放；失败返回 NULL
+     */
+    char* (*generate_config)(ProxyConfig * const *configs, guint count, const ProxyGenOptions *opts);
+
+    /**
+     * 检查实例是否已就绪（可以接收透明代理流量）
+     * @param port 透明代理入站端口
+     * @return gboolean 就绪返回 TRUE
+     */
+    gboolean (*is_ready)(int port);
+} ProxyCoreBackend;
+
+/**
+ * 获取后端
+ * @param type 内核类型
+ * @return const ProxyCoreBackend* 后端，类型无效时返回 V2Ray 后端
+ */
+const ProxyCoreBackend* proxy_core_get(ProxyCoreType type);
+
+/**
+ * 按标识获取后端
+ * @param id "v2ray" / "xray" / "sing-box"
+ * @return const ProxyCoreBackend* 后端，未知标识返回 NULL
+ */
+const ProxyCoreBackend* proxy_core_from_id(const char *id);
+
+/**
+ * 查找后端的二进制：先检查安装位置，再在 PATH 中查找
+ * @param backend 后端
+ * @return char* 二进制路径，需要用 g_free 释放；未找到返回 NULL
+ */
+char* proxy_core_find_binary(const ProxyCoreBackend *backend);
+
+/**
+ * 获取内核版本（运行 "<binary> version"，取第一行）
+ * @param backend 后端
+ * @param binary 二进制路径
+ * @return char* 版本字符串，需要用 g_free 释放；失败返回 NULL
+ */
+char* proxy_core_get_version(const ProxyCoreBackend *backend, const char *binary);
+
+/**
+ * 检查本机 TCP 端口是否处于监听状态（读取 /proc/net/tcp，不建立连接）
+ * @param port 端口
+ * @return gboolean 正在监听返回 TRUE
+ */
+gboolean proxy_core_port_listening(int port);
+
+#endif // PROXY_CORE_H
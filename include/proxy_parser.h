@@ -48,8 +48,12 @@ typedef struct {
     char *type;
     char *host;
     char *path;
-    char *security;
+    char *security;             // "none" / "tls" / "reality"
     char *sni;
+    char *fingerprint;          // uTLS 指纹 (fp)，如 "chrome"
+    char *public_key;           // REALITY 公钥 (pbk)
+    char *short_id;             // REALITY short ID (sid)
+    char *spider_x;             // REALITY 爬虫初始路径 (spx)
 } VLessConfig;
 
 // Trojan 配置
@@ -64,10 +68,12 @@ typedef struct {
     char *path;
 } TrojanConfig;
 
-// 通用代理配置
+// 通用代理配置：由 proxy_parser_parse 创建，所有字符串与配置在同一块内存中，
+// 只读，用 proxy_parser_free 释放
 typedef struct {
     ProxyType type;
     char *name;
+    int mux;                    // 链接中的 mux 参数：0 跟随全局设置，-1 禁用，>0 为并发数
     union {
         SSConfig ss;
         VMessConfig vmess;
@@ -76,6 +82,73 @@ typedef struct {
     } config;
 } ProxyConfig;
 
+// FakeIP 默认参数
+#define PROXY_FAKEIP_DEFAULT_POOL "198.18.0.0/15"
+#define PROXY_FAKEIP_DEFAULT_POOL_SIZE 65535
+#define PROXY_FAKEIP_DEFAULT_DNS_PORT 1053
+#define PROXY_FAKEIP_UPSTREAM_DNS "223.5.5.5"
+
+// 统计 API 默认端口（仅监听 127.0.0.1）
+#define PROXY_STATS_API_DEFAULT_PORT 10085
+
+// 多节点负载均衡：observatory 探测地址和间隔，出站标签为 "proxy-<序号>"，均衡器标签为 "proxy"
+#define PROXY_BALANCER_PROBE_URL "https://www.gstatic.com/generate_204"
+#define PROXY_BALANCER_PROBE_INTERVAL "30s"
+#define PROXY_OUTBOUND_TAG "proxy"
+
+// 连接复用 (Mux.Cool)：多个代理连接共用一条到服务器的连接，省去每个连接的握手
+// XUDP 只有 Xray 支持，V2Ray 忽略这些字段
+#define PROXY_MUX_DEFAULT_CONCURRENCY 8
+#define PROXY_XUDP_DEFAULT_CONCURRENCY 16
+
+// 内核自身连接的 SO_MARK：透明代理规则放行带此标记的连接，避免回环（内核需要 CAP_NET_ADMIN）
+#define PROXY_SOCKET_MARK 255
+
+// 性能配置：决定出站的 sockopt（sing-box 为拨号字段）和 V2Ray 的 policy 等级参数
+typedef enum {
+    PROXY_PROFILE_DEFAULT,      // 内核默认值
+    PROXY_PROFILE_LOW_LATENCY,  // TCP Fast Open，短握手超时，空闲连接较快回收
+    PROXY_PROFILE_BULK,         // BBR 拥塞控制，大缓冲区，长空闲超时，适合大文件传输
+    PROXY_PROFILE_LOW_MEMORY,   // 小缓冲区，空闲和半关闭连接尽快释放
+    PROXY_PROFILE_COUNT
+} ProxyProfile;
+
+// OpenVPN 隧道网段，任何分流模式下都不经过代理
+#define PROXY_VPN_SUBNET "10.8.0.0/24"
+
+// 只含分流用到的类别的 geo 数据文件，位于配置目录，经 ext:文件名:类别 引用
+#define PROXY_GEOIP_LITE_FILE "geoip-lite.dat"
+#define PROXY_GEOSITE_LITE_FILE "geosite-lite.dat"
+
+// 分流规则：由 RouteManager 按路由配置编译，V2Ray 和 sing-box 配置按相同顺序生成
+// 先阻断 CIDR，再直连 CIDR 和 geoip:cn / geosite:cn，然后广告阻断，其余流量交给最终出站
+typedef struct {
+    gboolean final_direct;      // 未匹配的流量直连（直连模式），否则走代理
+    gboolean geoip_cn_direct;   // 引用 geoip:cn 直连
+    gboolean geosite_cn_direct; // 引用 geosite:cn 直连
+    gboolean block_ads;         // 引用 geosite:category-ads-all 阻断
+    char **direct_cidrs;        // 直连 CIDR，已聚合去重，NULL 结尾，可为 NULL
+    char **block_cidrs;         // 阻断 CIDR，已聚合去重，NULL 结尾，可为 NULL
+} ProxyRouteRules;
+
+// V2Ray 配置生成选项
+typedef struct {
+    int local_port;             // 透明代理入站端口
+    gboolean fakeip;            // FakeIP 模式：DNS 返回保留地址池中的地址，按域名路由，不嗅探流量
+    const char *fakeip_pool;    // FakeIP 地址池 (CIDR)
+    int fakeip_pool_size;       // FakeIP 映射表容量 (LRU 淘汰)
+    int dns_port;               // FakeIP 模式下 DNS 入站端口
+    int api_port;               // 统计 API 入站端口，0 表示不启用统计
+    const char *probe_url;      // 多节点时 observatory 的探测地址
+    const char *probe_interval; // 多节点时 observatory 的探测间隔
+    int mux_concurrency;        // 全局 Mux 并发数，0 表示不启用；节点的 mux 参数优先
+    gboolean xudp;              // Mux 启用时 UDP 经 XUDP 传输 (Xray；sing-box 为 packet_encoding)
+    ProxyProfile profile;       // 性能配置
+    const ProxyRouteRules *routes;  // 分流规则，NULL 表示默认规则（隧道网段和中国大陆直连，广告阻断）
+    gboolean geo_lite;          // V2Ray/Xray 引用精简的 geo 数据文件而不是完整的 geoip.dat / geosite.dat
+    gboolean xtls;              // 内核支持 VLESS flow (XTLS Vision)、REALITY 和 uTLS 指纹；否则忽略 uTLS 指纹，需要 XTLS 的节点不能生成
+} ProxyGenOptions;
+
 /**
  * 解析代理链接
  * @param url 代理链接 (ss://, vmess://, vless://, trojan://)
@@ -96,6 +169,65 @@ void proxy_parser_free(ProxyConfig *config);
  */
 const char* proxy_parser_get_type_string(ProxyType type);
 
+/**
+ * 获取节点服务器地址，用于延迟探测
+ * @param config 代理配置
+ * @param host 输出服务器地址
+ * @param port 输出服务器端口
+ * @param tls 输出是否使用 TLS，可为 NULL
+ * @param sni 输出 TLS 服务器名，未设置时为服务器地址，可为 NULL
+ * @return gboolean 地址有效返回 TRUE
+ */
+gboolean proxy_parser_get_endpoint(const ProxyConfig *config, const char **host, int *port,
+                                   gboolean *tls, const char **sni);
+
+/**
+ * 节点是否需要 XTLS Vision 或 REALITY（只有 Xray 和 sing-box 支持）
+ * @param config 代理配置
+ * @return gboolean 需要返回 TRUE
+ */
+gboolean proxy_parser_needs_xtls(const ProxyConfig *config);
+
+/**
+ * 获取性能配置的显示名称
+ * @param profile 性能配置
+ * @return 名称字符串
+ */
+const char* proxy_parser_profile_to_string(ProxyProfile profile);
+
+/**
+ * 分流规则引用的 geo 数据类别，与生成的配置一致
+ * @param rules 分流规则，NULL 表示默认规则
+ * @param geosite TRUE 返回 geosite.dat 中的类别，FALSE 返回 geoip.dat 中的类别
+ * @return char** 类别代码，NULL 结尾，需要用 g_strfreev 释放；未引用该文件时返回 NULL
+ */
+char** proxy_route_rules_geo_codes(const ProxyRouteRules *rules, gboolean geosite);
+
+/**
+ * 释放分流规则
+ * @param rules 分流规则，可为 NULL
+ */
+void proxy_route_rules_free(ProxyRouteRules *rules);
+
+/**
+ * 计算节点指纹，作为节点的标识用于去重和订阅同步：只包含协议、地址、端口、凭据和传输参数，
+ * 不含节点名称和 mux 等调优参数；地址不区分大小写，取默认值的字段（如 network=tcp）与省略等价
+ * @param config 代理配置
+ * @return guint64 64 位 FNV-1a 指纹
+ */
+guint64 proxy_parser_fingerprint(const ProxyConfig *config);
+
+/**
+ * 计算生成配置的内容哈希：各节点指纹和 mux（按顺序）加上所有生成选项，
+ * 哈希相同则 proxy_parser_generate_v2ray_config_multi 生成的配置在语义上相同
+ * 生成器新增输入时必须同时加入这里
+ * @param configs 代理配置数组
+ * @param count 节点数量
+ * @param opts 生成选项
+ * @return guint64 64 位 FNV-1a 哈希
+ */
+guint64 proxy_parser_config_hash(ProxyConfig * const *configs, guint count, const ProxyGenOptions *opts);
+
 /**
  * 生成 V2Ray 配置 JSON
  * @param config 代理配置
@@ -104,4 +236,44 @@ const char* proxy_parser_get_type_string(ProxyType type);
  */
 char* proxy_parser_generate_v2ray_config(ProxyConfig *config, int local_port);
 
+/**
+ * 初始化配置生成选项为默认值
+ * @param opts 选项
+ * @param local_port 本地监听端口
+ */
+void proxy_parser_gen_options_init(ProxyGenOptions *opts, int local_port);
+
+/**
+ * 按选项生成 V2Ray 配置 JSON
+ * @param config 代理配置
+ * @param opts 生成选项
+ * @return JSON 字符串，需要用 g_free 释放
+ */
+char* proxy_parser_generate_v2ray_config_ex(ProxyConfig *config, const ProxyGenOptions *opts);
+
+/**
+ * 按选项生成多节点 V2Ray 配置 JSON
+ * 只有一个节点时与 proxy_parser_generate_v2ray_config_ex 相同；多个节点时每个节点一个出站，
+ * 由 observatory 定期探测、leastPing 均衡器选择延迟最低的可用节点，节点失效时自动切走。
+ * opts->xtls 为 FALSE 时有节点需要 XTLS（proxy_parser_needs_xtls）则返回 NULL，调用者应先跳过这些节点
+ * @param configs 代理配置数组
+ * @param count 节点数量
+ * @param opts 生成选项
+ * @return JSON 字符串，需要用 g_free 释放
+ */
+char* proxy_parser_generate_v2ray_config_multi(ProxyConfig * const *configs, guint count,
+                                               const ProxyGenOptions *opts);
+
+/**
+ * 按选项生成 sing-box 配置 JSON（sing-box 1.8 - 1.11 的格式）
+ * 出站标签与 V2Ray 配置相同；多个节点时由 urltest 出站选择延迟最低的节点。
+ * sing-box 发布版本不含统计 API，忽略 api_port
+ * @param configs 代理配置数组
+ * @param count 节点数量
+ * @param opts 生成选项
+ * @return JSON 字符串，需要用 g_free 释放
+ */
+char* proxy_parser_generate_singbox_config(ProxyConfig * const *configs, guint count,
+                                           const ProxyGenOptions *opts);
+
 #endif // PROXY_PARSER_H
\ No newline at end of file
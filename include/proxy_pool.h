@@ -0,0 +1,270 @@
+#ifndef PROXY_POOL_H
+#define PROXY_POOL_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "proxy_parser.h"
+
+// 并发探测的工作线程数和单次探测超时
+#define PROXY_POOL_PROBE_THREADS 16
+#define PROXY_POOL_PROBE_TIMEOUT_S 5
+
+// 默认每 60 秒重新探测一轮
+#define PROXY_POOL_DEFAULT_INTERVAL_MS 60000
+
+// 连续失败达到此次数的节点视为不可用
+#define PROXY_POOL_MAX_FAILURES 2
+
+// 生成配置时最多使用的节点数（延迟最低的可用节点）
+#define PROXY_POOL_MAX_ACTIVE 8
+
+// 导入时行数达到此值才分给多个线程并行解析
+#define PROXY_POOL_PARALLEL_MIN_LINES 256
+#define PROXY_POOL_MAX_PARSE_THREADS 8
+
+// 订阅文件大小上限
+#define PROXY_POOL_MAX_IMPORT_SIZE (64 * 1024 * 1024)
+
+// 节点状态
+typedef enum {
+    PROXY_NODE_UNKNOWN,         // 尚未探测
+    PROXY_NODE_HEALTHY,         // 最近一次探测成功
+    PROXY_NODE_DEGRADED,        // 最近一次探测失败，但未达到失败上限
+    PROXY_NODE_DOWN             // 连续失败，不再使用
+} ProxyNodeState;
+
+// 节点：字符串都存放在节点池的 GStringChunk 中，生成配置时再按 url 重新解析
+typedef struct {
+    const char *url;
+    const char *name;
+    const char *host;
+    const char *sni;            // TLS 服务器名，未设置时同 host
+    guint64 fingerprint;        // proxy_parser_fingerprint，节点的标识，用于去重和同步
+    ProxyType type;
+    int port;
+    gboolean tls;
+    ProxyNodeState state;
+    gint64 latency_us;          // 最近一次成功探测的延迟（TCP 连接 + TLS 握手）
+    gint64 smoothed_us;         // 平滑后的延迟，用于排序
+    guint failures;             // 连续失败次数
+    gboolean probing;
+} ProxyNode;
+
+// 导入结果统计
+typedef struct {
+    guint lines;                // 非空行数
+    guint added;                // 新增节点数
+    guint duplicates;           // 追加时与已有节点或同批节点指纹相同、同步时与同批节点相同而跳过的行数
+    guint failed;               // 无法解析的行数
+    guint kept;                 // 同步时保留的已有节点数（保留探测状态）
+    guint removed;              // 同步时移除的已有节点数
+} ProxyPoolImportStats;
+
+// 节点索引的槽位
+typedef struct {
+    guint64 key;                // 指纹或名称的哈希
+    guint node;                 // 节点下标 + 1，0 表示空位
+} ProxyNodeSlot;
+
+// 开放寻址（线性探测）哈希索引，只增不删，节点列表重建时整体重建
+typedef struct {
+    ProxyNodeSlot *slots;
+    guint capacity;             // 2 的幂，0 表示尚未分配
+    guint count;
+} ProxyNodeIndex;
+
+typedef struct ProxyPool ProxyPool;
+
+/**
+ * 一轮探测完成回调（主循环中调用）
+ * @param pool 节点池
+ * @param user_data 用户数据
+ */
+typedef void (*ProxyPoolFunc)(ProxyPool *pool, gpointer user_data);
+
+// 节点池
+struct ProxyPool {
+    GArray *nodes;              // ProxyNode，按添加顺序
+    GStringChunk *strings;      // 节点字符串，相同的地址/SNI 只存一份
+    ProxyNodeIndex by_fingerprint;  // 指纹 -> 节点
+    ProxyNodeIndex by_name;     // 名称 -> 第一个同名节点
+    guint generation;           // 节点列表变化时递增，丢弃旧列表的探测结果
+    GThreadPool *workers;       // 探测线程池，结果经队列交回主循环
+    guint pending;              // 尚未返回的探测数
+    guint drain_id;
+    guint probe_timer_id;
+    guint probe_interval_ms;
+    ProxyPoolFunc changed_func;
+    gpointer changed_data;
+};
+
+/**
+ * 创建节点池
+ * @return ProxyPool* 节点池
+ */
+ProxyPool* proxy_pool_new(void);
+
+/**
+ * 释放节点池，等待正在进行的探测结束
+ * @param pool 节点池
+ */
+void proxy_pool_free(ProxyPool *pool);
+
+/**
+ * 添加节点：每行一个代理链接，或整段 base64 编码的订阅内容
+ * 行数较多时并行解析，按指纹去重，已有节点保持不变
+ * @param pool 节点池
+ * @param text 链接或订阅内容
+ * @return guint 新增节点数
+ */
+guint proxy_pool_add_text(ProxyPool *pool, const char *text);
+
+/**
+ * 添加节点并返回统计
+ * @param pool 节点池
+ * @param text 链接或订阅内容
+ * @param stats 输出统计，可为 NULL
+ * @return guint 新增节点数
+ */
+guint proxy_pool_add_text_full(ProxyPool *pool, const char *text, ProxyPoolImportStats *stats);
+
+/**
+ * 同步节点：用 text 中的节点替换节点池，指纹相同的已有节点保留延迟、失败次数等探测状态，
+ * 名称和链接更新为新内容，text 中没有的节点移除；节点顺序按 text
+ * 没有解析出任何节点时节点池保持不变
+ * @param pool 节点池
+ * @param text 链接或订阅内容
+ * @param stats 输出统计，可为 NULL
+ * @return guint 新增节点数
+ */
+guint proxy_pool_sync_text(ProxyPool *pool, const char *text, ProxyPoolImportStats *stats);
+
+/**
+ * 在工作线程中读取订阅文件、解码并并行解析，完成后在主循环中合并到节点池
+ * @param pool 节点池，必须在回调前保持有效
+ * @param path 文件路径，"-" 表示标准输入
+ * @param sync TRUE 时按 proxy_pool_sync_text 同步，FALSE 时按 proxy_pool_add_text 追加
+ * @param cancellable 取消对象，可为 NULL
+ * @param callback 完成回调
+ * @param user_data 回调用户数据
+ */
+void proxy_pool_import_file_async(ProxyPool *pool, const char *path, gboolean sync,
+                                  GCancellable *cancellable, GAsyncReadyCallback callback,
+                                  gpointer user_data);
+
+/**
+ * 合并导入结果
+ * @param pool 节点池
+ * @param result 异步结果
+ * @param stats 输出统计，可为 NULL
+ * @param error 错误信息
+ * @return gboolean 成功返回 TRUE
+ */
+gboolean proxy_pool_import_file_finish(ProxyPool *pool, GAsyncResult *result,
+                                       ProxyPoolImportStats *stats, GError **error);
+
+/**
+ * 清空节点
+ * @param pool 节点池
+ */
+void proxy_pool_clear(ProxyPool *pool);
+
+/**
+ * 获取节点数量
+ * @param pool 节点池
+ * @return guint 节点数量
+ */
+guint proxy_pool_size(ProxyPool *pool);
+
+/**
+ * 按指纹查找节点，O(1)
+ * @param pool 节点池
+ * @param fingerprint proxy_parser_fingerprint 的结果
+ * @return ProxyNode* 节点（属于节点池，添加、同步或清空节点后失效），不存在时返回 NULL
+ */
+ProxyNode* proxy_pool_lookup(ProxyPool *pool, guint64 fingerprint);
+
+/**
+ * 按名称查找节点，O(1)；有多个同名节点时返回最先添加的
+ * @param pool 节点池
+ * @param name 节点名称
+ * @return ProxyNode* 节点（属于节点池，添加、同步或清空节点后失效），不存在时返回 NULL
+ */
+ProxyNode* proxy_pool_lookup_name(ProxyPool *pool, const char *name);
+
+/**
+ * 设置一轮探测完成回调
+ * @param pool 节点池
+ * @param func 回调，NULL 表示取消
+ * @param user_data 用户数据
+ */
+void proxy_pool_set_changed_func(ProxyPool *pool, ProxyPoolFunc func, gpointer user_data);
+
+/**
+ * 立即在工作线程池中并发探测所有节点（正在探测的节点跳过）
+ * @param pool 节点池
+ */
+void proxy_pool_probe_all(ProxyPool *pool);
+
+/**
+ * 开始定期探测，并立即探测一轮
+ * @param pool 节点池
+ * @param interval_ms 间隔
+ */
+void proxy_pool_start_probing(ProxyPool *pool, guint interval_ms);
+
+/**
+ * 停止定期探测
+ * @param pool 节点池
+ */
+void proxy_pool_stop_probing(ProxyPool *pool);
+
+/**
+ * 是否有探测正在进行
+ * @param pool 节点池
+ * @return gboolean 有探测正在进行返回 TRUE
+ */
+gboolean proxy_pool_is_probing(ProxyPool *pool);
+
+/**
+ * 按可用性和延迟排序的节点列表
+ * @param pool 节点池
+ * @return GPtrArray* 元素为 ProxyNode*（属于节点池，添加或清空节点后失效），用 g_ptr_array_unref 释放
+ */
+GPtrArray* proxy_pool_ranked(ProxyPool *pool);
+
+/**
+ * 为配置生成选出最多 max 个节点：优先可用节点，按延迟升序；没有探测结果时按添加顺序
+ * @param pool 节点池
+ * @param max 最多节点数
+ * @return GPtrArray* 元素为新解析的 ProxyConfig*，释放数组时一并释放
+ */
+GPtrArray* proxy_pool_select(ProxyPool *pool, guint max);
+
+/**
+ * 计算节点选择的标识，用于判断可用节点集合是否变化
+ * @param pool 节点池
+ * @param max 最多节点数
+ * @return char* 已排序的节点链接拼接，需要用 g_free 释放
+ */
+char* proxy_pool_selection_key(ProxyPool *pool, guint max);
+
+/**
+ * 判断按 key 选出的节点是否需要重新选择：其中有节点已不可用或被移除，
+ * 或者可用节点增多、当前选择不足 max 个
+ * 延迟排名的小幅波动不触发重新选择，节点间的选择由均衡器负责
+ * @param pool 节点池
+ * @param key proxy_pool_selection_key 的结果
+ * @param max 最多节点数
+ * @return gboolean 需要重新选择返回 TRUE
+ */
+gboolean proxy_pool_selection_stale(ProxyPool *pool, const char *key, guint max);
+
+/**
+ * 获取节点状态字符串
+ * @param state 状态
+ * @return 状态字符串
+ */
+const char* proxy_pool_state_string(ProxyNodeState state);
+
+#endif // PROXY_POOL_H
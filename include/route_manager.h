@@ -4,6 +4,7 @@
 #include <glib.h>
 #include <libnm/NetworkManager.h>
 #include "structs.h"
+#include "proxy_parser.h"
 
 // 路由动作类型
 typedef enum {
@@ -48,6 +49,9 @@ RouteManager* route_manager_new(void);
 // 释放路由管理器
 void route_manager_free(RouteManager *manager);
 
+// 路由配置文件路径（用户配置目录下的 ovpn-client/route_config.ini），需要 g_free
+char* route_manager_get_config_path(void);
+
 // 加载路由配置
 gboolean route_manager_load_config(RouteManager *manager, const char *config_file);
 
@@ -72,6 +76,17 @@ void route_manager_get_stats(RouteManager *manager, int *direct_count, int *vpn_
 // 导出路由规则到文件
 gboolean route_manager_export_rules(RouteManager *manager, const char *output_file);
 
+/**
+ * 把路由配置编译为代理内核的分流规则，与 NetworkManager 路由使用同一份配置
+ * 全局模式：除隧道网段和自定义走VPN网段外全部走代理；直连模式：全部直连；
+ * PAC 模式：私有网段、中国大陆（指定了 GeoIP 文件时使用文件中的网段，否则引用 geoip:cn）
+ * 和自定义直连网段直连，广告阻断，其余走代理。自定义阻断网段在所有模式下生效。
+ * 同一动作的 CIDR 合并为最少的网段，被阻断网段覆盖的直连网段去掉
+ * @param manager 路由管理器
+ * @return 分流规则，用 proxy_route_rules_free 释放
+ */
+ProxyRouteRules* route_manager_compile_proxy_rules(RouteManager *manager);
+
 // 测试IP是否匹配某个CIDR
 gboolean route_manager_ip_match_cidr(const char *ip, const char *cidr);
 
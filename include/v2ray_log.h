@@ -0,0 +1,122 @@
+#ifndef V2RAY_LOG_H
+#define V2RAY_LOG_H
+
+#include <glib.h>
+
+// 统计上限：出站标签数量有限，目的地址按 Space-Saving 算法只保留访问最多的若干个
+#define V2RAY_LOG_MAX_OUTBOUNDS 64
+#define V2RAY_LOG_MAX_DESTINATIONS 512
+
+// 错误率统计窗口（秒）
+#define V2RAY_LOG_WINDOW_SECONDS 60
+
+// 日志事件类型
+typedef enum {
+    V2RAY_EVENT_NONE,           // 无法识别或不关心的行
+    V2RAY_EVENT_ACCEPTED,       // 访问日志：连接已接受并路由到出站
+    V2RAY_EVENT_REJECTED,       // 访问日志：连接被拒绝
+    V2RAY_EVENT_DIAL_FAILED,    // 错误日志：连接目标或代理服务器失败
+    V2RAY_EVENT_TLS_ERROR,      // 错误日志：TLS 握手或证书错误
+    V2RAY_EVENT_ERROR           // 错误日志：其他 [Error] 级别错误
+} V2RayEventType;
+
+// 解析后的日志事件
+typedef struct {
+    V2RayEventType type;
+    char network[8];            // tcp / udp
+    char destination[256];      // 目的主机（不含端口），未知时为空
+    char inbound_tag[64];
+    char outbound_tag[64];
+} V2RayLogEvent;
+
+// 计数器
+typedef struct {
+    char *key;
+    guint64 connections;
+    guint64 failures;
+} V2RayLogCounter;
+
+// 每秒一个桶的滑动窗口
+typedef struct {
+    gint64 second;
+    guint accepted;
+    guint failures;
+} V2RayLogBucket;
+
+// 日志统计
+typedef struct {
+    guint64 accepted;
+    guint64 rejected;
+    guint64 dial_failures;
+    guint64 tls_errors;
+    guint64 errors;
+    GHashTable *outbounds;      // 出站标签 -> V2RayLogCounter
+    GHashTable *destinations;   // 目的主机 -> V2RayLogCounter
+    V2RayLogBucket window[V2RAY_LOG_WINDOW_SECONDS];
+} V2RayLogStats;
+
+/**
+ * 解析一行 V2Ray/Xray 日志（访问日志或错误日志）
+ * @param line 日志行
+ * @param len 长度，-1 表示以 NUL 结尾
+ * @param event 输出事件
+ * @return gboolean 识别出事件返回 TRUE
+ */
+gboolean v2ray_log_parse_line(const char *line, gssize len, V2RayLogEvent *event);
+
+/**
+ * 创建日志统计
+ * @return V2RayLogStats* 统计实例
+ */
+V2RayLogStats* v2ray_log_stats_new(void);
+
+/**
+ * 释放日志统计
+ * @param stats 统计实例
+ */
+void v2ray_log_stats_free(V2RayLogStats *stats);
+
+/**
+ * 清空统计
+ * @param stats 统计实例
+ */
+void v2ray_log_stats_reset(V2RayLogStats *stats);
+
+/**
+ * 记录一个事件
+ * @param stats 统计实例
+ * @param event 事件
+ * @param now_us 当前单调时间（微秒）
+ */
+void v2ray_log_stats_add(V2RayLogStats *stats, const V2RayLogEvent *event, gint64 now_us);
+
+/**
+ * 解析一行日志并记录
+ * @param stats 统计实例
+ * @param line 日志行
+ * @param len 长度，-1 表示以 NUL 结尾
+ * @param now_us 当前单调时间（微秒）
+ */
+void v2ray_log_stats_feed(V2RayLogStats *stats, const char *line, gssize len, gint64 now_us);
+
+/**
+ * 统计最近若干秒内的连接数和失败数（拨号失败 + TLS 错误）
+ * @param stats 统计实例
+ * @param seconds 窗口大小，最大 V2RAY_LOG_WINDOW_SECONDS
+ * @param now_us 当前单调时间（微秒）
+ * @param accepted 输出连接数，可为 NULL
+ * @param failures 输出失败数，可为 NULL
+ * @return 失败率 failures / (accepted + failures)，无数据时为 0
+ */
+double v2ray_log_stats_error_rate(V2RayLogStats *stats, guint seconds, gint64 now_us,
+                                  guint *accepted, guint *failures);
+
+/**
+ * 按连接数降序获取计数器
+ * @param table stats->outbounds 或 stats->destinations
+ * @param limit 最多返回的数量，0 表示全部
+ * @return GPtrArray* 元素为 V2RayLogCounter*（属于统计实例），用 g_ptr_array_unref 释放
+ */
+GPtrArray* v2ray_log_stats_top(GHashTable *table, guint limit);
+
+#endif // V2RAY_LOG_H
@@ -3,6 +3,15 @@
 
 #include <glib.h>
 #include "proxy_parser.h"
+#include "proxy_core.h"
+#include "proxy_pool.h"
+#include "log_ring.h"
+#include "v2ray_log.h"
+#include "v2ray_stats.h"
+
+// 日志缓冲区默认容量
+#define V2RAY_LOG_DEFAULT_MAX_LINES 2000
+#define V2RAY_LOG_DEFAULT_MAX_BYTES (512 * 1024)
 
 // V2Ray 状态
 typedef enum {
@@ -13,18 +22,114 @@ typedef enum {
     V2RAY_STATUS_ERROR
 } V2RayStatus;
 
+// 看门狗状态
+typedef enum {
+    V2RAY_WATCHDOG_IDLE,        // 未监控（V2Ray 未运行）
+    V2RAY_WATCHDOG_HEALTHY,     // 进程存活且入站端口在监听
+    V2RAY_WATCHDOG_FAILED_OPEN, // V2Ray 异常，已清空透明代理门控链放行流量
+    V2RAY_WATCHDOG_RECOVERING   // 已重启，等待入站端口就绪后恢复透明代理
+} V2RayWatchdogState;
+
+// 透明代理规则的实际状态，由脚本的执行结果维护，与界面开关无关
+typedef enum {
+    V2RAY_TPROXY_ABSENT,        // 规则不存在
+    V2RAY_TPROXY_ACTIVE,        // 规则生效，流量导入 V2Ray
+    V2RAY_TPROXY_BYPASSED,      // 规则保留，门控链已清空，流量直接放行
+    V2RAY_TPROXY_UNKNOWN        // 脚本中途失败或尚未确认，规则可能存在
+} V2RayTProxyRules;
+
+struct V2RayManager_opaque;
+
+// V2Ray 进程实例（热切换中的备用实例或排空中的旧实例），定义在 v2ray_manager.c
+typedef struct V2RayInstance V2RayInstance;
+
+// V2Ray 进程的 stdout/stderr 读取管道，定义在 v2ray_manager.c
+typedef struct V2RayOutput V2RayOutput;
+struct V2RaySwapJob;
+
+/**
+ * 异步操作完成回调
+ * @param manager 管理器实例
+ * @param success 操作是否成功
+ * @param error 失败原因，成功时为 NULL
+ * @param user_data 用户数据
+ */
+typedef void (*V2RayCompletionFunc)(struct V2RayManager_opaque *manager, gboolean success,
+                                    const GError *error, gpointer user_data);
+
 // V2Ray 管理器 - 使用与 structs.h 中一致的不透明类型名
 typedef struct V2RayManager_opaque {
     GPid v2ray_pid;
     V2RayStatus status;
-    ProxyConfig *current_config;
-    char *config_path;
-    char *v2ray_binary;
-    int local_port;
-    gboolean tproxy_enabled;
-    GIOChannel *log_channel;
-    guint log_watch_id;
-    GString *log_buffer;
+    GPtrArray *current_configs; // ProxyConfig*，多个节点时由均衡器选择
+    char *config_dir;
+    char *config_path;          // 活动槽位的配置文件
+    guint64 slot_config_hash[2];// 各槽位配置文件的内容哈希，0 表示未知
+    gboolean slot_config_fakeip[2]; // 各槽位配置文件是否启用了 FakeIP
+    gboolean slot_fakeip[2];    // 各槽位运行中实例的配置是否启用了 FakeIP，透明代理脚本据此劫持 DNS
+    gboolean restart_needed;    // 活动槽位配置已改写，运行中的实例仍在使用旧配置
+    const ProxyCoreBackend *backend;    // 代理内核：V2Ray / Xray / sing-box
+    char *v2ray_binary;         // 当前内核的二进制路径
+    int local_port;             // 活动槽位的入站端口 = base_port + active_slot
+    gboolean tproxy_enabled;    // 透明代理已由用户启用且规则生效
+    V2RayTProxyRules tproxy_rules;  // 规则的实际状态
+    guint tproxy_pending;       // 用户发起、尚未完成的透明代理切换数
+    gboolean fakeip_enabled;
+    int fakeip_pool_size;
+    int mux_concurrency;        // 全局 Mux 并发数，0 表示不启用
+    gboolean xudp_enabled;      // Mux 启用时 UDP 经 XUDP 传输
+    ProxyProfile profile;       // 性能配置
+    ProxyRouteRules *route_rules;   // 由 RouteManager 编译的分流规则，NULL 时使用默认规则
+    gboolean geo_lite;          // 配置目录中的精简 geo 数据文件可用，内核资源目录指向配置目录
+    int dns_port;               // 活动槽位的 DNS 入站端口 = base_dns_port + active_slot
+    V2RayOutput *output;        // 活动实例的输出管道
+    LogRing *log_ring;          // 有界日志缓冲区
+    V2RayLogStats *log_stats;   // 从日志解析出的连接统计
+    
+    // 统计 API：每个槽位的端口 = base_api_port + slot
+    int base_api_port;
+    int api_port;               // 活动槽位的统计 API 端口
+    V2RayTrafficTable *traffic; // 各入站/出站的累计流量和速率
+    guint stats_timer_id;
+    GCancellable *stats_cancellable;
+    gboolean stats_in_flight;
+    gboolean stats_xray_path;   // V2Ray 路径不存在时改用 Xray 的服务路径
+    
+    // 看门狗
+    V2RayWatchdogState watchdog_state;
+    guint child_watch_id;
+    guint health_timer_id;
+    guint restart_timer_id;
+    int probe_failures;
+    gboolean probe_seen_ready;
+    gint64 spawn_time;
+    int restart_attempts;
+    int last_exit_status;
+    gboolean tproxy_rearm;      // 恢复后需要重新启用透明代理
+    
+    // 启动就绪：入站端口开始监听后才进入 RUNNING 并启用透明代理
+    guint ready_timer_id;
+    guint ready_interval_ms;    // 下一次就绪探测的间隔，逐次加倍
+    guint64 ready_log_seq;      // 本次启动的第一行日志，启动失败时从这里找原因
+    gint64 ready_time_us;       // 最近一次启动从创建进程到就绪的耗时，-1 表示尚未就绪
+    GSList *start_waiters;      // 等待启动完成的回调
+    
+    // 异步生命周期
+    guint kill_timer_id;        // SIGTERM 超时后升级为 SIGKILL
+    GSList *stop_waiters;       // 等待停止完成的回调
+    
+    // 蓝绿热切换：两个槽位交替使用相邻端口和各自的配置文件
+    int base_port;
+    int base_dns_port;
+    int active_slot;            // 0 或 1
+    V2RayInstance *standby;     // 正在启动、等待就绪的新实例
+    V2RayInstance *draining;    // 已切走流量、等待连接排空的旧实例
+    struct V2RaySwapJob *swap_job;
+    
+    // 节点池：定期探测延迟，可用节点集合变化时自动热切换
+    ProxyPool *pool;
+    gboolean pool_active;       // 当前配置来自节点池
+    char *pool_key;             // 当前配置使用的节点集合
 } V2RayManager;
 
 /**
@@ -48,27 +153,136 @@ void v2ray_manager_free(V2RayManager *manager);
 gboolean v2ray_manager_set_config(V2RayManager *manager, ProxyConfig *config);
 
 /**
- * 启动 V2Ray
+ * 设置多个节点的代理配置
  * @param manager 管理器实例
- * @param error 错误信息
+ * @param configs ProxyConfig* 数组（接管所有权，需带 proxy_parser_free 释放函数）
  * @return gboolean 成功返回 TRUE
  */
-gboolean v2ray_manager_start(V2RayManager *manager, GError **error);
+gboolean v2ray_manager_set_configs(V2RayManager *manager, GPtrArray *configs);
+
+/**
+ * 设置连接复用：运行中修改时改写配置，重启或热切换节点后生效
+ * @param manager 管理器实例
+ * @param concurrency 每条连接承载的最大代理连接数，0 表示不启用
+ * @param xudp UDP 是否经 XUDP 传输 (Xray)
+ */
+void v2ray_manager_set_mux(V2RayManager *manager, int concurrency, gboolean xudp);
+
+/**
+ * 设置性能配置：运行中修改时改写配置，重启或热切换节点后生效
+ * @param manager 管理器实例
+ * @param profile 性能配置
+ */
+void v2ray_manager_set_profile(V2RayManager *manager, ProxyProfile profile);
+
+/**
+ * 设置分流规则：运行中修改时改写配置，重启或热切换节点后生效
+ * @param manager 管理器实例
+ * @param rules 分流规则（接管所有权），NULL 恢复默认规则
+ */
+void v2ray_manager_set_route_rules(V2RayManager *manager, ProxyRouteRules *rules);
 
 /**
- * 停止 V2Ray
+ * 切换代理内核，只能在停止状态下切换；已设置的节点按新内核的格式重新生成配置
  * @param manager 管理器实例
+ * @param type 内核类型
+ * @param error 错误信息
  * @return gboolean 成功返回 TRUE
  */
-gboolean v2ray_manager_stop(V2RayManager *manager);
+gboolean v2ray_manager_set_backend(V2RayManager *manager, ProxyCoreType type, GError **error);
 
 /**
- * 重启 V2Ray
+ * 获取当前代理内核
+ * @param manager 管理器实例
+ * @return const ProxyCoreBackend* 后端
+ */
+const ProxyCoreBackend* v2ray_manager_get_backend(V2RayManager *manager);
+
+/**
+ * 运行中的 V2Ray 是否需要重启才能使用最新写入的配置
+ * 配置内容未变化时不会改写文件，也不需要重启
+ * @param manager 管理器实例
+ * @return gboolean 需要重启返回 TRUE
+ */
+gboolean v2ray_manager_needs_restart(V2RayManager *manager);
+
+/**
+ * 启动 V2Ray：创建进程后即返回，状态为 STARTING，入站端口就绪后才变为 RUNNING 并启用透明代理
  * @param manager 管理器实例
  * @param error 错误信息
  * @return gboolean 成功返回 TRUE
  */
-gboolean v2ray_manager_restart(V2RayManager *manager, GError **error);
+gboolean v2ray_manager_start(V2RayManager *manager, GError **error);
+
+/**
+ * 异步启动 V2Ray，入站端口就绪（或启动失败、超时）后回调
+ * @param manager 管理器实例
+ * @param callback 完成回调，可为 NULL，总是在主循环中调用
+ * @param user_data 回调用户数据
+ */
+void v2ray_manager_start_async(V2RayManager *manager, V2RayCompletionFunc callback, gpointer user_data);
+
+/**
+ * 异步停止 V2Ray：先撤除透明代理，再发送 SIGTERM，超时后由定时器升级为 SIGKILL；
+ * 透明代理规则未能撤除时先放行流量，进程退出后以错误回调
+ * @param manager 管理器实例
+ * @param callback 完成回调，可为 NULL，总是在主循环中调用
+ * @param user_data 回调用户数据
+ */
+void v2ray_manager_stop_async(V2RayManager *manager, V2RayCompletionFunc callback, gpointer user_data);
+
+/**
+ * 异步重启 V2Ray：进程确认退出后再启动
+ * @param manager 管理器实例
+ * @param callback 完成回调，可为 NULL，总是在主循环中调用
+ * @param user_data 回调用户数据
+ */
+void v2ray_manager_restart_async(V2RayManager *manager, V2RayCompletionFunc callback, gpointer user_data);
+
+/**
+ * 热切换代理配置：在备用端口启动新实例，就绪后原子切换透明代理规则，
+ * 旧实例排空现有连接后停止。V2Ray 未运行时等同于 v2ray_manager_set_config；
+ * 生成的配置与运行中的相同时不切换，直接成功回调
+ * @param manager 管理器实例
+ * @param config 新的代理配置（接管所有权，失败时释放）
+ * @param callback 完成回调（流量已切换到新实例），可为 NULL，总是在主循环中调用
+ * @param user_data 回调用户数据
+ */
+void v2ray_manager_swap_config_async(V2RayManager *manager, ProxyConfig *config,
+                                     V2RayCompletionFunc callback, gpointer user_data);
+
+/**
+ * 热切换到多个节点的配置，同 v2ray_manager_swap_config_async
+ * @param manager 管理器实例
+ * @param configs ProxyConfig* 数组（接管所有权，需带 proxy_parser_free 释放函数）
+ * @param callback 完成回调，可为 NULL
+ * @param user_data 回调用户数据
+ */
+void v2ray_manager_swap_configs_async(V2RayManager *manager, GPtrArray *configs,
+                                      V2RayCompletionFunc callback, gpointer user_data);
+
+/**
+ * 获取节点池，可向其中添加节点
+ * @param manager 管理器实例
+ * @return ProxyPool* 节点池（属于管理器）
+ */
+ProxyPool* v2ray_manager_get_pool(V2RayManager *manager);
+
+/**
+ * 使用节点池：选出延迟最低的可用节点生成均衡配置（运行中热切换），
+ * 并开始定期探测，可用节点集合变化时自动热切换
+ * @param manager 管理器实例
+ * @param callback 完成回调，可为 NULL，总是在主循环中调用
+ * @param user_data 回调用户数据
+ */
+void v2ray_manager_use_pool_async(V2RayManager *manager, V2RayCompletionFunc callback, gpointer user_data);
+
+/**
+ * 是否有热切换正在进行（新实例尚未接管流量）
+ * @param manager 管理器实例
+ * @return gboolean 进行中返回 TRUE
+ */
+gboolean v2ray_manager_is_swapping(V2RayManager *manager);
 
 /**
  * 获取 V2Ray 状态
@@ -85,31 +299,96 @@ V2RayStatus v2ray_manager_get_status(V2RayManager *manager);
 const char* v2ray_manager_get_status_string(V2RayStatus status);
 
 /**
- * 启用透明代理
+ * 异步启用透明代理，脚本（含 pkexec 认证）在后台执行
  * @param manager 管理器实例
  * @param enable 是否启用
- * @param error 错误信息
- * @return gboolean 成功返回 TRUE
+ * @param callback 脚本结束后在主线程调用，可为 NULL
+ * @param user_data 传给回调的用户数据
+ */
+void v2ray_manager_enable_tproxy_async(V2RayManager *manager, gboolean enable,
+                                       V2RayCompletionFunc callback, gpointer user_data);
+
+/**
+ * 启用/禁用 FakeIP 模式，下次生成配置时生效
+ * @param manager 管理器实例
+ * @param enable 是否启用
+ */
+void v2ray_manager_set_fakeip(V2RayManager *manager, gboolean enable);
+
+/**
+ * 获取看门狗状态描述
+ * @param manager 管理器实例
+ * @return 状态描述，需要用 g_free 释放
+ */
+char* v2ray_manager_get_watchdog_string(V2RayManager *manager);
+
+/**
+ * 检查本机 TCP 端口是否处于监听状态（读取 /proc/net/tcp，不建立连接）
+ * @param port 端口
+ * @return gboolean 正在监听返回 TRUE
+ */
+gboolean v2ray_manager_probe_port(int port);
+
+/**
+ * 获取序号 >= since 的新日志，追加到 out
+ * @param manager 管理器实例
+ * @param since 起始序号，0 表示从最旧的一行开始
+ * @param out 输出，每行以换行符结尾
+ * @return 下一次调用应传入的序号
+ */
+guint64 v2ray_manager_fetch_log(V2RayManager *manager, guint64 since, GString *out);
+
+/**
+ * 按顺序遍历序号 >= since 的日志行（含来源 stdout/stderr）
+ * @param manager 管理器实例
+ * @param since 起始序号，0 表示从最旧的一行开始
+ * @param func 回调
+ * @param user_data 回调用户数据
+ * @return 下一次调用应传入的序号
+ */
+guint64 v2ray_manager_foreach_log(V2RayManager *manager, guint64 since, LogRingFunc func, gpointer user_data);
+
+/**
+ * 获取从日志解析出的连接统计（出站分布、目的地址、拨号失败、TLS 错误）
+ * @param manager 管理器实例
+ * @return V2RayLogStats* 统计数据，属于管理器，不要释放
+ */
+V2RayLogStats* v2ray_manager_get_log_stats(V2RayManager *manager);
+
+/**
+ * 清空连接统计
+ * @param manager 管理器实例
  */
-gboolean v2ray_manager_enable_tproxy(V2RayManager *manager, gboolean enable, GError **error);
+void v2ray_manager_reset_log_stats(V2RayManager *manager);
 
 /**
- * 获取日志内容
+ * 设置日志缓冲区容量，超出的旧日志被丢弃
  * @param manager 管理器实例
- * @return 日志字符串
+ * @param max_lines 最大行数
+ * @param max_bytes 最大字节数
  */
-const char* v2ray_manager_get_log(V2RayManager *manager);
+void v2ray_manager_set_log_limits(V2RayManager *manager, guint max_lines, gsize max_bytes);
 
 /**
- * 检查 V2Ray 二进制是否存在
+ * 获取各入站/出站的流量（来自统计 API，运行时每 2 秒更新一次）
+ * @param manager 管理器实例
+ * @return GPtrArray* 元素为 V2RayTraffic*（属于管理器，下一次更新前有效），出站在前，
+ *         用 g_ptr_array_unref 释放
+ */
+GPtrArray* v2ray_manager_get_traffic(V2RayManager *manager);
+
+/**
+ * 检查当前内核的二进制是否存在
+ * @param manager 管理器实例
  * @return gboolean 存在返回 TRUE
  */
-gboolean v2ray_manager_check_binary(void);
+gboolean v2ray_manager_check_binary(V2RayManager *manager);
 
 /**
- * 获取 V2Ray 版本
+ * 获取当前内核的版本
+ * @param manager 管理器实例
  * @return 版本字符串，需要用 g_free 释放
  */
-char* v2ray_manager_get_version(void);
+char* v2ray_manager_get_version(V2RayManager *manager);
 
 #endif // V2RAY_MANAGER_H
\ No newline at end of file
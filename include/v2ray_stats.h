@@ -0,0 +1,97 @@
+#ifndef V2RAY_STATS_H
+#define V2RAY_STATS_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+// StatsService.QueryStats 的 gRPC 路径（V2Ray / Xray 的 proto 包名不同）
+#define V2RAY_STATS_PATH_V2RAY "/v2ray.core.app.stats.command.StatsService/QueryStats"
+#define V2RAY_STATS_PATH_XRAY "/xray.app.stats.command.StatsService/QueryStats"
+
+// 单次查询的超时
+#define V2RAY_STATS_TIMEOUT_MS 1000
+
+// 一个计数器，例如 name = "outbound>>>proxy>>>traffic>>>downlink"
+typedef struct {
+    char *name;
+    gint64 value;
+} V2RayStat;
+
+// 一个入站/出站的流量
+typedef struct {
+    char *tag;
+    gboolean outbound;
+    guint64 uplink;             // 累计字节数（跨 V2Ray 重启累加）
+    guint64 downlink;
+    double uplink_rate;         // 字节/秒
+    double downlink_rate;
+    // 内部状态：上一次的原始计数和重启前累计的偏移
+    gint64 raw_uplink;
+    gint64 raw_downlink;
+    guint64 base_uplink;
+    guint64 base_downlink;
+} V2RayTraffic;
+
+// 流量表
+typedef struct {
+    GHashTable *entries;        // "inbound>>>tag" / "outbound>>>tag" -> V2RayTraffic
+    gint64 last_update;         // 上一次更新的单调时间（微秒）
+} V2RayTrafficTable;
+
+/**
+ * 通过 h2c gRPC 调用 StatsService.QueryStats（阻塞，应在工作线程中调用）
+ * @param port 统计 API 端口（127.0.0.1）
+ * @param path gRPC 方法路径，V2RAY_STATS_PATH_V2RAY 或 V2RAY_STATS_PATH_XRAY
+ * @param timeout_ms 超时
+ * @param error 错误信息；服务不存在（路径不匹配）时为 G_IO_ERROR_NOT_FOUND
+ * @return GPtrArray* 元素为 V2RayStat*，用 g_ptr_array_unref 释放
+ */
+GPtrArray* v2ray_stats_query(int port, const char *path, int timeout_ms, GError **error);
+
+/**
+ * 在线程池中异步查询
+ * @param port 统计 API 端口
+ * @param path gRPC 方法路径
+ * @param cancellable 取消对象
+ * @param callback 完成回调（主循环中调用）
+ * @param user_data 回调用户数据
+ */
+void v2ray_stats_query_async(int port, const char *path, GCancellable *cancellable,
+                             GAsyncReadyCallback callback, gpointer user_data);
+
+/**
+ * 获取异步查询结果
+ * @param result 异步结果
+ * @param error 错误信息
+ * @return GPtrArray* 同 v2ray_stats_query
+ */
+GPtrArray* v2ray_stats_query_finish(GAsyncResult *result, GError **error);
+
+/**
+ * 创建流量表
+ * @return V2RayTrafficTable* 流量表
+ */
+V2RayTrafficTable* v2ray_traffic_table_new(void);
+
+/**
+ * 释放流量表
+ * @param table 流量表
+ */
+void v2ray_traffic_table_free(V2RayTrafficTable *table);
+
+/**
+ * 用一次查询结果更新累计流量和速率
+ * @param table 流量表
+ * @param stats v2ray_stats_query 的结果
+ * @param now_us 当前单调时间（微秒）
+ */
+void v2ray_traffic_table_update(V2RayTrafficTable *table, GPtrArray *stats, gint64 now_us);
+
+/**
+ * 获取流量列表：出站在前，按总流量降序
+ * @param table 流量表
+ * @return GPtrArray* 元素为 V2RayTraffic*（属于流量表），用 g_ptr_array_unref 释放
+ */
+GPtrArray* v2ray_traffic_table_list(V2RayTrafficTable *table);
+
+#endif // V2RAY_STATS_H
@@ -7,6 +7,13 @@ set -e
 # 默认配置
 V2RAY_PORT=${2:-12345}
 OPENVPN_SUBNET="10.8.0.0/24"
+# 内核出站连接的 SO_MARK，与 proxy_parser.h 中的 PROXY_SOCKET_MARK 一致
+CORE_MARK=255
+
+# FakeIP 模式: $3=fakeip $4=DNS 入站端口 $5=上游 DNS（避免回环）
+FAKEIP_MODE=${3:-}
+DNS_PORT=${4:-1053}
+UPSTREAM_DNS=${5:-223.5.5.5}
 
 # 颜色输出
 RED='\033[0;31m'
@@ -32,19 +39,77 @@ if [ "$EUID" -ne 0 ]; then
     exit 1
 fi
 
+# 当前规则是否为完整的门控链布局（可以原地重新配置）
+gated_rules_installed() {
+    iptables -t mangle -L V2RAY >/dev/null 2>&1 &&
+    iptables -t mangle -L V2RAY_MASK >/dev/null 2>&1 &&
+    iptables -t mangle -L V2RAY_TPROXY >/dev/null 2>&1 &&
+    iptables -t mangle -C PREROUTING -j V2RAY_GATE_PRE >/dev/null 2>&1 &&
+    iptables -t mangle -C OUTPUT -j V2RAY_GATE_OUT >/dev/null 2>&1
+}
+
+# 规则已存在时原地重新配置：每个表一次提交替换端口并恢复门控链，流量不会中断
+reconfigure_tproxy() {
+    iptables-restore --noflush <<EOF
+*mangle
+-F V2RAY_TPROXY
+-A V2RAY_TPROXY -p tcp -j TPROXY --on-port ${V2RAY_PORT} --tproxy-mark 1
+-A V2RAY_TPROXY -p udp -j TPROXY --on-port ${V2RAY_PORT} --tproxy-mark 1
+-F V2RAY_GATE_PRE
+-A V2RAY_GATE_PRE -j V2RAY
+-F V2RAY_GATE_OUT
+-A V2RAY_GATE_OUT -j V2RAY_MASK
+COMMIT
+EOF
+    
+    ip rule add fwmark 1 table 100 2>/dev/null || true
+    ip route add local 0.0.0.0/0 dev lo table 100 2>/dev/null || true
+    
+    if [ "$FAKEIP_MODE" = "fakeip" ]; then
+        # 声明链会创建不存在的链，已存在的链在本次提交中被清空
+        iptables-restore --noflush <<EOF
+*nat
+:V2RAY_DNS - [0:0]
+:V2RAY_GATE_DNS - [0:0]
+-A V2RAY_DNS -d ${UPSTREAM_DNS} -j RETURN
+-A V2RAY_DNS -p udp --dport 53 -j REDIRECT --to-ports ${DNS_PORT}
+-A V2RAY_DNS -p tcp --dport 53 -j REDIRECT --to-ports ${DNS_PORT}
+-A V2RAY_GATE_DNS -j V2RAY_DNS
+COMMIT
+EOF
+        if ! iptables -t nat -C OUTPUT -j V2RAY_GATE_DNS >/dev/null 2>&1; then
+            iptables -t nat -A OUTPUT -j V2RAY_GATE_DNS
+        fi
+        log_info "FakeIP DNS redirected to port ${DNS_PORT}"
+    else
+        stop_fakeip_dns
+    fi
+    
+    log_info "TProxy reconfigured on port ${V2RAY_PORT}"
+}
+
 # 启动透明代理
 start_tproxy() {
     log_info "Starting V2Ray transparent proxy..."
     
-    # 检查是否已经配置
-    if iptables -t mangle -L V2RAY_MASK >/dev/null 2>&1; then
-        log_warn "TProxy rules already exist, cleaning up first..."
+    # 已按门控链布局配置时原地更新，不先撤除规则
+    if gated_rules_installed; then
+        reconfigure_tproxy
+        return
+    fi
+    
+    # 旧版本或不完整的规则无法原地更新，清理后重建
+    if iptables -t mangle -L V2RAY_MASK >/dev/null 2>&1 || iptables -t mangle -L V2RAY_GATE_PRE >/dev/null 2>&1; then
+        log_warn "Incomplete TProxy rules found, cleaning up first..."
         stop_tproxy
     fi
     
-    # 创建自定义链
+    # 创建自定义链；内置链只跳转到门控链，清空门控链即可放行流量（见 tproxy_gate.sh）
     iptables -t mangle -N V2RAY_MASK
     iptables -t mangle -N V2RAY
+    iptables -t mangle -N V2RAY_TPROXY
+    iptables -t mangle -N V2RAY_GATE_PRE
+    iptables -t mangle -N V2RAY_GATE_OUT
     
     # 跳过内网和保留地址
     iptables -t mangle -A V2RAY -d 0.0.0.0/8 -j RETURN
@@ -59,14 +124,17 @@ start_tproxy() {
     # 跳过 OpenVPN 内网段（确保内网流量走 OpenVPN）
     iptables -t mangle -A V2RAY -d ${OPENVPN_SUBNET} -j RETURN
     
-    # 其他流量转发到 V2Ray
-    iptables -t mangle -A V2RAY -p tcp -j TPROXY --on-port ${V2RAY_PORT} --tproxy-mark 1
-    iptables -t mangle -A V2RAY -p udp -j TPROXY --on-port ${V2RAY_PORT} --tproxy-mark 1
+    # 其他流量转发到 V2Ray（TPROXY 目标单独成链，便于热切换时原子替换端口）
+    iptables -t mangle -A V2RAY_TPROXY -p tcp -j TPROXY --on-port ${V2RAY_PORT} --tproxy-mark 1
+    iptables -t mangle -A V2RAY_TPROXY -p udp -j TPROXY --on-port ${V2RAY_PORT} --tproxy-mark 1
+    iptables -t mangle -A V2RAY -j V2RAY_TPROXY
     
-    # 应用到 PREROUTING 链
-    iptables -t mangle -A PREROUTING -j V2RAY
+    # 经门控链应用到 PREROUTING 链
+    iptables -t mangle -A V2RAY_GATE_PRE -j V2RAY
+    iptables -t mangle -A PREROUTING -j V2RAY_GATE_PRE
     
-    # 本机流量处理
+    # 本机流量处理：内核自身的出站连接直接放行，避免回环
+    iptables -t mangle -A V2RAY_MASK -m mark --mark ${CORE_MARK} -j RETURN
     iptables -t mangle -A V2RAY_MASK -d 0.0.0.0/8 -j RETURN
     iptables -t mangle -A V2RAY_MASK -d 10.0.0.0/8 -j RETURN
     iptables -t mangle -A V2RAY_MASK -d 127.0.0.0/8 -j RETURN
@@ -78,29 +146,93 @@ start_tproxy() {
     iptables -t mangle -A V2RAY_MASK -d ${OPENVPN_SUBNET} -j RETURN
     iptables -t mangle -A V2RAY_MASK -j MARK --set-mark 1
     
-    iptables -t mangle -A OUTPUT -j V2RAY_MASK
+    iptables -t mangle -A V2RAY_GATE_OUT -j V2RAY_MASK
+    iptables -t mangle -A OUTPUT -j V2RAY_GATE_OUT
     
     # 配置路由
     ip rule add fwmark 1 table 100 2>/dev/null || true
     ip route add local 0.0.0.0/0 dev lo table 100 2>/dev/null || true
     
+    # FakeIP 模式：将 DNS 查询重定向到 V2Ray 的 DNS 入站
+    if [ "$FAKEIP_MODE" = "fakeip" ]; then
+        iptables -t nat -N V2RAY_DNS
+        iptables -t nat -A V2RAY_DNS -d ${UPSTREAM_DNS} -j RETURN
+        iptables -t nat -A V2RAY_DNS -p udp --dport 53 -j REDIRECT --to-ports ${DNS_PORT}
+        iptables -t nat -A V2RAY_DNS -p tcp --dport 53 -j REDIRECT --to-ports ${DNS_PORT}
+        iptables -t nat -N V2RAY_GATE_DNS
+        iptables -t nat -A V2RAY_GATE_DNS -j V2RAY_DNS
+        iptables -t nat -A OUTPUT -j V2RAY_GATE_DNS
+        log_info "FakeIP DNS redirected to port ${DNS_PORT}"
+    fi
+    
     log_info "TProxy started successfully on port ${V2RAY_PORT}"
     log_info "OpenVPN subnet ${OPENVPN_SUBNET} will bypass V2Ray"
 }
 
+# 热切换：将 TPROXY 目标和 DNS 重定向原子地指向新的 V2Ray 实例
+# iptables-restore --noflush 在一次提交中替换整条链，不存在规则为空的窗口
+switch_tproxy() {
+    if ! iptables -t mangle -L V2RAY_TPROXY >/dev/null 2>&1; then
+        log_error "TProxy is not running, nothing to switch"
+        exit 1
+    fi
+    
+    iptables-restore --noflush <<EOF
+*mangle
+-F V2RAY_TPROXY
+-A V2RAY_TPROXY -p tcp -j TPROXY --on-port ${V2RAY_PORT} --tproxy-mark 1
+-A V2RAY_TPROXY -p udp -j TPROXY --on-port ${V2RAY_PORT} --tproxy-mark 1
+COMMIT
+EOF
+    
+    if [ "$FAKEIP_MODE" = "fakeip" ] && iptables -t nat -L V2RAY_DNS >/dev/null 2>&1; then
+        iptables-restore --noflush <<EOF
+*nat
+-F V2RAY_DNS
+-A V2RAY_DNS -d ${UPSTREAM_DNS} -j RETURN
+-A V2RAY_DNS -p udp --dport 53 -j REDIRECT --to-ports ${DNS_PORT}
+-A V2RAY_DNS -p tcp --dport 53 -j REDIRECT --to-ports ${DNS_PORT}
+COMMIT
+EOF
+        log_info "FakeIP DNS switched to port ${DNS_PORT}"
+    fi
+    
+    log_info "TProxy switched to port ${V2RAY_PORT}"
+}
+
+# 删除 FakeIP DNS 重定向
+stop_fakeip_dns() {
+    iptables -t nat -D OUTPUT -j V2RAY_GATE_DNS 2>/dev/null || true
+    iptables -t nat -F V2RAY_GATE_DNS 2>/dev/null || true
+    iptables -t nat -X V2RAY_GATE_DNS 2>/dev/null || true
+    iptables -t nat -D OUTPUT -j V2RAY_DNS 2>/dev/null || true
+    iptables -t nat -F V2RAY_DNS 2>/dev/null || true
+    iptables -t nat -X V2RAY_DNS 2>/dev/null || true
+}
+
 # 停止透明代理
 stop_tproxy() {
     log_info "Stopping V2Ray transparent proxy..."
     
-    # 删除 iptables 规则
+    # 删除 iptables 规则（包括没有门控链的旧版本规则）
+    iptables -t mangle -D PREROUTING -j V2RAY_GATE_PRE 2>/dev/null || true
+    iptables -t mangle -D OUTPUT -j V2RAY_GATE_OUT 2>/dev/null || true
     iptables -t mangle -D PREROUTING -j V2RAY 2>/dev/null || true
     iptables -t mangle -D OUTPUT -j V2RAY_MASK 2>/dev/null || true
     
     # 删除自定义链
+    iptables -t mangle -F V2RAY_GATE_PRE 2>/dev/null || true
+    iptables -t mangle -X V2RAY_GATE_PRE 2>/dev/null || true
+    iptables -t mangle -F V2RAY_GATE_OUT 2>/dev/null || true
+    iptables -t mangle -X V2RAY_GATE_OUT 2>/dev/null || true
     iptables -t mangle -F V2RAY 2>/dev/null || true
     iptables -t mangle -X V2RAY 2>/dev/null || true
     iptables -t mangle -F V2RAY_MASK 2>/dev/null || true
     iptables -t mangle -X V2RAY_MASK 2>/dev/null || true
+    iptables -t mangle -F V2RAY_TPROXY 2>/dev/null || true
+    iptables -t mangle -X V2RAY_TPROXY 2>/dev/null || true
+    
+    stop_fakeip_dns
     
     # 删除路由规则
     ip rule del fwmark 1 table 100 2>/dev/null || true
@@ -118,6 +250,14 @@ status_tproxy() {
     echo ""
     iptables -t mangle -L V2RAY_MASK -n -v 2>/dev/null || echo "V2RAY_MASK chain not found"
     echo ""
+    iptables -t mangle -L V2RAY_TPROXY -n -v 2>/dev/null || echo "V2RAY_TPROXY chain not found"
+    echo ""
+    iptables -t mangle -L V2RAY_GATE_PRE -n -v 2>/dev/null || echo "V2RAY_GATE_PRE chain not found"
+    echo ""
+    iptables -t mangle -L V2RAY_GATE_OUT -n -v 2>/dev/null || echo "V2RAY_GATE_OUT chain not found"
+    echo ""
+    iptables -t nat -L V2RAY_DNS -n -v 2>/dev/null || echo "V2RAY_DNS chain not found (FakeIP disabled)"
+    echo ""
     echo "IP rules:"
     ip rule show | grep "fwmark 0x1" || echo "No fwmark rule found"
     echo ""
@@ -138,12 +278,17 @@ case "$1" in
         sleep 1
         start_tproxy
         ;;
+    switch)
+        switch_tproxy
+        ;;
     status)
         status_tproxy
         ;;
     *)
-        echo "Usage: $0 {start|stop|restart|status} [v2ray_port]"
+        echo "Usage: $0 {start|stop|restart|switch|status} [v2ray_port] [fakeip dns_port upstream_dns]"
         echo "Example: $0 start 12345"
+        echo "Example: $0 switch 12346"
+        echo "Example: $0 start 12345 fakeip 1053 223.5.5.5"
         exit 1
         ;;
 esac
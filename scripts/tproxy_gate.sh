@@ -0,0 +1,83 @@
+#!/bin/bash
+# V2Ray 透明代理放行开关
+# setup_tproxy.sh start 创建常驻的门控链，内置链只跳转到门控链：
+#   mangle PREROUTING -> V2RAY_GATE_PRE -> V2RAY
+#   mangle OUTPUT     -> V2RAY_GATE_OUT -> V2RAY_MASK
+#   nat    OUTPUT     -> V2RAY_GATE_DNS -> V2RAY_DNS (FakeIP)
+# 清空门控链即放行全部流量，TPROXY 端口和 DNS 重定向保留，恢复时无需重新配置
+# 本脚本不接受其他参数，可以通过 polkit 预授权（见 org.ovpn-client.tproxy-gate.policy）
+# 退出码: 0 成功（status: 规则生效），2 透明代理规则不存在，3 status: 已放行，1 出错
+
+set -e
+
+chain_exists() {
+    iptables -t "$1" -n -L "$2" >/dev/null 2>&1
+}
+
+# 门控链中有跳转规则时为生效状态
+gate_active() {
+    iptables -t mangle -S V2RAY_GATE_PRE 2>/dev/null | grep -q -- "-j V2RAY"
+}
+
+if [ "$EUID" -ne 0 ]; then
+    echo "This script must be run as root" >&2
+    exit 1
+fi
+
+if ! chain_exists mangle V2RAY_GATE_PRE || ! chain_exists mangle V2RAY_GATE_OUT; then
+    echo "TProxy rules not installed"
+    exit 2
+fi
+
+case "$1" in
+    bypass)
+        # 每个表一次提交，提交前后都不会出现半生效的规则
+        iptables-restore --noflush <<EOF
+*mangle
+-F V2RAY_GATE_PRE
+-F V2RAY_GATE_OUT
+COMMIT
+EOF
+        if chain_exists nat V2RAY_GATE_DNS; then
+            iptables-restore --noflush <<EOF
+*nat
+-F V2RAY_GATE_DNS
+COMMIT
+EOF
+        fi
+        echo "TProxy bypassed"
+        ;;
+    resume)
+        iptables-restore --noflush <<EOF
+*mangle
+-F V2RAY_GATE_PRE
+-F V2RAY_GATE_OUT
+-A V2RAY_GATE_PRE -j V2RAY
+-A V2RAY_GATE_OUT -j V2RAY_MASK
+COMMIT
+EOF
+        if chain_exists nat V2RAY_GATE_DNS && chain_exists nat V2RAY_DNS; then
+            iptables-restore --noflush <<EOF
+*nat
+-F V2RAY_GATE_DNS
+-A V2RAY_GATE_DNS -j V2RAY_DNS
+COMMIT
+EOF
+        fi
+        echo "TProxy resumed"
+        ;;
+    status)
+        if gate_active; then
+            echo "active"
+        else
+            echo "bypassed"
+            exit 3
+        fi
+        ;;
+    *)
+        echo "Usage: $0 {bypass|resume|status}" >&2
+        exit 1
+        ;;
+esac
+
+exit 0
@@ -32,6 +32,9 @@ void app_activate(GtkApplication *app, gpointer user_data) {
     // 初始化 V2Ray 管理器
     init_v2ray_manager(client);
     
+    // 初始化路由管理器，分流规则同时用于 V2Ray
+    init_route_manager(client);
+    
     // ---- 加载CSS ----
     GtkCssProvider *provider = gtk_css_provider_new();
     gtk_css_provider_load_from_path(provider, "myapp.css", NULL);
@@ -83,6 +86,7 @@ void app_shutdown(GtkApplication *app, gpointer user_data) {
     
     // 清理 V2Ray 管理器
     cleanup_v2ray_manager(client);
+    cleanup_route_manager(client);
     
     // 清理资源
     if (client->parsed_config) {
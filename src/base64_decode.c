@@ -0,0 +1,154 @@
+#include "../include/base64_decode.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+static int base64_value(guchar c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+' || c == '-') return 62;    // 标准 / URL 安全字母表
+    if (c == '/' || c == '_') return 63;
+    return -1;
+}
+
+#ifdef BASE64_HAVE_X86_SIMD
+
+// 向量路径：按字符范围算出 6 位值，再把每 4 个值拼成 3 个字节
+// 只处理全部是字母表字符的块，含空白、'=' 或非法字符的块交给标量循环
+// 原地解码时输出位置不超过输入位置，每块多写的几个字节落在已经读过的输入上
+
+__attribute__((target("ssse3")))
+static gsize decode_blocks_ssse3(const char *in, gsize len, char *out) {
+    const __m128i upper_lo = _mm_set1_epi8('A' - 1), upper_hi = _mm_set1_epi8('Z' + 1);
+    const __m128i lower_lo = _mm_set1_epi8('a' - 1), lower_hi = _mm_set1_epi8('z' + 1);
+    const __m128i digit_lo = _mm_set1_epi8('0' - 1), digit_hi = _mm_set1_epi8('9' + 1);
+    const __m128i pack_pairs = _mm_set1_epi32(0x01400140);
+    const __m128i pack_quads = _mm_set1_epi32(0x00011000);
+    const __m128i order = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    gsize i = 0;
+    gsize o = 0;
+
+    while (len - i >= 16) {
+        __m128i c = _mm_loadu_si128((const __m128i*)(const void*)(in + i));
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, upper_lo), _mm_cmpgt_epi8(upper_hi, c));
+        __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, lower_lo), _mm_cmpgt_epi8(lower_hi, c));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, digit_lo), _mm_cmpgt_epi8(digit_hi, c));
+        __m128i c62 = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('+')), _mm_cmpeq_epi8(c, _mm_set1_epi8('-')));
+        __m128i c63 = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('/')), _mm_cmpeq_epi8(c, _mm_set1_epi8('_')));
+        __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(c62, c63)));
+        if (_mm_movemask_epi8(valid) != 0xffff) break;
+
+        __m128i v = _mm_and_si128(upper, _mm_sub_epi8(c, _mm_set1_epi8('A')));
+        v = _mm_or_si128(v, _mm_and_si128(lower, _mm_sub_epi8(c, _mm_set1_epi8('a' - 26))));
+        v = _mm_or_si128(v, _mm_and_si128(digit, _mm_add_epi8(c, _mm_set1_epi8(52 - '0'))));
+        v = _mm_or_si128(v, _mm_and_si128(c62, _mm_set1_epi8(62)));
+        v = _mm_or_si128(v, _mm_and_si128(c63, _mm_set1_epi8(63)));
+
+        v = _mm_maddubs_epi16(v, pack_pairs);       // 每对值拼成 12 位
+        v = _mm_madd_epi16(v, pack_quads);          // 每两对拼成 24 位
+        v = _mm_shuffle_epi8(v, order);             // 按大端顺序取出 12 个字节
+        _mm_storeu_si128((__m128i*)(void*)(out + o), v);
+
+        i += 16;
+        o += 12;
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static gsize decode_blocks_avx2(const char *in, gsize len, char *out) {
+    const __m256i upper_lo = _mm256_set1_epi8('A' - 1), upper_hi = _mm256_set1_epi8('Z' + 1);
+    const __m256i lower_lo = _mm256_set1_epi8('a' - 1), lower_hi = _mm256_set1_epi8('z' + 1);
+    const __m256i digit_lo = _mm256_set1_epi8('0' - 1), digit_hi = _mm256_set1_epi8('9' + 1);
+    const __m256i pack_pairs = _mm256_set1_epi32(0x01400140);
+    const __m256i pack_quads = _mm256_set1_epi32(0x00011000);
+    const __m256i order = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                           2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    gsize i = 0;
+    gsize o = 0;
+
+    while (len - i >= 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i*)(const void*)(in + i));
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(c, upper_lo), _mm256_cmpgt_epi8(upper_hi, c));
+        __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(c, lower_lo), _mm256_cmpgt_epi8(lower_hi, c));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, digit_lo), _mm256_cmpgt_epi8(digit_hi, c));
+        __m256i c62 = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('+')),
+                                      _mm256_cmpeq_epi8(c, _mm256_set1_epi8('-')));
+        __m256i c63 = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('/')),
+                                      _mm256_cmpeq_epi8(c, _mm256_set1_epi8('_')));
+        __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower),
+                                        _mm256_or_si256(digit, _mm256_or_si256(c62, c63)));
+        if (_mm256_movemask_epi8(valid) != -1) break;
+
+        __m256i v = _mm256_and_si256(upper, _mm256_sub_epi8(c, _mm256_set1_epi8('A')));
+        v = _mm256_or_si256(v, _mm256_and_si256(lower, _mm256_sub_epi8(c, _mm256_set1_epi8('a' - 26))));
+        v = _mm256_or_si256(v, _mm256_and_si256(digit, _mm256_add_epi8(c, _mm256_set1_epi8(52 - '0'))));
+        v = _mm256_or_si256(v, _mm256_and_si256(c62, _mm256_set1_epi8(62)));
+        v = _mm256_or_si256(v, _mm256_and_si256(c63, _mm256_set1_epi8(63)));
+
+        v = _mm256_maddubs_epi16(v, pack_pairs);
+        v = _mm256_madd_epi16(v, pack_quads);
+        v = _mm256_shuffle_epi8(v, order);          // 每个 128 位通道各 12 个字节
+        v = _mm256_permutevar8x32_epi32(v, lanes);  // 两个通道的结果拼成连续 24 个字节
+        _mm256_storeu_si256((__m256i*)(void*)(out + o), v);
+
+        i += 32;
+        o += 24;
+    }
+    return i;
+}
+
+// 返回向量路径消耗的输入字节数，总是 4 的倍数
+static gsize decode_blocks(const char *in, gsize len, char *out) {
+    if (__builtin_cpu_supports("avx2")) return decode_blocks_avx2(in, len, out);
+    if (__builtin_cpu_supports("ssse3")) return decode_blocks_ssse3(in, len, out);
+    return 0;
+}
+
+#endif
+
+// 向量路径一次至少处理的字节数，也是标量循环每轮处理的字节数
+#define BASE64_BLOCK 32
+
+gssize base64_decode_inplace(char *str, gsize len) {
+    guint32 acc = 0;
+    int bits = 0;
+    gsize out = 0;
+    gsize i = 0;
+
+    while (i < len) {
+#ifdef BASE64_HAVE_X86_SIMD
+        // 只在 4 个字符的分组边界上进入向量路径，此时没有未输出的位
+        if (bits == 0 && len - i >= BASE64_BLOCK) {
+            gsize n = decode_blocks(str + i, len - i, str + out);
+            i += n;
+            out += n / 4 * 3;
+        }
+#endif
+
+        gsize stop = MIN(len, i + BASE64_BLOCK);
+        for (; i < stop; i++) {
+            guchar c = (guchar)str[i];
+            if (c == '=') goto done;
+            if (g_ascii_isspace(c)) continue;
+
+            int v = base64_value(c);
+            if (v < 0) return -1;
+
+            acc = (acc << 6) | (guint32)v;
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                str[out++] = (char)((acc >> bits) & 0xff);
+            }
+        }
+    }
+
+done:
+    str[out] = '\0';
+    return (gssize)out;
+}
@@ -8,6 +8,7 @@
 
 #include "../include/core_logic.h"
 #include "../include/log_util.h"
+#include "../include/route_manager.h"
 #include "../include/structs.h"
 #include "../include/ui_callbacks.h"
 #include "../include/v2ray_manager.h"
@@ -160,6 +161,36 @@ void init_v2ray_manager(OVPNClient *client) {
     }
 }
 
+/**
+ * 初始化路由管理器：加载已保存的路由配置，并把编译出的分流规则交给 V2Ray 管理器
+ */
+void init_route_manager(OVPNClient *client) {
+    if (client->route_manager) return;
+
+    client->route_manager = route_manager_new();
+
+    char *config_path = route_manager_get_config_path();
+    if (g_file_test(config_path, G_FILE_TEST_EXISTS)) {
+        route_manager_load_config(client->route_manager, config_path);
+    }
+    g_free(config_path);
+
+    if (client->v2ray_manager) {
+        v2ray_manager_set_route_rules(client->v2ray_manager,
+                                      route_manager_compile_proxy_rules(client->route_manager));
+    }
+}
+
+/**
+ * 清理路由管理器
+ */
+void cleanup_route_manager(OVPNClient *client) {
+    if (client->route_manager) {
+        route_manager_free(client->route_manager);
+        client->route_manager = NULL;
+    }
+}
+
 /**
  * 清理 V2Ray 管理器
  */
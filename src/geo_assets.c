@@ -0,0 +1,235 @@
+#include "../include/geo_assets.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+// protobuf 线格式：键 = (字段号 << 3) | 类型
+#define PB_WIRE_VARINT 0
+#define PB_WIRE_FIXED64 1
+#define PB_WIRE_LEN 2
+#define PB_WIRE_FIXED32 5
+
+// 列表项 (GeoIPList.entry / GeoSiteList.entry) 和项中的类别代码 (country_code) 都是字段 1
+#define PB_KEY_ENTRY ((1 << 3) | PB_WIRE_LEN)
+#define PB_KEY_CODE ((1 << 3) | PB_WIRE_LEN)
+
+// 一次最多提取的类别数
+#define GEO_ASSETS_MAX_CODES 64
+
+// 系统安装的 geo 数据目录
+static const char * const share_dirs[] = {
+    "data/v2ray",
+    "/usr/local/share/v2ray",
+    "/usr/share/v2ray",
+    "/usr/local/share/xray",
+    "/usr/share/xray",
+    NULL
+};
+
+static gboolean read_varint(const guchar **p, const guchar *end, guint64 *value) {
+    guint64 v = 0;
+
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        guchar b = *(*p)++;
+        v |= (guint64)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *value = v;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static void write_varint(GString *out, guint64 value) {
+    while (value >= 0x80) {
+        g_string_append_c(out, (char)((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    g_string_append_c(out, (char)value);
+}
+
+// 跳过一个字段的值
+static gboolean skip_value(const guchar **p, const guchar *end, guint wire) {
+    guint64 n;
+
+    switch (wire) {
+        case PB_WIRE_VARINT:
+            return read_varint(p, end, &n);
+        case PB_WIRE_FIXED64:
+            n = 8;
+            break;
+        case PB_WIRE_FIXED32:
+            n = 4;
+            break;
+        case PB_WIRE_LEN:
+            if (!read_varint(p, end, &n)) return FALSE;
+            break;
+        default:
+            return FALSE;
+    }
+
+    if (n > (guint64)(end - *p)) return FALSE;
+    *p += n;
+    return TRUE;
+}
+
+// 在列表项中找类别代码 (字段 1)，一般是第一个字段
+static gboolean entry_code(const guchar *p, const guchar *end, const guchar **code, gsize *len) {
+    while (p < end) {
+        guint64 key;
+        if (!read_varint(&p, end, &key)) return FALSE;
+
+        if (key == PB_KEY_CODE) {
+            guint64 n;
+            if (!read_varint(&p, end, &n) || n > (guint64)(end - p)) return FALSE;
+            *code = p;
+            *len = (gsize)n;
+            return TRUE;
+        }
+        if (!skip_value(&p, end, (guint)(key & 7))) return FALSE;
+    }
+    return FALSE;
+}
+
+// 返回类别在 codes 中的下标，不需要时返回 -1
+static int find_code(const guchar *code, gsize len, const char * const *codes) {
+    for (int i = 0; codes[i]; i++) {
+        if (strlen(codes[i]) == len && g_ascii_strncasecmp((const char*)code, codes[i], len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+gboolean geo_assets_trim(const char *src_path, const char *dst_path, const char * const *codes, GError **error) {
+    guint n_codes = g_strv_length((char**)codes);
+    if (n_codes == 0 || n_codes > GEO_ASSETS_MAX_CODES) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Invalid number of geo categories: %u", n_codes);
+        return FALSE;
+    }
+
+    GMappedFile *mapped = g_mapped_file_new(src_path, FALSE, error);
+    if (!mapped) return FALSE;
+
+    const guchar *p = (const guchar*)g_mapped_file_get_contents(mapped);
+    const guchar *end = p + g_mapped_file_get_length(mapped);
+    guint64 found = 0;
+    GString *out = g_string_new(NULL);
+    gboolean ok = TRUE;
+
+    while (p < end) {
+        guint64 key;
+        if (!read_varint(&p, end, &key)) {
+            ok = FALSE;
+            break;
+        }
+        if (key != PB_KEY_ENTRY) {
+            if (!skip_value(&p, end, (guint)(key & 7))) {
+                ok = FALSE;
+                break;
+            }
+            continue;
+        }
+
+        guint64 len;
+        if (!read_varint(&p, end, &len) || len > (guint64)(end - p)) {
+            ok = FALSE;
+            break;
+        }
+
+        // 同一类别出现多次时内核只用第一项
+        const guchar *code;
+        gsize code_len;
+        if (entry_code(p, p + len, &code, &code_len)) {
+            int index = find_code(code, code_len, codes);
+            if (index >= 0 && !(found & (G_GUINT64_CONSTANT(1) << index))) {
+                found |= G_GUINT64_CONSTANT(1) << index;
+                write_varint(out, PB_KEY_ENTRY);
+                write_varint(out, len);
+                g_string_append_len(out, (const char*)p, (gssize)len);
+            }
+        }
+        p += len;
+    }
+
+    if (!ok) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Malformed geo data file %s", src_path);
+    } else {
+        for (guint i = 0; i < n_codes; i++) {
+            if (!(found & (G_GUINT64_CONSTANT(1) << i))) {
+                g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "Category %s not found in %s",
+                            codes[i], src_path);
+                ok = FALSE;
+                break;
+            }
+        }
+    }
+
+    if (ok) {
+        ok = g_file_set_contents(dst_path, out->str, (gssize)out->len, error);
+    }
+
+    g_string_free(out, TRUE);
+    g_mapped_file_unref(mapped);
+    return ok;
+}
+
+// 目标文件旁记录提取的类别，分流规则改变后即使数据文件没有更新也要重新提取
+static char* codes_record_path(const char *dst_path) {
+    return g_strconcat(dst_path, ".codes", NULL);
+}
+
+gboolean geo_assets_update(const char *src_path, const char *dst_path, const char * const *codes, GError **error) {
+    GStatBuf src_st;
+    GStatBuf dst_st;
+
+    if (g_stat(src_path, &src_st) != 0) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "Geo data file %s not found", src_path);
+        return FALSE;
+    }
+
+    char *record_path = codes_record_path(dst_path);
+    char *wanted = g_strjoinv("\n", (char**)codes);
+    char *recorded = NULL;
+    gboolean ok = TRUE;
+
+    if (g_stat(dst_path, &dst_st) != 0 || dst_st.st_mtime < src_st.st_mtime ||
+        !g_file_get_contents(record_path, &recorded, NULL, NULL) || strcmp(recorded, wanted) != 0) {
+        // 先删除记录，提取中途失败时下次仍会重新提取
+        g_unlink(record_path);
+        ok = geo_assets_trim(src_path, dst_path, codes, error) &&
+             g_file_set_contents(record_path, wanted, -1, error);
+    }
+
+    g_free(recorded);
+    g_free(wanted);
+    g_free(record_path);
+    return ok;
+}
+
+// dir 下存在 name 时返回完整路径
+static char* find_in_dir(const char *dir, const char *name) {
+    if (!dir || !*dir) return NULL;
+
+    char *path = g_build_filename(dir, name, NULL);
+    if (g_file_test(path, G_FILE_TEST_IS_REGULAR)) {
+        return path;
+    }
+    g_free(path);
+    return NULL;
+}
+
+char* geo_assets_find_source(const char *binary, const char *asset_env, const char *name) {
+    char *path = find_in_dir(asset_env ? g_getenv(asset_env) : NULL, name);
+
+    if (!path && binary) {
+        char *dir = g_path_get_dirname(binary);
+        path = find_in_dir(dir, name);
+        g_free(dir);
+    }
+
+    for (const char * const *dir = share_dirs; !path && *dir; dir++) {
+        path = find_in_dir(*dir, name);
+    }
+
+    return path;
+}
@@ -0,0 +1,197 @@
+#include "../include/json_writer.h"
+#include <math.h>
+#include <string.h>
+
+void json_writer_init(JsonWriter *writer, GString *buf, gboolean pretty) {
+    memset(writer, 0, sizeof(*writer));
+    writer->buf = buf;
+    writer->pretty = pretty;
+}
+
+static void write_newline(JsonWriter *writer) {
+    static const char spaces[] = "                                                                ";
+
+    g_string_append_c(writer->buf, '\n');
+    gsize indent = MIN(writer->depth, JSON_WRITER_MAX_DEPTH) * 2;
+    while (indent > 0) {
+        gsize n = MIN(indent, sizeof(spaces) - 1);
+        g_string_append_len(writer->buf, spaces, (gssize)n);
+        indent -= n;
+    }
+}
+
+// 值之前：数组元素之间加逗号和换行；对象的值紧跟在键后面
+static void begin_value(JsonWriter *writer) {
+    if (writer->after_key) {
+        writer->after_key = FALSE;
+        return;
+    }
+
+    if (writer->depth == 0) return;
+
+    guint level = MIN(writer->depth, JSON_WRITER_MAX_DEPTH);
+    if (writer->has_items[level]) {
+        g_string_append_c(writer->buf, ',');
+    }
+    writer->has_items[level] = TRUE;
+
+    if (writer->pretty) {
+        write_newline(writer);
+    }
+}
+
+static void begin_container(JsonWriter *writer, char open) {
+    begin_value(writer);
+    g_string_append_c(writer->buf, open);
+    writer->depth++;
+    writer->has_items[MIN(writer->depth, JSON_WRITER_MAX_DEPTH)] = FALSE;
+}
+
+static void end_container(JsonWriter *writer, char close) {
+    gboolean had_items = writer->has_items[MIN(writer->depth, JSON_WRITER_MAX_DEPTH)];
+    writer->depth--;
+    if (writer->pretty && had_items) {
+        write_newline(writer);
+    }
+    g_string_append_c(writer->buf, close);
+}
+
+void json_writer_begin_object(JsonWriter *writer) {
+    begin_container(writer, '{');
+}
+
+void json_writer_end_object(JsonWriter *writer) {
+    end_container(writer, '}');
+}
+
+void json_writer_begin_array(JsonWriter *writer) {
+    begin_container(writer, '[');
+}
+
+void json_writer_end_array(JsonWriter *writer) {
+    end_container(writer, ']');
+}
+
+void json_writer_key(JsonWriter *writer, const char *key) {
+    begin_value(writer);
+    g_string_append_c(writer->buf, '"');
+    g_string_append(writer->buf, key);
+    g_string_append_len(writer->buf, writer->pretty ? "\": " : "\":", writer->pretty ? 3 : 2);
+    writer->after_key = TRUE;
+}
+
+// 转义一段合法的 UTF-8：只有引号、反斜杠和控制字符需要转义，其余按段整体追加
+static void append_escaped_valid(GString *buf, const char *p, const char *end) {
+    static const char hex[] = "0123456789abcdef";
+    const char *start = p;
+
+    for (; p < end; p++) {
+        guchar c = (guchar)*p;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        g_string_append_len(buf, start, p - start);
+        switch (c) {
+            case '"':  g_string_append_len(buf, "\\\"", 2); break;
+            case '\\': g_string_append_len(buf, "\\\\", 2); break;
+            case '\n': g_string_append_len(buf, "\\n", 2); break;
+            case '\r': g_string_append_len(buf, "\\r", 2); break;
+            case '\t': g_string_append_len(buf, "\\t", 2); break;
+            default: {
+                char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+                g_string_append_len(buf, esc, sizeof(esc));
+                break;
+            }
+        }
+        start = p + 1;
+    }
+    g_string_append_len(buf, start, p - start);
+}
+
+// 节点名称等来自订阅，可能不是合法的 UTF-8；每个非法字节替换为 U+FFFD，保证输出是合法的 JSON
+static void append_escaped(GString *buf, const char *value) {
+    const char *p = value;
+    const char *valid_end;
+
+    g_string_append_c(buf, '"');
+    while (!g_utf8_validate(p, -1, &valid_end)) {
+        append_escaped_valid(buf, p, valid_end);
+        g_string_append_len(buf, "\\ufffd", 6);
+        p = valid_end + 1;
+    }
+    append_escaped_valid(buf, p, valid_end);
+    g_string_append_c(buf, '"');
+}
+
+void json_writer_string(JsonWriter *writer, const char *value) {
+    begin_value(writer);
+    if (value) {
+        append_escaped(writer->buf, value);
+    } else {
+        g_string_append_len(writer->buf, "null", 4);
+    }
+}
+
+void json_writer_int(JsonWriter *writer, gint64 value) {
+    begin_value(writer);
+    g_string_append_printf(writer->buf, "%" G_GINT64_FORMAT, value);
+}
+
+void json_writer_bool(JsonWriter *writer, gboolean value) {
+    begin_value(writer);
+    if (value) {
+        g_string_append_len(writer->buf, "true", 4);
+    } else {
+        g_string_append_len(writer->buf, "false", 5);
+    }
+}
+
+void json_writer_double(JsonWriter *writer, double value) {
+    begin_value(writer);
+    if (!isfinite(value)) {
+        g_string_append_len(writer->buf, "null", 4);
+        return;
+    }
+
+    char text[G_ASCII_DTOSTR_BUF_SIZE];
+    g_string_append(writer->buf, g_ascii_formatd(text, sizeof(text), "%.3f", value));
+}
+
+void json_writer_raw(JsonWriter *writer, const char *json) {
+    begin_value(writer);
+    g_string_append(writer->buf, json);
+}
+
+void json_writer_member_string(JsonWriter *writer, const char *key, const char *value) {
+    json_writer_key(writer, key);
+    json_writer_string(writer, value);
+}
+
+void json_writer_member_int(JsonWriter *writer, const char *key, gint64 value) {
+    json_writer_key(writer, key);
+    json_writer_int(writer, value);
+}
+
+void json_writer_member_bool(JsonWriter *writer, const char *key, gboolean value) {
+    json_writer_key(writer, key);
+    json_writer_bool(writer, value);
+}
+
+void json_writer_member_double(JsonWriter *writer, const char *key, double value) {
+    json_writer_key(writer, key);
+    json_writer_double(writer, value);
+}
+
+void json_writer_member_nonempty(JsonWriter *writer, const char *key, const char *value) {
+    if (value && *value) {
+        json_writer_member_string(writer, key, value);
+    }
+}
+
+void json_writer_member_strv(JsonWriter *writer, const char *key, const char * const *values, gssize count) {
+    json_writer_key(writer, key);
+    json_writer_begin_array(writer);
+    for (gssize i = 0; count < 0 ? values[i] != NULL : i < count; i++) {
+        json_writer_string(writer, values[i]);
+    }
+    json_writer_end_array(writer);
+}
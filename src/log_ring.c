@@ -0,0 +1,135 @@
+#include "../include/log_ring.h"
+#include <string.h>
+
+// 淘汰最旧的一行
+static void log_ring_drop_oldest(LogRing *ring) {
+    LogRingEntry *entry = &ring->entries[ring->head];
+
+    ring->bytes -= entry->len;
+    g_free(entry->text);
+    entry->text = NULL;
+    entry->len = 0;
+
+    ring->head = (ring->head + 1) % ring->capacity;
+    ring->count--;
+}
+
+// 淘汰旧行，直到能容纳 len 字节的新行
+static void log_ring_make_room(LogRing *ring, gsize len) {
+    while (ring->count > 0 &&
+           (ring->count >= ring->capacity || ring->bytes + len > ring->max_bytes)) {
+        log_ring_drop_oldest(ring);
+    }
+}
+
+LogRing* log_ring_new(guint max_lines, gsize max_bytes) {
+    LogRing *ring = g_new0(LogRing, 1);
+
+    ring->capacity = MAX(max_lines, 1);
+    ring->max_bytes = max_bytes;
+    ring->entries = g_new0(LogRingEntry, ring->capacity);
+    ring->next_seq = 1;
+
+    return ring;
+}
+
+void log_ring_free(LogRing *ring) {
+    if (!ring) return;
+
+    log_ring_clear(ring);
+    g_free(ring->entries);
+    g_free(ring);
+}
+
+void log_ring_append(LogRing *ring, LogRingStream stream, const char *line, gssize len) {
+    if (!ring || !line) return;
+
+    gsize n = len < 0 ? strlen(line) : (gsize)len;
+    while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) {
+        n--;
+    }
+    if (n > LOG_RING_MAX_LINE_LEN) {
+        n = LOG_RING_MAX_LINE_LEN;
+    }
+
+    log_ring_make_room(ring, n);
+
+    LogRingEntry *entry = &ring->entries[(ring->head + ring->count) % ring->capacity];
+    entry->text = g_strndup(line, n);
+    entry->len = n;
+    entry->seq = ring->next_seq++;
+    entry->stream = stream;
+
+    ring->count++;
+    ring->bytes += n;
+}
+
+guint64 log_ring_first_seq(LogRing *ring) {
+    if (!ring) return 0;
+    return ring->next_seq - ring->count;
+}
+
+// 序号 since 对应的相对下标
+static guint log_ring_index_of(LogRing *ring, guint64 since) {
+    guint64 first = log_ring_first_seq(ring);
+    return since > first ? (guint)MIN(since - first, (guint64)ring->count) : 0;
+}
+
+guint64 log_ring_fetch(LogRing *ring, guint64 since, GString *out) {
+    if (!ring) return since;
+
+    for (guint i = log_ring_index_of(ring, since); i < ring->count; i++) {
+        LogRingEntry *entry = &ring->entries[(ring->head + i) % ring->capacity];
+        g_string_append_len(out, entry->text, entry->len);
+        g_string_append_c(out, '\n');
+    }
+
+    return ring->next_seq;
+}
+
+guint64 log_ring_foreach(LogRing *ring, guint64 since, LogRingFunc func, gpointer user_data) {
+    if (!ring) return since;
+
+    for (guint i = log_ring_index_of(ring, since); i < ring->count; i++) {
+        func(&ring->entries[(ring->head + i) % ring->capacity], user_data);
+    }
+
+    return ring->next_seq;
+}
+
+void log_ring_set_limits(LogRing *ring, guint max_lines, gsize max_bytes) {
+    if (!ring) return;
+
+    max_lines = MAX(max_lines, 1);
+
+    // 只保留最新的 max_lines 行
+    while (ring->count > max_lines) {
+        log_ring_drop_oldest(ring);
+    }
+
+    if (max_lines != ring->capacity) {
+        LogRingEntry *entries = g_new0(LogRingEntry, max_lines);
+        for (guint i = 0; i < ring->count; i++) {
+            entries[i] = ring->entries[(ring->head + i) % ring->capacity];
+        }
+
+        g_free(ring->entries);
+        ring->entries = entries;
+        ring->capacity = max_lines;
+        ring->head = 0;
+    }
+
+    ring->max_bytes = max_bytes;
+    while (ring->count > 0 && ring->bytes > ring->max_bytes) {
+        log_ring_drop_oldest(ring);
+    }
+}
+
+void log_ring_clear(LogRing *ring) {
+    if (!ring) return;
+
+    while (ring->count > 0) {
+        log_ring_drop_oldest(ring);
+    }
+    ring->head = 0;
+}
@@ -0,0 +1,162 @@
+#include "../include/proxy_core.h"
+#include "../include/v2ray_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char * const v2ray_paths[] = { "data/v2ray/v2ray", NULL };
+static const char * const xray_paths[] = { "data/xray/xray", "data/v2ray/xray", NULL };
+static const char * const singbox_paths[] = { "data/sing-box/sing-box", NULL };
+
+// 三种内核都使用 "<binary> run -c <config>"
+static char** build_run_argv(const char *binary, const char *config_path) {
+    char **argv = g_new0(char*, 5);
+    argv[0] = g_strdup(binary);
+    argv[1] = g_strdup("run");
+    argv[2] = g_strdup("-c");
+    argv[3] = g_strdup(config_path);
+    return argv;
+}
+
+static const ProxyCoreBackend backends[PROXY_CORE_COUNT] = {
+    [PROXY_CORE_V2RAY] = {
+        .type = PROXY_CORE_V2RAY,
+        .id = "v2ray",
+        .display_name = "V2Ray",
+        .binary_name = "v2ray",
+        .binary_paths = v2ray_paths,
+        .version_arg = "version",
+        .stats_path = V2RAY_STATS_PATH_V2RAY,
+        .asset_env = "V2RAY_LOCATION_ASSET",
+        .xtls = FALSE,
+        .build_argv = build_run_argv,
+        .generate_config = proxy_parser_generate_v2ray_config_multi,
+        .is_ready = proxy_core_port_listening,
+    },
+    // Xray 兼容 V2Ray 的 JSON 配置，统计服务的 proto 包名不同
+    [PROXY_CORE_XRAY] = {
+        .type = PROXY_CORE_XRAY,
+        .id = "xray",
+        .display_name = "Xray",
+        .binary_name = "xray",
+        .binary_paths = xray_paths,
+        .version_arg = "version",
+        .stats_path = V2RAY_STATS_PATH_XRAY,
+        .asset_env = "XRAY_LOCATION_ASSET",
+        .xtls = TRUE,
+        .build_argv = build_run_argv,
+        .generate_config = proxy_parser_generate_v2ray_config_multi,
+        .is_ready = proxy_core_port_listening,
+    },
+    // sing-box 的统计 API 需要 with_v2ray_api 编译选项，发布版本不包含
+    [PROXY_CORE_SINGBOX] = {
+        .type = PROXY_CORE_SINGBOX,
+        .id = "sing-box",
+        .display_name = "sing-box",
+        .binary_name = "sing-box",
+        .binary_paths = singbox_paths,
+        .version_arg = "version",
+        .stats_path = NULL,
+        .asset_env = NULL,
+        .xtls = TRUE,
+        .build_argv = build_run_argv,
+        .generate_config = proxy_parser_generate_singbox_config,
+        .is_ready = proxy_core_port_listening,
+    },
+};
+
+const ProxyCoreBackend* proxy_core_get(ProxyCoreType type) {
+    if (type < 0 || type >= PROXY_CORE_COUNT) {
+        return &backends[PROXY_CORE_V2RAY];
+    }
+    return &backends[type];
+}
+
+const ProxyCoreBackend* proxy_core_from_id(const char *id) {
+    for (int i = 0; id && i < PROXY_CORE_COUNT; i++) {
+        if (g_ascii_strcasecmp(backends[i].id, id) == 0) {
+            return &backends[i];
+        }
+    }
+    return NULL;
+}
+
+char* proxy_core_find_binary(const ProxyCoreBackend *backend) {
+    if (!backend) return NULL;
+
+    for (const char * const *path = backend->binary_paths; path && *path; path++) {
+        if (g_file_test(*path, G_FILE_TEST_IS_EXECUTABLE)) {
+            return g_strdup(*path);
+        }
+    }
+
+    return g_find_program_in_path(backend->binary_name);
+}
+
+char* proxy_core_get_version(const ProxyCoreBackend *backend, const char *binary) {
+    if (!backend || !binary) return NULL;
+
+    char *argv[] = { (char*)binary, (char*)backend->version_arg, NULL };
+    char *output = NULL;
+    GError *error = NULL;
+
+    if (!g_spawn_sync(NULL, argv, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL,
+                      &output, NULL, NULL, &error)) {
+        g_debug("Failed to run %s %s: %s", binary, backend->version_arg, error->message);
+        g_error_free(error);
+        return NULL;
+    }
+
+    // 第一行形如 "V2Ray 5.x.x (...)" / "Xray 1.8.x (...)" / "sing-box version 1.x.x"
+    char *version = NULL;
+    if (output) {
+        char *newline = strchr(output, '\n');
+        if (newline) *newline = '\0';
+        g_strstrip(output);
+        if (*output) {
+            version = g_strdup(output);
+        }
+    }
+
+    g_free(output);
+    return version;
+}
+
+// 检查端口监听状态
+static gboolean probe_proc_net_tcp(const char *path, int port) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return FALSE;
+
+    char line[512];
+    gboolean listening = FALSE;
+
+    // 跳过表头
+    if (!fgets(line, sizeof(line), fp)) {
+        fclose(fp);
+        return FALSE;
+    }
+
+    // 格式: sl local_address(hex ip:hex port) rem_address st ...，st=0A 表示 LISTEN
+    while (fgets(line, sizeof(line), fp)) {
+        char local[128];
+        char remote[128];
+        unsigned int state;
+        if (sscanf(line, "%*s %127s %127s %x", local, remote, &state) != 3) {
+            continue;
+        }
+
+        char *colon = strrchr(local, ':');
+        if (colon && state == 0x0A && (int)strtoul(colon + 1, NULL, 16) == port) {
+            listening = TRUE;
+            break;
+        }
+    }
+
+    fclose(fp);
+    return listening;
+}
+
+gboolean proxy_core_port_listening(int port) {
+    return probe_proc_net_tcp("/proc/net/tcp", port) ||
+           probe_proc_net_tcp("/proc/net/tcp6", port);
+}
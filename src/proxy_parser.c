@@ -1,405 +1,1816 @@
 
 #include "../include/proxy_parser.h"
+#include "../include/json_writer.h"
+#include "../include/base64_decode.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <glib.h>
-#include <json-c/json.h>
 
-// Base64 解码（使用 GLib）
-static gchar* base64_decode_str(const char *encoded) {
-    gsize out_len;
-    guchar *decoded = g_base64_decode(encoded, &out_len);
-    if (!decoded) return NULL;
+// 解析结果：配置和它的所有字符串在同一块内存中
+// 链接复制到 data 后原地切分、解码，字段直接指向 data，proxy_parser_free 一次释放
+typedef struct {
+    ProxyConfig config;
+    gsize used;
+    gsize size;
+    char data[];
+} ParsedConfig;
+
+// 默认名称等常量字符串的预留空间
+#define PARSER_ARENA_SLACK 32
+
+static ParsedConfig* parsed_config_new(ProxyType type, const char *src, gsize len) {
+    ParsedConfig *pc = g_malloc(sizeof(ParsedConfig) + len + 1 + PARSER_ARENA_SLACK);
+    memset(pc, 0, sizeof(ParsedConfig));
+    pc->config.type = type;
+    memcpy(pc->data, src, len);
+    pc->data[len] = '\0';
+    pc->used = len + 1;
+    pc->size = len + 1 + PARSER_ARENA_SLACK;
+    return pc;
+}
+
+// 在预留空间中复制常量字符串
+static char* parsed_config_strdup(ParsedConfig *pc, const char *str) {
+    gsize len = strlen(str) + 1;
+    if (pc->used + len > pc->size) return NULL;
+    
+    char *dst = pc->data + pc->used;
+    memcpy(dst, str, len);
+    pc->used += len;
+    return dst;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// 原地 URL 解码，无效的 % 序列原样保留
+static char* percent_decode(char *str) {
+    if (!str) return NULL;
+    
+    char *w = str;
+    for (const char *r = str; *r; r++) {
+        int hi, lo;
+        if (*r == '%' && (hi = hex_value(r[1])) >= 0 && (lo = hex_value(r[2])) >= 0) {
+            *w++ = (char)((hi << 4) | lo);
+            r += 2;
+        } else {
+            *w++ = *r;
+        }
+    }
+    *w = '\0';
+    return str;
+}
+
+// 拆分 host:port，IPv6 地址写成 [addr]:port；端口后的路径忽略
+static void split_host_port(char *str, char **host, int *port, int default_port) {
+    str[strcspn(str, "/")] = '\0';
+    
+    char *colon;
+    if (*str == '[') {
+        char *bracket = strchr(str, ']');
+        if (!bracket) {
+            *host = NULL;
+            return;
+        }
+        *bracket = '\0';
+        *host = str + 1;
+        colon = bracket[1] == ':' ? bracket + 1 : NULL;
+    } else {
+        *host = str;
+        colon = strrchr(str, ':');
+        if (colon) *colon = '\0';
+    }
+    
+    *port = colon ? atoi(colon + 1) : default_port;
+}
+
+// 服务器地址非空且端口在 1-65535 之间
+static gboolean server_valid(const char *address, int port) {
+    return address && *address && port > 0 && port <= 65535;
+}
+
+// 链接参数与字段的对应关系
+typedef struct {
+    const char *key;
+    char **field;
+} QueryField;
+
+// 原地解析链接参数 key=value&...，值做 URL 解码；同名参数以最后一个为准
+static void parse_query_inplace(char *query, const QueryField *fields, gsize n_fields) {
+    char *pair = query;
+    while (pair && *pair) {
+        char *next = strchr(pair, '&');
+        if (next) *next++ = '\0';
+        
+        char *eq = strchr(pair, '=');
+        if (eq) {
+            *eq = '\0';
+            for (gsize i = 0; i < n_fields; i++) {
+                if (strcmp(pair, fields[i].key) == 0) {
+                    *fields[i].field = percent_decode(eq + 1);
+                    break;
+                }
+            }
+        }
+        pair = next;
+    }
+}
+
+// 切掉 '#' 后的名称并解码，没有名称时使用默认名称
+static void take_fragment_name(ParsedConfig *pc, char *str, const char *default_name) {
+    char *hash = strchr(str, '#');
+    if (hash) {
+        *hash = '\0';
+        pc->config.name = percent_decode(hash + 1);
+    }
+    if (!pc->config.name || !*pc->config.name) {
+        pc->config.name = parsed_config_strdup(pc, default_name);
+    }
+}
+
+// 链接中的 mux 参数：数字为并发数，0/false/off 禁用，true/on 使用默认并发数
+static int parse_mux_value(const char *value) {
+    if (!value || !*value) return 0;
+    if (g_ascii_strcasecmp(value, "true") == 0 || g_ascii_strcasecmp(value, "on") == 0) {
+        return PROXY_MUX_DEFAULT_CONCURRENCY;
+    }
     
-    gchar *result = g_strndup((const gchar*)decoded, out_len);
-    g_free(decoded);
-    return result;
+    int n = atoi(value);
+    return n > 0 ? MIN(n, 1024) : -1;
+}
+
+// 拆分 method:password
+static gboolean split_ss_userinfo(char *userinfo, SSConfig *ss) {
+    char *colon = strchr(userinfo, ':');
+    if (!colon) return FALSE;
+    
+    *colon = '\0';
+    ss->method = userinfo;
+    ss->password = colon + 1;
+    return TRUE;
 }
 
 // 解析 Shadowsocks 链接
 static ProxyConfig* parse_shadowsocks(const char *url) {
-    // ss://base64(method:password)@server:port
+    // SIP002: ss://base64(method:password)@server:port/?plugin=...#name
+    //         ss://method:password@server:port（2022 加密方法，用户信息做 URL 编码）
+    // 旧格式: ss://base64(method:password@server:port)#name
     if (strncmp(url, "ss://", 5) != 0) return NULL;
     
-    ProxyConfig *config = g_new0(ProxyConfig, 1);
-    config->type = PROXY_TYPE_SHADOWSOCKS;
-    config->name = g_strdup("Shadowsocks");
+    ParsedConfig *pc = parsed_config_new(PROXY_TYPE_SHADOWSOCKS, url + 5, strlen(url + 5));
+    SSConfig *ss = &pc->config.config.ss;
+    char *data = pc->data;
     
-    const char *data = url + 5;
-    char *at_pos = strchr(data, '@');
+    take_fragment_name(pc, data, "Shadowsocks");
     
-    if (at_pos) {
-        // 新格式: ss://base64@server:port
-        gchar *decoded = base64_decode_str(data);
-        if (!decoded) {
-            g_free(config);
-            return NULL;
-        }
+    char *question = strchr(data, '?');
+    if (question) {
+        *question = '\0';
+        char *plugin = NULL;
+        QueryField fields[] = { { "plugin", &plugin } };
+        parse_query_inplace(question + 1, fields, G_N_ELEMENTS(fields));
         
-        // 解析 method:password
-        char *colon = strchr(decoded, ':');
-        if (colon) {
-            *colon = '\0';
-            config->config.ss.method = g_strdup(decoded);
-            config->config.ss.password = g_strdup(colon + 1);
-        }
-        g_free(decoded);
-        
-        // 解析 server:port
-        at_pos++; // 跳过 @
-        char *slash = strchr(at_pos, '/');
-        if (slash) *slash = '\0';
-        
-        char *port_pos = strrchr(at_pos, ':');
-        if (port_pos) {
-            *port_pos = '\0';
-            config->config.ss.server = g_strdup(at_pos);
-            config->config.ss.port = atoi(port_pos + 1);
+        // plugin=name;opt1=a;opt2=b
+        if (plugin && *plugin) {
+            char *semicolon = strchr(plugin, ';');
+            if (semicolon) {
+                *semicolon = '\0';
+                ss->plugin_opts = semicolon + 1;
+            }
+            ss->plugin = plugin;
         }
-    } else {
-        // 旧格式: ss://base64(method:password@server:port)
-        gchar *decoded = base64_decode_str(data);
-        if (!decoded) {
-            g_free(config);
-            return NULL;
+    }
+    
+    gboolean ok;
+    char *at = strrchr(data, '@');
+    if (at) {
+        // 只解码用户信息，不包含 @server:port
+        *at = '\0';
+        if (strchr(data, ':')) {
+            ok = split_ss_userinfo(percent_decode(data), ss);
+        } else {
+            ok = base64_decode_inplace(data, strlen(data)) > 0 && split_ss_userinfo(data, ss);
         }
-        
-        // 解析完整字符串
-        char *at = strchr(decoded, '@');
+        if (ok) {
+            split_host_port(at + 1, &ss->server, &ss->port, 0);
+        }
+    } else {
+        data[strcspn(data, "/")] = '\0';
+        ok = base64_decode_inplace(data, strlen(data)) > 0;
+        at = ok ? strrchr(data, '@') : NULL;
         if (at) {
             *at = '\0';
-            char *colon1 = strchr(decoded, ':');
-            if (colon1) {
-                *colon1 = '\0';
-                config->config.ss.method = g_strdup(decoded);
-                config->config.ss.password = g_strdup(colon1 + 1);
-            }
-            
-            char *server_port = at + 1;
-            char *slash = strchr(server_port, '/');
-            if (slash) *slash = '\0';
-            
-            char *colon2 = strrchr(server_port, ':');
-            if (colon2) {
-                *colon2 = '\0';
-                config->config.ss.server = g_strdup(server_port);
-                config->config.ss.port = atoi(colon2 + 1);
+            ok = split_ss_userinfo(data, ss);
+            split_host_port(at + 1, &ss->server, &ss->port, 0);
+        } else {
+            ok = FALSE;
+        }
+    }
+    
+    if (!ok || !server_valid(ss->server, ss->port) || !*ss->method) {
+        g_free(pc);
+        return NULL;
+    }
+    
+    return &pc->config;
+}
+
+// 原地解析 JSON 字符串（p 指向开头的引号），反转义后以 NUL 结尾，返回结尾引号之后的位置
+static char* json_string_inplace(char *p, char **value) {
+    char *w = ++p;
+    *value = w;
+    
+    while (*p && *p != '"') {
+        if (*p != '\\') {
+            *w++ = *p++;
+            continue;
+        }
+        
+        p++;
+        switch (*p) {
+            case 'b': *w++ = '\b'; p++; break;
+            case 'f': *w++ = '\f'; p++; break;
+            case 'n': *w++ = '\n'; p++; break;
+            case 'r': *w++ = '\r'; p++; break;
+            case 't': *w++ = '\t'; p++; break;
+            case 'u': {
+                gunichar ch = 0;
+                for (int i = 1; i <= 4; i++) {
+                    int v = hex_value(p[i]);
+                    if (v < 0) return NULL;
+                    ch = (ch << 4) | (gunichar)v;
+                }
+                p += 5;
+                
+                // 代理对
+                if (ch >= 0xd800 && ch < 0xdc00 && p[0] == '\\' && p[1] == 'u') {
+                    gunichar low = 0;
+                    for (int i = 2; i <= 5; i++) {
+                        int v = hex_value(p[i]);
+                        if (v < 0) return NULL;
+                        low = (low << 4) | (gunichar)v;
+                    }
+                    if (low >= 0xdc00 && low < 0xe000) {
+                        ch = 0x10000 + ((ch - 0xd800) << 10) + (low - 0xdc00);
+                        p += 6;
+                    }
+                }
+                
+                // UTF-8 编码不长于 \uXXXX 转义本身
+                w += g_unichar_to_utf8(ch, w);
+                break;
             }
+            case '\0':
+                return NULL;
+            default:
+                // \" \\ \/
+                *w++ = *p++;
+                break;
         }
-        g_free(decoded);
     }
     
-    return config;
+    if (*p != '"') return NULL;
+    *w = '\0';
+    return p + 1;
+}
+
+// 跳过一个非字符串的值：数字、true/false/null，或者嵌套的对象/数组
+static char* json_skip_value(char *p) {
+    int depth = 0;
+    gboolean in_string = FALSE;
+    
+    for (; *p; p++) {
+        if (in_string) {
+            if (*p == '\\' && p[1]) p++;
+            else if (*p == '"') in_string = FALSE;
+        } else if (*p == '"') {
+            in_string = TRUE;
+        } else if (*p == '{' || *p == '[') {
+            depth++;
+        } else if (*p == '}' || *p == ']') {
+            if (depth == 0) return p;
+            depth--;
+        } else if (*p == ',' && depth == 0) {
+            return p;
+        }
+    }
+    
+    return depth == 0 ? p : NULL;
+}
+
+static char* json_skip_space(char *p) {
+    while (g_ascii_isspace(*p)) p++;
+    return p;
+}
+
+// 原地截取非字符串的值 [start, end)：去掉尾部空白后以 NUL 结尾，
+// 返回被覆盖前 end 处的分隔符（',' 或 '}'）
+static char json_literal_inplace(char *start, char *end) {
+    char delim = *end;
+    
+    while (end > start && g_ascii_isspace(end[-1])) end--;
+    *end = '\0';
+    return delim;
+}
+
+// VMess 分享格式字段；str 为字符串值，raw 为字符串值或以 NUL 结尾的数字/布尔值
+static void vmess_set_field(VMessConfig *vmess, char **name, int *mux, const char *key, char *str, const char *raw) {
+    if (strcmp(key, "port") == 0) vmess->port = atoi(raw);
+    else if (strcmp(key, "aid") == 0) vmess->alter_id = atoi(raw);
+    else if (strcmp(key, "mux") == 0) *mux = parse_mux_value(str ? str : raw);
+    else if (!str) return;
+    else if (strcmp(key, "ps") == 0) *name = str;
+    else if (strcmp(key, "add") == 0) vmess->address = str;
+    else if (strcmp(key, "id") == 0) vmess->id = str;
+    else if (strcmp(key, "scy") == 0) vmess->security = str;
+    else if (strcmp(key, "net") == 0) vmess->network = str;
+    else if (strcmp(key, "type") == 0) vmess->type = str;
+    else if (strcmp(key, "host") == 0) vmess->host = str;
+    else if (strcmp(key, "path") == 0) vmess->path = str;
+    else if (strcmp(key, "tls") == 0) vmess->tls = str;
+    else if (strcmp(key, "sni") == 0) vmess->sni = str;
 }
 
 // 解析 VMess 链接
 static ProxyConfig* parse_vmess(const char *url) {
-    // vmess://base64(json)
+    // vmess://base64(json)，json 是只有一层的对象
     if (strncmp(url, "vmess://", 8) != 0) return NULL;
     
-    gchar *decoded = base64_decode_str(url + 8);
-    if (!decoded) return NULL;
+    ParsedConfig *pc = parsed_config_new(PROXY_TYPE_VMESS, url + 8, strlen(url + 8));
+    VMessConfig *vmess = &pc->config.config.vmess;
+    
+    if (base64_decode_inplace(pc->data, strlen(pc->data)) <= 0) {
+        g_free(pc);
+        return NULL;
+    }
     
-    ProxyConfig *config = g_new0(ProxyConfig, 1);
-    config->type = PROXY_TYPE_VMESS;
+    char *p = json_skip_space(pc->data);
+    gboolean ok = *p == '{';
+    if (ok) p = json_skip_space(p + 1);
     
-    // 解析 JSON (使用 json-c)
-    struct json_object *parsed_json = json_tokener_parse(decoded);
-    if (parsed_json) {
-        struct json_object *tmp;
+    while (ok && *p != '}') {
+        char *key = NULL;
+        char *str = NULL;
+        char *raw;
+        char delim = '\0';
         
-        if (json_object_object_get_ex(parsed_json, "ps", &tmp)) {
-            config->name = g_strdup(json_object_get_string(tmp));
-        }
-        if (json_object_object_get_ex(parsed_json, "add", &tmp)) {
-            config->config.vmess.address = g_strdup(json_object_get_string(tmp));
-        }
-        if (json_object_object_get_ex(parsed_json, "port", &tmp)) {
-            config->config.vmess.port = json_object_get_int(tmp);
-        }
-        if (json_object_object_get_ex(parsed_json, "id", &tmp)) {
-            config->config.vmess.id = g_strdup(json_object_get_string(tmp));
-        }
-        if (json_object_object_get_ex(parsed_json, "aid", &tmp)) {
-            config->config.vmess.alter_id = json_object_get_int(tmp);
-        }
-        if (json_object_object_get_ex(parsed_json, "net", &tmp)) {
-            config->config.vmess.network = g_strdup(json_object_get_string(tmp));
-        }
-        if (json_object_object_get_ex(parsed_json, "type", &tmp)) {
-            config->config.vmess.type = g_strdup(json_object_get_string(tmp));
-        }
-        if (json_object_object_get_ex(parsed_json, "host", &tmp)) {
-            config->config.vmess.host = g_strdup(json_object_get_string(tmp));
-        }
-        if (json_object_object_get_ex(parsed_json, "path", &tmp)) {
-            config->config.vmess.path = g_strdup(json_object_get_string(tmp));
-        }
-        if (json_object_object_get_ex(parsed_json, "tls", &tmp)) {
-            config->config.vmess.tls = g_strdup(json_object_get_string(tmp));
-        }
-        if (json_object_object_get_ex(parsed_json, "sni", &tmp)) {
-            config->config.vmess.sni = g_strdup(json_object_get_string(tmp));
+        ok = *p == '"' && (p = json_string_inplace(p, &key)) != NULL;
+        if (!ok) break;
+        p = json_skip_space(p);
+        ok = *p == ':';
+        if (!ok) break;
+        p = json_skip_space(p + 1);
+        
+        raw = p;
+        if (*p == '"') {
+            p = json_string_inplace(p, &str);
+            raw = str;
+            if (p) {
+                p = json_skip_space(p);
+                delim = *p;
+            }
+        } else {
+            // 数字和 true/false 原地截断，"mux": true, 这样的值才能按完整的词解析
+            char *end = json_skip_value(p);
+            if (end) delim = json_literal_inplace(p, end);
+            p = end;
         }
+        ok = p != NULL;
+        if (!ok) break;
         
-        json_object_put(parsed_json);
+        vmess_set_field(vmess, &pc->config.name, &pc->config.mux, key, str, raw);
+        
+        if (delim != ',') {
+            ok = delim == '}';
+            break;
+        }
+        p = json_skip_space(p + 1);
     }
-    
-    g_free(decoded);
-    return config;
+
+    if (!ok || !server_valid(vmess->address, vmess->port) || !vmess->id || !*vmess->id) {
+        g_free(pc);
+        return NULL;
+    }
+
+    if (!pc->config.name || !*pc->config.name) {
+        pc->config.name = parsed_config_strdup(pc, "VMess");
+    }
+
+    return &pc->config;
 }
 
 // 解析 VLess 链接
 static ProxyConfig* parse_vless(const char *url) {
     // vless://uuid@server:port?params#name
     if (strncmp(url, "vless://", 8) != 0) return NULL;
-    
-    ProxyConfig *config = g_new0(ProxyConfig, 1);
-    config->type = PROXY_TYPE_VLESS;
-    
-    const char *data = url + 8;
-    
-    // 解析名称
-    char *hash = strchr(data, '#');
-    if (hash) {
-        config->name = g_uri_unescape_string(hash + 1, NULL);
-    } else {
-        config->name = g_strdup("VLess");
+
+    ParsedConfig *pc = parsed_config_new(PROXY_TYPE_VLESS, url + 8, strlen(url + 8));
+    VLessConfig *vless = &pc->config.config.vless;
+    char *data = pc->data;
+
+    take_fragment_name(pc, data, "VLess");
+
+    char *at = strchr(data, '@');
+    if (!at) {
+        g_free(pc);
+        return NULL;
+    }
+    *at = '\0';
+    vless->id = percent_decode(data);
+
+    char *question = strchr(at + 1, '?');
+    if (question) {
+        *question = '\0';
+        
+        char *path = NULL, *service_name = NULL, *header_type = NULL, *mode = NULL, *mux = NULL;
+        QueryField fields[] = {
+            { "encryption", &vless->encryption },
+            { "flow", &vless->flow },
+            { "type", &vless->network },
+            { "security", &vless->security },
+            { "sni", &vless->sni },
+            { "fp", &vless->fingerprint },
+            { "pbk", &vless->public_key },
+            { "sid", &vless->short_id },
+            { "spx", &vless->spider_x },
+            { "host", &vless->host },
+            { "path", &path },
+            { "serviceName", &service_name },
+            { "headerType", &header_type },
+            { "mode", &mode },
+            { "mux", &mux },
+        };
+        parse_query_inplace(question + 1, fields, G_N_ELEMENTS(fields));
+        pc->config.mux = parse_mux_value(mux);
+        
+        // gRPC 的服务名放在 serviceName，传输模式放在 mode；其他传输的伪装类型放在 headerType
+        gboolean grpc = g_strcmp0(vless->network, "grpc") == 0;
+        vless->path = grpc ? service_name : path;
+        vless->type = grpc ? mode : header_type;
+    }
+
+    split_host_port(at + 1, &vless->address, &vless->port, 443);
+
+    if (!server_valid(vless->address, vless->port) || !*vless->id) {
+        g_free(pc);
+        return NULL;
     }
     
-    // 解析 UUID@server:port
+    // REALITY 没有公钥无法握手，生成的配置会被内核整体拒绝
+    if (g_strcmp0(vless->security, "reality") == 0 && (!vless->public_key || !*vless->public_key)) {
+        g_free(pc);
+        return NULL;
+    }
+
+    return &pc->config;
+}
+
+// 解析 Trojan 链接
+static ProxyConfig* parse_trojan(const char *url) {
+    // trojan://password@server:port?params#name
+    if (strncmp(url, "trojan://", 9) != 0) return NULL;
+
+    ParsedConfig *pc = parsed_config_new(PROXY_TYPE_TROJAN, url + 9, strlen(url + 9));
+    TrojanConfig *trojan = &pc->config.config.trojan;
+    char *data = pc->data;
+
+    take_fragment_name(pc, data, "Trojan");
+
     char *at = strchr(data, '@');
-    if (at) {
-        config->config.vless.id = g_strndup(data, at - data);
+    if (!at) {
+        g_free(pc);
+        return NULL;
+    }
+    *at = '\0';
+    trojan->password = percent_decode(data);
+
+    char *question = strchr(at + 1, '?');
+    if (question) {
+        *question = '\0';
         
-        char *question = strchr(at, '?');
-        char *server_port = at + 1;
-        if (question) {
-            char *colon = strchr(server_port, ':');
-            if (colon && colon < question) {
-                config->config.vless.address = g_strndup(server_port, colon - server_port);
-                config->config.vless.port = atoi(colon + 1);
-            }
-            
-            // 解析参数
-            GHashTable *params = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
-            char *params_str = g_strndup(question + 1, hash ? hash - question - 1 : strlen(question + 1));
-            
-            char **pairs = g_strsplit(params_str, "&", -1);
-            for (int i = 0; pairs[i]; i++) {
-                char **kv = g_strsplit(pairs[i], "=", 2);
-                if (kv[0] && kv[1]) {
-                    g_hash_table_insert(params, g_strdup(kv[0]), g_uri_unescape_string(kv[1], NULL));
-                }
-                g_strfreev(kv);
-            }
-            g_strfreev(pairs);
-            g_free(params_str);
-            
-            config->config.vless.encryption = g_strdup(g_hash_table_lookup(params, "encryption"));
-            config->config.vless.flow = g_strdup(g_hash_table_lookup(params, "flow"));
-            config->config.vless.network = g_strdup(g_hash_table_lookup(params, "type"));
-            config->config.vless.security = g_strdup(g_hash_table_lookup(params, "security"));
-            config->config.vless.sni = g_strdup(g_hash_table_lookup(params, "sni"));
-            
-            g_hash_table_destroy(params);
-        }
+        char *sni = NULL, *peer = NULL;
+        char *path = NULL, *service_name = NULL, *header_type = NULL, *mode = NULL, *mux = NULL;
+        QueryField fields[] = {
+            { "sni", &sni },
+            { "peer", &peer },      // 旧版客户端用 peer 表示 SNI
+            { "type", &trojan->network },
+            { "host", &trojan->host },
+            { "path", &path },
+            { "serviceName", &service_name },
+            { "headerType", &header_type },
+            { "mode", &mode },
+            { "mux", &mux },
+        };
+        parse_query_inplace(question + 1, fields, G_N_ELEMENTS(fields));
+        pc->config.mux = parse_mux_value(mux);
+        
+        trojan->sni = sni ? sni : peer;
+        gboolean grpc = g_strcmp0(trojan->network, "grpc") == 0;
+        trojan->path = grpc ? service_name : path;
+        trojan->type = grpc ? mode : header_type;
     }
-    
-    return config;
+
+    // 未写端口时使用 443
+    split_host_port(at + 1, &trojan->address, &trojan->port, 443);
+
+    if (!server_valid(trojan->address, trojan->port) || !*trojan->password) {
+        g_free(pc);
+        return NULL;
+    }
+
+    return &pc->config;
 }
 
 // 主解析函数
 ProxyConfig* proxy_parser_parse(const char *url) {
     if (!url) return NULL;
-    
+
     if (strncmp(url, "ss://", 5) == 0) {
         return parse_shadowsocks(url);
     } else if (strncmp(url, "vmess://", 8) == 0) {
         return parse_vmess(url);
     } else if (strncmp(url, "vless://", 8) == 0) {
         return parse_vless(url);
+    } else if (strncmp(url, "trojan://", 9) == 0) {
+        return parse_trojan(url);
     }
-    
+
     return NULL;
 }
 
-// 释放配置
+// 释放配置：字符串与配置在同一块内存中
 void proxy_parser_free(ProxyConfig *config) {
-    if (!config) return;
+    g_free(config);
+}
+
+// 获取类型字符串
+const char* proxy_parser_get_type_string(ProxyType type) {
+    switch (type) {
+        case PROXY_TYPE_SHADOWSOCKS: return "Shadowsocks";
+        case PROXY_TYPE_VMESS: return "VMess";
+        case PROXY_TYPE_VLESS: return "VLess";
+        case PROXY_TYPE_TROJAN: return "Trojan";
+        default: return "Unknown";
+    }
+}
+
+// 初始化生成选项
+void proxy_parser_gen_options_init(ProxyGenOptions *opts, int local_port) {
+    if (!opts) return;
     
-    g_free(config->name);
+    memset(opts, 0, sizeof(*opts));
+    opts->local_port = local_port;
+    opts->fakeip = FALSE;
+    opts->fakeip_pool = PROXY_FAKEIP_DEFAULT_POOL;
+    opts->fakeip_pool_size = PROXY_FAKEIP_DEFAULT_POOL_SIZE;
+    opts->dns_port = PROXY_FAKEIP_DEFAULT_DNS_PORT;
+    opts->probe_url = PROXY_BALANCER_PROBE_URL;
+    opts->probe_interval = PROXY_BALANCER_PROBE_INTERVAL;
+}
+
+// 获取节点地址
+gboolean proxy_parser_get_endpoint(const ProxyConfig *config, const char **host, int *port,
+                                   gboolean *tls, const char **sni) {
+    if (!config || !host || !port) return FALSE;
+    
+    const char *server_name = NULL;
+    gboolean use_tls = FALSE;
     
     switch (config->type) {
         case PROXY_TYPE_SHADOWSOCKS:
-            g_free(config->config.ss.server);
-            g_free(config->config.ss.method);
-            g_free(config->config.ss.password);
-            g_free(config->config.ss.plugin);
-            g_free(config->config.ss.plugin_opts);
+            *host = config->config.ss.server;
+            *port = config->config.ss.port;
             break;
         case PROXY_TYPE_VMESS:
-            g_free(config->config.vmess.address);
-            g_free(config->config.vmess.id);
-            g_free(config->config.vmess.security);
-            g_free(config->config.vmess.network);
-            g_free(config->config.vmess.type);
-            g_free(config->config.vmess.host);
-            g_free(config->config.vmess.path);
-            g_free(config->config.vmess.tls);
-            g_free(config->config.vmess.sni);
+            *host = config->config.vmess.address;
+            *port = config->config.vmess.port;
+            use_tls = g_strcmp0(config->config.vmess.tls, "tls") == 0;
+            server_name = config->config.vmess.sni;
             break;
         case PROXY_TYPE_VLESS:
-            g_free(config->config.vless.address);
-            g_free(config->config.vless.id);
-            g_free(config->config.vless.encryption);
-            g_free(config->config.vless.flow);
-            g_free(config->config.vless.network);
-            g_free(config->config.vless.type);
-            g_free(config->config.vless.host);
-            g_free(config->config.vless.path);
-            g_free(config->config.vless.security);
-            g_free(config->config.vless.sni);
+            *host = config->config.vless.address;
+            *port = config->config.vless.port;
+            use_tls = g_strcmp0(config->config.vless.security, "tls") == 0 ||
+                      g_strcmp0(config->config.vless.security, "reality") == 0;
+            server_name = config->config.vless.sni;
+            break;
+        case PROXY_TYPE_TROJAN:
+            *host = config->config.trojan.address;
+            *port = config->config.trojan.port;
+            use_tls = TRUE;
+            server_name = config->config.trojan.sni;
             break;
+        default:
+            return FALSE;
+    }
+    
+    if (tls) *tls = use_tls;
+    if (sni) *sni = (server_name && *server_name) ? server_name : *host;
+    
+    return *host && **host && *port > 0 && *port <= 65535;
+}
+
+gboolean proxy_parser_needs_xtls(const ProxyConfig *config) {
+    if (!config || config->type != PROXY_TYPE_VLESS) return FALSE;
+    
+    const VLessConfig *c = &config->config.vless;
+    return (c->flow && *c->flow) || g_strcmp0(c->security, "reality") == 0;
+}
+
+// 节点指纹 (FNV-1a)
+#define FNV64_OFFSET 0xcbf29ce484222325ULL
+#define FNV64_PRIME 0x100000001b3ULL
+
+static guint64 fnv_str(guint64 hash, const char *str, gboolean fold_case) {
+    if (str) {
+        for (const char *p = str; *p; p++) {
+            hash ^= (guchar)(fold_case ? g_ascii_tolower(*p) : *p);
+            hash *= FNV64_PRIME;
+        }
+    }
+    
+    // 字段分隔符，避免 "ab"+"c" 与 "a"+"bc" 相同
+    hash ^= 0xff;
+    hash *= FNV64_PRIME;
+    return hash;
+}
+
+static guint64 fnv_int(guint64 hash, int value) {
+    char buf[16];
+    g_snprintf(buf, sizeof(buf), "%d", value);
+    return fnv_str(hash, buf, FALSE);
+}
+
+// 取值等于默认值时与省略等价，如 network=tcp、headerType=none
+static guint64 fnv_opt(guint64 hash, const char *str, const char *default_value) {
+    if (str && g_ascii_strcasecmp(str, default_value) == 0) {
+        str = NULL;
+    }
+    return fnv_str(hash, str, TRUE);
+}
+
+guint64 proxy_parser_fingerprint(const ProxyConfig *config) {
+    if (!config) return 0;
+    
+    guint64 hash = fnv_int(FNV64_OFFSET, config->type);
+    
+    switch (config->type) {
+        case PROXY_TYPE_SHADOWSOCKS: {
+            const SSConfig *c = &config->config.ss;
+            hash = fnv_str(hash, c->server, TRUE);
+            hash = fnv_int(hash, c->port);
+            hash = fnv_str(hash, c->method, TRUE);
+            hash = fnv_str(hash, c->password, FALSE);
+            hash = fnv_str(hash, c->plugin, FALSE);
+            hash = fnv_str(hash, c->plugin_opts, FALSE);
+            break;
+        }
+        case PROXY_TYPE_VMESS: {
+            const VMessConfig *c = &config->config.vmess;
+            hash = fnv_str(hash, c->address, TRUE);
+            hash = fnv_int(hash, c->port);
+            hash = fnv_str(hash, c->id, TRUE);
+            hash = fnv_int(hash, c->alter_id);
+            hash = fnv_opt(hash, c->security, "auto");
+            hash = fnv_opt(hash, c->network, "tcp");
+            hash = fnv_opt(hash, c->type, "none");
+            hash = fnv_str(hash, c->host, TRUE);
+            hash = fnv_str(hash, c->path, FALSE);
+            hash = fnv_opt(hash, c->tls, "none");
+            hash = fnv_str(hash, c->sni, TRUE);
+            break;
+        }
+        case PROXY_TYPE_VLESS: {
+            const VLessConfig *c = &config->config.vless;
+            hash = fnv_str(hash, c->address, TRUE);
+            hash = fnv_int(hash, c->port);
+            hash = fnv_str(hash, c->id, TRUE);
+            hash = fnv_str(hash, c->flow, FALSE);
+            hash = fnv_opt(hash, c->network, "tcp");
+            hash = fnv_opt(hash, c->type, "none");
+            hash = fnv_str(hash, c->host, TRUE);
+            hash = fnv_str(hash, c->path, FALSE);
+            hash = fnv_opt(hash, c->security, "none");
+            hash = fnv_str(hash, c->sni, TRUE);
+            hash = fnv_str(hash, c->fingerprint, TRUE);
+            hash = fnv_str(hash, c->public_key, FALSE);
+            hash = fnv_str(hash, c->short_id, TRUE);
+            hash = fnv_str(hash, c->spider_x, FALSE);
+            // 后加入的字段：取默认值 none 时不参与计算，升级后已有节点的指纹不变
+            if (c->encryption && *c->encryption && g_ascii_strcasecmp(c->encryption, "none") != 0) {
+                hash = fnv_str(hash, c->encryption, TRUE);
+            }
+            break;
+        }
+        case PROXY_TYPE_TROJAN: {
+            const TrojanConfig *c = &config->config.trojan;
+            hash = fnv_str(hash, c->address, TRUE);
+            hash = fnv_int(hash, c->port);
+            hash = fnv_str(hash, c->password, FALSE);
+            hash = fnv_str(hash, c->sni, TRUE);
+            hash = fnv_opt(hash, c->network, "tcp");
+            hash = fnv_opt(hash, c->type, "none");
+            hash = fnv_str(hash, c->host, TRUE);
+            hash = fnv_str(hash, c->path, FALSE);
+            break;
+        }
         default:
             break;
     }
     
-    g_free(config);
+    return hash;
 }
 
-// 获取类型字符串
-const char* proxy_parser_get_type_string(ProxyType type) {
-    switch (type) {
-        case PROXY_TYPE_SHADOWSOCKS: return "Shadowsocks";
-        case PROXY_TYPE_VMESS: return "VMess";
-        case PROXY_TYPE_VLESS: return "VLess";
-        case PROXY_TYPE_TROJAN: return "Trojan";
-        default: return "Unknown";
+// 未指定分流规则时的默认规则：隧道网段和中国大陆 IP/域名直连，广告阻断
+static char *default_direct_cidrs[] = { (char*)PROXY_VPN_SUBNET, NULL };
+
+static const ProxyRouteRules default_routes = {
+    .final_direct = FALSE,
+    .geoip_cn_direct = TRUE,
+    .geosite_cn_direct = TRUE,
+    .block_ads = TRUE,
+    .direct_cidrs = default_direct_cidrs,
+    .block_cidrs = NULL,
+};
+
+// 分流规则引用的 geo 数据类别
+#define GEO_CODE_CN "cn"
+#define GEO_CODE_ADS "category-ads-all"
+
+static const ProxyRouteRules* gen_routes(const ProxyGenOptions *opts) {
+    return opts->routes ? opts->routes : &default_routes;
+}
+
+static gboolean strv_nonempty(char * const *strv) {
+    return strv && strv[0];
+}
+
+// 分流规则写入配置的大致字节数：缩进后每个 CIDR 占一行，用于预分配输出缓冲区
+static gsize routes_size_hint(const ProxyRouteRules *routes) {
+    gsize n = 0;
+    
+    for (gsize i = 0; routes->direct_cidrs && routes->direct_cidrs[i]; i++) n++;
+    for (gsize i = 0; routes->block_cidrs && routes->block_cidrs[i]; i++) n++;
+    return n * 32;
+}
+
+char** proxy_route_rules_geo_codes(const ProxyRouteRules *rules, gboolean geosite) {
+    const ProxyRouteRules *routes = rules ? rules : &default_routes;
+    GPtrArray *codes = g_ptr_array_new();
+    
+    // 与配置生成中的引用保持一致
+    if (geosite) {
+        if (routes->geosite_cn_direct) g_ptr_array_add(codes, g_strdup(GEO_CODE_CN));
+        if (routes->block_ads) g_ptr_array_add(codes, g_strdup(GEO_CODE_ADS));
+    } else if (routes->geoip_cn_direct) {
+        g_ptr_array_add(codes, g_strdup(GEO_CODE_CN));
+    }
+    
+    if (codes->len == 0) {
+        g_ptr_array_free(codes, TRUE);
+        return NULL;
+    }
+    g_ptr_array_add(codes, NULL);
+    return (char**)g_ptr_array_free(codes, FALSE);
+}
+
+void proxy_route_rules_free(ProxyRouteRules *rules) {
+    if (!rules) return;
+    
+    g_strfreev(rules->direct_cidrs);
+    g_strfreev(rules->block_cidrs);
+    g_free(rules);
+}
+
+guint64 proxy_parser_config_hash(ProxyConfig * const *configs, guint count, const ProxyGenOptions *opts) {
+    guint64 hash = fnv_int(FNV64_OFFSET, (int)count);
+    
+    for (guint i = 0; i < count; i++) {
+        char buf[32];
+        g_snprintf(buf, sizeof(buf), "%" G_GUINT64_FORMAT, proxy_parser_fingerprint(configs[i]));
+        hash = fnv_str(hash, buf, FALSE);
+        hash = fnv_int(hash, configs[i]->mux);
+    }
+    
+    if (opts) {
+        hash = fnv_int(hash, opts->local_port);
+        hash = fnv_int(hash, opts->fakeip);
+        hash = fnv_str(hash, opts->fakeip_pool, FALSE);
+        hash = fnv_int(hash, opts->fakeip_pool_size);
+        hash = fnv_int(hash, opts->dns_port);
+        hash = fnv_int(hash, opts->api_port);
+        hash = fnv_str(hash, opts->probe_url, FALSE);
+        hash = fnv_str(hash, opts->probe_interval, FALSE);
+        hash = fnv_int(hash, opts->mux_concurrency);
+        hash = fnv_int(hash, opts->xudp);
+        hash = fnv_int(hash, opts->profile);
+        
+        const ProxyRouteRules *routes = gen_routes(opts);
+        hash = fnv_int(hash, routes->final_direct);
+        hash = fnv_int(hash, routes->geoip_cn_direct);
+        hash = fnv_int(hash, routes->geosite_cn_direct);
+        hash = fnv_int(hash, routes->block_ads);
+        hash = fnv_int(hash, opts->geo_lite);
+        hash = fnv_int(hash, opts->xtls);
+        for (gsize i = 0; routes->direct_cidrs && routes->direct_cidrs[i]; i++) {
+            hash = fnv_str(hash, routes->direct_cidrs[i], FALSE);
+        }
+        hash = fnv_int(hash, -1);   // 分隔两个列表
+        for (gsize i = 0; routes->block_cidrs && routes->block_cidrs[i]; i++) {
+            hash = fnv_str(hash, routes->block_cidrs[i], FALSE);
+        }
     }
+    
+    return hash;
 }
 
 // 生成 V2Ray 配置
 char* proxy_parser_generate_v2ray_config(ProxyConfig *config, int local_port) {
+    ProxyGenOptions opts;
+    proxy_parser_gen_options_init(&opts, local_port);
+    return proxy_parser_generate_v2ray_config_ex(config, &opts);
+}
+
+// 传输方式：链接中 "h2" 与 "http" 同义，未设置时为 tcp
+static const char* stream_network(const char *network) {
+    if (!network || !*network) return "tcp";
+    if (g_strcmp0(network, "h2") == 0) return "http";
+    return network;
+}
+
+static const char* default_path(const char *path) {
+    return path && *path ? path : "/";
+}
+
+// TLS 服务器名：未指定 SNI 时使用伪装域名；h2 有多个域名时交给内核使用服务器地址
+static const char* tls_server_name(const char *sni, const char *host) {
+    if (sni && *sni) return sni;
+    return host && !strchr(host, ',') ? host : NULL;
+}
+
+// h2 的 host 可以是逗号分隔的多个域名
+static void write_host_list(JsonWriter *w, const char *key, const char *host) {
+    json_writer_key(w, key);
+    json_writer_begin_array(w);
+    const char *p = host;
+    while (*p) {
+        while (*p == ',' || g_ascii_isspace(*p)) p++;
+        const char *end = p + strcspn(p, ",");
+        const char *last = end;
+        while (last > p && g_ascii_isspace(last[-1])) last--;
+        if (last > p) {
+            char *name = g_strndup(p, (gsize)(last - p));
+            json_writer_string(w, name);
+            g_free(name);
+        }
+        p = end;
+    }
+    json_writer_end_array(w);
+}
+
+// 性能配置的参数；0 或 NULL 表示不设置，使用内核默认值
+typedef struct {
+    const char *label;
+    gboolean tcp_fast_open;
+    int keepalive_interval;     // TCP keepalive 间隔（秒）
+    const char *congestion;     // 拥塞控制算法 (Xray 的 tcpcongestion)
+    int handshake;              // policy: 握手超时（秒）
+    int conn_idle;              // policy: 空闲超时（秒）
+    int uplink_only;            // policy: 下行关闭后上行的等待时间（秒）
+    int downlink_only;          // policy: 上行关闭后下行的等待时间（秒）
+    int buffer_size;            // policy: 每个连接的缓冲区 (KB)
+} ProfileSpec;
+
+static const ProfileSpec profile_specs[PROXY_PROFILE_COUNT] = {
+    [PROXY_PROFILE_DEFAULT] = { "默认", FALSE, 0, NULL, 0, 0, 0, 0, 0 },
+    [PROXY_PROFILE_LOW_LATENCY] = { "低延迟", TRUE, 15, NULL, 2, 120, 1, 1, 0 },
+    [PROXY_PROFILE_BULK] = { "大流量", FALSE, 30, "bbr", 8, 600, 5, 10, 2048 },
+    [PROXY_PROFILE_LOW_MEMORY] = { "低内存", FALSE, 0, NULL, 4, 60, 1, 1, 16 },
+};
+
+static const ProfileSpec* profile_spec(ProxyProfile profile) {
+    return &profile_specs[(guint)profile < PROXY_PROFILE_COUNT ? profile : PROXY_PROFILE_DEFAULT];
+}
+
+const char* proxy_parser_profile_to_string(ProxyProfile profile) {
+    return profile_spec(profile)->label;
+}
+
+static gboolean profile_has_policy(const ProfileSpec *spec) {
+    return spec->handshake > 0 || spec->conn_idle > 0 || spec->uplink_only > 0 ||
+           spec->downlink_only > 0 || spec->buffer_size > 0;
+}
+
+// 出站的 sockopt：总是带上 SO_MARK，透明代理规则据此放行内核自身的连接
+static void write_sockopt(JsonWriter *w, const ProfileSpec *spec) {
+    json_writer_key(w, "sockopt");
+    json_writer_begin_object(w);
+    json_writer_member_int(w, "mark", PROXY_SOCKET_MARK);
+    if (spec->tcp_fast_open) {
+        json_writer_member_bool(w, "tcpFastOpen", TRUE);
+    }
+    if (spec->keepalive_interval > 0) {
+        json_writer_member_int(w, "tcpKeepAliveInterval", spec->keepalive_interval);
+    }
+    // V2Ray 忽略 tcpcongestion
+    json_writer_member_nonempty(w, "tcpcongestion", spec->congestion);
+    json_writer_end_object(w);
+}
+
+// 没有传输设置的出站 (Shadowsocks、直连) 只写 sockopt
+static void write_sockopt_stream(JsonWriter *w, const ProfileSpec *spec) {
+    json_writer_key(w, "streamSettings");
+    json_writer_begin_object(w);
+    write_sockopt(w, spec);
+    json_writer_end_object(w);
+}
+
+// 写入 policy：统计开关和性能配置的等级 0 参数（所有入站连接都是等级 0）
+static void write_policy(JsonWriter *w, const ProxyGenOptions *opts) {
+    const ProfileSpec *spec = profile_spec(opts->profile);
+    if (opts->api_port <= 0 && !profile_has_policy(spec)) return;
+    
+    json_writer_key(w, "policy");
+    json_writer_begin_object(w);
+    
+    if (profile_has_policy(spec)) {
+        json_writer_key(w, "levels");
+        json_writer_begin_object(w);
+        json_writer_key(w, "0");
+        json_writer_begin_object(w);
+        if (spec->handshake > 0) json_writer_member_int(w, "handshake", spec->handshake);
+        if (spec->conn_idle > 0) json_writer_member_int(w, "connIdle", spec->conn_idle);
+        if (spec->uplink_only > 0) json_writer_member_int(w, "uplinkOnly", spec->uplink_only);
+        if (spec->downlink_only > 0) json_writer_member_int(w, "downlinkOnly", spec->downlink_only);
+        if (spec->buffer_size > 0) json_writer_member_int(w, "bufferSize", spec->buffer_size);
+        json_writer_end_object(w);
+        json_writer_end_object(w);
+    }
+    
+    if (opts->api_port > 0) {
+        json_writer_key(w, "system");
+        json_writer_begin_object(w);
+        json_writer_member_bool(w, "statsInboundUplink", TRUE);
+        json_writer_member_bool(w, "statsInboundDownlink", TRUE);
+        json_writer_member_bool(w, "statsOutboundUplink", TRUE);
+        json_writer_member_bool(w, "statsOutboundDownlink", TRUE);
+        json_writer_end_object(w);
+    }
+    
+    json_writer_end_object(w);
+}
+
+// 出站的 TLS 设置，public_key 不为 NULL 时为 REALITY
+typedef struct {
+    const char *sni;
+    const char *fingerprint;    // uTLS 指纹，NULL 表示内核默认
+    const char *public_key;
+    const char *short_id;
+    const char *spider_x;
+} TlsSpec;
+
+// REALITY 必须模拟浏览器的 ClientHello，链接未指定指纹时使用 chrome
+#define PROXY_REALITY_DEFAULT_FINGERPRINT "chrome"
+
+// VLESS 节点的 TLS 设置，不使用 TLS 时返回 NULL
+// 内核不支持 uTLS 时忽略指纹；需要 REALITY 的节点不会交给这样的内核
+static const TlsSpec* vless_tls(const VLessConfig *c, const ProxyGenOptions *opts, TlsSpec *tls) {
+    gboolean reality = g_strcmp0(c->security, "reality") == 0;
+    if (!reality && g_strcmp0(c->security, "tls") != 0) return NULL;
+    
+    memset(tls, 0, sizeof(*tls));
+    tls->sni = c->sni;
+    if (opts->xtls) {
+        tls->fingerprint = c->fingerprint && *c->fingerprint ? c->fingerprint : NULL;
+    }
+    if (reality) {
+        tls->public_key = c->public_key;
+        tls->short_id = c->short_id;
+        tls->spider_x = c->spider_x;
+        if (!tls->fingerprint) tls->fingerprint = PROXY_REALITY_DEFAULT_FINGERPRINT;
+    }
+    return tls;
+}
+
+// VLESS 节点使用的 flow，没有时返回 NULL
+static const char* vless_flow(const VLessConfig *c) {
+    return c->flow && *c->flow ? c->flow : NULL;
+}
+
+// 写入传输和 TLS 设置 (streamSettings)
+// header_type: tcp 的伪装类型，或 gRPC 的模式 ("multi")
+static void write_stream_settings(JsonWriter *w, const char *network, const char *header_type,
+                                  const char *host, const char *path, const TlsSpec *tls,
+                                  const ProfileSpec *spec) {
+    const char *net = stream_network(network);
+    json_writer_key(w, "streamSettings");
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "network", net);
+    
+    if (g_strcmp0(net, "ws") == 0) {
+        json_writer_key(w, "wsSettings");
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "path", default_path(path));
+        if (host && *host) {
+            json_writer_key(w, "headers");
+            json_writer_begin_object(w);
+            json_writer_member_string(w, "Host", host);
+            json_writer_end_object(w);
+        }
+        json_writer_end_object(w);
+    } else if (g_strcmp0(net, "grpc") == 0) {
+        json_writer_key(w, "grpcSettings");
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "serviceName", path ? path : "");
+        if (g_strcmp0(header_type, "multi") == 0) {
+            json_writer_member_bool(w, "multiMode", TRUE);
+        }
+        json_writer_end_object(w);
+    } else if (g_strcmp0(net, "http") == 0) {
+        json_writer_key(w, "httpSettings");
+        json_writer_begin_object(w);
+        if (host && *host) {
+            write_host_list(w, "host", host);
+        }
+        json_writer_member_string(w, "path", default_path(path));
+        json_writer_end_object(w);
+    } else if (g_strcmp0(net, "tcp") == 0 && g_strcmp0(header_type, "http") == 0) {
+        // tcp + HTTP 伪装头
+        const char *paths[] = { default_path(path) };
+        json_writer_key(w, "tcpSettings");
+        json_writer_begin_object(w);
+        json_writer_key(w, "header");
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "type", "http");
+        json_writer_key(w, "request");
+        json_writer_begin_object(w);
+        json_writer_member_strv(w, "path", paths, 1);
+        if (host && *host) {
+            const char *hosts[] = { host };
+            json_writer_key(w, "headers");
+            json_writer_begin_object(w);
+            json_writer_member_strv(w, "Host", hosts, 1);
+            json_writer_end_object(w);
+        }
+        json_writer_end_object(w);
+        json_writer_end_object(w);
+        json_writer_end_object(w);
+    }
+    
+    if (tls && tls->public_key) {
+        // REALITY: 握手借用目标网站的证书，服务器名必须是服务端 serverNames 中的一个
+        json_writer_member_string(w, "security", "reality");
+        json_writer_key(w, "realitySettings");
+        json_writer_begin_object(w);
+        json_writer_member_nonempty(w, "serverName", tls_server_name(tls->sni, host));
+        json_writer_member_string(w, "fingerprint", tls->fingerprint);
+        json_writer_member_string(w, "publicKey", tls->public_key);
+        json_writer_member_nonempty(w, "shortId", tls->short_id);
+        json_writer_member_nonempty(w, "spiderX", tls->spider_x);
+        json_writer_end_object(w);
+    } else if (tls) {
+        json_writer_member_string(w, "security", "tls");
+        json_writer_key(w, "tlsSettings");
+        json_writer_begin_object(w);
+        json_writer_member_nonempty(w, "serverName", tls_server_name(tls->sni, host));
+        if (g_strcmp0(net, "http") == 0) {
+            static const char * const alpn[] = { "h2" };
+            json_writer_member_strv(w, "alpn", alpn, 1);
+        }
+        json_writer_member_nonempty(w, "fingerprint", tls->fingerprint);
+        json_writer_end_object(w);
+    } else {
+        json_writer_member_string(w, "security", "none");
+    }
+    
+    write_sockopt(w, spec);
+    json_writer_end_object(w);
+}
+
+// 写入 VMess/VLESS 的 settings.vnext，用户对象保持打开，由调用者写入字段后调用 end_vnext_settings
+static void begin_vnext_settings(JsonWriter *w, const char *address, int port) {
+    json_writer_key(w, "settings");
+    json_writer_begin_object(w);
+    json_writer_key(w, "vnext");
+    json_writer_begin_array(w);
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "address", address ? address : "");
+    json_writer_member_int(w, "port", port);
+    json_writer_key(w, "users");
+    json_writer_begin_array(w);
+    json_writer_begin_object(w);
+}
+
+static void end_vnext_settings(JsonWriter *w) {
+    json_writer_end_object(w);
+    json_writer_end_array(w);
+    json_writer_end_object(w);
+    json_writer_end_array(w);
+    json_writer_end_object(w);
+}
+
+// 写入 settings.servers，服务器对象保持打开，由调用者写入凭据后调用 end_servers_settings
+static void begin_servers_settings(JsonWriter *w, const char *address, int port) {
+    json_writer_key(w, "settings");
+    json_writer_begin_object(w);
+    json_writer_key(w, "servers");
+    json_writer_begin_array(w);
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "address", address ? address : "");
+    json_writer_member_int(w, "port", port);
+}
+
+static void end_servers_settings(JsonWriter *w) {
+    json_writer_end_object(w);
+    json_writer_end_array(w);
+    json_writer_end_object(w);
+}
+
+// 节点实际使用的 Mux 并发数，0 表示不启用
+// 只用于 VMess/VLESS/Trojan；VLESS 的 flow (XTLS) 与 Mux 不兼容
+static int effective_mux(const ProxyConfig *config, const ProxyGenOptions *opts) {
+    switch (config->type) {
+        case PROXY_TYPE_VMESS:
+        case PROXY_TYPE_TROJAN:
+            break;
+        case PROXY_TYPE_VLESS:
+            if (config->config.vless.flow && *config->config.vless.flow) return 0;
+            break;
+        default:
+            return 0;
+    }
+    
+    if (config->mux < 0) return 0;
+    return config->mux > 0 ? config->mux : opts->mux_concurrency;
+}
+
+// 写入 Mux 设置
+static void write_mux_settings(JsonWriter *w, int concurrency, gboolean xudp) {
+    json_writer_key(w, "mux");
+    json_writer_begin_object(w);
+    json_writer_member_bool(w, "enabled", TRUE);
+    json_writer_member_int(w, "concurrency", concurrency);
+    if (xudp) {
+        // UDP 走独立的 XUDP 连接；QUIC (UDP 443) 拒绝后浏览器回退到 TCP，继续复用
+        json_writer_member_int(w, "xudpConcurrency", PROXY_XUDP_DEFAULT_CONCURRENCY);
+        json_writer_member_string(w, "xudpProxyUDP443", "reject");
+    }
+    json_writer_end_object(w);
+}
+
+// 写入代理出站
+static void write_proxy_outbound(JsonWriter *w, ProxyConfig *config, const char *tag,
+                                 const ProxyGenOptions *opts) {
+    const ProfileSpec *spec = profile_spec(opts->profile);
+    TlsSpec tls = { 0 };
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "tag", tag);
+    
+    if (config->type == PROXY_TYPE_VMESS) {
+        const VMessConfig *c = &config->config.vmess;
+        json_writer_member_string(w, "protocol", "vmess");
+        begin_vnext_settings(w, c->address, c->port);
+        json_writer_member_string(w, "id", c->id ? c->id : "");
+        json_writer_member_int(w, "alterId", c->alter_id);
+        json_writer_member_string(w, "security", c->security && *c->security ? c->security : "auto");
+        end_vnext_settings(w);
+        tls.sni = c->sni;
+        write_stream_settings(w, c->network, c->type, c->host, c->path,
+                              g_strcmp0(c->tls, "tls") == 0 ? &tls : NULL, spec);
+    } else if (config->type == PROXY_TYPE_VLESS) {
+        const VLessConfig *c = &config->config.vless;
+        json_writer_member_string(w, "protocol", "vless");
+        begin_vnext_settings(w, c->address, c->port);
+        json_writer_member_string(w, "id", c->id ? c->id : "");
+        json_writer_member_string(w, "encryption", c->encryption && *c->encryption ? c->encryption : "none");
+        // Vision: TLS 握手后内层 TLS 数据直接拼接转发 (splice)，不再二次加密
+        json_writer_member_nonempty(w, "flow", vless_flow(c));
+        end_vnext_settings(w);
+        write_stream_settings(w, c->network, c->type, c->host, c->path, vless_tls(c, opts, &tls), spec);
+    } else if (config->type == PROXY_TYPE_TROJAN) {
+        const TrojanConfig *c = &config->config.trojan;
+        json_writer_member_string(w, "protocol", "trojan");
+        begin_servers_settings(w, c->address, c->port);
+        json_writer_member_string(w, "password", c->password);
+        end_servers_settings(w);
+        // Trojan 总是使用 TLS
+        tls.sni = c->sni;
+        write_stream_settings(w, c->network, c->type, c->host, c->path, &tls, spec);
+    } else if (config->type == PROXY_TYPE_SHADOWSOCKS) {
+        const SSConfig *c = &config->config.ss;
+        json_writer_member_string(w, "protocol", "shadowsocks");
+        begin_servers_settings(w, c->server, c->port);
+        json_writer_member_string(w, "method", c->method);
+        json_writer_member_string(w, "password", c->password);
+        end_servers_settings(w);
+        write_sockopt_stream(w, spec);
+    }
+    
+    int mux = effective_mux(config, opts);
+    if (mux > 0) {
+        write_mux_settings(w, mux, opts->xudp);
+    }
+    
+    json_writer_end_object(w);
+}
+
+// 代理出站标签：单节点为 "proxy"，多节点为 "proxy-<序号>"
+static const char* outbound_tag(char *buf, gsize size, guint count, guint index) {
+    if (count == 1) return PROXY_OUTBOUND_TAG;
+    g_snprintf(buf, size, PROXY_OUTBOUND_TAG "-%u", index);
+    return buf;
+}
+
+// 按选项生成 V2Ray 配置
+char* proxy_parser_generate_v2ray_config_ex(ProxyConfig *config, const ProxyGenOptions *opts) {
     if (!config) return NULL;
+    return proxy_parser_generate_v2ray_config_multi(&config, 1, opts);
+}
+
+// V2Ray 的 field 规则: 单个匹配条件
+static void write_v2ray_rule(JsonWriter *w, const char *key, const char *value, const char *outbound_key,
+                             const char *outbound) {
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "type", "field");
+    json_writer_member_strv(w, key, &value, 1);
+    json_writer_member_string(w, outbound_key, outbound);
+    json_writer_end_object(w);
+}
+
+// V2Ray 的 IP 规则: 一条规则带全部 CIDR，geo 非 NULL 时追加在列表末尾
+static void write_v2ray_ip_rule(JsonWriter *w, char * const *cidrs, const char *geo, const char *outbound) {
+    if (!strv_nonempty(cidrs) && !geo) return;
+    
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "type", "field");
+    json_writer_key(w, "ip");
+    json_writer_begin_array(w);
+    for (gsize i = 0; cidrs && cidrs[i]; i++) {
+        json_writer_string(w, cidrs[i]);
+    }
+    if (geo) json_writer_string(w, geo);
+    json_writer_end_array(w);
+    json_writer_member_string(w, "outboundTag", outbound);
+    json_writer_end_object(w);
+}
+
+// 按选项生成多节点 V2Ray 配置
+char* proxy_parser_generate_v2ray_config_multi(ProxyConfig * const *configs, guint count,
+                                               const ProxyGenOptions *opts) {
+    if (!configs || count == 0 || !opts) return NULL;
+    for (guint i = 0; i < count; i++) {
+        // 不支持 XTLS 的内核无法连接这类节点，降级为普通 TLS 也连不上
+        if (!configs[i] || (!opts->xtls && proxy_parser_needs_xtls(configs[i]))) return NULL;
+    }
+    
+    GString *buf = g_string_sized_new(4096 + count * 1024 + routes_size_hint(gen_routes(opts)));
+    JsonWriter writer;
+    JsonWriter *w = &writer;
+    json_writer_init(w, buf, TRUE);
     
-    struct json_object *root = json_object_new_object();
+    json_writer_begin_object(w);
     
     // Log 配置
-    struct json_object *log_obj = json_object_new_object();
-    json_object_object_add(log_obj, "loglevel", json_object_new_string("warning"));
-    json_object_object_add(root, "log", log_obj);
+    json_writer_key(w, "log");
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "loglevel", "warning");
+    json_writer_end_object(w);
+    
+    // 流量统计: 开启入站/出站计数器，并通过本地 API 提供 StatsService 查询
+    if (opts->api_port > 0) {
+        static const char * const services[] = { "StatsService" };
+        
+        json_writer_key(w, "stats");
+        json_writer_begin_object(w);
+        json_writer_end_object(w);
+        
+        json_writer_key(w, "api");
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "tag", "api");
+        json_writer_member_strv(w, "services", services, 1);
+        json_writer_end_object(w);
+    }
+    
+    // 连接策略：统计开关和性能配置
+    write_policy(w, opts);
+    
+    // FakeIP: 由 V2Ray 内置 DNS 从保留地址池分配地址，
+    // 地址池按 poolSize 做 LRU 淘汰，连接到达时直接按映射还原域名
+    if (opts->fakeip) {
+        static const char * const dns_servers[] = { "fakedns", PROXY_FAKEIP_UPSTREAM_DNS };
+        
+        json_writer_key(w, "fakedns");
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "ipPool", opts->fakeip_pool);
+        json_writer_member_int(w, "poolSize", opts->fakeip_pool_size);
+        json_writer_end_object(w);
+        
+        json_writer_key(w, "dns");
+        json_writer_begin_object(w);
+        json_writer_member_strv(w, "servers", dns_servers, G_N_ELEMENTS(dns_servers));
+        json_writer_end_object(w);
+    }
     
     // Inbounds - 透明代理
-    struct json_object *inbounds = json_object_new_array();
-    struct json_object *inbound = json_object_new_object();
-    json_object_object_add(inbound, "tag", json_object_new_string("transparent"));
-    json_object_object_add(inbound, "port", json_object_new_int(local_port));
-    json_object_object_add(inbound, "protocol", json_object_new_string("dokodemo-door"));
-    
-    struct json_object *inbound_settings = json_object_new_object();
-    json_object_object_add(inbound_settings, "network", json_object_new_string("tcp,udp"));
-    json_object_object_add(inbound_settings, "followRedirect", json_object_new_boolean(1));
-    json_object_object_add(inbound, "settings", inbound_settings);
-    
-    struct json_object *sniffing = json_object_new_object();
-    json_object_object_add(sniffing, "enabled", json_object_new_boolean(1));
-    struct json_object *dest_override = json_object_new_array();
-    json_object_array_add(dest_override, json_object_new_string("http"));
-    json_object_array_add(dest_override, json_object_new_string("tls"));
-    json_object_object_add(sniffing, "destOverride", dest_override);
-    json_object_object_add(inbound, "sniffing", sniffing);
-    
-    json_object_array_add(inbounds, inbound);
-    json_object_object_add(root, "inbounds", inbounds);
+    json_writer_key(w, "inbounds");
+    json_writer_begin_array(w);
     
-    // Outbounds
-    struct json_object *outbounds = json_object_new_array();
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "tag", "transparent");
+    json_writer_member_int(w, "port", opts->local_port);
+    json_writer_member_string(w, "protocol", "dokodemo-door");
+    json_writer_key(w, "settings");
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "network", "tcp,udp");
+    json_writer_member_bool(w, "followRedirect", TRUE);
+    json_writer_end_object(w);
+    json_writer_key(w, "sniffing");
+    json_writer_begin_object(w);
+    json_writer_member_bool(w, "enabled", TRUE);
+    if (opts->fakeip) {
+        // 仅根据 FakeIP 映射还原域名，不读取连接首包
+        static const char * const dest_override[] = { "fakedns" };
+        json_writer_member_strv(w, "destOverride", dest_override, 1);
+        json_writer_member_bool(w, "metadataOnly", TRUE);
+    } else {
+        static const char * const dest_override[] = { "http", "tls" };
+        json_writer_member_strv(w, "destOverride", dest_override, 2);
+    }
+    json_writer_end_object(w);
+    json_writer_end_object(w);
     
-    // 主代理出站
-    struct json_object *proxy_outbound = json_object_new_object();
-    json_object_object_add(proxy_outbound, "tag", json_object_new_string("proxy"));
+    // DNS 入站 - FakeIP 模式下接管系统 DNS 查询
+    if (opts->fakeip) {
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "tag", "dns-in");
+        json_writer_member_int(w, "port", opts->dns_port);
+        json_writer_member_string(w, "listen", "127.0.0.1");
+        json_writer_member_string(w, "protocol", "dokodemo-door");
+        json_writer_key(w, "settings");
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "address", PROXY_FAKEIP_UPSTREAM_DNS);
+        json_writer_member_int(w, "port", 53);
+        json_writer_member_string(w, "network", "tcp,udp");
+        json_writer_end_object(w);
+        json_writer_end_object(w);
+    }
     
-    if (config->type == PROXY_TYPE_SHADOWSOCKS) {
-        json_object_object_add(proxy_outbound, "protocol", json_object_new_string("shadowsocks"));
-        struct json_object *settings = json_object_new_object();
-        struct json_object *servers = json_object_new_array();
-        struct json_object *server = json_object_new_object();
-        json_object_object_add(server, "address", json_object_new_string(config->config.ss.server));
-        json_object_object_add(server, "port", json_object_new_int(config->config.ss.port));
-        json_object_object_add(server, "method", json_object_new_string(config->config.ss.method));
-        json_object_object_add(server, "password", json_object_new_string(config->config.ss.password));
-        json_object_array_add(servers, server);
-        json_object_object_add(settings, "servers", servers);
-        json_object_object_add(proxy_outbound, "settings", settings);
+    // 统计 API 入站
+    if (opts->api_port > 0) {
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "tag", "api");
+        json_writer_member_int(w, "port", opts->api_port);
+        json_writer_member_string(w, "listen", "127.0.0.1");
+        json_writer_member_string(w, "protocol", "dokodemo-door");
+        json_writer_key(w, "settings");
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "address", "127.0.0.1");
+        json_writer_end_object(w);
+        json_writer_end_object(w);
     }
     
-    json_object_array_add(outbounds, proxy_outbound);
+    json_writer_end_array(w);
+    
+    // Outbounds
+    json_writer_key(w, "outbounds");
+    json_writer_begin_array(w);
+    
+    for (guint i = 0; i < count; i++) {
+        char tag[32];
+        write_proxy_outbound(w, configs[i], outbound_tag(tag, sizeof(tag), count, i), opts);
+    }
     
     // 直连出站
-    struct json_object *direct_outbound = json_object_new_object();
-    json_object_object_add(direct_outbound, "tag", json_object_new_string("direct"));
-    json_object_object_add(direct_outbound, "protocol", json_object_new_string("freedom"));
-    json_object_array_add(outbounds, direct_outbound);
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "tag", "direct");
+    json_writer_member_string(w, "protocol", "freedom");
+    if (opts->fakeip) {
+        // 直连目标是 FakeIP 时需要解析出真实地址
+        json_writer_key(w, "settings");
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "domainStrategy", "UseIP");
+        json_writer_end_object(w);
+    }
+    write_sockopt_stream(w, profile_spec(opts->profile));
+    json_writer_end_object(w);
     
     // 阻断出站
-    struct json_object *block_outbound = json_object_new_object();
-    json_object_object_add(block_outbound, "tag", json_object_new_string("block"));
-    json_object_object_add(block_outbound, "protocol", json_object_new_string("blackhole"));
-    json_object_array_add(outbounds, block_outbound);
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "tag", "block");
+    json_writer_member_string(w, "protocol", "blackhole");
+    json_writer_end_object(w);
     
-    json_object_object_add(root, "outbounds", outbounds);
+    // DNS 出站
+    if (opts->fakeip) {
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "tag", "dns-out");
+        json_writer_member_string(w, "protocol", "dns");
+        json_writer_end_object(w);
+    }
+    
+    json_writer_end_array(w);
+    
+    // 多节点: observatory 定期经各代理出站访问探测地址，记录延迟和可用性
+    static const char * const proxy_selector[] = { PROXY_OUTBOUND_TAG "-" };
+    if (count > 1) {
+        json_writer_key(w, "observatory");
+        json_writer_begin_object(w);
+        json_writer_member_strv(w, "subjectSelector", proxy_selector, 1);
+        json_writer_member_string(w, "probeURL", opts->probe_url);
+        json_writer_member_string(w, "probeInterval", opts->probe_interval);
+        json_writer_end_object(w);
+    }
     
     // 路由规则
-    struct json_object *routing = json_object_new_object();
-    json_object_object_add(routing, "domainStrategy", json_object_new_string("IPIfNonMatch"));
-    struct json_object *rules = json_object_new_array();
-    
-    // 规则1: 内网 IP 直连
-    struct json_object *rule1 = json_object_new_object();
-    json_object_object_add(rule1, "type", json_object_new_string("field"));
-    struct json_object *ip1 = json_object_new_array();
-    json_object_array_add(ip1, json_object_new_string("10.8.0.0/24"));
-    json_object_object_add(rule1, "ip", ip1);
-    json_object_object_add(rule1, "outboundTag", json_object_new_string("direct"));
-    json_object_array_add(rules, rule1);
-    
-    // 规则2: 中国大陆 IP 直连
-    struct json_object *rule2 = json_object_new_object();
-    json_object_object_add(rule2, "type", json_object_new_string("field"));
-    struct json_object *ip2 = json_object_new_array();
-    json_object_array_add(ip2, json_object_new_string("geoip:cn"));
-    json_object_object_add(rule2, "ip", ip2);
-    json_object_object_add(rule2, "outboundTag", json_object_new_string("direct"));
-    json_object_array_add(rules, rule2);
-    
-    // 规则3: 中国大陆域名直连
-    struct json_object *rule3 = json_object_new_object();
-    json_object_object_add(rule3, "type", json_object_new_string("field"));
-    struct json_object *domain3 = json_object_new_array();
-    json_object_array_add(domain3, json_object_new_string("geosite:cn"));
-    json_object_object_add(rule3, "domain", domain3);
-    json_object_object_add(rule3, "outboundTag", json_object_new_string("direct"));
-    json_object_array_add(rules, rule3);
-    
-    // 规则4: 广告域名阻断
-    struct json_object *rule4 = json_object_new_object();
-    json_object_object_add(rule4, "type", json_object_new_string("field"));
-    struct json_object *domain4 = json_object_new_array();
-    json_object_array_add(domain4, json_object_new_string("geosite:category-ads-all"));
-    json_object_object_add(rule4, "domain", domain4);
-    json_object_object_add(rule4, "outboundTag", json_object_new_string("block"));
-    json_object_array_add(rules, rule4);
-    
-    json_object_object_add(routing, "rules", rules);
-    json_object_object_add(root, "routing", routing);
-    
-    // 生成 JSON 字符串
-    const char *json_str = json_object_to_json_string_ext(root, JSON_C_TO_STRING_PRETTY);
-    char *result = g_strdup(json_str);
-    
-    json_object_put(root);
-    
-    return result;
-}
\ No newline at end of file
+    const ProxyRouteRules *routes = gen_routes(opts);
+    gboolean has_ip_rules = routes->geoip_cn_direct || strv_nonempty(routes->direct_cidrs) ||
+                            strv_nonempty(routes->block_cidrs);
+    gboolean use_balancer = count > 1 && !routes->final_direct;
+    
+    json_writer_key(w, "routing");
+    json_writer_begin_object(w);
+    // FakeIP 模式下域名已由映射还原；没有 IP 规则时也无需为匹配而解析域名
+    json_writer_member_string(w, "domainStrategy", opts->fakeip || !has_ip_rules ? "AsIs" : "IPIfNonMatch");
+    
+    // 多节点: 其余流量交给均衡器，选择 observatory 测得延迟最低的可用节点
+    if (use_balancer) {
+        json_writer_key(w, "balancers");
+        json_writer_begin_array(w);
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "tag", PROXY_OUTBOUND_TAG);
+        json_writer_member_strv(w, "selector", proxy_selector, 1);
+        json_writer_key(w, "strategy");
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "type", "leastPing");
+        json_writer_end_object(w);
+        json_writer_end_object(w);
+        json_writer_end_array(w);
+    }
+    
+    json_writer_key(w, "rules");
+    json_writer_begin_array(w);
+    
+    // 统计 API 请求交给 API 处理，必须排在其他规则之前
+    if (opts->api_port > 0) {
+        write_v2ray_rule(w, "inboundTag", "api", "outboundTag", "api");
+    }
+    
+    // DNS 查询交给 DNS 出站
+    if (opts->fakeip) {
+        write_v2ray_rule(w, "inboundTag", "dns-in", "outboundTag", "dns-out");
+    }
+    
+    // 分流规则：阻断优先，geo 数据只在启用时引用
+    // 精简数据文件只含这里用到的类别，内核加载时不必解析完整的 geoip.dat / geosite.dat
+    const char *geoip_cn = opts->geo_lite ? "ext:" PROXY_GEOIP_LITE_FILE ":" GEO_CODE_CN
+                                          : "geoip:" GEO_CODE_CN;
+    const char *geosite_cn = opts->geo_lite ? "ext:" PROXY_GEOSITE_LITE_FILE ":" GEO_CODE_CN
+                                            : "geosite:" GEO_CODE_CN;
+    const char *geosite_ads = opts->geo_lite ? "ext:" PROXY_GEOSITE_LITE_FILE ":" GEO_CODE_ADS
+                                             : "geosite:" GEO_CODE_ADS;
+    write_v2ray_ip_rule(w, routes->block_cidrs, NULL, "block");
+    write_v2ray_ip_rule(w, routes->direct_cidrs, routes->geoip_cn_direct ? geoip_cn : NULL, "direct");
+    if (routes->geosite_cn_direct) {
+        write_v2ray_rule(w, "domain", geosite_cn, "outboundTag", "direct");
+    }
+    if (routes->block_ads) {
+        write_v2ray_rule(w, "domain", geosite_ads, "outboundTag", "block");
+    }
+    
+    // 其余流量：直连模式交给直连出站；单节点时第一个出站（代理）是默认出站
+    if (routes->final_direct || use_balancer) {
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "type", "field");
+        json_writer_member_string(w, "network", "tcp,udp");
+        if (use_balancer) {
+            json_writer_member_string(w, "balancerTag", PROXY_OUTBOUND_TAG);
+        } else {
+            json_writer_member_string(w, "outboundTag", "direct");
+        }
+        json_writer_end_object(w);
+    }
+    
+    json_writer_end_array(w);
+    json_writer_end_object(w);
+    
+    json_writer_end_object(w);
+    g_string_append_c(buf, '\n');
+    
+    return g_string_free(buf, FALSE);
+}
+
+// sing-box 的传输设置，tcp 不需要；tcp 的 HTTP 伪装头 sing-box 不支持，按普通 tcp 连接
+static void write_singbox_transport(JsonWriter *w, const char *network, const char *host, const char *path) {
+    const char *net = stream_network(network);
+    
+    if (g_strcmp0(net, "ws") == 0) {
+        json_writer_key(w, "transport");
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "type", "ws");
+        json_writer_member_string(w, "path", default_path(path));
+        if (host && *host) {
+            json_writer_key(w, "headers");
+            json_writer_begin_object(w);
+            json_writer_member_string(w, "Host", host);
+            json_writer_end_object(w);
+        }
+        json_writer_end_object(w);
+    } else if (g_strcmp0(net, "grpc") == 0) {
+        json_writer_key(w, "transport");
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "type", "grpc");
+        json_writer_member_string(w, "service_name", path ? path : "");
+        json_writer_end_object(w);
+    } else if (g_strcmp0(net, "http") == 0) {
+        json_writer_key(w, "transport");
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "type", "http");
+        if (host && *host) {
+            write_host_list(w, "host", host);
+        }
+        json_writer_member_string(w, "path", default_path(path));
+        json_writer_end_object(w);
+    }
+}
+
+// sing-box 出站的服务器、TLS 和传输字段
+static void write_singbox_server(JsonWriter *w, const char *address, int port,
+                                 const char *network, const char *host, const char *path,
+                                 const TlsSpec *tls) {
+    json_writer_member_string(w, "server", address ? address : "");
+    json_writer_member_int(w, "server_port", port);
+    if (tls) {
+        json_writer_key(w, "tls");
+        json_writer_begin_object(w);
+        json_writer_member_bool(w, "enabled", TRUE);
+        json_writer_member_nonempty(w, "server_name", tls_server_name(tls->sni, host));
+        if (g_strcmp0(stream_network(network), "http") == 0 && !tls->public_key) {
+            static const char * const alpn[] = { "h2" };
+            json_writer_member_strv(w, "alpn", alpn, 1);
+        }
+        if (tls->fingerprint) {
+            json_writer_key(w, "utls");
+            json_writer_begin_object(w);
+            json_writer_member_bool(w, "enabled", TRUE);
+            json_writer_member_string(w, "fingerprint", tls->fingerprint);
+            json_writer_end_object(w);
+        }
+        if (tls->public_key) {
+            json_writer_key(w, "reality");
+            json_writer_begin_object(w);
+            json_writer_member_bool(w, "enabled", TRUE);
+            json_writer_member_string(w, "public_key", tls->public_key);
+            json_writer_member_nonempty(w, "short_id", tls->short_id);
+            json_writer_end_object(w);
+        }
+        json_writer_end_object(w);
+    }
+    write_singbox_transport(w, network, host, path);
+}
+
+// 写入 sing-box 代理出站
+// sing-box 的 multiplex 与 V2Ray 服务端的 Mux.Cool 不兼容，不生成；XUDP 用 packet_encoding 表示
+// sing-box 出站的拨号字段：没有缓冲区和超时等级，只对应 SO_MARK 和 TCP Fast Open
+static void write_singbox_dial(JsonWriter *w, const ProxyGenOptions *opts) {
+    json_writer_member_int(w, "routing_mark", PROXY_SOCKET_MARK);
+    if (profile_spec(opts->profile)->tcp_fast_open) {
+        json_writer_member_bool(w, "tcp_fast_open", TRUE);
+    }
+}
+
+static void write_singbox_outbound(JsonWriter *w, ProxyConfig *config, const char *tag,
+                                   const ProxyGenOptions *opts) {
+    TlsSpec tls = { 0 };
+    json_writer_begin_object(w);
+    
+    if (config->type == PROXY_TYPE_VMESS) {
+        const VMessConfig *c = &config->config.vmess;
+        json_writer_member_string(w, "type", "vmess");
+        json_writer_member_string(w, "tag", tag);
+        tls.sni = c->sni;
+        write_singbox_server(w, c->address, c->port, c->network, c->host, c->path,
+                             g_strcmp0(c->tls, "tls") == 0 ? &tls : NULL);
+        json_writer_member_string(w, "uuid", c->id ? c->id : "");
+        json_writer_member_string(w, "security", c->security && *c->security ? c->security : "auto");
+        json_writer_member_int(w, "alter_id", c->alter_id);
+        if (opts->xudp) {
+            json_writer_member_string(w, "packet_encoding", "xudp");
+        }
+    } else if (config->type == PROXY_TYPE_VLESS) {
+        const VLessConfig *c = &config->config.vless;
+        json_writer_member_string(w, "type", "vless");
+        json_writer_member_string(w, "tag", tag);
+        write_singbox_server(w, c->address, c->port, c->network, c->host, c->path, vless_tls(c, opts, &tls));
+        json_writer_member_string(w, "uuid", c->id ? c->id : "");
+        json_writer_member_nonempty(w, "flow", vless_flow(c));
+        if (opts->xudp) {
+            json_writer_member_string(w, "packet_encoding", "xudp");
+        }
+    } else if (config->type == PROXY_TYPE_TROJAN) {
+        const TrojanConfig *c = &config->config.trojan;
+        json_writer_member_string(w, "type", "trojan");
+        json_writer_member_string(w, "tag", tag);
+        tls.sni = c->sni;
+        write_singbox_server(w, c->address, c->port, c->network, c->host, c->path, &tls);
+        json_writer_member_string(w, "password", c->password);
+    } else if (config->type == PROXY_TYPE_SHADOWSOCKS) {
+        const SSConfig *c = &config->config.ss;
+        json_writer_member_string(w, "type", "shadowsocks");
+        json_writer_member_string(w, "tag", tag);
+        json_writer_member_string(w, "server", c->server);
+        json_writer_member_int(w, "server_port", c->port);
+        json_writer_member_string(w, "method", c->method);
+        json_writer_member_string(w, "password", c->password);
+    } else {
+        json_writer_member_string(w, "tag", tag);
+        json_writer_end_object(w);
+        return;
+    }
+    
+    write_singbox_dial(w, opts);
+    json_writer_end_object(w);
+}
+
+// sing-box 路由规则: 单个匹配条件
+static void write_singbox_rule(JsonWriter *w, const char *key, const char *value, const char *outbound) {
+    json_writer_begin_object(w);
+    json_writer_member_strv(w, key, &value, 1);
+    json_writer_member_string(w, "outbound", outbound);
+    json_writer_end_object(w);
+}
+
+static void write_singbox_cidr_rule(JsonWriter *w, char * const *cidrs, const char *outbound) {
+    if (!strv_nonempty(cidrs)) return;
+    
+    json_writer_begin_object(w);
+    json_writer_member_strv(w, "ip_cidr", (const char * const *)cidrs, -1);
+    json_writer_member_string(w, "outbound", outbound);
+    json_writer_end_object(w);
+}
+
+// 按选项生成 sing-box 配置
+char* proxy_parser_generate_singbox_config(ProxyConfig * const *configs, guint count,
+                                           const ProxyGenOptions *opts) {
+    if (!configs || count == 0 || !opts) return NULL;
+    for (guint i = 0; i < count; i++) {
+        if (!configs[i] || (!opts->xtls && proxy_parser_needs_xtls(configs[i]))) return NULL;
+    }
+    
+    GString *buf = g_string_sized_new(4096 + count * 1024 + routes_size_hint(gen_routes(opts)));
+    JsonWriter writer;
+    JsonWriter *w = &writer;
+    json_writer_init(w, buf, TRUE);
+    
+    json_writer_begin_object(w);
+    
+    // Log 配置
+    json_writer_key(w, "log");
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "level", "warn");
+    json_writer_member_bool(w, "timestamp", TRUE);
+    json_writer_end_object(w);
+    
+    // FakeIP: A/AAAA 查询由 fakeip 服务器分配保留地址，其余查询交给上游
+    if (opts->fakeip) {
+        static const char * const query_types[] = { "A", "AAAA" };
+        
+        json_writer_key(w, "dns");
+        json_writer_begin_object(w);
+        
+        json_writer_key(w, "servers");
+        json_writer_begin_array(w);
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "tag", "upstream");
+        json_writer_member_string(w, "address", PROXY_FAKEIP_UPSTREAM_DNS);
+        json_writer_member_string(w, "detour", "direct");
+        json_writer_end_object(w);
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "tag", "fakeip");
+        json_writer_member_string(w, "address", "fakeip");
+        json_writer_end_object(w);
+        json_writer_end_array(w);
+        
+        json_writer_key(w, "rules");
+        json_writer_begin_array(w);
+        json_writer_begin_object(w);
+        json_writer_member_strv(w, "query_type", query_types, G_N_ELEMENTS(query_types));
+        json_writer_member_string(w, "server", "fakeip");
+        json_writer_end_object(w);
+        json_writer_end_array(w);
+        json_writer_member_string(w, "final", "upstream");
+        
+        json_writer_key(w, "fakeip");
+        json_writer_begin_object(w);
+        json_writer_member_bool(w, "enabled", TRUE);
+        json_writer_member_string(w, "inet4_range", opts->fakeip_pool);
+        json_writer_end_object(w);
+        
+        json_writer_end_object(w);
+    }
+    
+    // Inbounds - 透明代理
+    json_writer_key(w, "inbounds");
+    json_writer_begin_array(w);
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "type", "tproxy");
+    json_writer_member_string(w, "tag", "transparent");
+    json_writer_member_string(w, "listen", "::");
+    json_writer_member_int(w, "listen_port", opts->local_port);
+    // FakeIP 模式下由映射还原域名，不读取连接首包
+    json_writer_member_bool(w, "sniff", !opts->fakeip);
+    json_writer_end_object(w);
+    
+    // DNS 入站 - FakeIP 模式下接管系统 DNS 查询
+    if (opts->fakeip) {
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "type", "direct");
+        json_writer_member_string(w, "tag", "dns-in");
+        json_writer_member_string(w, "listen", "127.0.0.1");
+        json_writer_member_int(w, "listen_port", opts->dns_port);
+        json_writer_end_object(w);
+    }
+    json_writer_end_array(w);
+    
+    // Outbounds: 代理出站标签与 V2Ray 配置一致
+    json_writer_key(w, "outbounds");
+    json_writer_begin_array(w);
+    
+    for (guint i = 0; i < count; i++) {
+        char tag[32];
+        write_singbox_outbound(w, configs[i], outbound_tag(tag, sizeof(tag), count, i), opts);
+    }
+    
+    // 多节点: urltest 定期经各出站访问探测地址，选择延迟最低的节点
+    if (count > 1) {
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "type", "urltest");
+        json_writer_member_string(w, "tag", PROXY_OUTBOUND_TAG);
+        json_writer_key(w, "outbounds");
+        json_writer_begin_array(w);
+        for (guint i = 0; i < count; i++) {
+            char tag[32];
+            json_writer_string(w, outbound_tag(tag, sizeof(tag), count, i));
+        }
+        json_writer_end_array(w);
+        json_writer_member_string(w, "url", opts->probe_url);
+        json_writer_member_string(w, "interval", opts->probe_interval);
+        json_writer_end_object(w);
+    }
+    
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "type", "direct");
+    json_writer_member_string(w, "tag", "direct");
+    write_singbox_dial(w, opts);
+    json_writer_end_object(w);
+    
+    json_writer_begin_object(w);
+    json_writer_member_string(w, "type", "block");
+    json_writer_member_string(w, "tag", "block");
+    json_writer_end_object(w);
+    
+    if (opts->fakeip) {
+        json_writer_begin_object(w);
+        json_writer_member_string(w, "type", "dns");
+        json_writer_member_string(w, "tag", "dns-out");
+        json_writer_end_object(w);
+    }
+    
+    json_writer_end_array(w);
+    
+    // 路由规则: 与 V2Ray 配置相同的顺序
+    json_writer_key(w, "route");
+    json_writer_begin_object(w);
+    json_writer_key(w, "rules");
+    json_writer_begin_array(w);
+    
+    const ProxyRouteRules *routes = gen_routes(opts);
+    
+    if (opts->fakeip) {
+        write_singbox_rule(w, "inbound", "dns-in", "dns-out");
+    }
+    write_singbox_cidr_rule(w, routes->block_cidrs, "block");
+    write_singbox_cidr_rule(w, routes->direct_cidrs, "direct");
+    if (routes->geoip_cn_direct) {
+        write_singbox_rule(w, "geoip", GEO_CODE_CN, "direct");
+    }
+    if (routes->geosite_cn_direct) {
+        write_singbox_rule(w, "geosite", GEO_CODE_CN, "direct");
+    }
+    if (routes->block_ads) {
+        write_singbox_rule(w, "geosite", GEO_CODE_ADS, "block");
+    }
+    
+    json_writer_end_array(w);
+    json_writer_member_string(w, "final", routes->final_direct ? "direct" : PROXY_OUTBOUND_TAG);
+    json_writer_end_object(w);
+    
+    json_writer_end_object(w);
+    g_string_append_c(buf, '\n');
+    
+    return g_string_free(buf, FALSE);
+}
@@ -0,0 +1,896 @@
+#include "../include/proxy_pool.h"
+#include "../include/base64_decode.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <gio/gio.h>
+
+// 主循环收取探测结果的间隔
+#define PROXY_POOL_DRAIN_INTERVAL_MS 100
+
+// 工作线程共享的上下文，节点池释放时置 cancelled，排队中的探测直接跳过
+typedef struct {
+    GAsyncQueue *results;
+    gint cancelled;
+} ProbeContext;
+
+typedef struct {
+    guint generation;
+    guint index;
+    char *host;
+    int port;
+    gboolean tls;
+    char *sni;
+} ProbeTask;
+
+typedef struct {
+    guint generation;
+    guint index;
+    gint64 latency_us;          // -1 表示失败
+} ProbeResult;
+
+static void probe_task_free(ProbeTask *task) {
+    g_free(task->host);
+    g_free(task->sni);
+    g_free(task);
+}
+
+// 探测只关心握手耗时，不校验证书
+static gboolean accept_any_certificate(GTlsConnection *conn, GTlsCertificate *cert,
+                                       GTlsCertificateFlags errors, gpointer user_data) {
+    (void)conn;
+    (void)cert;
+    (void)errors;
+    (void)user_data;
+    return TRUE;
+}
+
+// TCP 连接（TLS 节点再加一次握手）的耗时，失败返回 -1
+static gint64 probe_endpoint(const ProbeTask *task) {
+    GSocketClient *client = g_socket_client_new();
+    GError *error = NULL;
+    gint64 latency = -1;
+
+    g_socket_client_set_timeout(client, PROXY_POOL_PROBE_TIMEOUT_S);
+
+    gint64 start = g_get_monotonic_time();
+    GSocketConnection *conn = g_socket_client_connect_to_host(client, task->host, task->port, NULL, &error);
+    if (!conn) {
+        g_debug("Probe %s:%d failed: %s", task->host, task->port, error->message);
+        g_error_free(error);
+        g_object_unref(client);
+        return -1;
+    }
+
+    if (task->tls && g_tls_backend_supports_tls(g_tls_backend_get_default())) {
+        GSocketConnectable *identity = g_network_address_new(task->sni, task->port);
+        GIOStream *tls = g_tls_client_connection_new(G_IO_STREAM(conn), identity, &error);
+        g_object_unref(identity);
+
+        if (tls) {
+            g_signal_connect(tls, "accept-certificate", G_CALLBACK(accept_any_certificate), NULL);
+            if (g_tls_connection_handshake(G_TLS_CONNECTION(tls), NULL, &error)) {
+                latency = g_get_monotonic_time() - start;
+            }
+            g_object_unref(tls);
+        }
+
+        if (error) {
+            g_debug("Probe TLS %s:%d failed: %s", task->host, task->port, error->message);
+            g_error_free(error);
+        }
+    } else {
+        latency = g_get_monotonic_time() - start;
+    }
+
+    g_object_unref(conn);
+    g_object_unref(client);
+    return latency;
+}
+
+// 工作线程
+static void probe_worker(gpointer data, gpointer user_data) {
+    ProbeTask *task = (ProbeTask*)data;
+    ProbeContext *ctx = (ProbeContext*)user_data;
+
+    ProbeResult *result = g_new0(ProbeResult, 1);
+    result->generation = task->generation;
+    result->index = task->index;
+    result->latency_us = g_atomic_int_get(&ctx->cancelled) ? -1 : probe_endpoint(task);
+
+    g_async_queue_push(ctx->results, result);
+    probe_task_free(task);
+}
+
+static void node_apply_result(ProxyNode *node, gint64 latency_us) {
+    node->probing = FALSE;
+
+    if (latency_us >= 0) {
+        node->latency_us = latency_us;
+        node->smoothed_us = node->smoothed_us > 0 ? (node->smoothed_us * 3 + latency_us) / 4 : latency_us;
+        node->failures = 0;
+        node->state = PROXY_NODE_HEALTHY;
+    } else {
+        node->failures++;
+        node->state = node->failures >= PROXY_POOL_MAX_FAILURES ? PROXY_NODE_DOWN : PROXY_NODE_DEGRADED;
+    }
+}
+
+// 主循环中收取探测结果，一轮全部返回后通知
+static gboolean drain_results_cb(gpointer user_data) {
+    ProxyPool *pool = (ProxyPool*)user_data;
+    ProbeContext *ctx = g_thread_pool_get_user_data(pool->workers);
+    ProbeResult *result;
+
+    while ((result = g_async_queue_try_pop(ctx->results)) != NULL) {
+        if (result->generation == pool->generation && result->index < pool->nodes->len) {
+            node_apply_result(&g_array_index(pool->nodes, ProxyNode, result->index), result->latency_us);
+        }
+        pool->pending--;
+        g_free(result);
+    }
+
+    if (pool->pending > 0) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    pool->drain_id = 0;
+    if (pool->changed_func) {
+        pool->changed_func(pool, pool->changed_data);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+// 节点索引的初始容量，负载超过一半时翻倍
+#define NODE_INDEX_MIN_CAPACITY 64
+
+static guint node_index_slot(const ProxyNodeIndex *index, guint64 key) {
+    return (guint)(key ^ (key >> 32)) & (index->capacity - 1);
+}
+
+static void node_index_clear(ProxyNodeIndex *index) {
+    g_free(index->slots);
+    memset(index, 0, sizeof(*index));
+}
+
+static void node_index_grow(ProxyNodeIndex *index) {
+    ProxyNodeSlot *old = index->slots;
+    guint old_capacity = index->capacity;
+
+    index->capacity = MAX(old_capacity * 2, NODE_INDEX_MIN_CAPACITY);
+    index->slots = g_new0(ProxyNodeSlot, index->capacity);
+    for (guint i = 0; i < old_capacity; i++) {
+        if (old[i].node == 0) continue;
+
+        guint slot = node_index_slot(index, old[i].key);
+        while (index->slots[slot].node != 0) {
+            slot = (slot + 1) & (index->capacity - 1);
+        }
+        index->slots[slot] = old[i];
+    }
+    g_free(old);
+}
+
+// 同一个键可以插入多次（名称哈希可能冲突），查找时由调用者比较节点
+static void node_index_insert(ProxyNodeIndex *index, guint64 key, guint node_index) {
+    if ((index->count + 1) * 2 > index->capacity) {
+        node_index_grow(index);
+    }
+
+    guint slot = node_index_slot(index, key);
+    while (index->slots[slot].node != 0) {
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+    index->slots[slot].key = key;
+    index->slots[slot].node = node_index + 1;
+    index->count++;
+}
+
+// 在 nodes 中按指纹查找，返回节点下标，不存在时返回 -1
+static gint node_index_find_fingerprint(const ProxyNodeIndex *index, GArray *nodes, guint64 fingerprint) {
+    if (index->capacity == 0) return -1;
+
+    for (guint slot = node_index_slot(index, fingerprint); index->slots[slot].node != 0;
+         slot = (slot + 1) & (index->capacity - 1)) {
+        guint i = index->slots[slot].node - 1;
+        if (index->slots[slot].key == fingerprint &&
+            g_array_index(nodes, ProxyNode, i).fingerprint == fingerprint) {
+            return (gint)i;
+        }
+    }
+    return -1;
+}
+
+static gint node_index_find_name(const ProxyNodeIndex *index, GArray *nodes, const char *name) {
+    if (index->capacity == 0) return -1;
+
+    guint64 key = g_str_hash(name);
+    for (guint slot = node_index_slot(index, key); index->slots[slot].node != 0;
+         slot = (slot + 1) & (index->capacity - 1)) {
+        guint i = index->slots[slot].node - 1;
+        if (index->slots[slot].key == key && strcmp(g_array_index(nodes, ProxyNode, i).name, name) == 0) {
+            return (gint)i;
+        }
+    }
+    return -1;
+}
+
+// 追加节点并加入两个索引，名称索引只记录第一个同名节点
+static void pool_append_node(ProxyPool *pool, const ProxyNode *node) {
+    guint i = pool->nodes->len;
+    g_array_append_val(pool->nodes, *node);
+
+    node_index_insert(&pool->by_fingerprint, node->fingerprint, i);
+    if (node_index_find_name(&pool->by_name, pool->nodes, node->name) < 0) {
+        node_index_insert(&pool->by_name, g_str_hash(node->name), i);
+    }
+}
+
+ProxyPool* proxy_pool_new(void) {
+    ProxyPool *pool = g_new0(ProxyPool, 1);
+
+    ProbeContext *ctx = g_new0(ProbeContext, 1);
+    ctx->results = g_async_queue_new();
+
+    pool->nodes = g_array_new(FALSE, TRUE, sizeof(ProxyNode));
+    pool->strings = g_string_chunk_new(64 * 1024);
+    pool->workers = g_thread_pool_new(probe_worker, ctx, PROXY_POOL_PROBE_THREADS, FALSE, NULL);
+    pool->probe_interval_ms = PROXY_POOL_DEFAULT_INTERVAL_MS;
+
+    return pool;
+}
+
+void proxy_pool_free(ProxyPool *pool) {
+    if (!pool) return;
+
+    ProbeContext *ctx = g_thread_pool_get_user_data(pool->workers);
+    g_atomic_int_set(&ctx->cancelled, TRUE);
+
+    // 排队的探测立即跳过，只等待正在进行的探测（最多 PROXY_POOL_PROBE_TIMEOUT_S）
+    g_thread_pool_free(pool->workers, FALSE, TRUE);
+
+    ProbeResult *result;
+    while ((result = g_async_queue_try_pop(ctx->results)) != NULL) {
+        g_free(result);
+    }
+    g_async_queue_unref(ctx->results);
+    g_free(ctx);
+
+    if (pool->drain_id > 0) {
+        g_source_remove(pool->drain_id);
+    }
+    if (pool->probe_timer_id > 0) {
+        g_source_remove(pool->probe_timer_id);
+    }
+
+    g_array_unref(pool->nodes);
+    node_index_clear(&pool->by_fingerprint);
+    node_index_clear(&pool->by_name);
+    g_string_chunk_free(pool->strings);
+    g_free(pool);
+}
+
+// 解析阶段的节点，字符串属于批次（url 指向批次文本，其余在分片的 GStringChunk 中）
+typedef struct {
+    guint64 fingerprint;
+    ProxyType type;
+    int port;
+    gboolean tls;
+    const char *url;
+    const char *name;
+    const char *host;
+    const char *sni;
+} ParsedNode;
+
+// 一个解析线程负责的连续行
+typedef struct {
+    char **lines;
+    guint count;
+    GArray *nodes;              // ParsedNode
+    GStringChunk *strings;
+    guint failed;
+} ParseChunk;
+
+// 一次导入：解码后的文本按行原地切分，分片并行解析
+typedef struct {
+    char *text;
+    GPtrArray *lines;           // char*，指向 text
+    ParseChunk *chunks;
+    guint n_chunks;
+} ImportBatch;
+
+static void import_batch_free(ImportBatch *batch) {
+    if (!batch) return;
+
+    for (guint i = 0; i < batch->n_chunks; i++) {
+        g_array_unref(batch->chunks[i].nodes);
+        g_string_chunk_free(batch->chunks[i].strings);
+    }
+    g_free(batch->chunks);
+    g_ptr_array_unref(batch->lines);
+    g_free(batch->text);
+    g_free(batch);
+}
+
+// 接管 text，未包含链接时按订阅内容原地解码，然后按行切分
+static ImportBatch* import_batch_new(char *text, gsize len) {
+    if (!g_strstr_len(text, len, "://")) {
+        if (base64_decode_inplace(text, len) < 0 || !strstr(text, "://")) {
+            g_free(text);
+            return NULL;
+        }
+    }
+
+    ImportBatch *batch = g_new0(ImportBatch, 1);
+    batch->text = text;
+    batch->lines = g_ptr_array_new();
+
+    char *line = text;
+    while (line) {
+        char *next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+
+        g_strstrip(line);
+        if (*line != '\0') {
+            g_ptr_array_add(batch->lines, line);
+        }
+        line = next;
+    }
+
+    return batch;
+}
+
+static void parse_chunk(ParseChunk *chunk) {
+    for (guint i = 0; i < chunk->count; i++) {
+        const char *url = chunk->lines[i];
+        ProxyConfig *config = proxy_parser_parse(url);
+        const char *host, *sni;
+        int port;
+        gboolean tls;
+
+        if (!config || !proxy_parser_get_endpoint(config, &host, &port, &tls, &sni)) {
+            g_debug("Skipping unparsable node: %.32s", url);
+            proxy_parser_free(config);
+            chunk->failed++;
+            continue;
+        }
+
+        ParsedNode node = {
+            .fingerprint = proxy_parser_fingerprint(config),
+            .type = config->type,
+            .port = port,
+            .tls = tls,
+            .url = url,
+            .name = g_string_chunk_insert(chunk->strings, config->name ? config->name : ""),
+            .host = g_string_chunk_insert_const(chunk->strings, host),
+            .sni = g_string_chunk_insert_const(chunk->strings, sni ? sni : host),
+        };
+        g_array_append_val(chunk->nodes, node);
+        proxy_parser_free(config);
+    }
+}
+
+static gpointer parse_chunk_thread(gpointer data) {
+    parse_chunk((ParseChunk*)data);
+    return NULL;
+}
+
+// 行数较多时按处理器数分片，各线程只写自己的分片
+static void import_batch_parse(ImportBatch *batch) {
+    guint count = batch->lines->len;
+    guint n = 1;
+
+    if (count >= PROXY_POOL_PARALLEL_MIN_LINES) {
+        n = MIN((guint)g_get_num_processors(), PROXY_POOL_MAX_PARSE_THREADS);
+        n = MAX(n, 1);
+    }
+
+    batch->n_chunks = n;
+    batch->chunks = g_new0(ParseChunk, n);
+
+    guint per_chunk = (count + n - 1) / n;
+    for (guint i = 0; i < n; i++) {
+        ParseChunk *chunk = &batch->chunks[i];
+        guint first = MIN(i * per_chunk, count);
+
+        chunk->lines = (char**)batch->lines->pdata + first;
+        chunk->count = MIN(per_chunk, count - first);
+        chunk->nodes = g_array_sized_new(FALSE, FALSE, sizeof(ParsedNode), chunk->count);
+        chunk->strings = g_string_chunk_new(4096);
+    }
+
+    GThread **threads = g_new0(GThread*, n);
+    for (guint i = 1; i < n; i++) {
+        threads[i] = g_thread_new("proxy-import", parse_chunk_thread, &batch->chunks[i]);
+    }
+    parse_chunk(&batch->chunks[0]);
+    for (guint i = 1; i < n; i++) {
+        g_thread_join(threads[i]);
+    }
+    g_free(threads);
+}
+
+// 解析结果复制进节点池的字符串表；base 为已有节点时沿用其探测状态
+static ProxyNode node_from_parsed(ProxyPool *pool, const ParsedNode *parsed, const ProxyNode *base) {
+    ProxyNode node;
+    if (base) {
+        node = *base;
+        node.probing = FALSE;   // 节点下标变了，进行中的探测结果会按代数丢弃
+    } else {
+        memset(&node, 0, sizeof(node));
+        node.state = PROXY_NODE_UNKNOWN;
+        node.latency_us = -1;
+    }
+
+    node.url = g_string_chunk_insert(pool->strings, parsed->url);
+    node.name = g_string_chunk_insert_const(pool->strings, parsed->name);
+    node.host = g_string_chunk_insert_const(pool->strings, parsed->host);
+    node.sni = g_string_chunk_insert_const(pool->strings, parsed->sni);
+    node.fingerprint = parsed->fingerprint;
+    node.type = parsed->type;
+    node.port = parsed->port;
+    node.tls = parsed->tls;
+    return node;
+}
+
+// 追加：按指纹跳过已有节点和同批重复节点
+static guint import_batch_append(ProxyPool *pool, ImportBatch *batch, ProxyPoolImportStats *stats) {
+    for (guint c = 0; c < batch->n_chunks; c++) {
+        ParseChunk *chunk = &batch->chunks[c];
+
+        for (guint i = 0; i < chunk->nodes->len; i++) {
+            ParsedNode *parsed = &g_array_index(chunk->nodes, ParsedNode, i);
+
+            if (node_index_find_fingerprint(&pool->by_fingerprint, pool->nodes, parsed->fingerprint) >= 0) {
+                stats->duplicates++;
+                continue;
+            }
+
+            ProxyNode node = node_from_parsed(pool, parsed, NULL);
+            pool_append_node(pool, &node);
+            stats->added++;
+        }
+    }
+    return stats->added;
+}
+
+// 同步：按批次顺序重建节点列表和字符串表，一遍完成，指纹相同的已有节点沿用探测状态
+static guint import_batch_sync(ProxyPool *pool, ImportBatch *batch, ProxyPoolImportStats *stats) {
+    guint parsed_count = 0;
+    for (guint c = 0; c < batch->n_chunks; c++) {
+        parsed_count += batch->chunks[c].nodes->len;
+    }
+    if (parsed_count == 0) return 0;
+
+    GArray *old_nodes = pool->nodes;
+    GStringChunk *old_strings = pool->strings;
+    ProxyNodeIndex old_index = pool->by_fingerprint;
+
+    pool->nodes = g_array_sized_new(FALSE, TRUE, sizeof(ProxyNode), parsed_count);
+    pool->strings = g_string_chunk_new(64 * 1024);
+    memset(&pool->by_fingerprint, 0, sizeof(pool->by_fingerprint));
+    node_index_clear(&pool->by_name);
+
+    for (guint c = 0; c < batch->n_chunks; c++) {
+        ParseChunk *chunk = &batch->chunks[c];
+
+        for (guint i = 0; i < chunk->nodes->len; i++) {
+            ParsedNode *parsed = &g_array_index(chunk->nodes, ParsedNode, i);
+
+            if (node_index_find_fingerprint(&pool->by_fingerprint, pool->nodes, parsed->fingerprint) >= 0) {
+                stats->duplicates++;
+                continue;
+            }
+
+            gint old = node_index_find_fingerprint(&old_index, old_nodes, parsed->fingerprint);
+            ProxyNode node = node_from_parsed(pool, parsed, old >= 0 ? &g_array_index(old_nodes, ProxyNode, old) : NULL);
+            pool_append_node(pool, &node);
+            if (old >= 0) {
+                stats->kept++;
+            } else {
+                stats->added++;
+            }
+        }
+    }
+    stats->removed = old_nodes->len - stats->kept;
+
+    // 节点下标全部重排，进行中的探测结果丢弃
+    pool->generation++;
+    g_array_unref(old_nodes);
+    g_string_chunk_free(old_strings);
+    node_index_clear(&old_index);
+
+    return stats->added;
+}
+
+// 在主循环中合并到节点池
+static guint import_batch_merge(ProxyPool *pool, ImportBatch *batch, gboolean sync, ProxyPoolImportStats *stats) {
+    ProxyPoolImportStats local;
+    if (!stats) stats = &local;
+    memset(stats, 0, sizeof(*stats));
+
+    stats->lines = batch->lines->len;
+    for (guint c = 0; c < batch->n_chunks; c++) {
+        stats->failed += batch->chunks[c].failed;
+    }
+
+    return sync ? import_batch_sync(pool, batch, stats) : import_batch_append(pool, batch, stats);
+}
+
+guint proxy_pool_add_text(ProxyPool *pool, const char *text) {
+    return proxy_pool_add_text_full(pool, text, NULL);
+}
+
+static guint import_text(ProxyPool *pool, const char *text, gboolean sync, ProxyPoolImportStats *stats) {
+    if (stats) memset(stats, 0, sizeof(*stats));
+    if (!pool || !text) return 0;
+
+    gsize len = strlen(text);
+    ImportBatch *batch = import_batch_new(g_strndup(text, len), len);
+    if (!batch) return 0;
+
+    import_batch_parse(batch);
+    guint added = import_batch_merge(pool, batch, sync, stats);
+    import_batch_free(batch);
+
+    return added;
+}
+
+guint proxy_pool_add_text_full(ProxyPool *pool, const char *text, ProxyPoolImportStats *stats) {
+    return import_text(pool, text, FALSE, stats);
+}
+
+guint proxy_pool_sync_text(ProxyPool *pool, const char *text, ProxyPoolImportStats *stats) {
+    return import_text(pool, text, TRUE, stats);
+}
+
+// 读取整个文件，"-" 表示标准输入
+static char* read_import_file(const char *path, gsize *length, GError **error) {
+    gboolean is_stdin = g_strcmp0(path, "-") == 0;
+    FILE *fp = is_stdin ? stdin : fopen(path, "rb");
+    if (!fp) {
+        int saved_errno = errno;
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                    "无法打开 %s: %s", path, g_strerror(saved_errno));
+        return NULL;
+    }
+
+    GString *content = g_string_new(NULL);
+    char buffer[65536];
+    size_t n;
+    gboolean too_large = FALSE;
+
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        if (content->len + n > PROXY_POOL_MAX_IMPORT_SIZE) {
+            too_large = TRUE;
+            break;
+        }
+        g_string_append_len(content, buffer, n);
+    }
+
+    gboolean failed = ferror(fp);
+    if (!is_stdin) {
+        fclose(fp);
+    }
+
+    if (too_large) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_MESSAGE_TOO_LARGE,
+                    "订阅文件超过 %d MB", PROXY_POOL_MAX_IMPORT_SIZE / (1024 * 1024));
+        g_string_free(content, TRUE);
+        return NULL;
+    }
+    if (failed) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "读取 %s 失败", path);
+        g_string_free(content, TRUE);
+        return NULL;
+    }
+
+    *length = content->len;
+    return g_string_free(content, FALSE);
+}
+
+// 文件导入任务的参数
+typedef struct {
+    char *path;
+    gboolean sync;
+} ImportFileData;
+
+static void import_file_data_free(ImportFileData *data) {
+    g_free(data->path);
+    g_free(data);
+}
+
+static void import_file_thread(GTask *task, gpointer source_object, gpointer task_data,
+                               GCancellable *cancellable) {
+    (void)source_object;
+    const char *path = ((ImportFileData*)task_data)->path;
+    GError *error = NULL;
+    gsize len = 0;
+
+    char *text = read_import_file(path, &len, &error);
+    if (!text) {
+        g_task_return_error(task, error);
+        return;
+    }
+    if (g_task_return_error_if_cancelled(task)) {
+        g_free(text);
+        return;
+    }
+
+    ImportBatch *batch = import_batch_new(text, len);
+    if (!batch) {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                "%s 中没有可识别的代理链接", path);
+        return;
+    }
+
+    import_batch_parse(batch);
+    if (g_cancellable_is_cancelled(cancellable)) {
+        import_batch_free(batch);
+        g_task_return_error_if_cancelled(task);
+        return;
+    }
+
+    g_task_return_pointer(task, batch, (GDestroyNotify)import_batch_free);
+}
+
+void proxy_pool_import_file_async(ProxyPool *pool, const char *path, gboolean sync,
+                                  GCancellable *cancellable, GAsyncReadyCallback callback,
+                                  gpointer user_data) {
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, proxy_pool_import_file_async);
+
+    ImportFileData *data = g_new0(ImportFileData, 1);
+    data->path = g_strdup(path);
+    data->sync = sync;
+    g_task_set_task_data(task, data, (GDestroyNotify)import_file_data_free);
+
+    if (!pool || !path) {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "参数无效");
+        g_object_unref(task);
+        return;
+    }
+
+    // 读取、解码和解析都在工作线程中，合并在 finish 中进行，避免与探测结果并发修改节点表
+    g_task_run_in_thread(task, import_file_thread);
+    g_object_unref(task);
+}
+
+gboolean proxy_pool_import_file_finish(ProxyPool *pool, GAsyncResult *result,
+                                       ProxyPoolImportStats *stats, GError **error) {
+    if (stats) memset(stats, 0, sizeof(*stats));
+    g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+
+    ImportBatch *batch = g_task_propagate_pointer(G_TASK(result), error);
+    if (!batch) return FALSE;
+
+    const ImportFileData *data = g_task_get_task_data(G_TASK(result));
+    import_batch_merge(pool, batch, data->sync, stats);
+    import_batch_free(batch);
+    return TRUE;
+}
+
+void proxy_pool_clear(ProxyPool *pool) {
+    if (!pool) return;
+
+    // 进行中的探测结果按代数丢弃
+    pool->generation++;
+    g_array_set_size(pool->nodes, 0);
+    node_index_clear(&pool->by_fingerprint);
+    node_index_clear(&pool->by_name);
+    g_string_chunk_clear(pool->strings);
+}
+
+ProxyNode* proxy_pool_lookup(ProxyPool *pool, guint64 fingerprint) {
+    if (!pool) return NULL;
+
+    gint i = node_index_find_fingerprint(&pool->by_fingerprint, pool->nodes, fingerprint);
+    return i >= 0 ? &g_array_index(pool->nodes, ProxyNode, i) : NULL;
+}
+
+ProxyNode* proxy_pool_lookup_name(ProxyPool *pool, const char *name) {
+    if (!pool || !name) return NULL;
+
+    gint i = node_index_find_name(&pool->by_name, pool->nodes, name);
+    return i >= 0 ? &g_array_index(pool->nodes, ProxyNode, i) : NULL;
+}
+
+guint proxy_pool_size(ProxyPool *pool) {
+    return pool ? pool->nodes->len : 0;
+}
+
+void proxy_pool_set_changed_func(ProxyPool *pool, ProxyPoolFunc func, gpointer user_data) {
+    if (!pool) return;
+
+    pool->changed_func = func;
+    pool->changed_data = user_data;
+}
+
+void proxy_pool_probe_all(ProxyPool *pool) {
+    if (!pool) return;
+
+    for (guint i = 0; i < pool->nodes->len; i++) {
+        ProxyNode *node = &g_array_index(pool->nodes, ProxyNode, i);
+
+        if (node->probing) continue;
+
+        ProbeTask *task = g_new0(ProbeTask, 1);
+        task->generation = pool->generation;
+        task->index = i;
+        task->host = g_strdup(node->host);
+        task->port = node->port;
+        task->tls = node->tls;
+        task->sni = g_strdup(node->sni);
+
+        node->probing = TRUE;
+        pool->pending++;
+        g_thread_pool_push(pool->workers, task, NULL);
+    }
+
+    if (pool->pending > 0 && pool->drain_id == 0) {
+        pool->drain_id = g_timeout_add(PROXY_POOL_DRAIN_INTERVAL_MS, drain_results_cb, pool);
+    }
+}
+
+static gboolean probe_timer_cb(gpointer user_data) {
+    proxy_pool_probe_all((ProxyPool*)user_data);
+    return G_SOURCE_CONTINUE;
+}
+
+void proxy_pool_start_probing(ProxyPool *pool, guint interval_ms) {
+    if (!pool) return;
+
+    proxy_pool_stop_probing(pool);
+    pool->probe_interval_ms = interval_ms;
+    pool->probe_timer_id = g_timeout_add(interval_ms, probe_timer_cb, pool);
+    proxy_pool_probe_all(pool);
+}
+
+void proxy_pool_stop_probing(ProxyPool *pool) {
+    if (!pool || pool->probe_timer_id == 0) return;
+
+    g_source_remove(pool->probe_timer_id);
+    pool->probe_timer_id = 0;
+}
+
+gboolean proxy_pool_is_probing(ProxyPool *pool) {
+    return pool && pool->pending > 0;
+}
+
+static int state_rank(ProxyNodeState state) {
+    switch (state) {
+        case PROXY_NODE_HEALTHY: return 0;
+        case PROXY_NODE_UNKNOWN: return 1;
+        case PROXY_NODE_DEGRADED: return 2;
+        default: return 3;
+    }
+}
+
+static gint node_compare(gconstpointer a, gconstpointer b) {
+    const ProxyNode *na = *(ProxyNode * const *)a;
+    const ProxyNode *nb = *(ProxyNode * const *)b;
+
+    int ra = state_rank(na->state);
+    int rb = state_rank(nb->state);
+    if (ra != rb) {
+        return ra - rb;
+    }
+    if (na->smoothed_us != nb->smoothed_us && na->smoothed_us > 0 && nb->smoothed_us > 0) {
+        return na->smoothed_us < nb->smoothed_us ? -1 : 1;
+    }
+
+    // 延迟相同或未知时保持添加顺序（节点连续存放在同一数组中）
+    return na < nb ? -1 : (na > nb ? 1 : 0);
+}
+
+GPtrArray* proxy_pool_ranked(ProxyPool *pool) {
+    GPtrArray *result = g_ptr_array_new();
+    if (!pool) return result;
+
+    for (guint i = 0; i < pool->nodes->len; i++) {
+        g_ptr_array_add(result, &g_array_index(pool->nodes, ProxyNode, i));
+    }
+
+    g_ptr_array_sort(result, node_compare);
+
+    return result;
+}
+
+// 选出节点：跳过不可用节点，全部不可用时退回排名最前的节点
+static GPtrArray* select_nodes(ProxyPool *pool, guint max) {
+    GPtrArray *ranked = proxy_pool_ranked(pool);
+    GPtrArray *selected = g_ptr_array_new();
+
+    for (guint i = 0; i < ranked->len && selected->len < max; i++) {
+        ProxyNode *node = g_ptr_array_index(ranked, i);
+        if (node->state != PROXY_NODE_DOWN) {
+            g_ptr_array_add(selected, node);
+        }
+    }
+    for (guint i = 0; selected->len == 0 && i < ranked->len && i < max; i++) {
+        g_ptr_array_add(selected, g_ptr_array_index(ranked, i));
+    }
+
+    g_ptr_array_unref(ranked);
+    return selected;
+}
+
+GPtrArray* proxy_pool_select(ProxyPool *pool, guint max) {
+    GPtrArray *configs = g_ptr_array_new_with_free_func((GDestroyNotify)proxy_parser_free);
+    if (!pool) return configs;
+
+    GPtrArray *selected = select_nodes(pool, max);
+    for (guint i = 0; i < selected->len; i++) {
+        ProxyNode *node = g_ptr_array_index(selected, i);
+        ProxyConfig *config = proxy_parser_parse(node->url);
+        if (config) {
+            g_ptr_array_add(configs, config);
+        }
+    }
+    g_ptr_array_unref(selected);
+
+    return configs;
+}
+
+static int compare_urls(const void *a, const void *b) {
+    return strcmp(*(const char * const *)a, *(const char * const *)b);
+}
+
+char* proxy_pool_selection_key(ProxyPool *pool, guint max) {
+    if (!pool) return g_strdup("");
+
+    GPtrArray *selected = select_nodes(pool, max);
+    const char **urls = g_new0(const char*, selected->len + 1);
+    for (guint i = 0; i < selected->len; i++) {
+        urls[i] = ((ProxyNode*)g_ptr_array_index(selected, i))->url;
+    }
+    guint count = selected->len;
+    g_ptr_array_unref(selected);
+
+    // 均衡器自行在节点间选择，只有集合变化才需要重新生成配置
+    qsort(urls, count, sizeof(char*), compare_urls);
+    char *key = g_strjoinv("\n", (char**)urls);
+    g_free(urls);
+
+    return key;
+}
+
+gboolean proxy_pool_selection_stale(ProxyPool *pool, const char *key, guint max) {
+    if (!pool) return FALSE;
+    if (!key || *key == '\0') return TRUE;
+
+    GHashTable *by_url = g_hash_table_new(g_str_hash, g_str_equal);
+    guint available = 0;
+    for (guint i = 0; i < pool->nodes->len; i++) {
+        ProxyNode *node = &g_array_index(pool->nodes, ProxyNode, i);
+        g_hash_table_insert(by_url, (gpointer)node->url, node);
+        if (node->state != PROXY_NODE_DOWN) available++;
+    }
+
+    gboolean stale = FALSE;
+    char **urls = g_strsplit(key, "\n", -1);
+    guint selected = g_strv_length(urls);
+
+    for (char **url = urls; *url && !stale; url++) {
+        ProxyNode *node = g_hash_table_lookup(by_url, *url);
+        stale = !node || node->state == PROXY_NODE_DOWN;
+    }
+    if (!stale && selected < MIN(max, available)) {
+        stale = TRUE;
+    }
+
+    g_strfreev(urls);
+    g_hash_table_destroy(by_url);
+    return stale;
+}
+
+const char* proxy_pool_state_string(ProxyNodeState state) {
+    switch (state) {
+        case PROXY_NODE_UNKNOWN: return "未探测";
+        case PROXY_NODE_HEALTHY: return "可用";
+        case PROXY_NODE_DEGRADED: return "不稳定";
+        case PROXY_NODE_DOWN: return "不可用";
+        default: return "未知";
+    }
+}
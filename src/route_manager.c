@@ -149,6 +149,178 @@ gboolean route_manager_ip_match_cidr(const char *ip, const char *cidr) {
     return (ip_addr & netmask) == (network & netmask);
 }
 
+// 编译分流规则时使用的 IPv4 网段
+typedef struct {
+    uint32_t network;
+    int prefix;
+} CidrRange;
+
+static uint32_t prefix_mask(int prefix) {
+    return (prefix == 0) ? 0 : (~0U << (32 - prefix));
+}
+
+static void add_cidr_range(GArray *ranges, const char *cidr) {
+    uint32_t network, netmask;
+    
+    if (!parse_cidr(cidr, &network, &netmask)) {
+        log_message("WARNING", "Skipping invalid CIDR: %s", cidr);
+        return;
+    }
+    
+    CidrRange range = { network & netmask, __builtin_popcount(netmask) };
+    g_array_append_val(ranges, range);
+}
+
+static void add_cidr_ranges(GArray *ranges, GPtrArray *cidrs) {
+    for (guint i = 0; i < cidrs->len; i++) {
+        add_cidr_range(ranges, g_ptr_array_index(cidrs, i));
+    }
+}
+
+// 按起始地址排序，起始地址相同时大网段在前
+static gint compare_cidr_range(gconstpointer a, gconstpointer b) {
+    const CidrRange *x = a;
+    const CidrRange *y = b;
+    
+    if (x->network != y->network) {
+        return (x->network < y->network) ? -1 : 1;
+    }
+    return x->prefix - y->prefix;
+}
+
+static gboolean cidr_range_covers(const CidrRange *outer, const CidrRange *inner) {
+    return outer->prefix <= inner->prefix &&
+           (inner->network & prefix_mask(outer->prefix)) == outer->network;
+}
+
+// 聚合网段：排序后去掉被前一个网段覆盖的网段，相邻的两个同级网段合并为上一级网段
+static void aggregate_cidr_ranges(GArray *ranges) {
+    guint n = 0;
+    
+    g_array_sort(ranges, compare_cidr_range);
+    
+    for (guint i = 0; i < ranges->len; i++) {
+        CidrRange range = g_array_index(ranges, CidrRange, i);
+        if (n > 0 && cidr_range_covers(&g_array_index(ranges, CidrRange, n - 1), &range)) {
+            continue;
+        }
+        g_array_index(ranges, CidrRange, n++) = range;
+        
+        // 合并出的网段可能继续与更前面的网段合并
+        while (n >= 2) {
+            CidrRange *prev = &g_array_index(ranges, CidrRange, n - 2);
+            CidrRange *last = &g_array_index(ranges, CidrRange, n - 1);
+            if (prev->prefix != last->prefix || prev->prefix == 0) break;
+            
+            int parent = prev->prefix - 1;
+            if ((prev->network & prefix_mask(parent)) != prev->network ||
+                last->network != (prev->network | (1U << (32 - prev->prefix)))) {
+                break;
+            }
+            prev->prefix = parent;
+            n--;
+        }
+    }
+    
+    g_array_set_size(ranges, n);
+}
+
+// 去掉被 cover 中某个网段完全覆盖的网段，两个数组都已聚合
+static void remove_covered_ranges(GArray *ranges, GArray *cover) {
+    guint n = 0;
+    guint j = 0;
+    
+    for (guint i = 0; i < ranges->len; i++) {
+        CidrRange range = g_array_index(ranges, CidrRange, i);
+        
+        // cover 中起始地址不大于 range 的最后一个网段是唯一可能覆盖它的网段
+        while (j + 1 < cover->len && g_array_index(cover, CidrRange, j + 1).network <= range.network) {
+            j++;
+        }
+        if (cover->len > 0 && cidr_range_covers(&g_array_index(cover, CidrRange, j), &range)) {
+            continue;
+        }
+        g_array_index(ranges, CidrRange, n++) = range;
+    }
+    
+    g_array_set_size(ranges, n);
+}
+
+static char** cidr_ranges_to_strv(GArray *ranges) {
+    if (ranges->len == 0) return NULL;
+    
+    char **strv = g_new(char *, ranges->len + 1);
+    for (guint i = 0; i < ranges->len; i++) {
+        const CidrRange *range = &g_array_index(ranges, CidrRange, i);
+        strv[i] = g_strdup_printf("%u.%u.%u.%u/%d",
+                                  range->network >> 24, (range->network >> 16) & 0xff,
+                                  (range->network >> 8) & 0xff, range->network & 0xff,
+                                  range->prefix);
+    }
+    strv[ranges->len] = NULL;
+    return strv;
+}
+
+// 编译代理内核的分流规则
+ProxyRouteRules* route_manager_compile_proxy_rules(RouteManager *manager) {
+    if (!manager) return NULL;
+    
+    RouteConfig *config = manager->config;
+    ProxyRouteRules *rules = g_new0(ProxyRouteRules, 1);
+    GArray *direct = g_array_new(FALSE, FALSE, sizeof(CidrRange));
+    GArray *block = g_array_new(FALSE, FALSE, sizeof(CidrRange));
+    
+    // 隧道网段和走VPN的网段由系统路由送入隧道，任何模式下都不经过代理
+    add_cidr_range(direct, PROXY_VPN_SUBNET);
+    add_cidr_ranges(direct, config->custom_vpn_cidrs);
+    add_cidr_ranges(block, config->custom_block_cidrs);
+    
+    switch (config->mode) {
+        case ROUTE_MODE_GLOBAL:
+            break;
+        case ROUTE_MODE_DIRECT:
+            rules->final_direct = TRUE;
+            break;
+        case ROUTE_MODE_PAC:
+        default:
+            if (config->private_direct) {
+                for (int i = 0; PRIVATE_IP_RANGES[i] != NULL; i++) {
+                    add_cidr_range(direct, PRIVATE_IP_RANGES[i]);
+                }
+            }
+            
+            if (config->cn_direct && config->enable_geoip) {
+                // 指定了 GeoIP 文件时按文件中的网段直连，与 NetworkManager 路由一致
+                if (strlen(config->geoip_db_path) > 0) {
+                    route_manager_load_geoip(manager);
+                    add_cidr_ranges(direct, manager->cn_ip_list);
+                } else {
+                    rules->geoip_cn_direct = TRUE;
+                }
+                rules->geosite_cn_direct = TRUE;
+            }
+            
+            add_cidr_ranges(direct, config->custom_direct_cidrs);
+            rules->block_ads = TRUE;
+            break;
+    }
+    
+    aggregate_cidr_ranges(block);
+    aggregate_cidr_ranges(direct);
+    // 阻断规则在前，被阻断网段覆盖的直连网段不会被匹配到
+    remove_covered_ranges(direct, block);
+    
+    rules->direct_cidrs = cidr_ranges_to_strv(direct);
+    rules->block_cidrs = cidr_ranges_to_strv(block);
+    
+    log_message("INFO", "Compiled proxy routing rules (mode: %d): %u direct, %u block CIDRs",
+                config->mode, direct->len, block->len);
+    
+    g_array_free(direct, TRUE);
+    g_array_free(block, TRUE);
+    return rules;
+}
+
 // 加载GeoIP数据
 gboolean route_manager_load_geoip(RouteManager *manager) {
     if (!manager) return FALSE;
@@ -313,6 +485,9 @@ void route_manager_add_custom_cidr(RouteManager *manager, const char *cidr, Rout
     }
     
     if (target_array) {
+        for (guint i = 0; i < target_array->len; i++) {
+            if (strcmp(g_ptr_array_index(target_array, i), cidr) == 0) return;
+        }
         g_ptr_array_add(target_array, g_strdup(cidr));
         log_message("INFO", "Added custom %s rule: %s", action_name, cidr);
     }
@@ -375,6 +550,30 @@ void route_manager_get_stats(RouteManager *manager, int *direct_count, int *vpn_
     }
 }
 
+// 读取自定义 CIDR 列表，跳过格式错误的项
+static void load_cidr_list(GKeyFile *keyfile, const char *key, GPtrArray *target) {
+    gsize count = 0;
+    char **list = g_key_file_get_string_list(keyfile, "Custom", key, &count, NULL);
+    
+    g_ptr_array_set_size(target, 0);
+    for (gsize i = 0; i < count; i++) {
+        uint32_t network, netmask;
+        if (parse_cidr(list[i], &network, &netmask)) {
+            g_ptr_array_add(target, g_strdup(list[i]));
+        }
+    }
+    g_strfreev(list);
+}
+
+static void save_cidr_list(GKeyFile *keyfile, const char *key, GPtrArray *source) {
+    g_key_file_set_string_list(keyfile, "Custom", key, (const char * const *)source->pdata, source->len);
+}
+
+// 路由配置文件路径
+char* route_manager_get_config_path(void) {
+    return g_build_filename(g_get_user_config_dir(), "ovpn-client", "route_config.ini", NULL);
+}
+
 // 加载路由配置
 gboolean route_manager_load_config(RouteManager *manager, const char *config_file) {
     if (!manager || !config_file) return FALSE;
@@ -394,6 +593,11 @@ gboolean route_manager_load_config(RouteManager *manager, const char *config_fil
     manager->config->enable_geoip = g_key_file_get_boolean(keyfile, "General", "enable_geoip", NULL);
     manager->config->cn_direct = g_key_file_get_boolean(keyfile, "General", "cn_direct", NULL);
     manager->config->private_direct = g_key_file_get_boolean(keyfile, "General", "private_direct", NULL);
+    manager->config->lan_direct = g_key_file_get_boolean(keyfile, "General", "lan_direct", NULL);
+    
+    load_cidr_list(keyfile, "direct", manager->config->custom_direct_cidrs);
+    load_cidr_list(keyfile, "vpn", manager->config->custom_vpn_cidrs);
+    load_cidr_list(keyfile, "block", manager->config->custom_block_cidrs);
     
     char *geoip_path = g_key_file_get_string(keyfile, "General", "geoip_db_path", NULL);
     if (geoip_path) {
@@ -416,8 +620,13 @@ gboolean route_manager_save_config(RouteManager *manager, const char *config_fil
     g_key_file_set_boolean(keyfile, "General", "enable_geoip", manager->config->enable_geoip);
     g_key_file_set_boolean(keyfile, "General", "cn_direct", manager->config->cn_direct);
     g_key_file_set_boolean(keyfile, "General", "private_direct", manager->config->private_direct);
+    g_key_file_set_boolean(keyfile, "General", "lan_direct", manager->config->lan_direct);
     g_key_file_set_string(keyfile, "General", "geoip_db_path", manager->config->geoip_db_path);
     
+    save_cidr_list(keyfile, "direct", manager->config->custom_direct_cidrs);
+    save_cidr_list(keyfile, "vpn", manager->config->custom_vpn_cidrs);
+    save_cidr_list(keyfile, "block", manager->config->custom_block_cidrs);
+    
     GError *error = NULL;
     gboolean success = g_key_file_save_to_file(keyfile, config_file, &error);
     
@@ -1,5 +1,6 @@
 #include "../include/route_ui.h"
 #include "../include/log_util.h"
+#include "../include/v2ray_manager.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -11,6 +12,14 @@ static const char *MODE_OPTIONS[] = {
     NULL
 };
 
+// 自定义规则动作，顺序与 RouteAction 一致
+static const char *ACTION_OPTIONS[] = {
+    "直连",
+    "走VPN",
+    "阻断",
+    NULL
+};
+
 // ==================== 辅助函数：显示错误对话框 ====================
 static void show_error_message(GtkWindow *parent, const char *message) {
     GtkWidget *dialog = gtk_message_dialog_new(
@@ -51,9 +60,9 @@ static void on_add_rule_clicked(GtkButton *button, gpointer user_data) {
     // 动作选择
     GtkWidget *action_label = gtk_label_new("动作:");
     GtkWidget *action_combo = gtk_combo_box_text_new();
-    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(action_combo), "直连");
-    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(action_combo), "走VPN");
-    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(action_combo), "阻断");
+    for (int i = 0; ACTION_OPTIONS[i] != NULL; i++) {
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(action_combo), ACTION_OPTIONS[i]);
+    }
     gtk_combo_box_set_active(GTK_COMBO_BOX(action_combo), 0);
     
     gtk_grid_attach(GTK_GRID(grid), cidr_label, 0, 0, 1, 1);
@@ -79,7 +88,7 @@ static void on_add_rule_clicked(GtkButton *button, gpointer user_data) {
             gtk_list_store_append(GTK_LIST_STORE(dialog->custom_rules_store), &iter);
             gtk_list_store_set(GTK_LIST_STORE(dialog->custom_rules_store), &iter,
                              0, cidr,
-                             1, MODE_OPTIONS[action_idx],
+                             1, ACTION_OPTIONS[action_idx],
                              -1);
             
             route_config_dialog_update_stats(dialog);
@@ -105,9 +114,9 @@ static void on_remove_rule_clicked(GtkButton *button, gpointer user_data) {
         
         // 确定动作类型
         RouteAction action = ROUTE_ACTION_DIRECT;
-        if (strcmp(action_str, "走VPN") == 0) {
+        if (strcmp(action_str, ACTION_OPTIONS[ROUTE_ACTION_VPN]) == 0) {
             action = ROUTE_ACTION_VPN;
-        } else if (strcmp(action_str, "阻断") == 0) {
+        } else if (strcmp(action_str, ACTION_OPTIONS[ROUTE_ACTION_BLOCK]) == 0) {
             action = ROUTE_ACTION_BLOCK;
         }
         
@@ -306,6 +315,23 @@ static GtkWidget* create_custom_rules_page(RouteConfigDialog *dialog) {
     );
     gtk_tree_view_append_column(GTK_TREE_VIEW(dialog->custom_rules_view), column);
     
+    // 填入已保存的规则
+    GPtrArray *lists[] = {
+        dialog->route_manager->config->custom_direct_cidrs,
+        dialog->route_manager->config->custom_vpn_cidrs,
+        dialog->route_manager->config->custom_block_cidrs,
+    };
+    for (int action = 0; action < (int)G_N_ELEMENTS(lists); action++) {
+        for (guint i = 0; i < lists[action]->len; i++) {
+            GtkTreeIter iter;
+            gtk_list_store_append(GTK_LIST_STORE(dialog->custom_rules_store), &iter);
+            gtk_list_store_set(GTK_LIST_STORE(dialog->custom_rules_store), &iter,
+                             0, g_ptr_array_index(lists[action], i),
+                             1, ACTION_OPTIONS[action],
+                             -1);
+        }
+    }
+    
     // 滚动窗口
     GtkWidget *scrolled = gtk_scrolled_window_new(NULL, NULL);
     gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled),
@@ -440,9 +466,7 @@ void route_config_dialog_show(RouteConfigDialog *dialog) {
                sizeof(dialog->route_manager->config->geoip_db_path) - 1);
         
         // 保存到配置文件
-        const char *config_dir = g_get_user_config_dir();
-        char config_path[1024];
-        snprintf(config_path, sizeof(config_path), "%s/ovpn-client/route_config.ini", config_dir);
+        char *config_path = route_manager_get_config_path();
         
         // 确保目录存在
         char *dir = g_path_get_dirname(config_path);
@@ -450,6 +474,13 @@ void route_config_dialog_show(RouteConfigDialog *dialog) {
         g_free(dir);
         
         route_manager_save_config(dialog->route_manager, config_path);
+        g_free(config_path);
+        
+        // 代理内核使用同一份规则，运行中时改写配置
+        if (dialog->client->v2ray_manager) {
+            v2ray_manager_set_route_rules(dialog->client->v2ray_manager,
+                                          route_manager_compile_proxy_rules(dialog->route_manager));
+        }
         
         log_message("INFO", "Route configuration saved");
     }
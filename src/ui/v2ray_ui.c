@@ -3,36 +3,87 @@
 #include <string.h>
 #include "ui/ui_utils.h"
 
+// 日志视图最多保留的行数
+#define LOG_VIEW_MAX_LINES 1000
+
+// 连接统计显示的条目数和错误率告警阈值
+#define STATS_TOP_DESTINATIONS 10
+#define STATS_ERROR_RATE_WARN 0.1
+
+// 节点池列表最多显示的节点数
+#define POOL_VIEW_MAX_NODES 50
 
 typedef struct {
     GtkWidget *dialog;
     GtkWidget *url_entry;
     GtkWidget *status_label;
+    GtkWidget *watchdog_label;
     GtkWidget *start_button;
+    GtkWidget *swap_button;
     GtkWidget *stop_button;
     GtkWidget *tproxy_switch;
+    GtkWidget *fakeip_check;
+    GtkWidget *core_combo;
+    GtkWidget *mux_check;
+    GtkWidget *mux_spin;
+    GtkWidget *xudp_check;
+    GtkWidget *profile_combo;
     GtkWidget *log_view;
+    GtkWidget *stats_label;
+    GtkWidget *pool_view;
+    GtkWidget *pool_label;
     GtkTextBuffer *log_buffer;
+    guint64 log_seq;            // 下一条待显示日志的序号
     V2RayManager *manager;
     guint update_timer;
 } V2RayDialog;
 
-// 更新日志显示
+// 追加一行日志，stderr 输出标红
+static void append_log_line(const LogRingEntry *entry, gpointer user_data) {
+    V2RayDialog *dialog = (V2RayDialog*)user_data;
+    
+    GtkTextIter end;
+    gtk_text_buffer_get_end_iter(dialog->log_buffer, &end);
+    
+    if (entry->stream == LOG_RING_STREAM_STDERR) {
+        gtk_text_buffer_insert_with_tags_by_name(dialog->log_buffer, &end, entry->text, (gint)entry->len,
+                                                 "stderr", NULL);
+    } else {
+        gtk_text_buffer_insert(dialog->log_buffer, &end, entry->text, (gint)entry->len);
+    }
+    
+    gtk_text_buffer_get_end_iter(dialog->log_buffer, &end);
+    gtk_text_buffer_insert(dialog->log_buffer, &end, "\n", 1);
+}
+
+// 更新日志显示：只追加新日志，超出上限时删除最早的行
 static gboolean update_log_view(gpointer user_data) {
     V2RayDialog *dialog = (V2RayDialog*)user_data;
     
-    const char *log = v2ray_manager_get_log(dialog->manager);
-    gtk_text_buffer_set_text(dialog->log_buffer, log, -1);
+    guint64 next_seq = v2ray_manager_foreach_log(dialog->manager, dialog->log_seq, append_log_line, dialog);
+    if (next_seq == dialog->log_seq) {
+        return TRUE;
+    }
+    dialog->log_seq = next_seq;
+    
+    // 末尾总有一个空行
+    gint excess = gtk_text_buffer_get_line_count(dialog->log_buffer) - 1 - LOG_VIEW_MAX_LINES;
+    if (excess > 0) {
+        GtkTextIter start, cut;
+        gtk_text_buffer_get_start_iter(dialog->log_buffer, &start);
+        gtk_text_buffer_get_iter_at_line(dialog->log_buffer, &cut, excess);
+        gtk_text_buffer_delete(dialog->log_buffer, &start, &cut);
+    }
     
     // 滚动到底部
-    GtkTextIter end;
-    gtk_text_buffer_get_end_iter(dialog->log_buffer, &end);
-    GtkTextMark *mark = gtk_text_buffer_create_mark(dialog->log_buffer, NULL, &end, FALSE);
+    GtkTextMark *mark = gtk_text_buffer_get_mark(dialog->log_buffer, "log-end");
     gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(dialog->log_view), mark, 0.0, TRUE, 0.0, 1.0);
     
     return TRUE;
 }
 
+static void on_tproxy_toggled(GtkSwitch *widget, gboolean state, gpointer user_data);
+
 // 更新状态
 static void update_status(V2RayDialog *dialog) {
     if (!dialog || !dialog->manager) {
@@ -49,36 +100,259 @@ static void update_status(V2RayDialog *dialog) {
         case V2RAY_STATUS_RUNNING:
             color = "green";
             gtk_widget_set_sensitive(dialog->start_button, FALSE);
+            gtk_widget_set_sensitive(dialog->swap_button, !v2ray_manager_is_swapping(dialog->manager));
             gtk_widget_set_sensitive(dialog->stop_button, TRUE);
-            gtk_widget_set_sensitive(dialog->url_entry, FALSE);
+            gtk_widget_set_sensitive(dialog->url_entry, TRUE);  // 运行中可热切换节点
+            gtk_widget_set_sensitive(dialog->fakeip_check, FALSE);
             gtk_widget_set_sensitive(dialog->tproxy_switch, TRUE);
             break;
+        case V2RAY_STATUS_STARTING:
+            // 等待入站端口就绪，可随时停止
+            color = "orange";
+            gtk_widget_set_sensitive(dialog->start_button, FALSE);
+            gtk_widget_set_sensitive(dialog->swap_button, FALSE);
+            gtk_widget_set_sensitive(dialog->stop_button, TRUE);
+            gtk_widget_set_sensitive(dialog->url_entry, TRUE);
+            gtk_widget_set_sensitive(dialog->fakeip_check, FALSE);
+            gtk_widget_set_sensitive(dialog->tproxy_switch, FALSE);
+            break;
         case V2RAY_STATUS_STOPPED:
             color = "gray";
             gtk_widget_set_sensitive(dialog->start_button, TRUE);
+            gtk_widget_set_sensitive(dialog->swap_button, FALSE);
             gtk_widget_set_sensitive(dialog->stop_button, FALSE);
             gtk_widget_set_sensitive(dialog->url_entry, TRUE);  // ✅ 允许编辑
+            gtk_widget_set_sensitive(dialog->fakeip_check, TRUE);
             gtk_widget_set_sensitive(dialog->tproxy_switch, FALSE);
             break;
         case V2RAY_STATUS_ERROR:
             color = "red";
             gtk_widget_set_sensitive(dialog->start_button, TRUE);
+            gtk_widget_set_sensitive(dialog->swap_button, FALSE);
             gtk_widget_set_sensitive(dialog->stop_button, FALSE);
             gtk_widget_set_sensitive(dialog->url_entry, TRUE);  // ✅ 允许编辑
+            gtk_widget_set_sensitive(dialog->fakeip_check, TRUE);
             gtk_widget_set_sensitive(dialog->tproxy_switch, FALSE);
             break;
         default:
+            // 启动/停止进行中，等待异步操作完成
             color = "orange";
-            gtk_widget_set_sensitive(dialog->start_button, TRUE);
+            gtk_widget_set_sensitive(dialog->start_button, FALSE);
+            gtk_widget_set_sensitive(dialog->swap_button, FALSE);
             gtk_widget_set_sensitive(dialog->stop_button, FALSE);
             gtk_widget_set_sensitive(dialog->url_entry, TRUE);  // ✅ 默认允许编辑
+            gtk_widget_set_sensitive(dialog->fakeip_check, TRUE);
             gtk_widget_set_sensitive(dialog->tproxy_switch, FALSE);
             break;
     }
     
-    snprintf(markup, sizeof(markup), "<span foreground='%s' weight='bold'>状态: %s</span>", 
-             color, status_str);
+    // 只能在停止状态下切换内核
+    gtk_widget_set_sensitive(dialog->core_combo,
+                             status == V2RAY_STATUS_STOPPED || status == V2RAY_STATUS_ERROR);
+    
+    const char *restart_hint = v2ray_manager_needs_restart(dialog->manager) ? "  配置已更改，重启后生效" : "";
+    
+    if (status == V2RAY_STATUS_RUNNING && dialog->manager->ready_time_us >= 0) {
+        snprintf(markup, sizeof(markup),
+                 "<span foreground='%s' weight='bold'>状态: %s</span>  (启动耗时 %" G_GINT64_FORMAT " ms)%s",
+                 color, status_str, dialog->manager->ready_time_us / 1000, restart_hint);
+    } else {
+        snprintf(markup, sizeof(markup), "<span foreground='%s' weight='bold'>状态: %s</span>%s", 
+                 color, status_str, restart_hint);
+    }
     gtk_label_set_markup(GTK_LABEL(dialog->status_label), markup);
+    
+    // 看门狗可能已撤除/恢复透明代理规则，开关跟随实际状态；用户发起的切换完成前保持开关位置
+    gboolean tproxy_active = dialog->manager->tproxy_enabled;
+    if (gtk_switch_get_active(GTK_SWITCH(dialog->tproxy_switch)) != tproxy_active &&
+        !dialog->manager->tproxy_rearm && dialog->manager->tproxy_pending == 0) {
+        g_signal_handlers_block_by_func(dialog->tproxy_switch, G_CALLBACK(on_tproxy_toggled), dialog);
+        gtk_switch_set_active(GTK_SWITCH(dialog->tproxy_switch), tproxy_active);
+        g_signal_handlers_unblock_by_func(dialog->tproxy_switch, G_CALLBACK(on_tproxy_toggled), dialog);
+    }
+    
+    char *watchdog_str = v2ray_manager_get_watchdog_string(dialog->manager);
+    gtk_label_set_text(GTK_LABEL(dialog->watchdog_label), watchdog_str);
+    g_free(watchdog_str);
+}
+
+// 追加一个入站/出站的流量行
+static void append_traffic_line(GString *markup, V2RayTraffic *traffic) {
+    char *up = g_format_size(traffic->uplink);
+    char *down = g_format_size(traffic->downlink);
+    char *up_rate = g_format_size((guint64)traffic->uplink_rate);
+    char *down_rate = g_format_size((guint64)traffic->downlink_rate);
+    
+    char *line = g_markup_printf_escaped("  %-16s ↑ %10s/s ↓ %10s/s   总计 ↑ %s ↓ %s\n",
+                                         traffic->tag, up_rate, down_rate, up, down);
+    g_string_append(markup, line);
+    
+    g_free(line);
+    g_free(up);
+    g_free(down);
+    g_free(up_rate);
+    g_free(down_rate);
+}
+
+// 实时流量（来自统计 API）
+static void append_traffic_view(GString *markup, V2RayManager *manager) {
+    GPtrArray *traffic = v2ray_manager_get_traffic(manager);
+    gboolean inbound_header = FALSE;
+    
+    g_string_append(markup, "<b>实时流量（出站）</b>\n");
+    for (guint i = 0; i < traffic->len; i++) {
+        V2RayTraffic *entry = g_ptr_array_index(traffic, i);
+        if (!entry->outbound && !inbound_header) {
+            g_string_append(markup, "<b>实时流量（入站）</b>\n");
+            inbound_header = TRUE;
+        }
+        append_traffic_line(markup, entry);
+    }
+    if (traffic->len == 0) {
+        g_string_append(markup, "  (暂无数据)\n");
+    }
+    g_string_append_c(markup, '\n');
+    
+    g_ptr_array_unref(traffic);
+}
+
+// 更新连接统计
+static void update_stats_view(V2RayDialog *dialog) {
+    V2RayLogStats *stats = v2ray_manager_get_log_stats(dialog->manager);
+    if (!stats) return;
+    
+    GString *markup = g_string_new("<tt>");
+    
+    append_traffic_view(markup, dialog->manager);
+    
+    g_string_append_printf(markup, "总连接: %" G_GUINT64_FORMAT "    拒绝: %" G_GUINT64_FORMAT "\n",
+                           stats->accepted, stats->rejected);
+    g_string_append_printf(markup, "拨号失败: %" G_GUINT64_FORMAT "    TLS 错误: %" G_GUINT64_FORMAT
+                           "    其他错误: %" G_GUINT64_FORMAT "\n",
+                           stats->dial_failures, stats->tls_errors, stats->errors);
+    
+    guint recent_accepted, recent_failures;
+    double rate = v2ray_log_stats_error_rate(stats, V2RAY_LOG_WINDOW_SECONDS, g_get_monotonic_time(),
+                                             &recent_accepted, &recent_failures);
+    g_string_append_printf(markup, "最近 %d 秒: 连接 %u，失败 <span foreground='%s'>%u (%.1f%%)</span>\n\n",
+                           V2RAY_LOG_WINDOW_SECONDS, recent_accepted,
+                           rate >= STATS_ERROR_RATE_WARN ? "red" : "green", recent_failures, rate * 100);
+    
+    // 出站分布
+    g_string_append(markup, "<b>出站分布</b>\n");
+    GPtrArray *outbounds = v2ray_log_stats_top(stats->outbounds, 0);
+    for (guint i = 0; i < outbounds->len; i++) {
+        V2RayLogCounter *counter = g_ptr_array_index(outbounds, i);
+        double share = stats->accepted > 0 ? 100.0 * counter->connections / stats->accepted : 0;
+        char *line = g_markup_printf_escaped("  %-16s %10" G_GUINT64_FORMAT "  (%5.1f%%)\n",
+                                             counter->key, counter->connections, share);
+        g_string_append(markup, line);
+        g_free(line);
+    }
+    if (outbounds->len == 0) {
+        g_string_append(markup, "  (暂无数据)\n");
+    }
+    g_ptr_array_unref(outbounds);
+    
+    // 访问最多的目的地址
+    g_string_append(markup, "\n<b>访问最多的目的地址</b>\n");
+    GPtrArray *destinations = v2ray_log_stats_top(stats->destinations, STATS_TOP_DESTINATIONS);
+    for (guint i = 0; i < destinations->len; i++) {
+        V2RayLogCounter *counter = g_ptr_array_index(destinations, i);
+        char *line = g_markup_printf_escaped("  %-32s %8" G_GUINT64_FORMAT "  失败 %" G_GUINT64_FORMAT "\n",
+                                             counter->key, counter->connections, counter->failures);
+        g_string_append(markup, line);
+        g_free(line);
+    }
+    if (destinations->len == 0) {
+        g_string_append(markup, "  (暂无数据)\n");
+    }
+    g_ptr_array_unref(destinations);
+    
+    g_string_append(markup, "</tt>");
+    gtk_label_set_markup(GTK_LABEL(dialog->stats_label), markup->str);
+    g_string_free(markup, TRUE);
+}
+
+// 清空统计按钮回调
+static void on_reset_stats_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    V2RayDialog *dialog = (V2RayDialog*)user_data;
+    
+    v2ray_manager_reset_log_stats(dialog->manager);
+    update_stats_view(dialog);
+}
+
+// 更新节点池列表
+static void update_pool_view(V2RayDialog *dialog) {
+    ProxyPool *pool = v2ray_manager_get_pool(dialog->manager);
+    GPtrArray *ranked = proxy_pool_ranked(pool);
+    GString *markup = g_string_new("<tt>");
+    
+    const char *summary = g_object_get_data(G_OBJECT(dialog->dialog), "pool-import-summary");
+    
+    g_string_append_printf(markup, "共 %u 个节点%s%s\n", ranked->len,
+                           dialog->manager->pool_active ? "，正在使用节点池" : "",
+                           proxy_pool_is_probing(pool) ? "，测速中..." : "");
+    if (summary) {
+        char *escaped = g_markup_escape_text(summary, -1);
+        g_string_append_printf(markup, "%s\n", escaped);
+        g_free(escaped);
+    }
+    g_string_append_c(markup, '\n');
+    
+    for (guint i = 0; i < ranked->len && i < POOL_VIEW_MAX_NODES; i++) {
+        ProxyNode *node = g_ptr_array_index(ranked, i);
+        const char *color = node->state == PROXY_NODE_HEALTHY ? "green" :
+                            node->state == PROXY_NODE_DOWN ? "red" : "gray";
+        char latency[32];
+        
+        if (node->smoothed_us > 0) {
+            g_snprintf(latency, sizeof(latency), "%5" G_GINT64_FORMAT " ms", node->smoothed_us / 1000);
+        } else {
+            g_snprintf(latency, sizeof(latency), "%8s", "-");
+        }
+        
+        char *line = g_markup_printf_escaped("%3u. <span foreground='%s'>%-6s</span> %s  %-12s %s\n",
+                                             i + 1, color, proxy_pool_state_string(node->state), latency,
+                                             proxy_parser_get_type_string(node->type), node->name);
+        g_string_append(markup, line);
+        g_free(line);
+    }
+    if (ranked->len > POOL_VIEW_MAX_NODES) {
+        g_string_append_printf(markup, "  ... 另有 %u 个节点\n", ranked->len - POOL_VIEW_MAX_NODES);
+    }
+    
+    g_string_append(markup, "</tt>");
+    gtk_label_set_markup(GTK_LABEL(dialog->pool_label), markup->str);
+    g_string_free(markup, TRUE);
+    g_ptr_array_unref(ranked);
+}
+
+// 定时刷新：状态可能被看门狗异步改变
+static gboolean on_update_timer(gpointer user_data) {
+    V2RayDialog *dialog = (V2RayDialog*)user_data;
+    
+    update_status(dialog);
+    update_log_view(dialog);
+    update_stats_view(dialog);
+    update_pool_view(dialog);
+    
+    return TRUE;
+}
+
+// 启动完成回调
+static void on_start_finished(V2RayManager *manager, gboolean success, const GError *error, gpointer user_data) {
+    (void)manager;
+    GtkWidget *anchor = GTK_WIDGET(user_data);
+    
+    // 被停止或程序退出取消的启动不提示
+    if (!success && !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        ui_show_error(anchor, "启动 V2Ray 失败请检查代理链接是否正确\n\n%s",
+                      error ? error->message : "未知错误");
+    }
+    
+    g_object_unref(anchor);
 }
 
 // 启动按钮回调
@@ -108,46 +382,189 @@ static void on_start_clicked(GtkButton *button, gpointer user_data) {
         return;
     }
     
-    // 启动 V2Ray
-    GError *error = NULL;
-    if (!v2ray_manager_start(dialog->manager, &error)) {
+    // 异步启动 V2Ray，对话框可能在完成前关闭，回调只持有对话框控件的引用
+    v2ray_manager_start_async(dialog->manager, on_start_finished, g_object_ref(dialog->dialog));
+    update_status(dialog);
+}
 
-        ui_show_error(dialog->dialog, "启动 V2Ray 失败请检查代理链接是否正确");
+// 热切换完成回调
+static void on_swap_finished(V2RayManager *manager, gboolean success, const GError *error, gpointer user_data) {
+    (void)manager;
+    GtkWidget *anchor = GTK_WIDGET(user_data);
+    
+    if (!success) {
+        ui_show_error(anchor, "切换节点失败，仍在使用原节点\n\n%s",
+                      error ? error->message : "未知错误");
+    }
+    
+    g_object_unref(anchor);
+}
+
+// 切换节点按钮回调：运行中无中断地切换到新节点
+static void on_swap_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    V2RayDialog *dialog = (V2RayDialog*)user_data;
+    
+    const char *url = gtk_entry_get_text(GTK_ENTRY(dialog->url_entry));
+    if (!url || strlen(url) == 0) {
+        ui_show_error(dialog->dialog, "请输入代理节点链接");
+        return;
+    }
+    
+    ProxyConfig *config = proxy_parser_parse(url);
+    if (!config) {
+        ui_show_error(dialog->dialog, "无法解析代理链接，请检查格式是否正确");
         return;
     }
     
+    v2ray_manager_swap_config_async(dialog->manager, config, on_swap_finished, g_object_ref(dialog->dialog));
     update_status(dialog);
+}
+
+// 导入节点按钮回调
+static void on_pool_import_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    V2RayDialog *dialog = (V2RayDialog*)user_data;
+    
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(dialog->pool_view));
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds(buffer, &start, &end);
+    char *text = gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
     
-    // 启动日志更新定时器
-    if (dialog->update_timer == 0) {
-        dialog->update_timer = g_timeout_add(1000, update_log_view, dialog);
+    ProxyPool *pool = v2ray_manager_get_pool(dialog->manager);
+    guint added = proxy_pool_add_text(pool, text);
+    g_free(text);
+    
+    if (added == 0) {
+        ui_show_error(dialog->dialog, "没有导入任何节点，请检查链接或订阅内容");
+        return;
     }
+    
+    gtk_text_buffer_set_text(buffer, "", 0);
+    proxy_pool_probe_all(pool);
+    update_pool_view(dialog);
 }
 
-// 停止按钮回调
-static void on_stop_clicked(GtkButton *button, gpointer user_data) {
+// 订阅文件导入完成：对话框可能已关闭，只通过 anchor 上的数据访问管理器
+static void on_pool_file_imported(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source;
+    GtkWidget *anchor = GTK_WIDGET(user_data);
+    V2RayManager *manager = g_object_get_data(G_OBJECT(anchor), "manager");
+    ProxyPool *pool = v2ray_manager_get_pool(manager);
+    ProxyPoolImportStats stats;
+    GError *error = NULL;
+    
+    if (!proxy_pool_import_file_finish(pool, result, &stats, &error)) {
+        ui_show_error(anchor, "导入订阅文件失败\n\n%s", error->message);
+        g_error_free(error);
+        g_object_unref(anchor);
+        return;
+    }
+    
+    char *summary = g_strdup_printf("上次导入: %u 行，新增 %u，保留 %u，移除 %u，重复 %u，无法解析 %u",
+                                    stats.lines, stats.added, stats.kept, stats.removed,
+                                    stats.duplicates, stats.failed);
+    g_object_set_data_full(G_OBJECT(anchor), "pool-import-summary", summary, g_free);
+    
+    // 节点集合变化后测速一轮，一轮结束时管理器按新的集合重新选择节点
+    if (stats.added > 0 || stats.removed > 0) {
+        proxy_pool_probe_all(pool);
+    }
+    g_object_unref(anchor);
+}
+
+// 从文件导入按钮回调：读取和解析在工作线程中进行，大订阅也不阻塞界面
+static void on_pool_import_file_clicked(GtkButton *button, gpointer user_data) {
     (void)button;
     V2RayDialog *dialog = (V2RayDialog*)user_data;
     
-    v2ray_manager_stop(dialog->manager);
+    GtkWidget *file_chooser = gtk_file_chooser_dialog_new(
+        "选择订阅文件",
+        GTK_WINDOW(dialog->dialog),
+        GTK_FILE_CHOOSER_ACTION_OPEN,
+        "取消", GTK_RESPONSE_CANCEL,
+        "打开", GTK_RESPONSE_ACCEPT,
+        NULL
+    );
+    
+    // 同步时已有节点按指纹保留测速结果，订阅中已删除的节点移除
+    GtkWidget *sync_check = gtk_check_button_new_with_label("同步订阅：移除订阅中已不存在的节点，保留已有节点的测速结果");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(sync_check), proxy_pool_size(v2ray_manager_get_pool(dialog->manager)) > 0);
+    gtk_file_chooser_set_extra_widget(GTK_FILE_CHOOSER(file_chooser), sync_check);
+    
+    if (gtk_dialog_run(GTK_DIALOG(file_chooser)) == GTK_RESPONSE_ACCEPT) {
+        char *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(file_chooser));
+        gboolean sync = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(sync_check));
+        proxy_pool_import_file_async(v2ray_manager_get_pool(dialog->manager), filename, sync, NULL,
+                                     on_pool_file_imported, g_object_ref(dialog->dialog));
+        g_free(filename);
+    }
+    
+    gtk_widget_destroy(file_chooser);
+}
+
+// 清空节点池按钮回调
+static void on_pool_clear_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    V2RayDialog *dialog = (V2RayDialog*)user_data;
+    
+    proxy_pool_clear(v2ray_manager_get_pool(dialog->manager));
+    update_pool_view(dialog);
+}
+
+// 测速按钮回调
+static void on_pool_probe_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    V2RayDialog *dialog = (V2RayDialog*)user_data;
+    
+    proxy_pool_probe_all(v2ray_manager_get_pool(dialog->manager));
+    update_pool_view(dialog);
+}
+
+// 使用节点池按钮回调
+static void on_pool_use_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
+    V2RayDialog *dialog = (V2RayDialog*)user_data;
+    
+    if (proxy_pool_size(v2ray_manager_get_pool(dialog->manager)) == 0) {
+        ui_show_error(dialog->dialog, "节点池为空，请先导入节点");
+        return;
+    }
+    
+    v2ray_manager_use_pool_async(dialog->manager, on_swap_finished, g_object_ref(dialog->dialog));
     update_status(dialog);
+}
+
+// 停止完成：透明代理规则未能撤除时提示
+static void on_stopped(V2RayManager *manager, gboolean success, const GError *error, gpointer user_data) {
+    (void)manager;
+    GtkWidget *anchor = GTK_WIDGET(user_data);
     
-    // 停止日志更新定时器
-    if (dialog->update_timer > 0) {
-        g_source_remove(dialog->update_timer);
-        dialog->update_timer = 0;
+    if (!success && !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        ui_show_error(anchor, "V2Ray 已停止，但透明代理规则未能撤除\n\n%s",
+                      error ? error->message : "未知错误");
     }
+    
+    g_object_unref(anchor);
 }
 
-// 透明代理开关回调
-static void on_tproxy_toggled(GtkSwitch *widget, gboolean state, gpointer user_data) {
+// 停止按钮回调
+static void on_stop_clicked(GtkButton *button, gpointer user_data) {
+    (void)button;
     V2RayDialog *dialog = (V2RayDialog*)user_data;
+    
+    // 异步停止，状态由定时器刷新
+    v2ray_manager_stop_async(dialog->manager, on_stopped, g_object_ref(dialog->dialog));
+    update_status(dialog);
+}
 
-    GError *error = NULL;
-    if (!v2ray_manager_enable_tproxy(dialog->manager, state, &error)) {
+// 透明代理脚本执行完成：失败时提示并让开关回到规则的实际状态
+static void on_tproxy_finished(V2RayManager *manager, gboolean success, const GError *error, gpointer user_data) {
+    GtkWidget *widget = GTK_WIDGET(user_data);
 
+    if (!success) {
         ui_show_error(
-            dialog->dialog,
+            gtk_widget_get_toplevel(widget),
             "配置透明代理失败: %s\n\n"
             "请确保:\n"
             "1. 已安装 pkexec\n"
@@ -156,27 +573,76 @@ static void on_tproxy_toggled(GtkSwitch *widget, gboolean state, gpointer user_d
             error ? error->message : "未知错误"
         );
 
-        if (error) {
-            g_error_free(error);
-        }
-
         /* 恢复开关状态，避免递归触发 */
-        g_signal_handlers_block_by_func(
-            widget,
-            G_CALLBACK(on_tproxy_toggled),
-            user_data
-        );
+        g_signal_handlers_block_matched(widget, G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+                                        G_CALLBACK(on_tproxy_toggled), NULL);
 
-        gtk_switch_set_active(widget, !state);
+        gtk_switch_set_active(GTK_SWITCH(widget), manager->tproxy_enabled);
 
-        g_signal_handlers_unblock_by_func(
-            widget,
-            G_CALLBACK(on_tproxy_toggled),
-            user_data
-        );
+        g_signal_handlers_unblock_matched(widget, G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+                                          G_CALLBACK(on_tproxy_toggled), NULL);
     }
+
+    g_object_unref(widget);
+}
+
+// 透明代理开关回调：脚本异步执行，等待 pkexec 认证时界面不会卡住
+static void on_tproxy_toggled(GtkSwitch *widget, gboolean state, gpointer user_data) {
+    V2RayDialog *dialog = (V2RayDialog*)user_data;
+
+    v2ray_manager_enable_tproxy_async(dialog->manager, state, on_tproxy_finished, g_object_ref(widget));
+}
+
+
+// FakeIP 模式开关回调
+static void on_fakeip_toggled(GtkToggleButton *button, gpointer user_data) {
+    V2RayDialog *dialog = (V2RayDialog*)user_data;
+    v2ray_manager_set_fakeip(dialog->manager, gtk_toggle_button_get_active(button));
 }
 
+// 连接复用设置
+static void on_mux_changed(GtkWidget *widget, gpointer user_data) {
+    (void)widget;
+    V2RayDialog *dialog = (V2RayDialog*)user_data;
+    gboolean enabled = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(dialog->mux_check));
+    int concurrency = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(dialog->mux_spin));
+    
+    gtk_widget_set_sensitive(dialog->mux_spin, enabled);
+    gtk_widget_set_sensitive(dialog->xudp_check, enabled);
+    v2ray_manager_set_mux(dialog->manager, enabled ? concurrency : 0,
+                          gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(dialog->xudp_check)));
+    update_status(dialog);
+}
+
+// 性能配置
+static void on_profile_changed(GtkComboBox *combo, gpointer user_data) {
+    V2RayDialog *dialog = (V2RayDialog*)user_data;
+    int active = gtk_combo_box_get_active(combo);
+    if (active < 0) return;
+    
+    v2ray_manager_set_profile(dialog->manager, (ProxyProfile)active);
+    update_status(dialog);
+}
+
+// 内核切换
+static void on_core_changed(GtkComboBox *combo, gpointer user_data) {
+    V2RayDialog *dialog = (V2RayDialog*)user_data;
+    const ProxyCoreBackend *backend = proxy_core_from_id(gtk_combo_box_get_active_id(combo));
+    const ProxyCoreBackend *current = v2ray_manager_get_backend(dialog->manager);
+    if (!backend || backend == current) {
+        return;
+    }
+    
+    GError *error = NULL;
+    if (!v2ray_manager_set_backend(dialog->manager, backend->type, &error)) {
+        ui_show_error(dialog->dialog, "切换内核失败\n\n%s", error->message);
+        g_error_free(error);
+        g_signal_handlers_block_by_func(combo, G_CALLBACK(on_core_changed), dialog);
+        gtk_combo_box_set_active_id(combo, current->id);
+        g_signal_handlers_unblock_by_func(combo, G_CALLBACK(on_core_changed), dialog);
+    }
+    update_status(dialog);
+}
 
 // 对话框关闭回调
 static void on_dialog_destroy(GtkWidget *widget, gpointer user_data) {
@@ -206,6 +672,7 @@ void v2ray_ui_show_config_dialog(GtkWindow *parent, V2RayManager *manager) {
     );
     gtk_window_set_default_size(GTK_WINDOW(dialog), 700, 500);
     dialog_data->dialog = dialog;
+    g_object_set_data(G_OBJECT(dialog), "manager", manager);
     
     GtkWidget *content = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
     gtk_container_set_border_width(GTK_CONTAINER(content), 10);
@@ -224,6 +691,10 @@ void v2ray_ui_show_config_dialog(GtkWindow *parent, V2RayManager *manager) {
                         "<span foreground='gray' weight='bold'>状态: 已停止</span>");
     gtk_box_pack_start(GTK_BOX(config_box), dialog_data->status_label, FALSE, FALSE, 0);
     
+    dialog_data->watchdog_label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(dialog_data->watchdog_label), 0);
+    gtk_box_pack_start(GTK_BOX(config_box), dialog_data->watchdog_label, FALSE, FALSE, 0);
+    
     // 节点输入
     GtkWidget *url_frame = gtk_frame_new("代理节点");
     gtk_box_pack_start(GTK_BOX(config_box), url_frame, FALSE, FALSE, 0);
@@ -259,6 +730,13 @@ void v2ray_ui_show_config_dialog(GtkWindow *parent, V2RayManager *manager) {
     g_signal_connect(dialog_data->start_button, "clicked", G_CALLBACK(on_start_clicked), dialog_data);
     gtk_box_pack_start(GTK_BOX(button_box), dialog_data->start_button, FALSE, FALSE, 0);
     
+    dialog_data->swap_button = gtk_button_new_with_label("切换节点");
+    gtk_widget_set_size_request(dialog_data->swap_button, 120, -1);
+    gtk_widget_set_sensitive(dialog_data->swap_button, FALSE);
+    gtk_widget_set_tooltip_text(dialog_data->swap_button, "运行中切换到输入框中的节点，现有连接不中断");
+    g_signal_connect(dialog_data->swap_button, "clicked", G_CALLBACK(on_swap_clicked), dialog_data);
+    gtk_box_pack_start(GTK_BOX(button_box), dialog_data->swap_button, FALSE, FALSE, 0);
+    
     dialog_data->stop_button = gtk_button_new_with_label("停止 V2Ray");
     gtk_widget_set_size_request(dialog_data->stop_button, 120, -1);
     gtk_widget_set_sensitive(dialog_data->stop_button, FALSE);
@@ -277,6 +755,70 @@ void v2ray_ui_show_config_dialog(GtkWindow *parent, V2RayManager *manager) {
     g_signal_connect(dialog_data->tproxy_switch, "state-set", G_CALLBACK(on_tproxy_toggled), dialog_data);
     gtk_box_pack_start(GTK_BOX(tproxy_box), dialog_data->tproxy_switch, FALSE, FALSE, 0);
     
+    // FakeIP 模式
+    dialog_data->fakeip_check = gtk_check_button_new_with_label("FakeIP 模式 (按域名分流，无需嗅探)");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(dialog_data->fakeip_check), manager->fakeip_enabled);
+    g_signal_connect(dialog_data->fakeip_check, "toggled", G_CALLBACK(on_fakeip_toggled), dialog_data);
+    gtk_box_pack_start(GTK_BOX(config_box), dialog_data->fakeip_check, FALSE, FALSE, 0);
+    
+    // 连接复用：短连接共用已建立的连接，省去握手；服务端需支持 Mux.Cool
+    GtkWidget *mux_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+    gtk_box_pack_start(GTK_BOX(config_box), mux_box, FALSE, FALSE, 0);
+    
+    gboolean mux_enabled = manager->mux_concurrency > 0;
+    dialog_data->mux_check = gtk_check_button_new_with_label("连接复用 (Mux)，并发数:");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(dialog_data->mux_check), mux_enabled);
+    gtk_box_pack_start(GTK_BOX(mux_box), dialog_data->mux_check, FALSE, FALSE, 0);
+    
+    dialog_data->mux_spin = gtk_spin_button_new_with_range(1, 128, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(dialog_data->mux_spin),
+                              mux_enabled ? manager->mux_concurrency : PROXY_MUX_DEFAULT_CONCURRENCY);
+    gtk_widget_set_sensitive(dialog_data->mux_spin, mux_enabled);
+    gtk_box_pack_start(GTK_BOX(mux_box), dialog_data->mux_spin, FALSE, FALSE, 0);
+    
+    dialog_data->xudp_check = gtk_check_button_new_with_label("UDP 使用 XUDP (Xray)");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(dialog_data->xudp_check), manager->xudp_enabled);
+    gtk_widget_set_sensitive(dialog_data->xudp_check, mux_enabled);
+    gtk_box_pack_start(GTK_BOX(mux_box), dialog_data->xudp_check, FALSE, FALSE, 0);
+    
+    g_signal_connect(dialog_data->mux_check, "toggled", G_CALLBACK(on_mux_changed), dialog_data);
+    g_signal_connect(dialog_data->mux_spin, "value-changed", G_CALLBACK(on_mux_changed), dialog_data);
+    g_signal_connect(dialog_data->xudp_check, "toggled", G_CALLBACK(on_mux_changed), dialog_data);
+    
+    // 性能配置：出站的 socket 选项和连接超时、缓冲区
+    GtkWidget *profile_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+    gtk_box_pack_start(GTK_BOX(config_box), profile_box, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(profile_box), gtk_label_new("性能配置:"), FALSE, FALSE, 0);
+    
+    dialog_data->profile_combo = gtk_combo_box_text_new();
+    for (int i = 0; i < PROXY_PROFILE_COUNT; i++) {
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(dialog_data->profile_combo),
+                                       proxy_parser_profile_to_string((ProxyProfile)i));
+    }
+    gtk_combo_box_set_active(GTK_COMBO_BOX(dialog_data->profile_combo), manager->profile);
+    g_signal_connect(dialog_data->profile_combo, "changed", G_CALLBACK(on_profile_changed), dialog_data);
+    gtk_box_pack_start(GTK_BOX(profile_box), dialog_data->profile_combo, FALSE, FALSE, 0);
+    
+    // 代理内核，未安装的内核也列出，启动时报告缺少二进制
+    GtkWidget *core_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+    gtk_box_pack_start(GTK_BOX(config_box), core_box, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(core_box), gtk_label_new("内核:"), FALSE, FALSE, 0);
+    
+    dialog_data->core_combo = gtk_combo_box_text_new();
+    for (int i = 0; i < PROXY_CORE_COUNT; i++) {
+        const ProxyCoreBackend *backend = proxy_core_get((ProxyCoreType)i);
+        char *binary = proxy_core_find_binary(backend);
+        char *label = binary ? g_strdup(backend->display_name)
+                             : g_strdup_printf("%s (未找到)", backend->display_name);
+        gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(dialog_data->core_combo), backend->id, label);
+        g_free(label);
+        g_free(binary);
+    }
+    gtk_combo_box_set_active_id(GTK_COMBO_BOX(dialog_data->core_combo),
+                                v2ray_manager_get_backend(manager)->id);
+    g_signal_connect(dialog_data->core_combo, "changed", G_CALLBACK(on_core_changed), dialog_data);
+    gtk_box_pack_start(GTK_BOX(core_box), dialog_data->core_combo, FALSE, FALSE, 0);
+    
     GtkWidget *tproxy_hint = gtk_label_new(NULL);
     gtk_label_set_markup(GTK_LABEL(tproxy_hint), 
                         "<small><i>需要 root 权限,启用后所有流量将自动分流</i></small>");
@@ -302,6 +844,63 @@ void v2ray_ui_show_config_dialog(GtkWindow *parent, V2RayManager *manager) {
     
     gtk_notebook_append_page(GTK_NOTEBOOK(notebook), config_box, gtk_label_new("节点配置"));
     
+    // === 标签页: 节点池 ===
+    GtkWidget *pool_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
+    gtk_container_set_border_width(GTK_CONTAINER(pool_box), 10);
+    
+    GtkWidget *pool_hint = gtk_label_new("每行一个节点链接，或粘贴 base64 订阅内容:");
+    gtk_label_set_xalign(GTK_LABEL(pool_hint), 0);
+    gtk_box_pack_start(GTK_BOX(pool_box), pool_hint, FALSE, FALSE, 0);
+    
+    GtkWidget *pool_input_scroll = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(pool_input_scroll),
+                                   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_widget_set_size_request(pool_input_scroll, -1, 80);
+    gtk_box_pack_start(GTK_BOX(pool_box), pool_input_scroll, FALSE, FALSE, 0);
+    
+    dialog_data->pool_view = gtk_text_view_new();
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(dialog_data->pool_view), TRUE);
+    gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(dialog_data->pool_view), GTK_WRAP_CHAR);
+    gtk_container_add(GTK_CONTAINER(pool_input_scroll), dialog_data->pool_view);
+    
+    GtkWidget *pool_buttons = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+    gtk_box_pack_start(GTK_BOX(pool_box), pool_buttons, FALSE, FALSE, 0);
+    
+    GtkWidget *pool_import_button = gtk_button_new_with_label("导入节点");
+    g_signal_connect(pool_import_button, "clicked", G_CALLBACK(on_pool_import_clicked), dialog_data);
+    gtk_box_pack_start(GTK_BOX(pool_buttons), pool_import_button, FALSE, FALSE, 0);
+    
+    GtkWidget *pool_file_button = gtk_button_new_with_label("从文件导入");
+    gtk_widget_set_tooltip_text(pool_file_button, "导入本地订阅文件（base64 或每行一个链接）");
+    g_signal_connect(pool_file_button, "clicked", G_CALLBACK(on_pool_import_file_clicked), dialog_data);
+    gtk_box_pack_start(GTK_BOX(pool_buttons), pool_file_button, FALSE, FALSE, 0);
+    
+    GtkWidget *pool_probe_button = gtk_button_new_with_label("测速");
+    g_signal_connect(pool_probe_button, "clicked", G_CALLBACK(on_pool_probe_clicked), dialog_data);
+    gtk_box_pack_start(GTK_BOX(pool_buttons), pool_probe_button, FALSE, FALSE, 0);
+    
+    GtkWidget *pool_use_button = gtk_button_new_with_label("使用节点池");
+    gtk_widget_set_tooltip_text(pool_use_button, "使用延迟最低的可用节点，节点失效时自动切换");
+    g_signal_connect(pool_use_button, "clicked", G_CALLBACK(on_pool_use_clicked), dialog_data);
+    gtk_box_pack_start(GTK_BOX(pool_buttons), pool_use_button, FALSE, FALSE, 0);
+    
+    GtkWidget *pool_clear_button = gtk_button_new_with_label("清空");
+    g_signal_connect(pool_clear_button, "clicked", G_CALLBACK(on_pool_clear_clicked), dialog_data);
+    gtk_box_pack_start(GTK_BOX(pool_buttons), pool_clear_button, FALSE, FALSE, 0);
+    
+    GtkWidget *pool_scroll = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(pool_scroll),
+                                   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_box_pack_start(GTK_BOX(pool_box), pool_scroll, TRUE, TRUE, 0);
+    
+    dialog_data->pool_label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(dialog_data->pool_label), 0);
+    gtk_label_set_yalign(GTK_LABEL(dialog_data->pool_label), 0);
+    gtk_label_set_selectable(GTK_LABEL(dialog_data->pool_label), TRUE);
+    gtk_container_add(GTK_CONTAINER(pool_scroll), dialog_data->pool_label);
+    
+    gtk_notebook_append_page(GTK_NOTEBOOK(notebook), pool_box, gtk_label_new("节点池"));
+    
     // === 标签页2: 运行日志 ===
     GtkWidget *log_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
     gtk_container_set_border_width(GTK_CONTAINER(log_box), 10);
@@ -316,10 +915,37 @@ void v2ray_ui_show_config_dialog(GtkWindow *parent, V2RayManager *manager) {
     gtk_text_view_set_monospace(GTK_TEXT_VIEW(dialog_data->log_view), TRUE);
     gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(dialog_data->log_view), GTK_WRAP_WORD_CHAR);
     dialog_data->log_buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(dialog_data->log_view));
+    
+    // 右重力标记始终停在文本末尾，用于自动滚动
+    GtkTextIter log_end;
+    gtk_text_buffer_get_end_iter(dialog_data->log_buffer, &log_end);
+    gtk_text_buffer_create_mark(dialog_data->log_buffer, "log-end", &log_end, FALSE);
+    gtk_text_buffer_create_tag(dialog_data->log_buffer, "stderr", "foreground", "red", NULL);
     gtk_container_add(GTK_CONTAINER(log_scroll), dialog_data->log_view);
     
     gtk_notebook_append_page(GTK_NOTEBOOK(notebook), log_box, gtk_label_new("运行日志"));
     
+    // === 标签页: 连接统计 ===
+    GtkWidget *stats_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
+    gtk_container_set_border_width(GTK_CONTAINER(stats_box), 10);
+    
+    GtkWidget *stats_scroll = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(stats_scroll),
+                                   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_box_pack_start(GTK_BOX(stats_box), stats_scroll, TRUE, TRUE, 0);
+    
+    dialog_data->stats_label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(dialog_data->stats_label), 0);
+    gtk_label_set_yalign(GTK_LABEL(dialog_data->stats_label), 0);
+    gtk_label_set_selectable(GTK_LABEL(dialog_data->stats_label), TRUE);
+    gtk_container_add(GTK_CONTAINER(stats_scroll), dialog_data->stats_label);
+    
+    GtkWidget *reset_stats_button = gtk_button_new_with_label("清空统计");
+    g_signal_connect(reset_stats_button, "clicked", G_CALLBACK(on_reset_stats_clicked), dialog_data);
+    gtk_box_pack_start(GTK_BOX(stats_box), reset_stats_button, FALSE, FALSE, 0);
+    
+    gtk_notebook_append_page(GTK_NOTEBOOK(notebook), stats_box, gtk_label_new("连接统计"));
+    
     // === 标签页3: 帮助信息 ===
     GtkWidget *help_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
     gtk_container_set_border_width(GTK_CONTAINER(help_box), 10);
@@ -379,6 +1005,10 @@ void v2ray_ui_show_config_dialog(GtkWindow *parent, V2RayManager *manager) {
     
     // ✅ 最后更新状态（此时所有控件已创建并可见）
     update_status(dialog_data);
+    update_pool_view(dialog_data);
+    
+    // 对话框打开期间定时刷新状态和日志
+    dialog_data->update_timer = g_timeout_add(1000, on_update_timer, dialog_data);
 }
 
 // 创建状态指示器
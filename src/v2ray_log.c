@@ -0,0 +1,327 @@
+#include "../include/v2ray_log.h"
+#include <stddef.h>
+#include <string.h>
+
+// 日志级别标记只会出现在行首时间戳之后
+#define V2RAY_LOG_LEVEL_SCAN_LEN 48
+
+static const char *tls_markers[] = {
+    "tls:", "x509:", "transport/internet/tls", "transport/internet/reality", NULL
+};
+
+static const char *dial_markers[] = {
+    "failed to dial", "failed to open connection", "failed to find an available destination",
+    "dial tcp", "dial udp", "connection refused", "i/o timeout", "no route to host",
+    "network is unreachable", NULL
+};
+
+static const char* find(const char *start, const char *end, const char *needle) {
+    return g_strstr_len(start, end - start, needle);
+}
+
+static gboolean contains_any(const char *start, const char *end, const char **needles) {
+    for (const char **needle = needles; *needle; needle++) {
+        if (find(start, end, *needle)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static void copy_field(char *dst, gsize size, const char *start, const char *stop) {
+    gsize n = MIN((gsize)(stop - start), size - 1);
+    memcpy(dst, start, n);
+    dst[n] = '\0';
+}
+
+// 解析 "tcp:host:port" / "udp:[v6]:port"，返回目的地址之后的位置，失败返回 NULL
+static const char* parse_destination(const char *p, const char *end, V2RayLogEvent *event) {
+    const char *colon = memchr(p, ':', end - p);
+    if (!colon || colon == p || colon - p >= (ptrdiff_t)sizeof(event->network)) {
+        return NULL;
+    }
+    copy_field(event->network, sizeof(event->network), p, colon);
+
+    const char *host = colon + 1;
+    const char *stop = host;
+
+    if (host < end && *host == '[') {
+        const char *close = memchr(host, ']', end - host);
+        if (!close) return NULL;
+        copy_field(event->destination, sizeof(event->destination), host + 1, close);
+        stop = close;
+        while (stop < end && *stop != ' ') stop++;
+        return stop;
+    }
+
+    while (stop < end && *stop != ' ') stop++;
+
+    // 去掉端口
+    const char *port = stop;
+    while (port > host && *port != ':') port--;
+    if (port == host) port = stop;
+
+    copy_field(event->destination, sizeof(event->destination), host, port);
+    return stop;
+}
+
+// 访问日志: "... accepted tcp:www.example.com:443 [tproxy-in -> proxy]"
+// 旧版本只有出站标签 "[proxy]"，v5 使用 ">>" 分隔
+static void parse_route(const char *p, const char *end, V2RayLogEvent *event) {
+    const char *open = memchr(p, '[', end - p);
+    if (!open) return;
+    const char *close = memchr(open, ']', end - open);
+    if (!close) return;
+
+    const char *arrow = find(open, close, " -> ");
+    if (!arrow) arrow = find(open, close, " >> ");
+
+    if (arrow) {
+        copy_field(event->inbound_tag, sizeof(event->inbound_tag), open + 1, arrow);
+        copy_field(event->outbound_tag, sizeof(event->outbound_tag), arrow + 4, close);
+    } else {
+        copy_field(event->outbound_tag, sizeof(event->outbound_tag), open + 1, close);
+    }
+}
+
+// 错误日志: "... [Warning] [123] proxy/freedom: failed to open connection to tcp:x.com:443 > ..."
+static gboolean parse_error_line(const char *line, const char *end, gboolean is_error, V2RayLogEvent *event) {
+    if (contains_any(line, end, tls_markers)) {
+        event->type = V2RAY_EVENT_TLS_ERROR;
+    } else if (contains_any(line, end, dial_markers)) {
+        event->type = V2RAY_EVENT_DIAL_FAILED;
+    } else if (is_error) {
+        event->type = V2RAY_EVENT_ERROR;
+    } else {
+        return FALSE;
+    }
+
+    const char *dest = find(line, end, " tcp:");
+    if (!dest) dest = find(line, end, " udp:");
+    if (dest) {
+        parse_destination(dest + 1, end, event);
+    }
+
+    return TRUE;
+}
+
+gboolean v2ray_log_parse_line(const char *line, gssize len, V2RayLogEvent *event) {
+    memset(event, 0, sizeof(*event));
+    if (!line) return FALSE;
+
+    const char *end = line + (len < 0 ? strlen(line) : (gsize)len);
+    const char *head_end = MIN(end, line + V2RAY_LOG_LEVEL_SCAN_LEN);
+
+    if (find(line, head_end, "[Error]")) {
+        return parse_error_line(line, end, TRUE, event);
+    }
+    if (find(line, head_end, "[Warning]")) {
+        return parse_error_line(line, end, FALSE, event);
+    }
+    if (find(line, head_end, "[Info]") || find(line, head_end, "[Debug]")) {
+        return FALSE;
+    }
+
+    const char *p = find(line, end, " accepted ");
+    if (p) {
+        event->type = V2RAY_EVENT_ACCEPTED;
+        p += strlen(" accepted ");
+        while (p < end && *p == ' ') p++;
+
+        const char *after = parse_destination(p, end, event);
+        parse_route(after ? after : p, end, event);
+        return TRUE;
+    }
+
+    if (find(line, end, " rejected ")) {
+        event->type = V2RAY_EVENT_REJECTED;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void counter_free(gpointer data) {
+    V2RayLogCounter *counter = (V2RayLogCounter*)data;
+    g_free(counter->key);
+    g_free(counter);
+}
+
+// 查找或创建计数器；表满时按 Space-Saving 替换计数最小的条目，新条目继承其计数作为上界
+static V2RayLogCounter* counter_lookup(GHashTable *table, const char *key, guint max_entries) {
+    V2RayLogCounter *counter = g_hash_table_lookup(table, key);
+    if (counter) return counter;
+
+    guint64 inherited = 0;
+    if (g_hash_table_size(table) >= max_entries) {
+        GHashTableIter iter;
+        gpointer value;
+        V2RayLogCounter *min = NULL;
+
+        g_hash_table_iter_init(&iter, table);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            V2RayLogCounter *candidate = (V2RayLogCounter*)value;
+            if (!min || candidate->connections < min->connections) {
+                min = candidate;
+            }
+        }
+
+        inherited = min->connections;
+        g_hash_table_remove(table, min->key);
+    }
+
+    counter = g_new0(V2RayLogCounter, 1);
+    counter->key = g_strdup(key);
+    counter->connections = inherited;
+    g_hash_table_insert(table, counter->key, counter);
+
+    return counter;
+}
+
+static V2RayLogBucket* window_bucket(V2RayLogStats *stats, gint64 now_us) {
+    gint64 second = now_us / G_USEC_PER_SEC;
+    V2RayLogBucket *bucket = &stats->window[second % V2RAY_LOG_WINDOW_SECONDS];
+
+    if (bucket->second != second) {
+        bucket->second = second;
+        bucket->accepted = 0;
+        bucket->failures = 0;
+    }
+
+    return bucket;
+}
+
+V2RayLogStats* v2ray_log_stats_new(void) {
+    V2RayLogStats *stats = g_new0(V2RayLogStats, 1);
+
+    stats->outbounds = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, counter_free);
+    stats->destinations = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, counter_free);
+
+    return stats;
+}
+
+void v2ray_log_stats_free(V2RayLogStats *stats) {
+    if (!stats) return;
+
+    g_hash_table_destroy(stats->outbounds);
+    g_hash_table_destroy(stats->destinations);
+    g_free(stats);
+}
+
+void v2ray_log_stats_reset(V2RayLogStats *stats) {
+    if (!stats) return;
+
+    stats->accepted = 0;
+    stats->rejected = 0;
+    stats->dial_failures = 0;
+    stats->tls_errors = 0;
+    stats->errors = 0;
+    g_hash_table_remove_all(stats->outbounds);
+    g_hash_table_remove_all(stats->destinations);
+    memset(stats->window, 0, sizeof(stats->window));
+}
+
+void v2ray_log_stats_add(V2RayLogStats *stats, const V2RayLogEvent *event, gint64 now_us) {
+    if (!stats || !event) return;
+
+    gboolean failure = FALSE;
+
+    switch (event->type) {
+        case V2RAY_EVENT_ACCEPTED:
+            stats->accepted++;
+            window_bucket(stats, now_us)->accepted++;
+            if (event->outbound_tag[0]) {
+                counter_lookup(stats->outbounds, event->outbound_tag, V2RAY_LOG_MAX_OUTBOUNDS)->connections++;
+            }
+            if (event->destination[0]) {
+                counter_lookup(stats->destinations, event->destination, V2RAY_LOG_MAX_DESTINATIONS)->connections++;
+            }
+            return;
+        case V2RAY_EVENT_REJECTED:
+            stats->rejected++;
+            return;
+        case V2RAY_EVENT_DIAL_FAILED:
+            stats->dial_failures++;
+            failure = TRUE;
+            break;
+        case V2RAY_EVENT_TLS_ERROR:
+            stats->tls_errors++;
+            failure = TRUE;
+            break;
+        case V2RAY_EVENT_ERROR:
+            stats->errors++;
+            break;
+        default:
+            return;
+    }
+
+    if (failure) {
+        window_bucket(stats, now_us)->failures++;
+        if (event->destination[0]) {
+            counter_lookup(stats->destinations, event->destination, V2RAY_LOG_MAX_DESTINATIONS)->failures++;
+        }
+    }
+}
+
+void v2ray_log_stats_feed(V2RayLogStats *stats, const char *line, gssize len, gint64 now_us) {
+    V2RayLogEvent event;
+
+    if (v2ray_log_parse_line(line, len, &event)) {
+        v2ray_log_stats_add(stats, &event, now_us);
+    }
+}
+
+double v2ray_log_stats_error_rate(V2RayLogStats *stats, guint seconds, gint64 now_us,
+                                  guint *accepted, guint *failures) {
+    guint total_accepted = 0;
+    guint total_failures = 0;
+
+    if (stats) {
+        gint64 now = now_us / G_USEC_PER_SEC;
+        seconds = MIN(seconds, V2RAY_LOG_WINDOW_SECONDS);
+
+        for (guint i = 0; i < seconds; i++) {
+            gint64 second = now - i;
+            V2RayLogBucket *bucket = &stats->window[second % V2RAY_LOG_WINDOW_SECONDS];
+            if (bucket->second == second) {
+                total_accepted += bucket->accepted;
+                total_failures += bucket->failures;
+            }
+        }
+    }
+
+    if (accepted) *accepted = total_accepted;
+    if (failures) *failures = total_failures;
+
+    guint total = total_accepted + total_failures;
+    return total > 0 ? (double)total_failures / total : 0.0;
+}
+
+static gint counter_compare_desc(gconstpointer a, gconstpointer b) {
+    const V2RayLogCounter *ca = *(V2RayLogCounter * const *)a;
+    const V2RayLogCounter *cb = *(V2RayLogCounter * const *)b;
+
+    if (ca->connections != cb->connections) {
+        return ca->connections > cb->connections ? -1 : 1;
+    }
+    return strcmp(ca->key, cb->key);
+}
+
+GPtrArray* v2ray_log_stats_top(GHashTable *table, guint limit) {
+    GPtrArray *result = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, table);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(result, value);
+    }
+
+    g_ptr_array_sort(result, counter_compare_desc);
+
+    if (limit > 0 && result->len > limit) {
+        g_ptr_array_set_size(result, limit);
+    }
+
+    return result;
+}
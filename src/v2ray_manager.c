@@ -1,4 +1,5 @@
 #include "../include/v2ray_manager.h"
+#include "../include/geo_assets.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,239 +7,1912 @@
 #include <signal.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <errno.h>
 #include <gio/gio.h>
+#include <glib-unix.h>
 
-#define V2RAY_BINARY_PATH "data/v2ray/v2ray"
 #define V2RAY_CONFIG_DIR ".config/ovpn-client/v2ray"
 #define V2RAY_CONFIG_FILE "config.json"
+#define V2RAY_CONFIG_FILE_ALT "config-b.json"
 #define V2RAY_LOG_FILE "/tmp/v2ray.log"
 #define TPROXY_SCRIPT_PATH "scripts/setup_tproxy.sh"
+// 放行开关：优先使用 make install-polkit 安装的 root 所有的副本，polkit 对其免认证
+#define TPROXY_GATE_INSTALLED_PATH "/usr/local/libexec/ovpn-client/tproxy_gate.sh"
+#define TPROXY_GATE_PATH "scripts/tproxy_gate.sh"
+#define TPROXY_GATE_EXIT_ABSENT 2   // 规则不存在
+#define TPROXY_GATE_EXIT_BYPASSED 3 // status: 门控链已清空
+#define PKEXEC_EXIT_NOT_AUTHORIZED 126
 #define DEFAULT_TPROXY_PORT 12345
 
-// 日志回调
-static gboolean log_watch_cb(GIOChannel *channel, GIOCondition condition, gpointer user_data) {
+// 看门狗参数
+#define WATCHDOG_PROBE_INTERVAL_MS 500
+#define WATCHDOG_MAX_PROBE_FAILURES 2
+#define WATCHDOG_STARTUP_GRACE_US (10 * G_USEC_PER_SEC)
+#define WATCHDOG_BACKOFF_BASE_MS 1000
+#define WATCHDOG_BACKOFF_MAX_MS 30000
+
+// 启动就绪探测：间隔从 READY_PROBE_MIN_MS 逐次加倍到 READY_PROBE_MAX_MS，
+// 超过 READY_TIMEOUT_US 仍未监听视为启动失败
+#define READY_PROBE_MIN_MS 20
+#define READY_PROBE_MAX_MS 500
+#define READY_TIMEOUT_US (15 * G_USEC_PER_SEC)
+
+// 输出管道单次读取大小和每次回调的最大读取次数
+#define V2RAY_OUTPUT_BUF_SIZE (64 * 1024)
+#define V2RAY_OUTPUT_MAX_READS 16
+
+// SIGTERM 后等待进程退出的时间，超时升级为 SIGKILL
+#define V2RAY_STOP_TIMEOUT_MS 5000
+
+// 退出程序时不再进入主循环，SIGTERM 后只等待这么久
+#define V2RAY_SHUTDOWN_GRACE_MS 500
+
+// 热切换参数
+#define SWAP_PROBE_INTERVAL_MS 50
+#define SWAP_READY_TIMEOUT_US (10 * G_USEC_PER_SEC)
+#define DRAIN_CHECK_INTERVAL_MS 1000
+#define DRAIN_TIMEOUT_US (120 * G_USEC_PER_SEC)
+
+// 统计 API 轮询间隔
+#define STATS_POLL_INTERVAL_MS 2000
+
+// 热切换中的 V2Ray 实例
+struct V2RayInstance {
+    V2RayManager *manager;      // 实例被丢弃后置 NULL，退出时自行释放
+    GPid pid;
+    int slot;
+    guint child_watch_id;
+    guint timer_id;             // 备用实例：就绪探测；排空实例：连接检查
+    guint kill_timer_id;
+    V2RayOutput *output;
+    gint64 start_time;
+    int idle_sockets;           // 无连接时的套接字数（仅监听套接字）
+};
+
+typedef struct V2RaySwapJob {
+    GPtrArray *configs;
+    V2RayCompletionFunc callback;
+    gpointer user_data;
+} V2RaySwapJob;
+
+static void watchdog_arm(V2RayManager *manager);
+static void watchdog_cancel(V2RayManager *manager);
+static void swap_abort(V2RayManager *manager);
+static void ready_cancel(V2RayManager *manager);
+static void stop_complete(V2RayManager *manager);
+static GError* start_failure_error(V2RayManager *manager, gint wait_status);
+
+// V2Ray 输出管道：非阻塞大块读取，在缓冲区内就地按行切分后写入日志缓冲区
+typedef struct {
+    V2RayManager *manager;
+    LogRingStream stream;
+    int fd;
+    guint source_id;
+    gsize used;                 // buf 中尚未凑成整行的字节数
+    char buf[V2RAY_OUTPUT_BUF_SIZE];
+} V2RayOutputPipe;
+
+struct V2RayOutput {
+    V2RayOutputPipe out;
+    V2RayOutputPipe err;
+};
+
+// 一行输出：写入日志缓冲区并更新连接统计
+static void output_line(V2RayOutputPipe *pipe, const char *line, gsize len) {
+    log_ring_append(pipe->manager->log_ring, pipe->stream, line, len);
+    v2ray_log_stats_feed(pipe->manager->log_stats, line, len, g_get_monotonic_time());
+}
+
+// 输出 buf 中的完整行；flush 时连同不完整的末尾一起输出
+static void output_emit_lines(V2RayOutputPipe *pipe, gboolean flush) {
+    char *start = pipe->buf;
+    char *end = pipe->buf + pipe->used;
+    char *newline;
+    
+    while ((newline = memchr(start, '\n', end - start)) != NULL) {
+        output_line(pipe, start, newline - start);
+        start = newline + 1;
+    }
+    
+    gsize rest = end - start;
+    
+    // 超长行占满缓冲区时强制切断，避免读取停滞
+    if (rest > 0 && (flush || rest == sizeof(pipe->buf))) {
+        output_line(pipe, start, rest);
+        rest = 0;
+    }
+    
+    if (rest > 0 && start != pipe->buf) {
+        memmove(pipe->buf, start, rest);
+    }
+    pipe->used = rest;
+}
+
+// 读取管道直到暂无数据；返回 FALSE 表示对端已关闭
+static gboolean output_read(V2RayOutputPipe *pipe, int max_reads) {
+    for (int i = 0; i < max_reads; i++) {
+        ssize_t n = read(pipe->fd, pipe->buf + pipe->used, sizeof(pipe->buf) - pipe->used);
+        
+        if (n > 0) {
+            pipe->used += n;
+            output_emit_lines(pipe, FALSE);
+            continue;
+        }
+        
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return TRUE;
+        }
+        
+        // EOF 或读取错误
+        output_emit_lines(pipe, TRUE);
+        return FALSE;
+    }
+    
+    return TRUE;
+}
+
+static void output_pipe_close(V2RayOutputPipe *pipe) {
+    if (pipe->source_id > 0) {
+        g_source_remove(pipe->source_id);
+        pipe->source_id = 0;
+    }
+    
+    if (pipe->fd >= 0) {
+        close(pipe->fd);
+        pipe->fd = -1;
+    }
+}
+
+static gboolean output_pipe_cb(gint fd, GIOCondition condition, gpointer user_data) {
+    (void)fd;
+    (void)condition;
+    V2RayOutputPipe *pipe = (V2RayOutputPipe*)user_data;
+    
+    // 每次最多读取若干块，避免输出洪峰独占主循环
+    if (output_read(pipe, V2RAY_OUTPUT_MAX_READS)) {
+        return G_SOURCE_CONTINUE;
+    }
+    
+    pipe->source_id = 0;
+    output_pipe_close(pipe);
+    return G_SOURCE_REMOVE;
+}
+
+static void output_pipe_init(V2RayOutputPipe *pipe, V2RayManager *manager, LogRingStream stream, int fd) {
+    pipe->manager = manager;
+    pipe->stream = stream;
+    pipe->fd = fd;
+    pipe->used = 0;
+    
+    g_unix_set_fd_nonblocking(fd, TRUE, NULL);
+    pipe->source_id = g_unix_fd_add(fd, G_IO_IN | G_IO_HUP | G_IO_ERR, output_pipe_cb, pipe);
+}
+
+static V2RayOutput* output_new(V2RayManager *manager, int stdout_fd, int stderr_fd) {
+    V2RayOutput *output = g_new0(V2RayOutput, 1);
+    
+    output_pipe_init(&output->out, manager, LOG_RING_STREAM_STDOUT, stdout_fd);
+    output_pipe_init(&output->err, manager, LOG_RING_STREAM_STDERR, stderr_fd);
+    
+    return output;
+}
+
+// 读完管道中剩余的输出（通常是进程退出前的错误信息）后关闭
+static void output_free(V2RayOutput **output) {
+    if (!*output) return;
+    
+    V2RayOutputPipe *pipes[] = { &(*output)->out, &(*output)->err };
+    for (guint i = 0; i < G_N_ELEMENTS(pipes); i++) {
+        if (pipes[i]->fd >= 0) {
+            output_read(pipes[i], V2RAY_OUTPUT_MAX_READS);
+            output_emit_lines(pipes[i], TRUE);
+        }
+        output_pipe_close(pipes[i]);
+    }
+    
+    g_free(*output);
+    *output = NULL;
+}
+
+// 异步操作等待者
+typedef struct {
+    V2RayCompletionFunc func;
+    gpointer user_data;
+} V2RayWaiter;
+
+// 延迟到主循环中执行的完成通知
+typedef struct {
+    V2RayManager *manager;
+    V2RayCompletionFunc func;
+    gpointer user_data;
+    gboolean success;
+    GError *error;
+} V2RayDeferredCompletion;
+
+static void add_waiter(GSList **list, V2RayCompletionFunc func, gpointer user_data) {
+    if (!func) return;
+    
+    V2RayWaiter *waiter = g_new0(V2RayWaiter, 1);
+    waiter->func = func;
+    waiter->user_data = user_data;
+    *list = g_slist_append(*list, waiter);
+}
+
+// 通知并清空等待者列表
+static void complete_waiters(V2RayManager *manager, GSList **list, gboolean success, const GError *error) {
+    GSList *waiters = *list;
+    *list = NULL;
+    
+    for (GSList *l = waiters; l; l = l->next) {
+        V2RayWaiter *waiter = l->data;
+        waiter->func(manager, success, error, waiter->user_data);
+    }
+    
+    g_slist_free_full(waiters, g_free);
+}
+
+static gboolean deferred_completion_cb(gpointer user_data) {
+    V2RayDeferredCompletion *completion = (V2RayDeferredCompletion*)user_data;
+    
+    completion->func(completion->manager, completion->success, completion->error, completion->user_data);
+    
+    if (completion->error) {
+        g_error_free(completion->error);
+    }
+    g_free(completion);
+    return G_SOURCE_REMOVE;
+}
+
+// 在下一次主循环迭代中调用回调，保证回调不会在发起函数内重入；接管 error
+static void complete_later(V2RayManager *manager, V2RayCompletionFunc func, gpointer user_data,
+                           gboolean success, GError *error) {
+    if (!func) {
+        if (error) g_error_free(error);
+        return;
+    }
+    
+    V2RayDeferredCompletion *completion = g_new0(V2RayDeferredCompletion, 1);
+    completion->manager = manager;
+    completion->func = func;
+    completion->user_data = user_data;
+    completion->success = success;
+    completion->error = error;
+    g_idle_add(deferred_completion_cb, completion);
+}
+
+// 停止日志监控
+static void stop_log_watch(V2RayManager *manager) {
+    output_free(&manager->output);
+}
+
+// 槽位对应的入站端口和配置文件
+static int slot_port(V2RayManager *manager, int slot) {
+    return manager->base_port + slot;
+}
+
+static int slot_dns_port(V2RayManager *manager, int slot) {
+    return manager->base_dns_port + slot;
+}
+
+static int slot_api_port(V2RayManager *manager, int slot) {
+    return manager->base_api_port + slot;
+}
+
+static char* slot_config_path(V2RayManager *manager, int slot) {
+    return g_build_filename(manager->config_dir, slot == 0 ? V2RAY_CONFIG_FILE : V2RAY_CONFIG_FILE_ALT, NULL);
+}
+
+// 放行开关的动作（bypass/resume/status）由 tproxy_gate.sh 执行，其余由 setup_tproxy.sh 执行
+static gboolean tproxy_is_gate_action(const char *action) {
+    return strcmp(action, "bypass") == 0 || strcmp(action, "resume") == 0 || strcmp(action, "status") == 0;
+}
+
+static const char* tproxy_script_path(const char *action) {
+    if (!tproxy_is_gate_action(action)) return TPROXY_SCRIPT_PATH;
+    return g_file_test(TPROXY_GATE_INSTALLED_PATH, G_FILE_TEST_EXISTS) ? TPROXY_GATE_INSTALLED_PATH
+                                                                        : TPROXY_GATE_PATH;
+}
+
+// 构造透明代理脚本参数（start/stop/switch，或放行开关的动作），返回的数组需用 g_strfreev 释放
+static char** build_tproxy_argv(V2RayManager *manager, const char *action, int slot) {
+    char **argv = g_new0(char*, 8);
+    argv[0] = g_strdup("pkexec");
+    argv[1] = g_strdup(tproxy_script_path(action));
+    argv[2] = g_strdup(action);
+    
+    // 放行开关不接受其他参数，才能安全地预授权
+    if (tproxy_is_gate_action(action)) {
+        return argv;
+    }
+    
+    argv[3] = g_strdup_printf("%d", slot_port(manager, slot));
+    
+    // 实例的配置启用了 FakeIP 时额外劫持 DNS 到其 DNS 入站；
+    // 跟随运行中的配置而不是当前选项，选项改变后实例重启前没有 DNS 入站
+    if (manager->slot_fakeip[slot]) {
+        argv[4] = g_strdup("fakeip");
+        argv[5] = g_strdup_printf("%d", slot_dns_port(manager, slot));
+        argv[6] = g_strdup(PROXY_FAKEIP_UPSTREAM_DNS);
+    }
+    
+    return argv;
+}
+
+// 异步透明代理任务
+typedef struct {
+    V2RayManager *manager;
+    const char *action;
+    void (*done)(V2RayManager *manager, gboolean success);
+    V2RayCompletionFunc callback;   // 调用方的完成回调，在 done 之后调用
+    gpointer user_data;
+} TProxyJob;
+
+// 按脚本的执行结果更新规则状态；返回动作是否达到目的
+static gboolean tproxy_update_rules(V2RayManager *manager, const char *action, gint wait_status) {
+    int code = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : -1;
+    
+    if (tproxy_is_gate_action(action) && code == TPROXY_GATE_EXIT_ABSENT) {
+        // 没有规则可放行也算放行成功；恢复则需要重新 start
+        manager->tproxy_rules = V2RAY_TPROXY_ABSENT;
+        return strcmp(action, "resume") != 0;
+    }
+    if (strcmp(action, "status") == 0 && code == TPROXY_GATE_EXIT_BYPASSED) {
+        manager->tproxy_rules = V2RAY_TPROXY_BYPASSED;
+        return TRUE;
+    }
+    if (code == PKEXEC_EXIT_NOT_AUTHORIZED) {
+        // 认证被取消，脚本没有运行，规则不变
+        return FALSE;
+    }
+    if (code != 0) {
+        // 脚本中途失败，规则可能只配置或撤除了一部分
+        manager->tproxy_rules = V2RAY_TPROXY_UNKNOWN;
+        return FALSE;
+    }
+    
+    if (strcmp(action, "start") == 0 || strcmp(action, "resume") == 0) {
+        manager->tproxy_rules = V2RAY_TPROXY_ACTIVE;
+        manager->tproxy_enabled = TRUE;
+        manager->tproxy_rearm = FALSE;
+    } else if (strcmp(action, "stop") == 0) {
+        manager->tproxy_rules = V2RAY_TPROXY_ABSENT;
+        manager->tproxy_enabled = FALSE;
+        manager->tproxy_rearm = FALSE;
+    } else if (strcmp(action, "bypass") == 0) {
+        manager->tproxy_rules = V2RAY_TPROXY_BYPASSED;
+    } else if (strcmp(action, "status") == 0) {
+        manager->tproxy_rules = V2RAY_TPROXY_ACTIVE;
+    }
+    return TRUE;
+}
+
+// 透明代理脚本异步执行完成
+static void tproxy_async_done_cb(GPid pid, gint wait_status, gpointer user_data) {
+    TProxyJob *job = (TProxyJob*)user_data;
+    
+    g_spawn_close_pid(pid);
+    
+    gboolean success = tproxy_update_rules(job->manager, job->action, wait_status);
+    GError *error = NULL;
+    if (!success) {
+        if (WIFEXITED(wait_status) && WEXITSTATUS(wait_status) == PKEXEC_EXIT_NOT_AUTHORIZED) {
+            error = g_error_new(G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED,
+                                "Authentication was cancelled or denied");
+        } else if (g_spawn_check_exit_status(wait_status, &error)) {
+            error = g_error_new(G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "TProxy rules not installed");
+        }
+        g_warning("Async TProxy %s failed: %s", job->action, error->message);
+    } else {
+        g_message("TProxy %s done (async)", job->action);
+    }
+    
+    if (job->done) {
+        job->done(job->manager, success);
+    }
+    if (job->callback) {
+        job->callback(job->manager, success, error, job->user_data);
+    }
+    if (error) {
+        g_error_free(error);
+    }
+    g_free(job);
+}
+
+// 异步执行透明代理脚本，不阻塞主线程；done 和 callback 在脚本结束（或无法执行）后调用
+static void spawn_tproxy_job(V2RayManager *manager, const char *action, int slot,
+                             void (*done)(V2RayManager *manager, gboolean success),
+                             V2RayCompletionFunc callback, gpointer user_data) {
+    const char *script = tproxy_script_path(action);
+    if (!g_file_test(script, G_FILE_TEST_EXISTS)) {
+        g_warning("TProxy script not found at %s", script);
+        if (done) done(manager, FALSE);
+        complete_later(manager, callback, user_data, FALSE,
+                       g_error_new(G_FILE_ERROR, G_FILE_ERROR_NOENT, "TProxy script not found at %s", script));
+        return;
+    }
+    
+    char **argv = build_tproxy_argv(manager, action, slot);
+    GPid pid;
+    GError *error = NULL;
+    
+    if (g_spawn_async(NULL, argv, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+                      NULL, NULL, &pid, &error)) {
+        TProxyJob *job = g_new0(TProxyJob, 1);
+        job->manager = manager;
+        job->action = action;
+        job->done = done;
+        job->callback = callback;
+        job->user_data = user_data;
+        g_child_watch_add(pid, tproxy_async_done_cb, job);
+    } else {
+        g_warning("Failed to spawn TProxy script: %s", error->message);
+        if (done) done(manager, FALSE);
+        complete_later(manager, callback, user_data, FALSE, error);
+    }
+    
+    g_strfreev(argv);
+}
+
+static void spawn_tproxy_async(V2RayManager *manager, const char *action, int slot,
+                               void (*done)(V2RayManager *manager, gboolean success)) {
+    spawn_tproxy_job(manager, action, slot, done, NULL, NULL);
+}
+
+// 放行流量：清空门控链，避免流量被导入已失效的端口
+// 放行开关经 polkit 预授权，不弹出认证，也不重建规则；只要规则可能存在就执行，
+// 不依赖界面开关（之前会话遗留的规则也会被放行）
+static void watchdog_fail_open(V2RayManager *manager) {
+    manager->watchdog_state = V2RAY_WATCHDOG_FAILED_OPEN;
+    
+    if (manager->tproxy_enabled) {
+        manager->tproxy_enabled = FALSE;
+        manager->tproxy_rearm = TRUE;
+    }
+    
+    if (manager->tproxy_rules == V2RAY_TPROXY_ACTIVE || manager->tproxy_rules == V2RAY_TPROXY_UNKNOWN) {
+        spawn_tproxy_async(manager, "bypass", manager->active_slot, NULL);
+    }
+}
+
+// 恢复透明代理：规则仍在时只需恢复门控链，否则重新配置
+static void tproxy_rearm(V2RayManager *manager, void (*done)(V2RayManager *manager, gboolean success)) {
+    const char *action = manager->tproxy_rules == V2RAY_TPROXY_BYPASSED ? "resume" : "start";
+    spawn_tproxy_async(manager, action, manager->active_slot, done);
+}
+
+// 退避后重启 V2Ray
+static gboolean watchdog_restart_cb(gpointer user_data) {
     V2RayManager *manager = (V2RayManager*)user_data;
+    manager->restart_timer_id = 0;
     
-    if (condition & G_IO_IN) {
-        gchar *line = NULL;
-        gsize length;
-        GError *error = NULL;
+    GError *error = NULL;
+    if (!v2ray_manager_start(manager, &error)) {
+        g_warning("Watchdog restart failed: %s", error ? error->message : "unknown error");
+        if (error) g_error_free(error);
+        
+        manager->restart_attempts++;
+        guint delay = WATCHDOG_BACKOFF_BASE_MS << MIN(manager->restart_attempts, 5);
+        manager->restart_timer_id = g_timeout_add(MIN(delay, WATCHDOG_BACKOFF_MAX_MS),
+                                                  watchdog_restart_cb, manager);
+        return G_SOURCE_REMOVE;
+    }
+    
+    manager->watchdog_state = V2RAY_WATCHDOG_RECOVERING;
+    return G_SOURCE_REMOVE;
+}
+
+// V2Ray 已失效：放行流量并安排重启
+static void watchdog_handle_failure(V2RayManager *manager) {
+    watchdog_fail_open(manager);
+    
+    guint delay = WATCHDOG_BACKOFF_BASE_MS << MIN(manager->restart_attempts, 5);
+    delay = MIN(delay, WATCHDOG_BACKOFF_MAX_MS);
+    manager->restart_attempts++;
+    
+    g_message("Watchdog: restarting V2Ray in %u ms (attempt %d)", delay, manager->restart_attempts);
+    manager->restart_timer_id = g_timeout_add(delay, watchdog_restart_cb, manager);
+}
+
+// V2Ray 子进程退出
+static void child_watch_cb(GPid pid, gint wait_status, gpointer user_data) {
+    V2RayManager *manager = (V2RayManager*)user_data;
+    
+    manager->child_watch_id = 0;
+    g_spawn_close_pid(pid);
+    
+    if (pid != manager->v2ray_pid) {
+        return;
+    }
+    
+    // 主动停止：进程已退出，完成停止流程
+    if (manager->status == V2RAY_STATUS_STOPPING) {
+        if (manager->kill_timer_id > 0) {
+            g_source_remove(manager->kill_timer_id);
+            manager->kill_timer_id = 0;
+        }
+        
+        manager->v2ray_pid = 0;
+        manager->last_exit_status = wait_status;
+        stop_log_watch(manager);
         
-        while (g_io_channel_read_line(channel, &line, &length, NULL, &error) == G_IO_STATUS_NORMAL) {
-            if (line) {
-                g_string_append(manager->log_buffer, line);
-                g_free(line);
+        g_message("V2Ray stopped");
+        stop_complete(manager);
+        return;
+    }
+    
+    // 启动阶段退出（多为配置错误）：通知等待启动的调用者，只有看门狗发起的重启才继续重试
+    if (manager->status == V2RAY_STATUS_STARTING) {
+        ready_cancel(manager);
+        
+        manager->v2ray_pid = 0;
+        manager->last_exit_status = wait_status;
+        manager->status = V2RAY_STATUS_ERROR;
+        
+        if (manager->health_timer_id > 0) {
+            g_source_remove(manager->health_timer_id);
+            manager->health_timer_id = 0;
+        }
+        stop_log_watch(manager);
+        
+        GError *error = start_failure_error(manager, wait_status);
+        g_warning("%s", error->message);
+        complete_waiters(manager, &manager->start_waiters, FALSE, error);
+        g_error_free(error);
+        
+        if (manager->restart_attempts > 0) {
+            watchdog_handle_failure(manager);
+        } else {
+            watchdog_cancel(manager);
+        }
+        return;
+    }
+    
+    g_warning("V2Ray (PID %d) exited unexpectedly, wait status %d", pid, wait_status);
+    
+    manager->v2ray_pid = 0;
+    manager->last_exit_status = wait_status;
+    manager->status = V2RAY_STATUS_ERROR;
+    
+    if (manager->health_timer_id > 0) {
+        g_source_remove(manager->health_timer_id);
+        manager->health_timer_id = 0;
+    }
+    stop_log_watch(manager);
+    
+    watchdog_handle_failure(manager);
+}
+
+// 周期性就绪探测
+static gboolean health_check_cb(gpointer user_data) {
+    V2RayManager *manager = (V2RayManager*)user_data;
+    
+    if (manager->status != V2RAY_STATUS_RUNNING || manager->v2ray_pid <= 0) {
+        return G_SOURCE_CONTINUE;
+    }
+    
+    if (manager->backend->is_ready(manager->local_port)) {
+        manager->probe_failures = 0;
+        manager->probe_seen_ready = TRUE;
+        
+        if (manager->watchdog_state != V2RAY_WATCHDOG_HEALTHY) {
+            if (manager->tproxy_rearm) {
+                tproxy_rearm(manager, NULL);
             }
+            manager->restart_attempts = 0;
+            manager->watchdog_state = V2RAY_WATCHDOG_HEALTHY;
         }
+        return G_SOURCE_CONTINUE;
+    }
+    
+    // 启动阶段端口尚未绑定，给予宽限期
+    if (!manager->probe_seen_ready &&
+        g_get_monotonic_time() - manager->spawn_time < WATCHDOG_STARTUP_GRACE_US) {
+        return G_SOURCE_CONTINUE;
+    }
+    
+    if (++manager->probe_failures < WATCHDOG_MAX_PROBE_FAILURES) {
+        return G_SOURCE_CONTINUE;
+    }
+    
+    // 进程仍在但入站端口失效：先放行流量，再强制结束，由 child watch 负责重启
+    g_warning("Watchdog: V2Ray inbound port %d not listening, killing PID %d",
+              manager->local_port, manager->v2ray_pid);
+    manager->health_timer_id = 0;
+    watchdog_fail_open(manager);
+    kill(manager->v2ray_pid, SIGKILL);
+    
+    return G_SOURCE_REMOVE;
+}
+
+// 开始监控 V2Ray 进程
+static void watchdog_arm(V2RayManager *manager) {
+    manager->probe_failures = 0;
+    manager->probe_seen_ready = FALSE;
+    manager->spawn_time = g_get_monotonic_time();
+    
+    if (manager->watchdog_state == V2RAY_WATCHDOG_IDLE) {
+        manager->watchdog_state = V2RAY_WATCHDOG_RECOVERING;
+    }
+    
+    manager->child_watch_id = g_child_watch_add(manager->v2ray_pid, child_watch_cb, manager);
+    manager->health_timer_id = g_timeout_add(WATCHDOG_PROBE_INTERVAL_MS, health_check_cb, manager);
+}
+
+// 停止监控（主动停止时调用）；child watch 保留，用于确认进程退出
+static void watchdog_cancel(V2RayManager *manager) {
+    ready_cancel(manager);
+    if (manager->health_timer_id > 0) {
+        g_source_remove(manager->health_timer_id);
+        manager->health_timer_id = 0;
+    }
+    if (manager->restart_timer_id > 0) {
+        g_source_remove(manager->restart_timer_id);
+        manager->restart_timer_id = 0;
+    }
+    
+    manager->restart_attempts = 0;
+    manager->tproxy_rearm = FALSE;
+    manager->watchdog_state = V2RAY_WATCHDOG_IDLE;
+}
+
+// 创建管理器
+V2RayManager* v2ray_manager_new(void) {
+    V2RayManager *manager = g_new0(V2RayManager, 1);
+    
+    manager->status = V2RAY_STATUS_STOPPED;
+    manager->v2ray_pid = 0;
+    manager->base_port = DEFAULT_TPROXY_PORT;
+    manager->base_dns_port = PROXY_FAKEIP_DEFAULT_DNS_PORT;
+    manager->active_slot = 0;
+    manager->local_port = manager->base_port;
+    manager->tproxy_enabled = FALSE;
+    manager->fakeip_enabled = FALSE;
+    
+    // 之前的会话可能遗留了规则；放行开关已预授权时查询一次，否则无法免认证确认，按不存在处理
+    if (g_file_test(TPROXY_GATE_INSTALLED_PATH, G_FILE_TEST_EXISTS)) {
+        manager->tproxy_rules = V2RAY_TPROXY_UNKNOWN;
+        spawn_tproxy_async(manager, "status", manager->active_slot, NULL);
+    } else {
+        manager->tproxy_rules = V2RAY_TPROXY_ABSENT;
+    }
+    manager->fakeip_pool_size = PROXY_FAKEIP_DEFAULT_POOL_SIZE;
+    manager->dns_port = manager->base_dns_port;
+    manager->watchdog_state = V2RAY_WATCHDOG_IDLE;
+    manager->ready_time_us = -1;
+    manager->log_ring = log_ring_new(V2RAY_LOG_DEFAULT_MAX_LINES, V2RAY_LOG_DEFAULT_MAX_BYTES);
+    manager->log_stats = v2ray_log_stats_new();
+    manager->base_api_port = PROXY_STATS_API_DEFAULT_PORT;
+    manager->api_port = manager->base_api_port;
+    manager->traffic = v2ray_traffic_table_new();
+    manager->stats_cancellable = g_cancellable_new();
+    manager->pool = proxy_pool_new();
+    
+    // 设置配置路径
+    const char *home = g_get_home_dir();
+    manager->config_dir = g_strdup_printf("%s/%s", home, V2RAY_CONFIG_DIR);
+    g_mkdir_with_parents(manager->config_dir, 0755);
+    
+    manager->config_path = slot_config_path(manager, manager->active_slot);
+    
+    // 默认使用 V2Ray 内核
+    manager->backend = proxy_core_get(PROXY_CORE_V2RAY);
+    manager->v2ray_binary = proxy_core_find_binary(manager->backend);
+    if (!manager->v2ray_binary) {
+        manager->v2ray_binary = g_strdup(manager->backend->binary_paths[0]);
+    }
+    manager->stats_xray_path = FALSE;
+    
+    return manager;
+}
+
+// 退出程序时终止 V2Ray：此时不能等待 pkexec 认证，也不再进入主循环。
+// 规则可能仍在时经预授权的放行开关放行（脚本独立运行，结束后不回调管理器），
+// 然后直接发送 SIGTERM，宽限期内未退出则 SIGKILL
+static void shutdown_process(V2RayManager *manager) {
+    swap_abort(manager);
+    watchdog_cancel(manager);
+    
+    if (manager->tproxy_rules == V2RAY_TPROXY_ACTIVE || manager->tproxy_rules == V2RAY_TPROXY_UNKNOWN) {
+        char **argv = build_tproxy_argv(manager, "bypass", manager->active_slot);
+        GError *error = NULL;
         
-        if (error) {
+        if (!g_spawn_async(NULL, argv, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL, NULL, &error)) {
+            g_warning("Failed to bypass TProxy rules on shutdown: %s", error->message);
             g_error_free(error);
         }
+        g_strfreev(argv);
+    }
+    
+    if (manager->child_watch_id > 0) {
+        g_source_remove(manager->child_watch_id);
+        manager->child_watch_id = 0;
     }
+    if (manager->kill_timer_id > 0) {
+        g_source_remove(manager->kill_timer_id);
+        manager->kill_timer_id = 0;
+    }
+    
+    if (manager->v2ray_pid > 0) {
+        GPid pid = manager->v2ray_pid;
+        gint64 deadline = g_get_monotonic_time() + V2RAY_SHUTDOWN_GRACE_MS * 1000;
+        
+        kill(pid, SIGTERM);
+        while (waitpid(pid, NULL, WNOHANG) == 0) {
+            if (g_get_monotonic_time() >= deadline) {
+                g_warning("V2Ray (PID %d) did not exit within %d ms, sending SIGKILL", pid, V2RAY_SHUTDOWN_GRACE_MS);
+                kill(pid, SIGKILL);
+                waitpid(pid, NULL, 0);
+                break;
+            }
+            g_usleep(10 * 1000);
+        }
+        g_spawn_close_pid(pid);
+        manager->v2ray_pid = 0;
+    }
+    stop_log_watch(manager);
+    manager->status = V2RAY_STATUS_STOPPED;
+    
+    GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED, "V2Ray manager is shutting down");
+    complete_waiters(manager, &manager->start_waiters, FALSE, error);
+    complete_waiters(manager, &manager->stop_waiters, FALSE, error);
+    g_error_free(error);
+}
+
+// 释放管理器
+void v2ray_manager_free(V2RayManager *manager) {
+    if (!manager) return;
+    
+    shutdown_process(manager);
+    
+    // 正在进行的统计查询在工作线程中结束，回调看到取消后不会再访问管理器
+    g_cancellable_cancel(manager->stats_cancellable);
+    g_object_unref(manager->stats_cancellable);
+    if (manager->stats_timer_id > 0) {
+        g_source_remove(manager->stats_timer_id);
+    }
+    
+    if (manager->current_configs) {
+        g_ptr_array_unref(manager->current_configs);
+    }
+    proxy_pool_free(manager->pool);
+    g_free(manager->pool_key);
+    
+    g_free(manager->config_dir);
+    g_free(manager->config_path);
+    g_free(manager->v2ray_binary);
+    proxy_route_rules_free(manager->route_rules);
+    log_ring_free(manager->log_ring);
+    v2ray_log_stats_free(manager->log_stats);
+    v2ray_traffic_table_free(manager->traffic);
+    g_free(manager);
+}
+
+static void slot_gen_options(V2RayManager *manager, int slot, ProxyGenOptions *opts) {
+    proxy_parser_gen_options_init(opts, slot_port(manager, slot));
+    opts->fakeip = manager->fakeip_enabled;
+    opts->fakeip_pool_size = manager->fakeip_pool_size;
+    opts->dns_port = slot_dns_port(manager, slot);
+    opts->api_port = manager->backend->stats_path ? slot_api_port(manager, slot) : 0;
+    opts->mux_concurrency = manager->mux_concurrency;
+    opts->xudp = manager->xudp_enabled;
+    opts->profile = manager->profile;
+    opts->routes = manager->route_rules;
+    opts->geo_lite = manager->geo_lite;
+    opts->xtls = manager->backend->xtls;
+}
+
+// 提取一个 geo 数据文件中分流规则用到的类别；未引用该文件时不处理
+static gboolean update_geo_file(V2RayManager *manager, const char *name, const char *lite_name,
+                                gboolean geosite, GError **error) {
+    char **codes = proxy_route_rules_geo_codes(manager->route_rules, geosite);
+    if (!codes) return TRUE;
+    
+    char *src = geo_assets_find_source(manager->v2ray_binary, manager->backend->asset_env, name);
+    char *dst = g_build_filename(manager->config_dir, lite_name, NULL);
+    gboolean ok = FALSE;
+    
+    if (!src) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "Geo data file %s not found", name);
+    } else {
+        ok = geo_assets_update(src, dst, (const char * const *)codes, error);
+    }
+    
+    g_free(src);
+    g_free(dst);
+    g_strfreev(codes);
+    return ok;
+}
+
+// 分流规则引用 geo 数据时，从完整的 geoip.dat / geosite.dat 提取所需类别到配置目录
+// 内核只需加载几百 KB 而不是几十 MB；找不到源文件或提取失败时仍引用完整文件
+static void update_geo_assets(V2RayManager *manager) {
+    const ProxyRouteRules *rules = manager->route_rules;
+    GError *error = NULL;
+    
+    manager->geo_lite = FALSE;
+    if (!manager->backend->asset_env) return;
+    if (rules && !rules->geoip_cn_direct && !rules->geosite_cn_direct && !rules->block_ads) return;
+    
+    if (update_geo_file(manager, "geoip.dat", PROXY_GEOIP_LITE_FILE, FALSE, &error) &&
+        update_geo_file(manager, "geosite.dat", PROXY_GEOSITE_LITE_FILE, TRUE, &error)) {
+        manager->geo_lite = TRUE;
+    } else {
+        g_warning("Failed to generate trimmed geo data, using full files: %s", error->message);
+        g_error_free(error);
+    }
+}
+
+// 配置写入指定槽位后的内容哈希
+static guint64 slot_config_hash(V2RayManager *manager, GPtrArray *configs, int slot) {
+    ProxyGenOptions opts;
+    slot_gen_options(manager, slot, &opts);
+    guint64 hash = proxy_parser_config_hash((ProxyConfig * const *)configs->pdata, configs->len, &opts);
+    
+    // 0 保留为"未知"
+    return hash != 0 ? hash : 1;
+}
+
+// 为指定槽位生成并写入配置文件；内容与文件中已有的相同时跳过，written 返回是否改写
+static gboolean write_slot_config(V2RayManager *manager, GPtrArray *configs, int slot,
+                                  gboolean *written, GError **error) {
+    update_geo_assets(manager);
+    
+    guint64 hash = slot_config_hash(manager, configs, slot);
+    char *path = slot_config_path(manager, slot);
+    
+    if (written) *written = FALSE;
+    
+    if (manager->slot_config_hash[slot] == hash && g_file_test(path, G_FILE_TEST_EXISTS)) {
+        g_debug("V2Ray config for slot %d unchanged, not rewriting %s", slot, path);
+        manager->slot_config_fakeip[slot] = manager->fakeip_enabled;
+        g_free(path);
+        return TRUE;
+    }
+    
+    ProxyGenOptions opts;
+    slot_gen_options(manager, slot, &opts);
+    
+    // 内核不支持 XTLS 时跳过需要 XTLS Vision/REALITY 的节点，降级为普通 TLS 也连不上
+    GPtrArray *usable = g_ptr_array_sized_new(configs->len);
+    for (guint i = 0; i < configs->len; i++) {
+        ProxyConfig *config = g_ptr_array_index(configs, i);
+        if (!opts.xtls && proxy_parser_needs_xtls(config)) {
+            g_warning("%s does not support XTLS Vision/REALITY, skipping node %s; use Xray or sing-box",
+                      manager->backend->display_name, config->name);
+            continue;
+        }
+        g_ptr_array_add(usable, config);
+    }
+    
+    if (usable->len == 0) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                    "%s does not support XTLS Vision/REALITY used by the selected nodes; use Xray or sing-box",
+                    manager->backend->display_name);
+        g_ptr_array_unref(usable);
+        g_free(path);
+        return FALSE;
+    }
+    
+    char *json_config = manager->backend->generate_config((ProxyConfig * const *)usable->pdata,
+                                                          usable->len, &opts);
+    g_ptr_array_unref(usable);
+    if (!json_config) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Failed to generate %s config",
+                    manager->backend->display_name);
+        g_free(path);
+        return FALSE;
+    }
+    
+    // 写入失败时文件内容未知
+    manager->slot_config_hash[slot] = 0;
+    gboolean ok = g_file_set_contents(path, json_config, -1, error);
+    if (ok) {
+        manager->slot_config_hash[slot] = hash;
+        manager->slot_config_fakeip[slot] = opts.fakeip;
+        if (written) *written = TRUE;
+    }
+    
+    g_free(path);
+    g_free(json_config);
+    return ok;
+}
+
+// 单个节点包装为配置数组
+static GPtrArray* single_config(ProxyConfig *config) {
+    GPtrArray *configs = g_ptr_array_new_with_free_func((GDestroyNotify)proxy_parser_free);
+    g_ptr_array_add(configs, config);
+    return configs;
+}
+
+// 设置配置
+gboolean v2ray_manager_set_config(V2RayManager *manager, ProxyConfig *config) {
+    if (!manager || !config) return FALSE;
+    
+    manager->pool_active = FALSE;
+    return v2ray_manager_set_configs(manager, single_config(config));
+}
+
+gboolean v2ray_manager_set_configs(V2RayManager *manager, GPtrArray *configs) {
+    if (!manager || !configs) return FALSE;
+    
+    if (configs->len == 0) {
+        g_ptr_array_unref(configs);
+        return FALSE;
+    }
+    
+    // 释放旧配置
+    if (manager->current_configs) {
+        g_ptr_array_unref(manager->current_configs);
+    }
+    
+    manager->current_configs = configs;
+    
+    // 生成 V2Ray 配置文件；运行中的实例不会重新读取，改写后需要重启才生效
+    GError *error = NULL;
+    gboolean written = FALSE;
+    if (!write_slot_config(manager, configs, manager->active_slot, &written, &error)) {
+        g_warning("Failed to write V2Ray config: %s", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+    
+    if (written && (manager->status == V2RAY_STATUS_RUNNING || manager->status == V2RAY_STATUS_STARTING)) {
+        manager->restart_needed = TRUE;
+    }
+    
+    return TRUE;
+}
+
+// 生成选项变化后改写运行中实例的配置，重启后生效；停止状态下启动时会重新生成配置
+static void rewrite_running_config(V2RayManager *manager) {
+    if (!manager->current_configs ||
+        (manager->status != V2RAY_STATUS_RUNNING && manager->status != V2RAY_STATUS_STARTING)) {
+        return;
+    }
+    
+    GError *error = NULL;
+    gboolean written = FALSE;
+    if (!write_slot_config(manager, manager->current_configs, manager->active_slot, &written, &error)) {
+        g_warning("Failed to write V2Ray config: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+    if (written) {
+        manager->restart_needed = TRUE;
+    }
+}
+
+void v2ray_manager_set_mux(V2RayManager *manager, int concurrency, gboolean xudp) {
+    if (!manager) return;
+    
+    manager->mux_concurrency = CLAMP(concurrency, 0, 1024);
+    manager->xudp_enabled = xudp;
+    rewrite_running_config(manager);
+}
+
+void v2ray_manager_set_profile(V2RayManager *manager, ProxyProfile profile) {
+    if (!manager || (guint)profile >= PROXY_PROFILE_COUNT) return;
+    
+    manager->profile = profile;
+    rewrite_running_config(manager);
+}
+
+void v2ray_manager_set_route_rules(V2RayManager *manager, ProxyRouteRules *rules) {
+    if (!manager) {
+        proxy_route_rules_free(rules);
+        return;
+    }
+    
+    proxy_route_rules_free(manager->route_rules);
+    manager->route_rules = rules;
+    rewrite_running_config(manager);
+}
+
+gboolean v2ray_manager_set_backend(V2RayManager *manager, ProxyCoreType type, GError **error) {
+    if (!manager) return FALSE;
+    
+    const ProxyCoreBackend *backend = proxy_core_get(type);
+    if (backend == manager->backend) {
+        return TRUE;
+    }
+    
+    if (manager->status != V2RAY_STATUS_STOPPED && manager->status != V2RAY_STATUS_ERROR) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_BUSY, "Stop %s before switching core",
+                    manager->backend->display_name);
+        return FALSE;
+    }
+    
+    char *binary = proxy_core_find_binary(backend);
+    if (!binary) {
+        binary = g_strdup(backend->binary_paths[0]);
+    }
+    
+    g_free(manager->v2ray_binary);
+    manager->v2ray_binary = binary;
+    manager->backend = backend;
+    manager->stats_xray_path = (backend->type == PROXY_CORE_XRAY);
+    
+    // 配置格式随内核变化，旧的内容哈希不再有效
+    manager->slot_config_hash[0] = 0;
+    manager->slot_config_hash[1] = 0;
+    
+    if (manager->current_configs) {
+        gboolean written = FALSE;
+        if (!write_slot_config(manager, manager->current_configs, manager->active_slot, &written, error)) {
+            return FALSE;
+        }
+    }
+    
+    g_message("Proxy core switched to %s (%s)", backend->display_name, manager->v2ray_binary);
+    return TRUE;
+}
+
+const ProxyCoreBackend* v2ray_manager_get_backend(V2RayManager *manager) {
+    return manager ? manager->backend : proxy_core_get(PROXY_CORE_V2RAY);
+}
+
+gboolean v2ray_manager_needs_restart(V2RayManager *manager) {
+    return manager && manager->restart_needed;
+}
+
+// 用槽位的配置文件启动 V2Ray 进程并监控其日志输出
+static gboolean spawn_v2ray_process(V2RayManager *manager, int slot, GPid *pid,
+                                    V2RayOutput **output, GError **error) {
+    char *config_path = slot_config_path(manager, slot);
+    char **argv = manager->backend->build_argv(manager->v2ray_binary, config_path);
+    g_free(config_path);
+    
+    GSpawnFlags flags = G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_SEARCH_PATH;
+    gint stdout_fd, stderr_fd;
+    
+    // 配置以 ext: 引用精简 geo 数据时，内核的资源目录指向配置目录
+    char **envp = NULL;
+    if (manager->geo_lite) {
+        envp = g_environ_setenv(g_get_environ(), manager->backend->asset_env, manager->config_dir, TRUE);
+    }
+    
+    gboolean spawned = g_spawn_async_with_pipes(NULL, argv, envp, flags, NULL, NULL,
+                                                pid, NULL, &stdout_fd, &stderr_fd, error);
+    g_strfreev(argv);
+    g_strfreev(envp);
+    if (!spawned) {
+        return FALSE;
+    }
+    
+    manager->slot_fakeip[slot] = manager->slot_config_fakeip[slot];
+    
+    // stdout 和 stderr 都必须持续读取，否则管道写满后 V2Ray 会阻塞在日志输出上
+    *output = output_new(manager, stdout_fd, stderr_fd);
+    
+    return TRUE;
+}
+
+static void stats_query_done_cb(GObject *source, GAsyncResult *result, gpointer user_data) {
+    GError *error = NULL;
+    GPtrArray *stats = v2ray_stats_query_finish(result, &error);
+    
+    (void)source;
+    
+    // 管理器可能已释放
+    if (g_cancellable_is_cancelled(g_task_get_cancellable(G_TASK(result)))) {
+        if (stats) g_ptr_array_unref(stats);
+        g_clear_error(&error);
+        return;
+    }
+    
+    V2RayManager *manager = (V2RayManager*)user_data;
+    manager->stats_in_flight = FALSE;
+    
+    if (!stats) {
+        // 两种实现的 proto 包名不同，路径不存在时换另一个
+        if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+            manager->stats_xray_path = !manager->stats_xray_path;
+        }
+        g_debug("V2Ray stats query failed: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+    
+    v2ray_traffic_table_update(manager->traffic, stats, g_get_monotonic_time());
+    g_ptr_array_unref(stats);
+}
+
+// 定期查询统计 API，V2Ray 不再运行时停止
+static gboolean stats_poll_cb(gpointer user_data) {
+    V2RayManager *manager = (V2RayManager*)user_data;
+    
+    if (manager->status != V2RAY_STATUS_RUNNING) {
+        manager->stats_timer_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+    
+    // 上一次查询还没返回（最多阻塞 V2RAY_STATS_TIMEOUT_MS）
+    if (manager->stats_in_flight) {
+        return G_SOURCE_CONTINUE;
+    }
+    
+    manager->stats_in_flight = TRUE;
+    v2ray_stats_query_async(manager->api_port,
+                            manager->stats_xray_path ? V2RAY_STATS_PATH_XRAY : V2RAY_STATS_PATH_V2RAY,
+                            manager->stats_cancellable, stats_query_done_cb, manager);
+    
+    return G_SOURCE_CONTINUE;
+}
+
+static void stats_poll_arm(V2RayManager *manager) {
+    if (manager->stats_timer_id == 0 && manager->backend->stats_path) {
+        manager->stats_timer_id = g_timeout_add(STATS_POLL_INTERVAL_MS, stats_poll_cb, manager);
+    }
+}
+
+static void ready_cancel(V2RayManager *manager) {
+    if (manager->ready_timer_id > 0) {
+        g_source_remove(manager->ready_timer_id);
+        manager->ready_timer_id = 0;
+    }
+}
+
+typedef struct {
+    const char *found;
+    char *reason;
+} StartFailureScan;
+
+// 本次启动的日志中最后一行错误，没有则取最后一行
+static void start_failure_scan_cb(const LogRingEntry *entry, gpointer user_data) {
+    StartFailureScan *scan = (StartFailureScan*)user_data;
+    gboolean is_error = g_strstr_len(entry->text, entry->len, "Failed") ||
+                        g_strstr_len(entry->text, entry->len, "failed") ||
+                        g_strstr_len(entry->text, entry->len, "[Error]");
+    
+    if (is_error || !scan->found) {
+        g_free(scan->reason);
+        scan->reason = g_strndup(entry->text, entry->len);
+        if (is_error) scan->found = scan->reason;
+    }
+}
+
+static GError* start_failure_error(V2RayManager *manager, gint wait_status) {
+    StartFailureScan scan = { NULL, NULL };
+    log_ring_foreach(manager->log_ring, manager->ready_log_seq, start_failure_scan_cb, &scan);
+    
+    GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED,
+                                "V2Ray exited during startup (wait status %d)%s%s", wait_status,
+                                scan.reason ? ": " : "", scan.reason ? scan.reason : "");
+    g_free(scan.reason);
+    return error;
+}
+
+// 入站端口已监听：进入 RUNNING，此时再把流量导入 V2Ray
+// 启动后的透明代理配置完成；V2Ray 已在运行，规则配置失败不影响启动结果
+static void start_tproxy_done(V2RayManager *manager, gboolean success) {
+    if (manager->status != V2RAY_STATUS_RUNNING) {
+        // 脚本执行期间已被停止，撤除刚配置的规则
+        if (success) {
+            spawn_tproxy_async(manager, "stop", manager->active_slot, NULL);
+        }
+        return;
+    }
+    
+    if (!success) {
+        g_warning("V2Ray started without transparent proxy");
+    }
+    complete_waiters(manager, &manager->start_waiters, TRUE, NULL);
+}
+
+static void start_ready(V2RayManager *manager) {
+    manager->ready_time_us = g_get_monotonic_time() - manager->spawn_time;
+    manager->status = V2RAY_STATUS_RUNNING;
+    manager->probe_seen_ready = TRUE;
+    
+    g_message("V2Ray ready on port %d after %" G_GINT64_FORMAT " ms",
+              manager->local_port, manager->ready_time_us / 1000);
+    
+    stats_poll_arm(manager);
+    
+    // 透明代理脚本异步执行（可能等待 pkexec 认证），完成后再通知等待者
+    if (manager->tproxy_enabled) {
+        manager->tproxy_enabled = FALSE;
+        spawn_tproxy_async(manager, "start", manager->active_slot, start_tproxy_done);
+        return;
+    }
+    
+    complete_waiters(manager, &manager->start_waiters, TRUE, NULL);
+}
+
+// 就绪探测：端口通常在几十毫秒内开始监听，先密后疏
+static gboolean ready_probe_cb(gpointer user_data) {
+    V2RayManager *manager = (V2RayManager*)user_data;
+    manager->ready_timer_id = 0;
+    
+    if (manager->status != V2RAY_STATUS_STARTING || manager->v2ray_pid <= 0) {
+        return G_SOURCE_REMOVE;
+    }
+    
+    if (manager->backend->is_ready(manager->local_port)) {
+        start_ready(manager);
+        return G_SOURCE_REMOVE;
+    }
+    
+    // 超时：通知等待者后结束进程，由 child watch 收尾
+    if (g_get_monotonic_time() - manager->spawn_time >= READY_TIMEOUT_US) {
+        GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                                    "V2Ray did not listen on port %d within %d s",
+                                    manager->local_port, (int)(READY_TIMEOUT_US / G_USEC_PER_SEC));
+        g_warning("%s, killing PID %d", error->message, manager->v2ray_pid);
+        complete_waiters(manager, &manager->start_waiters, FALSE, error);
+        g_error_free(error);
+        
+        kill(manager->v2ray_pid, SIGKILL);
+        return G_SOURCE_REMOVE;
+    }
+    
+    manager->ready_interval_ms = MIN(manager->ready_interval_ms * 2, READY_PROBE_MAX_MS);
+    manager->ready_timer_id = g_timeout_add(manager->ready_interval_ms, ready_probe_cb, manager);
+    return G_SOURCE_REMOVE;
+}
+
+// 启动 V2Ray
+gboolean v2ray_manager_start(V2RayManager *manager, GError **error) {
+    if (!manager) return FALSE;
+    
+    if (manager->status == V2RAY_STATUS_RUNNING || manager->status == V2RAY_STATUS_STARTING) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "V2Ray is already running");
+        return FALSE;
+    }
+    
+    if (manager->status == V2RAY_STATUS_STOPPING) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_AGAIN, "V2Ray is still stopping");
+        return FALSE;
+    }
+    
+    // 检查二进制文件
+    if (!g_file_test(manager->v2ray_binary, G_FILE_TEST_EXISTS)) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT, 
+                   "%s binary not found at %s", manager->backend->display_name, manager->v2ray_binary);
+        return FALSE;
+    }
+    
+    // 停止期间选项可能已改变，按当前选项重新生成配置（内容未变时不改写）
+    if (manager->current_configs &&
+        !write_slot_config(manager, manager->current_configs, manager->active_slot, NULL, error)) {
+        return FALSE;
+    }
+    
+    // 检查配置文件
+    if (!g_file_test(manager->config_path, G_FILE_TEST_EXISTS)) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT, 
+                   "V2Ray config not found. Please set a proxy first.");
+        return FALSE;
+    }
+    
+    manager->status = V2RAY_STATUS_STARTING;
+    manager->restart_needed = FALSE;
+    manager->ready_time_us = -1;
+    manager->ready_log_seq = manager->log_ring->next_seq;
     
-    if (condition & (G_IO_HUP | G_IO_ERR)) {
+    // 启动 V2Ray 进程，监控日志输出
+    if (!spawn_v2ray_process(manager, manager->active_slot, &manager->v2ray_pid,
+                             &manager->output, error)) {
+        manager->status = V2RAY_STATUS_ERROR;
         return FALSE;
     }
     
+    g_message("V2Ray started with PID %d, waiting for port %d", manager->v2ray_pid, manager->local_port);
+    
+    // 监控子进程退出；V2Ray 解析配置、绑定入站端口之前不导入流量，
+    // 否则这段时间的连接都会被重置
+    watchdog_arm(manager);
+    manager->ready_interval_ms = READY_PROBE_MIN_MS;
+    manager->ready_timer_id = g_timeout_add(manager->ready_interval_ms, ready_probe_cb, manager);
+    
     return TRUE;
 }
 
-// 创建管理器
-V2RayManager* v2ray_manager_new(void) {
-    V2RayManager *manager = g_new0(V2RayManager, 1);
+// 停止超时：升级为 SIGKILL
+static gboolean stop_timeout_cb(gpointer user_data) {
+    V2RayManager *manager = (V2RayManager*)user_data;
+    manager->kill_timer_id = 0;
+    
+    if (manager->v2ray_pid > 0) {
+        g_warning("V2Ray (PID %d) did not exit within %d ms, sending SIGKILL",
+                  manager->v2ray_pid, V2RAY_STOP_TIMEOUT_MS);
+        kill(manager->v2ray_pid, SIGKILL);
+    }
     
+    return G_SOURCE_REMOVE;
+}
+
+// 通知等待停止的调用者；透明代理规则未能撤除时以错误结束，由调用者提示用户
+static void stop_complete(V2RayManager *manager) {
     manager->status = V2RAY_STATUS_STOPPED;
-    manager->v2ray_pid = 0;
-    manager->local_port = DEFAULT_TPROXY_PORT;
-    manager->tproxy_enabled = FALSE;
-    manager->log_buffer = g_string_new("");
     
-    // 设置配置路径
-    const char *home = g_get_home_dir();
-    char config_dir[1024];
-    snprintf(config_dir, sizeof(config_dir), "%s/%s", home, V2RAY_CONFIG_DIR);
-    g_mkdir_with_parents(config_dir, 0755);
+    if (manager->tproxy_rules == V2RAY_TPROXY_ABSENT) {
+        complete_waiters(manager, &manager->stop_waiters, TRUE, NULL);
+        return;
+    }
+    
+    GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED,
+                                manager->tproxy_rules == V2RAY_TPROXY_BYPASSED
+                                    ? "V2Ray stopped, but TProxy rules could not be removed (traffic is bypassed)"
+                                    : "V2Ray stopped, but TProxy rules could not be removed");
+    complete_waiters(manager, &manager->stop_waiters, FALSE, error);
+    g_error_free(error);
+}
+
+// 向进程发送 SIGTERM
+static void stop_send_sigterm(V2RayManager *manager, gboolean bypass_ok) {
+    (void)bypass_ok;
     
-    manager->config_path = g_strdup_printf("%s/%s", config_dir, V2RAY_CONFIG_FILE);
+    if (manager->status != V2RAY_STATUS_STOPPING) {
+        return;
+    }
     
-    // 设置 V2Ray 二进制路径
-    manager->v2ray_binary = g_strdup(V2RAY_BINARY_PATH);
+    if (manager->v2ray_pid <= 0) {
+        stop_complete(manager);
+        return;
+    }
     
-    return manager;
+    kill(manager->v2ray_pid, SIGTERM);
+    manager->kill_timer_id = g_timeout_add(V2RAY_STOP_TIMEOUT_MS, stop_timeout_cb, manager);
 }
 
-// 释放管理器
-void v2ray_manager_free(V2RayManager *manager) {
+// 透明代理撤除结束后终止进程；撤除失败（如认证被取消）时规则可能仍把流量导入即将退出的端口，
+// 先经预授权的放行开关放行，与看门狗的处理相同
+static void stop_terminate_process(V2RayManager *manager, gboolean tproxy_ok) {
+    if (manager->status != V2RAY_STATUS_STOPPING) {
+        return;
+    }
+    
+    if (!tproxy_ok &&
+        (manager->tproxy_rules == V2RAY_TPROXY_ACTIVE || manager->tproxy_rules == V2RAY_TPROXY_UNKNOWN)) {
+        g_warning("TProxy rules could not be removed, bypassing them before stopping V2Ray");
+        spawn_tproxy_async(manager, "bypass", manager->active_slot, stop_send_sigterm);
+        return;
+    }
+    
+    stop_send_sigterm(manager, TRUE);
+}
+
+// 异步停止 V2Ray
+void v2ray_manager_stop_async(V2RayManager *manager, V2RayCompletionFunc callback, gpointer user_data) {
     if (!manager) return;
     
-    v2ray_manager_stop(manager);
+    // 已在停止中：等待同一次停止完成
+    if (manager->status == V2RAY_STATUS_STOPPING) {
+        add_waiter(&manager->stop_waiters, callback, user_data);
+        return;
+    }
+    
+    // 放弃进行中的热切换，结束备用/排空实例
+    swap_abort(manager);
+    
+    // 主动停止：取消看门狗（包括等待中的自动重启）
+    gboolean was_recovering = manager->restart_timer_id > 0;
+    watchdog_cancel(manager);
     
-    if (manager->current_config) {
-        proxy_parser_free(manager->current_config);
+    if (manager->status != V2RAY_STATUS_RUNNING && manager->status != V2RAY_STATUS_STARTING) {
+        if (was_recovering) {
+            manager->status = V2RAY_STATUS_STOPPED;
+        }
+        complete_later(manager, callback, user_data, TRUE, NULL);
+        return;
     }
     
-    g_free(manager->config_path);
-    g_free(manager->v2ray_binary);
-    g_string_free(manager->log_buffer, TRUE);
-    g_free(manager);
+    if (manager->start_waiters) {
+        GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED, "V2Ray was stopped before it became ready");
+        complete_waiters(manager, &manager->start_waiters, FALSE, error);
+        g_error_free(error);
+    }
+    
+    manager->status = V2RAY_STATUS_STOPPING;
+    add_waiter(&manager->stop_waiters, callback, user_data);
+    
+    // 先撤除透明代理，避免进程退出后流量进入失效端口；按规则的实际状态判断，放行中的规则也一并撤除
+    manager->tproxy_enabled = FALSE;
+    if (manager->tproxy_rules != V2RAY_TPROXY_ABSENT) {
+        spawn_tproxy_async(manager, "stop", manager->active_slot, stop_terminate_process);
+    } else {
+        stop_terminate_process(manager, TRUE);
+    }
 }
 
-// 设置配置
-gboolean v2ray_manager_set_config(V2RayManager *manager, ProxyConfig *config) {
-    if (!manager || !config) return FALSE;
+// 异步启动 V2Ray
+void v2ray_manager_start_async(V2RayManager *manager, V2RayCompletionFunc callback, gpointer user_data) {
+    if (!manager) return;
     
-    // 释放旧配置
-    if (manager->current_config) {
-        proxy_parser_free(manager->current_config);
+    GError *error = NULL;
+    if (!v2ray_manager_start(manager, &error)) {
+        complete_later(manager, callback, user_data, FALSE, error);
+        return;
     }
     
-    manager->current_config = config;
+    // 就绪探测或 child watch 在主循环中回调
+    add_waiter(&manager->start_waiters, callback, user_data);
+}
+
+// 异步重启任务
+typedef struct {
+    V2RayCompletionFunc callback;
+    gpointer user_data;
+} V2RayRestartJob;
+
+static void restart_stopped_cb(V2RayManager *manager, gboolean success, const GError *error, gpointer user_data) {
+    (void)success;
+    (void)error;
+    V2RayRestartJob *job = (V2RayRestartJob*)user_data;
     
-    // 生成 V2Ray 配置文件
-    char *json_config = proxy_parser_generate_v2ray_config(config, manager->local_port);
-    if (!json_config) {
-        g_warning("Failed to generate V2Ray config");
-        return FALSE;
+    v2ray_manager_start_async(manager, job->callback, job->user_data);
+    g_free(job);
+}
+
+// 异步重启 V2Ray
+void v2ray_manager_restart_async(V2RayManager *manager, V2RayCompletionFunc callback, gpointer user_data) {
+    if (!manager) return;
+    
+    V2RayRestartJob *job = g_new0(V2RayRestartJob, 1);
+    job->callback = callback;
+    job->user_data = user_data;
+    v2ray_manager_stop_async(manager, restart_stopped_cb, job);
+}
+
+// 统计进程持有的套接字数量，失败返回 -1
+static int count_socket_fds(GPid pid) {
+    char *fd_dir = g_strdup_printf("/proc/%d/fd", pid);
+    GDir *dir = g_dir_open(fd_dir, 0, NULL);
+    if (!dir) {
+        g_free(fd_dir);
+        return -1;
     }
     
-    // 写入配置文件
-    GError *error = NULL;
-    if (!g_file_set_contents(manager->config_path, json_config, -1, &error)) {
-        g_warning("Failed to write V2Ray config: %s", error->message);
-        g_error_free(error);
-        g_free(json_config);
-        return FALSE;
+    int count = 0;
+    const char *name;
+    char target[64];
+    
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        char *link = g_build_filename(fd_dir, name, NULL);
+        ssize_t len = readlink(link, target, sizeof(target) - 1);
+        g_free(link);
+        
+        if (len > 0) {
+            target[len] = '\0';
+            if (g_str_has_prefix(target, "socket:")) {
+                count++;
+            }
+        }
     }
     
-    g_free(json_config);
-    return TRUE;
+    g_dir_close(dir);
+    g_free(fd_dir);
+    return count;
 }
 
-// 启动 V2Ray
-gboolean v2ray_manager_start(V2RayManager *manager, GError **error) {
-    if (!manager) return FALSE;
+static void instance_free(V2RayInstance *inst) {
+    if (inst->timer_id > 0) {
+        g_source_remove(inst->timer_id);
+    }
+    if (inst->kill_timer_id > 0) {
+        g_source_remove(inst->kill_timer_id);
+    }
+    output_free(&inst->output);
+    g_free(inst);
+}
+
+// 与管理器解除关联：实例仅保留 child watch，退出后自行释放
+static void instance_detach(V2RayInstance *inst) {
+    inst->manager = NULL;
     
-    if (manager->status == V2RAY_STATUS_RUNNING) {
-        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "V2Ray is already running");
-        return FALSE;
+    if (inst->timer_id > 0) {
+        g_source_remove(inst->timer_id);
+        inst->timer_id = 0;
     }
+    output_free(&inst->output);
+}
+
+static gboolean instance_kill_timeout_cb(gpointer user_data) {
+    V2RayInstance *inst = (V2RayInstance*)user_data;
+    inst->kill_timer_id = 0;
     
-    // 检查二进制文件
-    if (!g_file_test(manager->v2ray_binary, G_FILE_TEST_EXISTS)) {
-        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT, 
-                   "V2Ray binary not found at %s", manager->v2ray_binary);
-        return FALSE;
+    if (inst->pid > 0) {
+        g_warning("V2Ray (PID %d) did not exit within %d ms, sending SIGKILL",
+                  inst->pid, V2RAY_STOP_TIMEOUT_MS);
+        kill(inst->pid, SIGKILL);
     }
     
-    // 检查配置文件
-    if (!g_file_test(manager->config_path, G_FILE_TEST_EXISTS)) {
-        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT, 
-                   "V2Ray config not found. Please set a proxy first.");
-        return FALSE;
+    return G_SOURCE_REMOVE;
+}
+
+// 发送 SIGTERM，超时升级为 SIGKILL
+static void instance_terminate(V2RayInstance *inst) {
+    if (inst->pid <= 0) return;
+    
+    kill(inst->pid, SIGTERM);
+    if (inst->kill_timer_id == 0) {
+        inst->kill_timer_id = g_timeout_add(V2RAY_STOP_TIMEOUT_MS, instance_kill_timeout_cb, inst);
+    }
+}
+
+// 结束热切换任务；失败时释放新配置，接管 error
+static void swap_finish(V2RayManager *manager, gboolean success, GError *error) {
+    V2RaySwapJob *job = manager->swap_job;
+    if (!job) {
+        if (error) g_error_free(error);
+        return;
     }
     
-    manager->status = V2RAY_STATUS_STARTING;
+    manager->swap_job = NULL;
+    if (job->configs) {
+        g_ptr_array_unref(job->configs);
+    }
     
-    // 启动 V2Ray 进程
-    char *argv[] = {
-        manager->v2ray_binary,
-        "run",
-        "-c",
-        manager->config_path,
-        NULL
-    };
+    complete_later(manager, job->callback, job->user_data, success, error);
+    g_free(job);
+}
+
+// 丢弃备用实例并以失败结束热切换，旧实例继续服务
+static void swap_fail(V2RayManager *manager, GError *error) {
+    V2RayInstance *standby = manager->standby;
     
-    GSpawnFlags flags = G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_SEARCH_PATH;
-    gint stdout_fd, stderr_fd;
+    if (standby) {
+        manager->standby = NULL;
+        instance_detach(standby);
+        if (standby->pid > 0) {
+            kill(standby->pid, SIGKILL);
+        }
+    }
     
-    if (!g_spawn_async_with_pipes(NULL, argv, NULL, flags, NULL, NULL,
-                                   &manager->v2ray_pid, NULL, &stdout_fd, &stderr_fd, error)) {
-        manager->status = V2RAY_STATUS_ERROR;
-        return FALSE;
+    g_warning("V2Ray config swap failed: %s", error->message);
+    swap_finish(manager, FALSE, error);
+}
+
+static void swap_begin_standby(V2RayManager *manager);
+
+static void instance_exit_cb(GPid pid, gint wait_status, gpointer user_data) {
+    V2RayInstance *inst = (V2RayInstance*)user_data;
+    V2RayManager *manager = inst->manager;
+    
+    inst->child_watch_id = 0;
+    inst->pid = 0;
+    g_spawn_close_pid(pid);
+    
+    if (manager && manager->standby == inst) {
+        manager->standby = NULL;
+        instance_free(inst);
+        swap_fail(manager, g_error_new(G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                       "New V2Ray instance exited before becoming ready (wait status %d)",
+                                       wait_status));
+        return;
     }
     
-    // 监控日志输出
-    manager->log_channel = g_io_channel_unix_new(stderr_fd);
-    g_io_channel_set_encoding(manager->log_channel, NULL, NULL);
-    g_io_channel_set_flags(manager->log_channel, G_IO_FLAG_NONBLOCK, NULL);
-    manager->log_watch_id = g_io_add_watch(manager->log_channel, 
-                                           G_IO_IN | G_IO_HUP | G_IO_ERR,
-                                           log_watch_cb, manager);
+    if (manager && manager->draining == inst) {
+        manager->draining = NULL;
+        g_message("Drained V2Ray instance (PID %d) exited", pid);
+        instance_free(inst);
+        
+        // 排空实例占用着下一次切换要用的槽位，等它退出后再继续
+        if (manager->swap_job && !manager->standby) {
+            swap_begin_standby(manager);
+        }
+        return;
+    }
     
-    manager->status = V2RAY_STATUS_RUNNING;
-    g_message("V2Ray started with PID %d", manager->v2ray_pid);
+    instance_free(inst);
+}
+
+// 排空检查：旧实例只剩监听套接字（或超时）后停止
+static gboolean drain_check_cb(gpointer user_data) {
+    V2RayInstance *inst = (V2RayInstance*)user_data;
     
-    // 如果启用了透明代理，配置 iptables
-    if (manager->tproxy_enabled) {
-        v2ray_manager_enable_tproxy(manager, TRUE, NULL);
+    int sockets = count_socket_fds(inst->pid);
+    gboolean timed_out = g_get_monotonic_time() - inst->start_time >= DRAIN_TIMEOUT_US;
+    
+    if (sockets > inst->idle_sockets && !timed_out) {
+        return G_SOURCE_CONTINUE;
     }
     
-    return TRUE;
+    g_message("V2Ray (PID %d) %s, stopping old instance", inst->pid,
+              timed_out ? "drain timed out" : "drained");
+    inst->timer_id = 0;
+    instance_terminate(inst);
+    
+    return G_SOURCE_REMOVE;
 }
 
-// 停止 V2Ray
-gboolean v2ray_manager_stop(V2RayManager *manager) {
-    if (!manager) return FALSE;
+// 新实例接管：旧实例转入排空，新实例成为活动实例
+static void swap_promote(V2RayManager *manager) {
+    V2RayInstance *next = manager->standby;
+    V2RaySwapJob *job = manager->swap_job;
+    manager->standby = NULL;
     
-    if (manager->status != V2RAY_STATUS_RUNNING) {
-        return TRUE;
+    // 旧实例的 child watch 和日志转交给排空实例
+    if (manager->child_watch_id > 0) {
+        g_source_remove(manager->child_watch_id);
+        manager->child_watch_id = 0;
+    }
+    if (manager->health_timer_id > 0) {
+        g_source_remove(manager->health_timer_id);
+        manager->health_timer_id = 0;
     }
     
-    manager->status = V2RAY_STATUS_STOPPING;
+    V2RayInstance *old = g_new0(V2RayInstance, 1);
+    old->manager = manager;
+    old->pid = manager->v2ray_pid;
+    old->slot = manager->active_slot;
+    old->output = manager->output;
+    old->start_time = g_get_monotonic_time();
+    old->idle_sockets = next->idle_sockets;  // 两个实例的监听套接字相同
+    old->child_watch_id = g_child_watch_add(old->pid, instance_exit_cb, old);
+    old->timer_id = g_timeout_add(DRAIN_CHECK_INTERVAL_MS, drain_check_cb, old);
+    manager->draining = old;
     
-    // 停止日志监控
-    if (manager->log_watch_id > 0) {
-        g_source_remove(manager->log_watch_id);
-        manager->log_watch_id = 0;
+    g_source_remove(next->child_watch_id);
+    
+    manager->v2ray_pid = next->pid;
+    manager->output = next->output;
+    manager->active_slot = next->slot;
+    manager->local_port = slot_port(manager, next->slot);
+    manager->dns_port = slot_dns_port(manager, next->slot);
+    manager->api_port = slot_api_port(manager, next->slot);
+    g_free(manager->config_path);
+    manager->config_path = slot_config_path(manager, next->slot);
+    g_free(next);
+    
+    if (manager->current_configs) {
+        g_ptr_array_unref(manager->current_configs);
     }
+    manager->current_configs = job->configs;
+    job->configs = NULL;
+    manager->restart_needed = FALSE;
+    
+    watchdog_arm(manager);
     
-    if (manager->log_channel) {
-        g_io_channel_shutdown(manager->log_channel, FALSE, NULL);
-        g_io_channel_unref(manager->log_channel);
-        manager->log_channel = NULL;
+    g_message("V2Ray swapped to PID %d on port %d, draining PID %d",
+              manager->v2ray_pid, manager->local_port, old->pid);
+    swap_finish(manager, TRUE, NULL);
+}
+
+// 透明代理规则已切换到新端口
+static void swap_switched_cb(V2RayManager *manager, gboolean success) {
+    if (!manager->standby) {
+        // 切换期间备用实例已退出：规则若已指向它，切回仍在服务的旧实例
+        if (success && manager->tproxy_enabled) {
+            spawn_tproxy_async(manager, "switch", manager->active_slot, NULL);
+        }
+        return;
     }
     
-    // 关闭透明代理
-    if (manager->tproxy_enabled) {
-        v2ray_manager_enable_tproxy(manager, FALSE, NULL);
+    if (!success) {
+        swap_fail(manager, g_error_new(G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                       "Failed to switch TProxy rules to port %d",
+                                       slot_port(manager, manager->standby->slot)));
+        return;
     }
     
-    // 终止进程
-    if (manager->v2ray_pid > 0) {
-        kill(manager->v2ray_pid, SIGTERM);
-        
-        // 等待进程退出
-        int status;
-        for (int i = 0; i < 50; i++) {
-            if (waitpid(manager->v2ray_pid, &status, WNOHANG) != 0) {
-                break;
-            }
-            usleep(100000); // 100ms
+    swap_promote(manager);
+}
+
+// 备用实例就绪探测
+static gboolean standby_probe_cb(gpointer user_data) {
+    V2RayInstance *inst = (V2RayInstance*)user_data;
+    V2RayManager *manager = inst->manager;
+    
+    // 活动实例在切换过程中失效，交由看门狗处理
+    if (manager->status != V2RAY_STATUS_RUNNING) {
+        inst->timer_id = 0;
+        swap_fail(manager, g_error_new(G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                       "V2Ray stopped during config swap"));
+        return G_SOURCE_REMOVE;
+    }
+    
+    gboolean ready = manager->backend->is_ready(slot_port(manager, inst->slot)) &&
+                     (!manager->slot_fakeip[inst->slot] ||
+                      v2ray_manager_probe_port(slot_dns_port(manager, inst->slot)));
+    
+    if (!ready) {
+        if (g_get_monotonic_time() - inst->start_time < SWAP_READY_TIMEOUT_US) {
+            return G_SOURCE_CONTINUE;
         }
         
-        // 强制终止
-        if (kill(manager->v2ray_pid, 0) == 0) {
-            kill(manager->v2ray_pid, SIGKILL);
-            waitpid(manager->v2ray_pid, &status, 0);
+        inst->timer_id = 0;
+        swap_fail(manager, g_error_new(G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                       "New V2Ray instance did not listen on port %d in time",
+                                       slot_port(manager, inst->slot)));
+        return G_SOURCE_REMOVE;
+    }
+    
+    inst->timer_id = 0;
+    inst->idle_sockets = count_socket_fds(inst->pid);
+    
+    if (manager->tproxy_enabled) {
+        spawn_tproxy_async(manager, "switch", inst->slot, swap_switched_cb);
+    } else {
+        swap_promote(manager);
+    }
+    
+    return G_SOURCE_REMOVE;
+}
+
+// 在空闲槽位启动备用实例
+static void swap_begin_standby(V2RayManager *manager) {
+    V2RaySwapJob *job = manager->swap_job;
+    int slot = 1 - manager->active_slot;
+    GError *error = NULL;
+    
+    if (!write_slot_config(manager, job->configs, slot, NULL, &error)) {
+        swap_fail(manager, error);
+        return;
+    }
+    
+    V2RayInstance *inst = g_new0(V2RayInstance, 1);
+    inst->manager = manager;
+    inst->slot = slot;
+    
+    gboolean spawned = spawn_v2ray_process(manager, slot, &inst->pid, &inst->output, &error);
+    
+    if (!spawned) {
+        g_free(inst);
+        swap_fail(manager, error);
+        return;
+    }
+    
+    g_message("Started standby V2Ray with PID %d on port %d", inst->pid, slot_port(manager, slot));
+    
+    inst->start_time = g_get_monotonic_time();
+    inst->child_watch_id = g_child_watch_add(inst->pid, instance_exit_cb, inst);
+    inst->timer_id = g_timeout_add(SWAP_PROBE_INTERVAL_MS, standby_probe_cb, inst);
+    manager->standby = inst;
+}
+
+// 放弃热切换：备用实例立即结束，排空实例不再等待连接
+static void swap_abort(V2RayManager *manager) {
+    if (manager->standby) {
+        V2RayInstance *standby = manager->standby;
+        manager->standby = NULL;
+        instance_detach(standby);
+        if (standby->pid > 0) {
+            kill(standby->pid, SIGKILL);
         }
-        
-        g_spawn_close_pid(manager->v2ray_pid);
-        manager->v2ray_pid = 0;
     }
     
-    manager->status = V2RAY_STATUS_STOPPED;
-    g_message("V2Ray stopped");
+    if (manager->draining) {
+        V2RayInstance *draining = manager->draining;
+        manager->draining = NULL;
+        instance_detach(draining);
+        instance_terminate(draining);
+    }
     
-    return TRUE;
+    swap_finish(manager, FALSE, g_error_new(G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                            "V2Ray was stopped during config swap"));
 }
 
-// 重启 V2Ray
-gboolean v2ray_manager_restart(V2RayManager *manager, GError **error) {
-    if (!manager) return FALSE;
+// 热切换代理配置
+void v2ray_manager_swap_config_async(V2RayManager *manager, ProxyConfig *config,
+                                     V2RayCompletionFunc callback, gpointer user_data) {
+    if (!manager || !config) return;
+    
+    manager->pool_active = FALSE;
+    v2ray_manager_swap_configs_async(manager, single_config(config), callback, user_data);
+}
+
+void v2ray_manager_swap_configs_async(V2RayManager *manager, GPtrArray *configs,
+                                      V2RayCompletionFunc callback, gpointer user_data) {
+    if (!manager || !configs) return;
+    
+    // 未运行：只需写入配置，下次启动生效
+    if (manager->status != V2RAY_STATUS_RUNNING) {
+        gboolean ok = v2ray_manager_set_configs(manager, configs);
+        complete_later(manager, callback, user_data, ok,
+                       ok ? NULL : g_error_new(G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                               "Failed to write V2Ray config"));
+        return;
+    }
+    
+    if (manager->swap_job) {
+        g_ptr_array_unref(configs);
+        complete_later(manager, callback, user_data, FALSE,
+                       g_error_new(G_FILE_ERROR, G_FILE_ERROR_AGAIN, "A config swap is already in progress"));
+        return;
+    }
+    
+    if (configs->len == 0) {
+        g_ptr_array_unref(configs);
+        complete_later(manager, callback, user_data, FALSE,
+                       g_error_new(G_FILE_ERROR, G_FILE_ERROR_INVAL, "No proxy nodes to use"));
+        return;
+    }
+    
+    // 与运行中的配置相同：不必启动新实例
+    if (!manager->restart_needed &&
+        manager->slot_config_hash[manager->active_slot] == slot_config_hash(manager, configs, manager->active_slot)) {
+        g_message("V2Ray config unchanged, skipping swap");
+        g_ptr_array_unref(configs);
+        complete_later(manager, callback, user_data, TRUE, NULL);
+        return;
+    }
+    
+    V2RaySwapJob *job = g_new0(V2RaySwapJob, 1);
+    job->configs = configs;
+    job->callback = callback;
+    job->user_data = user_data;
+    manager->swap_job = job;
+    
+    // 上一次切换的旧实例仍在排空：提前结束它，退出后再启动备用实例
+    if (manager->draining) {
+        g_message("Stopping draining V2Ray (PID %d) early for a new swap", manager->draining->pid);
+        instance_terminate(manager->draining);
+        return;
+    }
+    
+    swap_begin_standby(manager);
+}
+
+gboolean v2ray_manager_is_swapping(V2RayManager *manager) {
+    return manager && manager->swap_job != NULL;
+}
+
+// 节点池自动切换失败：清除记录，下一轮探测重试
+static void pool_swap_done_cb(V2RayManager *manager, gboolean success, const GError *error, gpointer user_data) {
+    (void)user_data;
     
-    v2ray_manager_stop(manager);
-    usleep(500000); // 等待 500ms
-    return v2ray_manager_start(manager, error);
+    if (!success) {
+        g_warning("Automatic node switch failed: %s", error ? error->message : "unknown error");
+        g_clear_pointer(&manager->pool_key, g_free);
+    }
+}
+
+// 一轮探测完成：可用节点集合变化时重新生成均衡配置
+static void pool_changed_cb(ProxyPool *pool, gpointer user_data) {
+    V2RayManager *manager = (V2RayManager*)user_data;
+    
+    if (!manager->pool_active || manager->status != V2RAY_STATUS_RUNNING || manager->swap_job) {
+        return;
+    }
+    
+    if (!proxy_pool_selection_stale(pool, manager->pool_key, PROXY_POOL_MAX_ACTIVE)) {
+        return;
+    }
+    
+    char *key = proxy_pool_selection_key(pool, PROXY_POOL_MAX_ACTIVE);
+    if (g_strcmp0(key, manager->pool_key) == 0) {
+        // 所有节点都不可用时选择不会变化，等待节点恢复
+        g_free(key);
+        return;
+    }
+    
+    g_message("Proxy node pool changed, switching to the current best nodes");
+    g_free(manager->pool_key);
+    manager->pool_key = key;
+    v2ray_manager_swap_configs_async(manager, proxy_pool_select(pool, PROXY_POOL_MAX_ACTIVE),
+                                     pool_swap_done_cb, NULL);
+}
+
+ProxyPool* v2ray_manager_get_pool(V2RayManager *manager) {
+    if (!manager) return NULL;
+    return manager->pool;
+}
+
+void v2ray_manager_use_pool_async(V2RayManager *manager, V2RayCompletionFunc callback, gpointer user_data) {
+    if (!manager) return;
+    
+    if (proxy_pool_size(manager->pool) == 0) {
+        complete_later(manager, callback, user_data, FALSE,
+                       g_error_new(G_FILE_ERROR, G_FILE_ERROR_INVAL, "The node pool is empty"));
+        return;
+    }
+    
+    manager->pool_active = TRUE;
+    g_free(manager->pool_key);
+    manager->pool_key = proxy_pool_selection_key(manager->pool, PROXY_POOL_MAX_ACTIVE);
+    
+    proxy_pool_set_changed_func(manager->pool, pool_changed_cb, manager);
+    if (manager->pool->probe_timer_id == 0) {
+        proxy_pool_start_probing(manager->pool, PROXY_POOL_DEFAULT_INTERVAL_MS);
+    }
+    
+    v2ray_manager_swap_configs_async(manager, proxy_pool_select(manager->pool, PROXY_POOL_MAX_ACTIVE),
+                                     callback, user_data);
 }
 
 // 获取状态
@@ -259,82 +1933,112 @@ const char* v2ray_manager_get_status_string(V2RayStatus status) {
     }
 }
 
-// 启用透明代理
-gboolean v2ray_manager_enable_tproxy(V2RayManager *manager, gboolean enable, GError **error) {
-    if (!manager) return FALSE;
+// 用户发起的透明代理切换完成
+typedef struct {
+    V2RayCompletionFunc callback;
+    gpointer user_data;
+} TProxyToggle;
+
+static void tproxy_toggle_done(V2RayManager *manager, gboolean success, const GError *error, gpointer user_data) {
+    TProxyToggle *toggle = (TProxyToggle*)user_data;
     
-    // 检查脚本是否存在
-    if (!g_file_test(TPROXY_SCRIPT_PATH, G_FILE_TEST_EXISTS)) {
-        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
-                   "TProxy setup script not found at %s", TPROXY_SCRIPT_PATH);
-        return FALSE;
+    manager->tproxy_pending--;
+    if (toggle->callback) {
+        toggle->callback(manager, success, error, toggle->user_data);
     }
+    g_free(toggle);
+}
+
+// 异步启用/禁用透明代理，pkexec 认证期间不阻塞主循环
+void v2ray_manager_enable_tproxy_async(V2RayManager *manager, gboolean enable,
+                                       V2RayCompletionFunc callback, gpointer user_data) {
+    if (!manager) return;
     
-    // 执行脚本
-    char *argv[] = {
-        "pkexec",
-        TPROXY_SCRIPT_PATH,
-        enable ? "start" : "stop",
-        g_strdup_printf("%d", manager->local_port),
-        NULL
-    };
-    
-    gint exit_status;
-    if (!g_spawn_sync(NULL, argv, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL,
-                      NULL, NULL, &exit_status, error)) {
-        return FALSE;
-    }
+    TProxyToggle *toggle = g_new0(TProxyToggle, 1);
+    toggle->callback = callback;
+    toggle->user_data = user_data;
     
-    g_free(argv[3]);
+    manager->tproxy_pending++;
+    spawn_tproxy_job(manager, enable ? "start" : "stop", manager->active_slot, NULL,
+                     tproxy_toggle_done, toggle);
+}
+
+// 设置 FakeIP 模式
+void v2ray_manager_set_fakeip(V2RayManager *manager, gboolean enable) {
+    if (!manager) return;
+    manager->fakeip_enabled = enable;
+    rewrite_running_config(manager);
+}
+
+// 获取看门狗状态描述
+char* v2ray_manager_get_watchdog_string(V2RayManager *manager) {
+    if (!manager) return g_strdup("");
     
-    if (exit_status != 0) {
-        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                   "TProxy setup failed with exit code %d", exit_status);
-        return FALSE;
+    switch (manager->watchdog_state) {
+        case V2RAY_WATCHDOG_IDLE:
+            return g_strdup("看门狗: 未运行");
+        case V2RAY_WATCHDOG_HEALTHY:
+            return g_strdup("看门狗: 正常");
+        case V2RAY_WATCHDOG_FAILED_OPEN:
+            return g_strdup_printf("看门狗: V2Ray 异常退出 (状态 %d)，已放行流量，等待第 %d 次重启",
+                                   manager->last_exit_status, manager->restart_attempts);
+        case V2RAY_WATCHDOG_RECOVERING:
+            return g_strdup_printf("看门狗: 等待 V2Ray 就绪%s",
+                                   manager->tproxy_rearm ? "，就绪后恢复透明代理" : "");
+        default:
+            return g_strdup("看门狗: 未知");
     }
-    
-    manager->tproxy_enabled = enable;
-    g_message("TProxy %s", enable ? "enabled" : "disabled");
-    
-    return TRUE;
+}
+
+gboolean v2ray_manager_probe_port(int port) {
+    return proxy_core_port_listening(port);
 }
 
 // 获取日志
-const char* v2ray_manager_get_log(V2RayManager *manager) {
-    if (!manager) return "";
-    return manager->log_buffer->str;
+guint64 v2ray_manager_fetch_log(V2RayManager *manager, guint64 since, GString *out) {
+    if (!manager) return since;
+    return log_ring_fetch(manager->log_ring, since, out);
+}
+
+guint64 v2ray_manager_foreach_log(V2RayManager *manager, guint64 since, LogRingFunc func, gpointer user_data) {
+    if (!manager) return since;
+    return log_ring_foreach(manager->log_ring, since, func, user_data);
+}
+
+// 获取连接统计
+V2RayLogStats* v2ray_manager_get_log_stats(V2RayManager *manager) {
+    if (!manager) return NULL;
+    return manager->log_stats;
+}
+
+void v2ray_manager_reset_log_stats(V2RayManager *manager) {
+    if (!manager) return;
+    v2ray_log_stats_reset(manager->log_stats);
+}
+
+// 设置日志容量
+void v2ray_manager_set_log_limits(V2RayManager *manager, guint max_lines, gsize max_bytes) {
+    if (!manager) return;
+    log_ring_set_limits(manager->log_ring, max_lines, max_bytes);
+}
+
+// 获取流量
+GPtrArray* v2ray_manager_get_traffic(V2RayManager *manager) {
+    if (!manager) return g_ptr_array_new();
+    return v2ray_traffic_table_list(manager->traffic);
 }
 
 // 检查二进制
-gboolean v2ray_manager_check_binary(void) {
-    return g_file_test(V2RAY_BINARY_PATH, G_FILE_TEST_EXISTS);
+gboolean v2ray_manager_check_binary(V2RayManager *manager) {
+    return manager && g_file_test(manager->v2ray_binary, G_FILE_TEST_IS_EXECUTABLE);
 }
 
 // 获取版本
-char* v2ray_manager_get_version(void) {
-    if (!v2ray_manager_check_binary()) {
+char* v2ray_manager_get_version(V2RayManager *manager) {
+    if (!v2ray_manager_check_binary(manager)) {
         return g_strdup("未安装");
     }
     
-    char *argv[] = { V2RAY_BINARY_PATH, "version", NULL };
-    char *output = NULL;
-    GError *error = NULL;
-    
-    if (g_spawn_sync(NULL, argv, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL,
-                     &output, NULL, NULL, &error)) {
-        // 解析版本号
-        char *line = strtok(output, "\n");
-        if (line) {
-            char *version = g_strdup(line);
-            g_free(output);
-            return version;
-        }
-        g_free(output);
-    }
-    
-    if (error) {
-        g_error_free(error);
-    }
-    
-    return g_strdup("未知版本");
-}
\ No newline at end of file
+    char *version = proxy_core_get_version(manager->backend, manager->v2ray_binary);
+    return version ? version : g_strdup("未知版本");
+}
@@ -0,0 +1,923 @@
+#include "../include/v2ray_stats.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// HTTP/2 帧类型和标志
+#define H2_FRAME_DATA 0x0
+#define H2_FRAME_HEADERS 0x1
+#define H2_FRAME_RST_STREAM 0x3
+#define H2_FRAME_SETTINGS 0x4
+#define H2_FRAME_PING 0x6
+#define H2_FRAME_GOAWAY 0x7
+#define H2_FRAME_WINDOW_UPDATE 0x8
+#define H2_FRAME_CONTINUATION 0x9
+
+#define H2_FLAG_END_STREAM 0x1
+#define H2_FLAG_ACK 0x1
+#define H2_FLAG_END_HEADERS 0x4
+#define H2_FLAG_PADDED 0x8
+#define H2_FLAG_PRIORITY 0x20
+
+#define H2_HEADER_SIZE 9
+#define H2_MAX_FRAME_SIZE 16384     // 未修改 SETTINGS_MAX_FRAME_SIZE 时的上限
+#define H2_STREAM_ID 1
+#define H2_WINDOW_INCREMENT (4 * 1024 * 1024)
+
+// 响应上限，计数器很多时也远小于此
+#define STATS_MAX_RESPONSE (4 * 1024 * 1024)
+#define STATS_MAX_HEADER_BLOCK (64 * 1024)
+
+// SETTINGS_HEADER_TABLE_SIZE 默认值，请求中未修改
+#define HPACK_TABLE_SIZE 4096
+#define HPACK_ENTRY_OVERHEAD 32
+
+// gRPC 状态码：方法或服务不存在
+#define GRPC_STATUS_UNIMPLEMENTED 12
+
+static const char h2_preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+// ---------- 写帧 ----------
+
+static void h2_frame_header(GByteArray *buf, guint32 len, guint8 type, guint8 flags, guint32 stream) {
+    guint8 header[H2_HEADER_SIZE] = {
+        (len >> 16) & 0xff, (len >> 8) & 0xff, len & 0xff,
+        type, flags,
+        (stream >> 24) & 0x7f, (stream >> 16) & 0xff, (stream >> 8) & 0xff, stream & 0xff
+    };
+    g_byte_array_append(buf, header, sizeof(header));
+}
+
+static void h2_window_update(GByteArray *buf, guint32 stream, guint32 increment) {
+    guint8 payload[4] = {
+        (increment >> 24) & 0x7f, (increment >> 16) & 0xff, (increment >> 8) & 0xff, increment & 0xff
+    };
+    h2_frame_header(buf, sizeof(payload), H2_FRAME_WINDOW_UPDATE, 0, stream);
+    g_byte_array_append(buf, payload, sizeof(payload));
+}
+
+// HPACK 整数编码（RFC 7541 5.1）
+static void hpack_int(GByteArray *buf, guint8 first, guint prefix_bits, guint value) {
+    guint max = (1u << prefix_bits) - 1;
+    guint8 byte;
+
+    if (value < max) {
+        byte = first | value;
+        g_byte_array_append(buf, &byte, 1);
+        return;
+    }
+
+    byte = first | max;
+    g_byte_array_append(buf, &byte, 1);
+    value -= max;
+    while (value >= 0x80) {
+        byte = (value & 0x7f) | 0x80;
+        g_byte_array_append(buf, &byte, 1);
+        value >>= 7;
+    }
+    byte = value;
+    g_byte_array_append(buf, &byte, 1);
+}
+
+// 不使用 Huffman 编码的字符串
+static void hpack_string(GByteArray *buf, const char *str) {
+    gsize len = strlen(str);
+    hpack_int(buf, 0x00, 7, len);
+    g_byte_array_append(buf, (const guint8*)str, len);
+}
+
+// 不索引的字面量头部，名称引用静态表
+static void hpack_literal(GByteArray *buf, guint name_index, const char *value) {
+    hpack_int(buf, 0x00, 4, name_index);
+    hpack_string(buf, value);
+}
+
+// 不索引的字面量头部，新名称
+static void hpack_literal_name(GByteArray *buf, const char *name, const char *value) {
+    hpack_int(buf, 0x00, 4, 0);
+    hpack_string(buf, name);
+    hpack_string(buf, value);
+}
+
+// 连接前言 + SETTINGS + HEADERS + DATA，一次写出
+static GByteArray* build_request(int port, const char *path) {
+    GByteArray *buf = g_byte_array_sized_new(256);
+    GByteArray *headers = g_byte_array_sized_new(128);
+    char authority[32];
+
+    g_byte_array_append(buf, (const guint8*)h2_preface, strlen(h2_preface));
+    h2_frame_header(buf, 0, H2_FRAME_SETTINGS, 0, 0);
+    h2_window_update(buf, 0, H2_WINDOW_INCREMENT);
+
+    g_snprintf(authority, sizeof(authority), "127.0.0.1:%d", port);
+
+    guint8 method_post = 0x83;      // 静态表 3 :method POST
+    guint8 scheme_http = 0x86;      // 静态表 6 :scheme http
+    g_byte_array_append(headers, &method_post, 1);
+    g_byte_array_append(headers, &scheme_http, 1);
+    hpack_literal(headers, 4, path);                    // :path
+    hpack_literal(headers, 1, authority);               // :authority
+    hpack_literal(headers, 31, "application/grpc");     // content-type
+    hpack_literal_name(headers, "te", "trailers");
+
+    h2_frame_header(buf, headers->len, H2_FRAME_HEADERS, 0x4, H2_STREAM_ID);   // END_HEADERS
+    g_byte_array_append(buf, headers->data, headers->len);
+    g_byte_array_free(headers, TRUE);
+
+    h2_window_update(buf, H2_STREAM_ID, H2_WINDOW_INCREMENT);
+
+    // gRPC 消息：未压缩，长度 0（空的 QueryStatsRequest 匹配全部计数器，不重置）
+    guint8 message[5] = { 0, 0, 0, 0, 0 };
+    h2_frame_header(buf, sizeof(message), H2_FRAME_DATA, H2_FLAG_END_STREAM, H2_STREAM_ID);
+    g_byte_array_append(buf, message, sizeof(message));
+
+    return buf;
+}
+
+// ---------- HPACK 解码 ----------
+
+// 只关心 grpc-status / grpc-message，但其他头部也要完整解码以维护动态表，
+// 否则后续头部的索引会错位
+
+// RFC 7541 附录 A 静态表的名称；值只用于索引字段，解码时用不到
+static const char *const hpack_static_names[] = {
+    NULL, ":authority", ":method", ":method", ":path", ":path", ":scheme", ":scheme",
+    ":status", ":status", ":status", ":status", ":status", ":status", ":status",
+    "accept-charset", "accept-encoding", "accept-language", "accept-ranges", "accept",
+    "access-control-allow-origin", "age", "allow", "authorization", "cache-control",
+    "content-disposition", "content-encoding", "content-language", "content-length",
+    "content-location", "content-range", "content-type", "cookie", "date", "etag", "expect",
+    "expires", "from", "host", "if-match", "if-modified-since", "if-none-match", "if-range",
+    "if-unmodified-since", "last-modified", "link", "location", "max-forwards",
+    "proxy-authenticate", "proxy-authorization", "range", "referer", "refresh", "retry-after",
+    "server", "set-cookie", "strict-transport-security", "transfer-encoding", "user-agent",
+    "vary", "via", "www-authenticate"
+};
+#define HPACK_STATIC_COUNT (G_N_ELEMENTS(hpack_static_names) - 1)
+
+// RFC 7541 附录 B 的 Huffman 码是规范码：各长度的码字数，及按（长度，符号）排序的符号
+// 最后一个 30 位码字是 EOS（符号 256），不在符号表中
+static const guint8 huffman_counts[31] = {
+    0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3, 0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4
+};
+
+static const guint8 huffman_symbols[256] = {
+    48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37, 45, 46, 47, 51,
+    52, 53, 54, 55, 56, 57, 61, 65, 95, 98, 100, 102, 103, 104, 108, 109,
+    110, 112, 114, 117, 58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+    77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89, 106, 107, 113, 118,
+    119, 120, 121, 122, 38, 42, 44, 59, 88, 90, 33, 34, 40, 41, 63, 39,
+    43, 124, 35, 62, 0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+    195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+    179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160,
+    163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+    233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157,
+    158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239, 9, 142,
+    144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+    200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211,
+    212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+    2, 3, 4, 5, 6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+    21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220, 249, 10, 13, 22,
+};
+
+typedef struct {
+    char *name;
+    char *value;
+} HpackEntry;
+
+typedef struct {
+    GPtrArray *table;           // 动态表，最新的条目在前
+    gsize size;
+    gsize max_size;
+    int grpc_status;            // 未收到时为 -1
+    char *grpc_message;
+} HpackDecoder;
+
+static void hpack_entry_free(gpointer data) {
+    HpackEntry *entry = (HpackEntry*)data;
+    g_free(entry->name);
+    g_free(entry->value);
+    g_free(entry);
+}
+
+static gsize hpack_entry_size(const char *name, const char *value) {
+    return strlen(name) + strlen(value) + HPACK_ENTRY_OVERHEAD;
+}
+
+static void hpack_init(HpackDecoder *dec) {
+    dec->table = g_ptr_array_new_with_free_func(hpack_entry_free);
+    dec->size = 0;
+    dec->max_size = HPACK_TABLE_SIZE;
+    dec->grpc_status = -1;
+    dec->grpc_message = NULL;
+}
+
+static void hpack_clear(HpackDecoder *dec) {
+    g_ptr_array_unref(dec->table);
+    g_free(dec->grpc_message);
+}
+
+static void hpack_evict(HpackDecoder *dec) {
+    while (dec->size > dec->max_size && dec->table->len > 0) {
+        HpackEntry *oldest = g_ptr_array_index(dec->table, dec->table->len - 1);
+        dec->size -= hpack_entry_size(oldest->name, oldest->value);
+        g_ptr_array_remove_index(dec->table, dec->table->len - 1);
+    }
+}
+
+// 加入动态表；条目本身超过上限时清空动态表（RFC 7541 4.4）
+static void hpack_insert(HpackDecoder *dec, const char *name, const char *value) {
+    gsize size = hpack_entry_size(name, value);
+
+    if (size > dec->max_size) {
+        g_ptr_array_set_size(dec->table, 0);
+        dec->size = 0;
+        return;
+    }
+
+    HpackEntry *entry = g_new0(HpackEntry, 1);
+    entry->name = g_strdup(name);
+    entry->value = g_strdup(value);
+    g_ptr_array_insert(dec->table, 0, entry);
+    dec->size += size;
+    hpack_evict(dec);
+}
+
+// 按索引查找；静态表条目的 value 为 NULL
+static gboolean hpack_lookup(HpackDecoder *dec, guint index, const char **name, const char **value) {
+    if (index == 0) return FALSE;
+
+    if (index <= HPACK_STATIC_COUNT) {
+        *name = hpack_static_names[index];
+        *value = NULL;
+        return TRUE;
+    }
+
+    index -= HPACK_STATIC_COUNT + 1;
+    if (index >= dec->table->len) return FALSE;
+
+    HpackEntry *entry = g_ptr_array_index(dec->table, index);
+    *name = entry->name;
+    *value = entry->value;
+    return TRUE;
+}
+
+// HPACK 整数（RFC 7541 5.1）
+static gboolean hpack_read_int(const guint8 **p, const guint8 *end, guint prefix_bits, guint *out) {
+    guint max = (1u << prefix_bits) - 1;
+
+    if (*p >= end) return FALSE;
+
+    guint value = *(*p)++ & max;
+    if (value < max) {
+        *out = value;
+        return TRUE;
+    }
+
+    for (guint shift = 0; *p < end && shift <= 21; shift += 7) {
+        guint8 byte = *(*p)++;
+        value += (guint)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *out = value;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// 规范 Huffman 码逐位解码；末尾不足 8 位的填充必须是 EOS 的前缀（全 1）
+static gboolean huffman_decode(const guint8 *p, gsize len, GString *out) {
+    gint code = 0, first = 0, index = 0;
+    guint bits = 0;
+    guint raw = 0;
+
+    for (gsize i = 0; i < len; i++) {
+        for (int b = 7; b >= 0; b--) {
+            guint bit = (p[i] >> b) & 1;
+            code |= bit;
+            raw = (raw << 1) | bit;
+            bits++;
+
+            gint count = huffman_counts[bits];
+            if (code - count < first) {
+                gint symbol = index + (code - first);
+                if (symbol >= (gint)G_N_ELEMENTS(huffman_symbols)) return FALSE;     // EOS
+                g_string_append_c(out, (gchar)huffman_symbols[symbol]);
+                code = first = index = 0;
+                bits = raw = 0;
+                continue;
+            }
+            if (bits == G_N_ELEMENTS(huffman_counts) - 1) return FALSE;
+
+            index += count;
+            first += count;
+            first <<= 1;
+            code <<= 1;
+        }
+    }
+
+    return bits < 8 && raw == (1u << bits) - 1;
+}
+
+static gboolean hpack_read_string(const guint8 **p, const guint8 *end, char **out) {
+    if (*p >= end) return FALSE;
+
+    gboolean huffman = (**p & 0x80) != 0;
+    guint len;
+    if (!hpack_read_int(p, end, 7, &len) || len > (guint)(end - *p)) return FALSE;
+
+    if (huffman) {
+        GString *str = g_string_sized_new(len * 8 / 5 + 1);
+        if (!huffman_decode(*p, len, str)) {
+            g_string_free(str, TRUE);
+            return FALSE;
+        }
+        *out = g_string_free(str, FALSE);
+    } else {
+        *out = g_strndup((const char*)*p, len);
+    }
+
+    *p += len;
+    return TRUE;
+}
+
+static void hpack_header(HpackDecoder *dec, const char *name, const char *value) {
+    if (strcmp(name, "grpc-status") == 0) {
+        char *end = NULL;
+        gint64 status = g_ascii_strtoll(value, &end, 10);
+        dec->grpc_status = (end != value && *end == '\0' && status >= 0 && status <= G_MAXINT) ? (int)status : -1;
+    } else if (strcmp(name, "grpc-message") == 0) {
+        g_free(dec->grpc_message);
+        dec->grpc_message = g_strdup(value);
+    }
+}
+
+// 解码一个完整的头部块（RFC 7541 6）
+static gboolean hpack_decode_block(HpackDecoder *dec, const guint8 *p, const guint8 *end) {
+    while (p < end) {
+        guint8 first = *p;
+        guint index;
+        const char *name = NULL;
+        const char *value = NULL;
+
+        if (first & 0x80) {
+            // 索引字段
+            if (!hpack_read_int(&p, end, 7, &index) || !hpack_lookup(dec, index, &name, &value)) {
+                return FALSE;
+            }
+            if (value) hpack_header(dec, name, value);
+            continue;
+        }
+
+        if ((first & 0xe0) == 0x20) {
+            // 动态表大小更新，不能超过 SETTINGS 中的上限
+            if (!hpack_read_int(&p, end, 5, &index) || index > HPACK_TABLE_SIZE) return FALSE;
+            dec->max_size = index;
+            hpack_evict(dec);
+            continue;
+        }
+
+        // 字面量：带索引（01）、不索引（0000）、永不索引（0001）
+        gboolean indexed = (first & 0xc0) == 0x40;
+        if (!hpack_read_int(&p, end, indexed ? 6 : 4, &index)) return FALSE;
+
+        char *literal_name = NULL;
+        char *literal_value = NULL;
+        if (index == 0) {
+            if (!hpack_read_string(&p, end, &literal_name)) return FALSE;
+            name = literal_name;
+        } else if (!hpack_lookup(dec, index, &name, &value)) {
+            return FALSE;
+        }
+
+        // name 可能指向动态表条目，插入新条目前先用完
+        if (!hpack_read_string(&p, end, &literal_value)) {
+            g_free(literal_name);
+            return FALSE;
+        }
+        hpack_header(dec, name, literal_value);
+        if (indexed) hpack_insert(dec, name, literal_value);
+
+        g_free(literal_name);
+        g_free(literal_value);
+    }
+
+    return TRUE;
+}
+
+// ---------- 套接字 ----------
+
+static gboolean write_all(int fd, const guint8 *data, gsize len, GError **error) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno),
+                        "发送统计请求失败: %s", g_strerror(errno));
+            return FALSE;
+        }
+        data += n;
+        len -= n;
+    }
+    return TRUE;
+}
+
+static gboolean read_all(int fd, guint8 *data, gsize len, GError **error) {
+    while (len > 0) {
+        ssize_t n = recv(fd, data, len, 0);
+        if (n == 0) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED, "统计 API 关闭了连接");
+            return FALSE;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT, "统计 API 响应超时");
+            } else {
+                g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno),
+                            "读取统计响应失败: %s", g_strerror(errno));
+            }
+            return FALSE;
+        }
+        data += n;
+        len -= n;
+    }
+    return TRUE;
+}
+
+static int connect_api(int port, int timeout_ms, GError **error) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno),
+                    "创建套接字失败: %s", g_strerror(errno));
+        return -1;
+    }
+
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000
+    };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno),
+                    "连接统计 API 127.0.0.1:%d 失败: %s", port, g_strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// 去掉 HEADERS 帧的填充和优先级字段，返回头部块片段的范围
+static gboolean h2_headers_fragment(const guint8 *payload, guint32 len, guint8 flags,
+                                    guint32 *start, guint32 *end) {
+    *start = 0;
+    *end = len;
+
+    if (flags & H2_FLAG_PADDED) {
+        if (len < 1 || payload[0] >= len) return FALSE;
+        *start = 1;
+        *end = len - payload[0];
+    }
+    if (flags & H2_FLAG_PRIORITY) {
+        if (*end - *start < 5) return FALSE;
+        *start += 5;
+    }
+    return TRUE;
+}
+
+// 读取帧直到流 1 结束，把 DATA 负载收集到 body，头部（含 trailers）交给 hpack 解码
+static gboolean read_response(int fd, GByteArray *body, HpackDecoder *hpack, GError **error) {
+    guint8 header[H2_HEADER_SIZE];
+    guint8 *payload = g_malloc(H2_MAX_FRAME_SIZE);
+    GByteArray *block = g_byte_array_new();
+    gboolean in_block = FALSE;
+    gboolean end_stream = FALSE;
+    gboolean ok = FALSE;
+
+    for (;;) {
+        if (!read_all(fd, header, sizeof(header), error)) break;
+
+        guint32 len = (header[0] << 16) | (header[1] << 8) | header[2];
+        guint8 type = header[3];
+        guint8 flags = header[4];
+        guint32 stream = ((header[5] & 0x7f) << 24) | (header[6] << 16) | (header[7] << 8) | header[8];
+
+        if (len > H2_MAX_FRAME_SIZE) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "统计 API 帧过大: %u", len);
+            break;
+        }
+        if (!read_all(fd, payload, len, error)) break;
+
+        // 头部块被 CONTINUATION 分割时，中间不能插入其他帧
+        if (in_block != (type == H2_FRAME_CONTINUATION)) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "统计 API 头部块不完整");
+            break;
+        }
+
+        if (type == H2_FRAME_SETTINGS && !(flags & H2_FLAG_ACK)) {
+            GByteArray *ack = g_byte_array_sized_new(H2_HEADER_SIZE);
+            h2_frame_header(ack, 0, H2_FRAME_SETTINGS, H2_FLAG_ACK, 0);
+            gboolean sent = write_all(fd, ack->data, ack->len, error);
+            g_byte_array_free(ack, TRUE);
+            if (!sent) break;
+        } else if (type == H2_FRAME_PING && !(flags & H2_FLAG_ACK) && len == 8) {
+            GByteArray *pong = g_byte_array_sized_new(H2_HEADER_SIZE + 8);
+            h2_frame_header(pong, 8, H2_FRAME_PING, H2_FLAG_ACK, 0);
+            g_byte_array_append(pong, payload, 8);
+            gboolean sent = write_all(fd, pong->data, pong->len, error);
+            g_byte_array_free(pong, TRUE);
+            if (!sent) break;
+        } else if (type == H2_FRAME_GOAWAY) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED, "统计 API 发送了 GOAWAY");
+            break;
+        } else if (type == H2_FRAME_RST_STREAM && stream == H2_STREAM_ID) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "统计 API 重置了请求");
+            break;
+        } else if (type == H2_FRAME_HEADERS || type == H2_FRAME_CONTINUATION) {
+            guint32 start = 0;
+            guint32 end = len;
+            if (type == H2_FRAME_HEADERS) {
+                if (!h2_headers_fragment(payload, len, flags, &start, &end)) {
+                    g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "统计 API 头部帧无效");
+                    break;
+                }
+                end_stream = stream == H2_STREAM_ID && (flags & H2_FLAG_END_STREAM);
+            }
+            if (block->len + (end - start) > STATS_MAX_HEADER_BLOCK) {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_MESSAGE_TOO_LARGE, "统计 API 头部过大");
+                break;
+            }
+            g_byte_array_append(block, payload + start, end - start);
+            in_block = !(flags & H2_FLAG_END_HEADERS);
+
+            if (!in_block) {
+                gboolean decoded = hpack_decode_block(hpack, block->data, block->data + block->len);
+                g_byte_array_set_size(block, 0);
+                if (!decoded) {
+                    g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "无法解码统计 API 头部");
+                    break;
+                }
+                // 流 1 的 HEADERS（trailers）带 END_STREAM 时结束
+                if (end_stream) {
+                    ok = TRUE;
+                    break;
+                }
+            }
+        } else if (stream == H2_STREAM_ID && type == H2_FRAME_DATA) {
+            guint32 start = 0;
+            guint32 end = len;
+            if (flags & H2_FLAG_PADDED) {
+                if (len < 1 || payload[0] >= len) {
+                    g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "统计 API 填充无效");
+                    break;
+                }
+                start = 1;
+                end = len - payload[0];
+            }
+            if (body->len + (end - start) > STATS_MAX_RESPONSE) {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_MESSAGE_TOO_LARGE, "统计响应过大");
+                break;
+            }
+            g_byte_array_append(body, payload + start, end - start);
+
+            // 流 1 的 DATA 带 END_STREAM 时结束（没有 trailers）
+            if (flags & H2_FLAG_END_STREAM) {
+                ok = TRUE;
+                break;
+            }
+        }
+    }
+
+    g_byte_array_free(block, TRUE);
+    g_free(payload);
+    return ok;
+}
+
+// ---------- protobuf ----------
+
+static gboolean pb_varint(const guint8 **p, const guint8 *end, guint64 *out) {
+    guint64 value = 0;
+
+    for (guint shift = 0; *p < end && shift < 64; shift += 7) {
+        guint8 byte = *(*p)++;
+        value |= (guint64)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *out = value;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static gboolean pb_skip(const guint8 **p, const guint8 *end, guint wire_type) {
+    guint64 n;
+
+    switch (wire_type) {
+        case 0:
+            return pb_varint(p, end, &n);
+        case 1:
+            n = 8;
+            break;
+        case 2:
+            if (!pb_varint(p, end, &n)) return FALSE;
+            break;
+        case 5:
+            n = 4;
+            break;
+        default:
+            return FALSE;
+    }
+
+    if (n > (guint64)(end - *p)) return FALSE;
+    *p += n;
+    return TRUE;
+}
+
+static void stat_free(gpointer data) {
+    V2RayStat *stat = (V2RayStat*)data;
+    g_free(stat->name);
+    g_free(stat);
+}
+
+// message Stat { string name = 1; int64 value = 2; }
+static V2RayStat* parse_stat(const guint8 *p, const guint8 *end) {
+    V2RayStat *stat = g_new0(V2RayStat, 1);
+
+    while (p < end) {
+        guint64 tag;
+        if (!pb_varint(&p, end, &tag)) goto fail;
+
+        guint field = tag >> 3;
+        guint wire_type = tag & 0x7;
+
+        if (field == 1 && wire_type == 2) {
+            guint64 len;
+            if (!pb_varint(&p, end, &len) || len > (guint64)(end - p)) goto fail;
+            g_free(stat->name);
+            stat->name = g_strndup((const char*)p, len);
+            p += len;
+        } else if (field == 2 && wire_type == 0) {
+            guint64 value;
+            if (!pb_varint(&p, end, &value)) goto fail;
+            stat->value = (gint64)value;
+        } else if (!pb_skip(&p, end, wire_type)) {
+            goto fail;
+        }
+    }
+
+    if (stat->name) return stat;
+
+fail:
+    stat_free(stat);
+    return NULL;
+}
+
+// message QueryStatsResponse { repeated Stat stat = 1; }
+static GPtrArray* parse_response(const guint8 *p, const guint8 *end, GError **error) {
+    GPtrArray *stats = g_ptr_array_new_with_free_func(stat_free);
+
+    while (p < end) {
+        guint64 tag;
+        if (!pb_varint(&p, end, &tag)) goto fail;
+
+        guint field = tag >> 3;
+        guint wire_type = tag & 0x7;
+
+        if (field == 1 && wire_type == 2) {
+            guint64 len;
+            if (!pb_varint(&p, end, &len) || len > (guint64)(end - p)) goto fail;
+            V2RayStat *stat = parse_stat(p, p + len);
+            if (stat) g_ptr_array_add(stats, stat);
+            p += len;
+        } else if (!pb_skip(&p, end, wire_type)) {
+            goto fail;
+        }
+    }
+
+    return stats;
+
+fail:
+    g_ptr_array_unref(stats);
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "无法解析统计响应");
+    return NULL;
+}
+
+GPtrArray* v2ray_stats_query(int port, const char *path, int timeout_ms, GError **error) {
+    int fd = connect_api(port, timeout_ms, error);
+    if (fd < 0) return NULL;
+
+    GByteArray *request = build_request(port, path);
+    GByteArray *body = g_byte_array_new();
+    GPtrArray *stats = NULL;
+    HpackDecoder hpack;
+
+    hpack_init(&hpack);
+
+    if (!write_all(fd, request->data, request->len, error) ||
+        !read_response(fd, body, &hpack, error)) {
+        goto out;
+    }
+
+    // 错误只通过 trailers（或只有 trailers 的响应）中的 grpc-status 返回；
+    // 只有 UNIMPLEMENTED 表示方法不存在（路径属于另一种内核），其他错误照实报告
+    if (hpack.grpc_status == GRPC_STATUS_UNIMPLEMENTED) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "统计 API 不支持 %s", path);
+        goto out;
+    }
+    if (hpack.grpc_status > 0) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "统计 API 返回错误 %d: %s",
+                    hpack.grpc_status, hpack.grpc_message ? hpack.grpc_message : "");
+        goto out;
+    }
+    if (hpack.grpc_status < 0 || body->len < 5) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "统计响应格式错误");
+        goto out;
+    }
+
+    guint32 message_len = (body->data[1] << 24) | (body->data[2] << 16) |
+                          (body->data[3] << 8) | body->data[4];
+    if (body->data[0] != 0 || message_len > body->len - 5) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "统计响应格式错误");
+        goto out;
+    }
+
+    stats = parse_response(body->data + 5, body->data + 5 + message_len, error);
+
+out:
+    close(fd);
+    hpack_clear(&hpack);
+    g_byte_array_free(request, TRUE);
+    g_byte_array_free(body, TRUE);
+    return stats;
+}
+
+// ---------- 异步 ----------
+
+typedef struct {
+    int port;
+    char *path;
+} StatsQuery;
+
+static void stats_query_free(gpointer data) {
+    StatsQuery *query = (StatsQuery*)data;
+    g_free(query->path);
+    g_free(query);
+}
+
+static void stats_query_thread(GTask *task, gpointer source_object, gpointer task_data,
+                               GCancellable *cancellable) {
+    StatsQuery *query = (StatsQuery*)task_data;
+    GError *error = NULL;
+
+    (void)source_object;
+    (void)cancellable;
+
+    GPtrArray *stats = v2ray_stats_query(query->port, query->path, V2RAY_STATS_TIMEOUT_MS, &error);
+    if (stats) {
+        g_task_return_pointer(task, stats, (GDestroyNotify)g_ptr_array_unref);
+    } else {
+        g_task_return_error(task, error);
+    }
+}
+
+void v2ray_stats_query_async(int port, const char *path, GCancellable *cancellable,
+                             GAsyncReadyCallback callback, gpointer user_data) {
+    StatsQuery *query = g_new0(StatsQuery, 1);
+    query->port = port;
+    query->path = g_strdup(path);
+
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_task_data(task, query, stats_query_free);
+    g_task_set_return_on_cancel(task, TRUE);
+    g_task_run_in_thread(task, stats_query_thread);
+    g_object_unref(task);
+}
+
+GPtrArray* v2ray_stats_query_finish(GAsyncResult *result, GError **error) {
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+// ---------- 流量表 ----------
+
+static void traffic_free(gpointer data) {
+    V2RayTraffic *traffic = (V2RayTraffic*)data;
+    g_free(traffic->tag);
+    g_free(traffic);
+}
+
+V2RayTrafficTable* v2ray_traffic_table_new(void) {
+    V2RayTrafficTable *table = g_new0(V2RayTrafficTable, 1);
+    table->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, traffic_free);
+    return table;
+}
+
+void v2ray_traffic_table_free(V2RayTrafficTable *table) {
+    if (!table) return;
+
+    g_hash_table_destroy(table->entries);
+    g_free(table);
+}
+
+// 原始计数变小说明 V2Ray 重启或切换了实例，之前的计数并入偏移
+static void traffic_advance(gint64 raw, gint64 *last_raw, guint64 *base, guint64 *total,
+                            double *rate, double elapsed) {
+    gint64 delta;
+
+    if (raw < *last_raw) {
+        *base += *last_raw;
+        delta = raw;
+    } else {
+        delta = raw - *last_raw;
+    }
+
+    *last_raw = raw;
+    *total = *base + raw;
+    *rate = elapsed > 0 ? delta / elapsed : 0.0;
+}
+
+void v2ray_traffic_table_update(V2RayTrafficTable *table, GPtrArray *stats, gint64 now_us) {
+    if (!table || !stats) return;
+
+    double elapsed = table->last_update > 0 ?
+                     (double)(now_us - table->last_update) / G_USEC_PER_SEC : 0.0;
+    table->last_update = now_us;
+
+    for (guint i = 0; i < stats->len; i++) {
+        V2RayStat *stat = g_ptr_array_index(stats, i);
+
+        // "inbound>>>tag>>>traffic>>>uplink"，忽略 user>>> 等其他计数器
+        char **parts = g_strsplit(stat->name, ">>>", 4);
+        if (g_strv_length(parts) != 4 || strcmp(parts[2], "traffic") != 0 ||
+            (strcmp(parts[0], "inbound") != 0 && strcmp(parts[0], "outbound") != 0)) {
+            g_strfreev(parts);
+            continue;
+        }
+
+        char *key = g_strdup_printf("%s>>>%s", parts[0], parts[1]);
+        V2RayTraffic *traffic = g_hash_table_lookup(table->entries, key);
+        if (!traffic) {
+            traffic = g_new0(V2RayTraffic, 1);
+            traffic->tag = g_strdup(parts[1]);
+            traffic->outbound = strcmp(parts[0], "outbound") == 0;
+            g_hash_table_insert(table->entries, key, traffic);
+        } else {
+            g_free(key);
+        }
+
+        if (strcmp(parts[3], "uplink") == 0) {
+            traffic_advance(stat->value, &traffic->raw_uplink, &traffic->base_uplink,
+                            &traffic->uplink, &traffic->uplink_rate, elapsed);
+        } else if (strcmp(parts[3], "downlink") == 0) {
+            traffic_advance(stat->value, &traffic->raw_downlink, &traffic->base_downlink,
+                            &traffic->downlink, &traffic->downlink_rate, elapsed);
+        }
+
+        g_strfreev(parts);
+    }
+}
+
+static gint traffic_compare(gconstpointer a, gconstpointer b) {
+    const V2RayTraffic *ta = *(V2RayTraffic * const *)a;
+    const V2RayTraffic *tb = *(V2RayTraffic * const *)b;
+
+    if (ta->outbound != tb->outbound) {
+        return ta->outbound ? -1 : 1;
+    }
+
+    guint64 total_a = ta->uplink + ta->downlink;
+    guint64 total_b = tb->uplink + tb->downlink;
+    if (total_a != total_b) {
+        return total_a > total_b ? -1 : 1;
+    }
+    return strcmp(ta->tag, tb->tag);
+}
+
+GPtrArray* v2ray_traffic_table_list(V2RayTrafficTable *table) {
+    GPtrArray *result = g_ptr_array_new();
+
+    if (table) {
+        GHashTableIter iter;
+        gpointer value;
+
+        g_hash_table_iter_init(&iter, table->entries);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            g_ptr_array_add(result, value);
+        }
+        g_ptr_array_sort(result, traffic_compare);
+    }
+
+    return result;
+}
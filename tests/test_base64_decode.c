@@ -0,0 +1,132 @@
+#include "../include/base64_decode.h"
+#include <string.h>
+
+// 短输入走标量路径；长输入由测试编码后再解码，覆盖 SSSE3/AVX2 路径和分组边界
+
+typedef struct {
+    const char *name;
+    const char *input;
+    gssize expected_len;        // -1 表示非法输入
+    const char *expected;
+} DecodeCase;
+
+static const DecodeCase decode_cases[] = {
+    { "empty", "", 0, "" },
+    { "std-padded", "aGVsbG8=", 5, "hello" },
+    { "std-unpadded", "aGVsbG8", 5, "hello" },
+    { "std-double-pad", "aGk=", 2, "hi" },
+    { "unpadded-two", "aGk", 2, "hi" },
+    { "std-alphabet", "+/8=", 2, "\xfb\xff" },
+    { "url-safe", "-_8", 2, "\xfb\xff" },
+    { "url-safe-padded", "-_8=", 2, "\xfb\xff" },
+    { "mixed-alphabet", "+_-/", 3, "\xfb\xff\xbf" },
+    { "whitespace", " aGVs\r\nbG8=\n", 5, "hello" },
+    { "stop-at-padding", "aGk=aGk=", 2, "hi" },
+    { "invalid-char", "aG*sbG8=", -1, NULL },
+    { "invalid-dot", "aGVsbG8.", -1, NULL },
+    { "invalid-high-byte", "aGVs\xc3\xa9", -1, NULL },
+};
+
+static void test_decode(gconstpointer data) {
+    const DecodeCase *test_case = (const DecodeCase*)data;
+    char *buf = g_strdup(test_case->input);
+
+    gssize n = base64_decode_inplace(buf, strlen(buf));
+    g_assert_cmpint(n, ==, test_case->expected_len);
+    if (n >= 0) {
+        g_assert_cmpmem(buf, n, test_case->expected, test_case->expected_len);
+        g_assert_cmpint(buf[n], ==, '\0');
+    }
+    g_free(buf);
+}
+
+static char* encode(const guchar *data, gsize len, gboolean url_safe, gboolean padded, guint wrap) {
+    const char *alphabet = url_safe ? "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"
+                                    : "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    GString *out = g_string_new(NULL);
+
+    for (gsize i = 0; i < len; i += 3) {
+        guint32 v = (guint32)data[i] << 16;
+        if (i + 1 < len) v |= (guint32)data[i + 1] << 8;
+        if (i + 2 < len) v |= data[i + 2];
+
+        gsize chars = MIN(len - i, 3) + 1;
+        for (gsize k = 0; k < 4; k++) {
+            if (wrap && out->len % (wrap + 1) == wrap) g_string_append_c(out, '\n');
+            if (k < chars) {
+                g_string_append_c(out, alphabet[(v >> (18 - 6 * k)) & 0x3f]);
+            } else if (padded) {
+                g_string_append_c(out, '=');
+            }
+        }
+    }
+    return g_string_free(out, FALSE);
+}
+
+typedef struct {
+    const char *name;
+    gboolean url_safe;
+    gboolean padded;
+    guint wrap;                 // 每多少个字符插入换行，0 表示不换行
+} LongCase;
+
+static const LongCase long_cases[] = {
+    { "std", FALSE, TRUE, 0 },
+    { "url-safe-unpadded", TRUE, FALSE, 0 },
+    { "wrapped", FALSE, TRUE, 76 },
+    { "wrapped-odd", TRUE, FALSE, 37 },
+};
+
+// 每种长度 (0..300 字节) 都解码回原数据，覆盖向量路径之后的尾部
+static void test_long(gconstpointer data) {
+    const LongCase *test_case = (const LongCase*)data;
+    guchar raw[300];
+
+    for (gsize i = 0; i < sizeof(raw); i++) {
+        raw[i] = (guchar)(i * 37 + 11);
+    }
+
+    for (gsize len = 0; len <= sizeof(raw); len++) {
+        char *text = encode(raw, len, test_case->url_safe, test_case->padded, test_case->wrap);
+        g_assert_cmpint(base64_decode_inplace(text, strlen(text)), ==, (gssize)len);
+        g_assert_cmpmem(text, len, raw, len);
+        g_free(text);
+    }
+}
+
+// 非法字符出现在长输入的任意位置（包括向量路径处理的块内）都要报错
+static void test_long_invalid(void) {
+    guchar raw[120];
+
+    for (gsize i = 0; i < sizeof(raw); i++) {
+        raw[i] = (guchar)(i * 53);
+    }
+    char *encoded = encode(raw, sizeof(raw), FALSE, TRUE, 0);
+    gsize len = strlen(encoded);
+
+    for (gsize pos = 0; pos < len; pos++) {
+        char *text = g_strdup(encoded);
+        text[pos] = '*';
+        g_assert_cmpint(base64_decode_inplace(text, len), ==, -1);
+        g_free(text);
+    }
+    g_free(encoded);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    for (gsize i = 0; i < G_N_ELEMENTS(decode_cases); i++) {
+        char *path = g_strdup_printf("/base64/decode/%s", decode_cases[i].name);
+        g_test_add_data_func(path, &decode_cases[i], test_decode);
+        g_free(path);
+    }
+    for (gsize i = 0; i < G_N_ELEMENTS(long_cases); i++) {
+        char *path = g_strdup_printf("/base64/long/%s", long_cases[i].name);
+        g_test_add_data_func(path, &long_cases[i], test_long);
+        g_free(path);
+    }
+    g_test_add_func("/base64/long/invalid", test_long_invalid);
+
+    return g_test_run();
+}
@@ -0,0 +1,179 @@
+#include "../include/geo_assets.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+// 合成的 geo 数据文件：列表项 = 字段 1 (LEN)，项内字段 1 是类别代码，字段 2 是占位数据
+// 第二个 "cn" 项用来检查重复类别只保留第一项
+
+typedef struct {
+    const char *code;
+    const char *payload;
+} GeoEntry;
+
+static const GeoEntry geo_entries[] = {
+    { "private", "10.0.0.0/8" },
+    { "CN", "1.0.1.0/24" },
+    { "category-ads-all", "ads.example" },
+    { "us", "3.0.0.0/8" },
+    { "cn", "duplicate" },
+};
+
+typedef struct {
+    const char *name;
+    const char *codes[4];
+    guint expected[4];          // 输出中各项在 geo_entries 中的下标，以 G_MAXUINT 结尾
+    gint error_code;            // 期望的 G_FILE_ERROR 错误码，-1 表示成功
+} TrimCase;
+
+static const TrimCase trim_cases[] = {
+    { "single", { "cn", NULL }, { 1, G_MAXUINT }, -1 },
+    { "case-insensitive", { "CN", "Category-Ads-All", NULL }, { 1, 2, G_MAXUINT }, -1 },
+    { "file-order", { "us", "private", NULL }, { 0, 3, G_MAXUINT }, -1 },
+    { "missing", { "cn", "ru", NULL }, { G_MAXUINT }, G_FILE_ERROR_NOENT },
+    { "empty", { NULL }, { G_MAXUINT }, G_FILE_ERROR_INVAL },
+};
+
+static void append_field(GString *out, const char *data, gsize len) {
+    g_string_append_c(out, (1 << 3) | 2);
+    g_string_append_c(out, (char)len);
+    g_string_append_len(out, data, (gssize)len);
+}
+
+static void append_entry(GString *out, const GeoEntry *entry) {
+    GString *inner = g_string_new(NULL);
+
+    append_field(inner, entry->code, strlen(entry->code));
+    g_string_append_c(inner, (2 << 3) | 2);
+    g_string_append_c(inner, (char)strlen(entry->payload));
+    g_string_append(inner, entry->payload);
+    append_field(out, inner->str, inner->len);
+    g_string_free(inner, TRUE);
+}
+
+typedef struct {
+    char *dir;
+    char *src;
+    char *dst;
+} Fixture;
+
+static void fixture_setup(Fixture *fixture, gconstpointer data) {
+    (void)data;
+    GString *contents = g_string_new(NULL);
+
+    for (gsize i = 0; i < G_N_ELEMENTS(geo_entries); i++) {
+        append_entry(contents, &geo_entries[i]);
+    }
+
+    fixture->dir = g_dir_make_tmp("geo-assets-XXXXXX", NULL);
+    g_assert_nonnull(fixture->dir);
+    fixture->src = g_build_filename(fixture->dir, "geosite.dat", NULL);
+    fixture->dst = g_build_filename(fixture->dir, "geosite-lite.dat", NULL);
+    g_assert_true(g_file_set_contents(fixture->src, contents->str, (gssize)contents->len, NULL));
+    g_string_free(contents, TRUE);
+}
+
+static void fixture_teardown(Fixture *fixture, gconstpointer data) {
+    (void)data;
+    char *record = g_strconcat(fixture->dst, ".codes", NULL);
+
+    g_unlink(record);
+    g_unlink(fixture->dst);
+    g_unlink(fixture->src);
+    g_rmdir(fixture->dir);
+    g_free(record);
+    g_free(fixture->dst);
+    g_free(fixture->src);
+    g_free(fixture->dir);
+}
+
+static void assert_file_contents(const char *path, const char *expected, gsize expected_len) {
+    char *contents = NULL;
+    gsize len = 0;
+
+    g_assert_true(g_file_get_contents(path, &contents, &len, NULL));
+    g_assert_cmpmem(contents, len, expected, expected_len);
+    g_free(contents);
+}
+
+static void test_trim(Fixture *fixture, gconstpointer data) {
+    const TrimCase *test_case = (const TrimCase*)data;
+    GError *error = NULL;
+
+    gboolean ok = geo_assets_trim(fixture->src, fixture->dst, test_case->codes, &error);
+    if (test_case->error_code >= 0) {
+        g_assert_false(ok);
+        g_assert_error(error, G_FILE_ERROR, test_case->error_code);
+        g_error_free(error);
+        g_assert_false(g_file_test(fixture->dst, G_FILE_TEST_EXISTS));
+        return;
+    }
+
+    g_assert_no_error(error);
+    g_assert_true(ok);
+
+    GString *expected = g_string_new(NULL);
+    for (gsize i = 0; test_case->expected[i] != G_MAXUINT; i++) {
+        append_entry(expected, &geo_entries[test_case->expected[i]]);
+    }
+    assert_file_contents(fixture->dst, expected->str, expected->len);
+    g_string_free(expected, TRUE);
+}
+
+static void test_trim_malformed(Fixture *fixture, gconstpointer data) {
+    static const char truncated[] = { (1 << 3) | 2, 0x20, (1 << 3) | 2, 0x02, 'c' };
+    static const char * const codes[] = { "cn", NULL };
+    GError *error = NULL;
+    (void)data;
+
+    g_assert_true(g_file_set_contents(fixture->src, truncated, sizeof(truncated), NULL));
+    g_assert_false(geo_assets_trim(fixture->src, fixture->dst, codes, &error));
+    g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+    g_error_free(error);
+}
+
+// 类别改变时即使目标文件比源文件新也要重新提取，类别不变时不改写
+static void test_update_codes(Fixture *fixture, gconstpointer data) {
+    static const char * const cn[] = { "cn", NULL };
+    static const char * const cn_ads[] = { "cn", "category-ads-all", NULL };
+    char *record = g_strconcat(fixture->dst, ".codes", NULL);
+    GString *expected = g_string_new(NULL);
+    (void)data;
+
+    g_assert_true(geo_assets_update(fixture->src, fixture->dst, cn, NULL));
+    append_entry(expected, &geo_entries[1]);
+    assert_file_contents(fixture->dst, expected->str, expected->len);
+    assert_file_contents(record, "cn", 2);
+
+    g_assert_true(g_file_set_contents(fixture->dst, "kept", 4, NULL));
+    g_assert_true(geo_assets_update(fixture->src, fixture->dst, cn, NULL));
+    assert_file_contents(fixture->dst, "kept", 4);
+
+    g_assert_true(geo_assets_update(fixture->src, fixture->dst, cn_ads, NULL));
+    append_entry(expected, &geo_entries[2]);
+    assert_file_contents(fixture->dst, expected->str, expected->len);
+    assert_file_contents(record, "cn\ncategory-ads-all", 19);
+
+    // 记录丢失时重新提取
+    g_assert_true(g_file_set_contents(fixture->dst, "kept", 4, NULL));
+    g_unlink(record);
+    g_assert_true(geo_assets_update(fixture->src, fixture->dst, cn_ads, NULL));
+    assert_file_contents(fixture->dst, expected->str, expected->len);
+
+    g_string_free(expected, TRUE);
+    g_free(record);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    for (gsize i = 0; i < G_N_ELEMENTS(trim_cases); i++) {
+        char *path = g_strdup_printf("/geo-assets/trim/%s", trim_cases[i].name);
+        g_test_add(path, Fixture, &trim_cases[i], fixture_setup, test_trim, fixture_teardown);
+        g_free(path);
+    }
+    g_test_add("/geo-assets/trim/malformed", Fixture, NULL, fixture_setup, test_trim_malformed,
+               fixture_teardown);
+    g_test_add("/geo-assets/update/codes", Fixture, NULL, fixture_setup, test_update_codes, fixture_teardown);
+
+    return g_test_run();
+}
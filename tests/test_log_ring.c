@@ -0,0 +1,146 @@
+#include "../include/log_ring.h"
+#include <string.h>
+
+// 按顺序追加 lines 后，从 since 读取的结果
+
+typedef struct {
+    const char *name;
+    guint max_lines;
+    gsize max_bytes;
+    const char *lines[8];
+    guint64 since;
+    const char *expected;       // log_ring_fetch 的输出
+    guint64 first_seq;
+    guint64 next_seq;
+} FetchCase;
+
+static const FetchCase fetch_cases[] = {
+    { "empty", 4, 1024, { NULL }, 0, "", 1, 1 },
+    { "all", 4, 1024, { "a", "b", "c", NULL }, 0, "a\nb\nc\n", 1, 4 },
+    { "since", 4, 1024, { "a", "b", "c", NULL }, 2, "b\nc\n", 1, 4 },
+    { "since-future", 4, 1024, { "a", "b", NULL }, 9, "", 1, 3 },
+    { "strip-newlines", 4, 1024, { "a\r\n", "b\n\n", "", NULL }, 0, "a\nb\n\n", 1, 4 },
+    { "evict-lines", 3, 1024, { "a", "b", "c", "d", "e", NULL }, 0, "c\nd\ne\n", 3, 6 },
+    { "evict-since-evicted", 3, 1024, { "a", "b", "c", "d", "e", NULL }, 1, "c\nd\ne\n", 3, 6 },
+    { "evict-bytes", 8, 6, { "aa", "bb", "cc", "dd", NULL }, 0, "bb\ncc\ndd\n", 2, 5 },
+    { "oversized-line", 8, 2, { "a", "bcdef", NULL }, 0, "bcdef\n", 2, 3 },
+    { "single-slot", 0, 1024, { "a", "b", NULL }, 0, "b\n", 2, 3 },
+};
+
+static LogRing* ring_with_lines(guint max_lines, gsize max_bytes, const char * const *lines) {
+    LogRing *ring = log_ring_new(max_lines, max_bytes);
+
+    for (gsize i = 0; lines[i]; i++) {
+        log_ring_append(ring, i % 2 ? LOG_RING_STREAM_STDERR : LOG_RING_STREAM_STDOUT, lines[i], -1);
+    }
+    return ring;
+}
+
+static void test_fetch(gconstpointer data) {
+    const FetchCase *test_case = (const FetchCase*)data;
+    LogRing *ring = ring_with_lines(test_case->max_lines, test_case->max_bytes, test_case->lines);
+    GString *out = g_string_new(NULL);
+
+    g_assert_cmpuint(log_ring_fetch(ring, test_case->since, out), ==, test_case->next_seq);
+    g_assert_cmpstr(out->str, ==, test_case->expected);
+    g_assert_cmpuint(log_ring_first_seq(ring), ==, test_case->first_seq);
+    g_assert_cmpuint(ring->bytes, <=, MAX(ring->max_bytes, LOG_RING_MAX_LINE_LEN));
+
+    g_string_free(out, TRUE);
+    log_ring_free(ring);
+}
+
+typedef struct {
+    guint64 seq[8];
+    LogRingStream stream[8];
+    guint count;
+} Collected;
+
+static void collect(const LogRingEntry *entry, gpointer user_data) {
+    Collected *collected = (Collected*)user_data;
+
+    g_assert_cmpuint(collected->count, <, G_N_ELEMENTS(collected->seq));
+    collected->seq[collected->count] = entry->seq;
+    collected->stream[collected->count] = entry->stream;
+    collected->count++;
+}
+
+// 序号在淘汰和环绕后仍连续，来源随行保存
+static void test_foreach_wraparound(void) {
+    static const char * const lines[] = { "1", "2", "3", "4", "5", "6", "7", NULL };
+    LogRing *ring = ring_with_lines(3, 1024, lines);
+    Collected collected = { { 0 }, { 0 }, 0 };
+
+    g_assert_cmpuint(log_ring_foreach(ring, 0, collect, &collected), ==, 8);
+    g_assert_cmpuint(collected.count, ==, 3);
+    for (guint i = 0; i < collected.count; i++) {
+        g_assert_cmpuint(collected.seq[i], ==, 5 + i);
+        g_assert_cmpint(collected.stream[i], ==, (5 + i - 1) % 2 ? LOG_RING_STREAM_STDERR : LOG_RING_STREAM_STDOUT);
+    }
+
+    log_ring_free(ring);
+}
+
+static void test_truncate(void) {
+    LogRing *ring = log_ring_new(2, LOG_RING_MAX_LINE_LEN * 2);
+    char *line = g_strnfill(LOG_RING_MAX_LINE_LEN + 100, 'x');
+    GString *out = g_string_new(NULL);
+
+    log_ring_append(ring, LOG_RING_STREAM_STDOUT, line, -1);
+    log_ring_fetch(ring, 0, out);
+    g_assert_cmpuint(out->len, ==, LOG_RING_MAX_LINE_LEN + 1);
+    g_assert_cmpuint(ring->bytes, ==, LOG_RING_MAX_LINE_LEN);
+
+    g_string_free(out, TRUE);
+    g_free(line);
+    log_ring_free(ring);
+}
+
+// 缩小容量保留最新的行，扩大容量后可继续追加，清空后序号不回退
+static void test_set_limits(void) {
+    static const char * const lines[] = { "a", "b", "c", "d", "e", NULL };
+    LogRing *ring = ring_with_lines(4, 1024, lines);
+    GString *out = g_string_new(NULL);
+
+    log_ring_set_limits(ring, 2, 1024);
+    log_ring_fetch(ring, 0, out);
+    g_assert_cmpstr(out->str, ==, "d\ne\n");
+    g_assert_cmpuint(log_ring_first_seq(ring), ==, 4);
+
+    log_ring_set_limits(ring, 4, 1024);
+    log_ring_append(ring, LOG_RING_STREAM_STDOUT, "f", -1);
+    log_ring_append(ring, LOG_RING_STREAM_STDOUT, "g", -1);
+    g_string_truncate(out, 0);
+    g_assert_cmpuint(log_ring_fetch(ring, 0, out), ==, 8);
+    g_assert_cmpstr(out->str, ==, "d\ne\nf\ng\n");
+
+    log_ring_set_limits(ring, 4, 2);
+    g_string_truncate(out, 0);
+    log_ring_fetch(ring, 0, out);
+    g_assert_cmpstr(out->str, ==, "f\ng\n");
+
+    log_ring_clear(ring);
+    g_assert_cmpuint(log_ring_first_seq(ring), ==, 8);
+    log_ring_append(ring, LOG_RING_STREAM_STDOUT, "h", 1);
+    g_string_truncate(out, 0);
+    g_assert_cmpuint(log_ring_fetch(ring, 8, out), ==, 9);
+    g_assert_cmpstr(out->str, ==, "h\n");
+
+    g_string_free(out, TRUE);
+    log_ring_free(ring);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    for (gsize i = 0; i < G_N_ELEMENTS(fetch_cases); i++) {
+        char *path = g_strdup_printf("/log-ring/fetch/%s", fetch_cases[i].name);
+        g_test_add_data_func(path, &fetch_cases[i], test_fetch);
+        g_free(path);
+    }
+    g_test_add_func("/log-ring/foreach-wraparound", test_foreach_wraparound);
+    g_test_add_func("/log-ring/truncate", test_truncate);
+    g_test_add_func("/log-ring/set-limits", test_set_limits);
+
+    return g_test_run();
+}
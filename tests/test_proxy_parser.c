@@ -0,0 +1,663 @@
+#include "../include/proxy_parser.h"
+#include <json-c/json.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 链接解析：提取的字段与链接一致，不完整或无法连接的链接被拒绝
+// 各协议的字段统一比较：secret 是 SS/Trojan 的密码或 VMess/VLESS 的 id，
+// security 是 SS 的加密方法、VMess 的 tls 或 VLESS 的 security
+
+typedef struct {
+    const char *name;
+    const char *url;
+    ProxyType type;             // PROXY_TYPE_UNKNOWN 表示应拒绝
+    const char *node_name;
+    const char *address;
+    int port;
+    const char *secret;
+    const char *security;
+    const char *network;
+    const char *host;
+    const char *path;
+    const char *sni;
+    int alter_id;
+    int mux;
+} ParseCase;
+
+static const ParseCase parse_cases[] = {
+    { .name = "ss-base64-userinfo", .url = "ss://YWVzLTI1Ni1nY206cHc@example.com:8388#a",
+      .type = PROXY_TYPE_SHADOWSOCKS, .node_name = "a", .address = "example.com", .port = 8388,
+      .secret = "pw", .security = "aes-256-gcm" },
+    { .name = "ss-plain-userinfo", .url = "ss://2022-blake3-aes-128-gcm:a%2Bb%3D@example.com:8388",
+      .type = PROXY_TYPE_SHADOWSOCKS, .node_name = "Shadowsocks", .address = "example.com", .port = 8388,
+      .secret = "a+b=", .security = "2022-blake3-aes-128-gcm" },
+    // aes-256-gcm:pw@[2001:db8::1]:8388
+    { .name = "ss-legacy-ipv6", .url = "ss://YWVzLTI1Ni1nY206cHdAWzIwMDE6ZGI4OjoxXTo4Mzg4#%E8%8A%82%E7%82%B9",
+      .type = PROXY_TYPE_SHADOWSOCKS, .node_name = "节点", .address = "2001:db8::1", .port = 8388,
+      .secret = "pw", .security = "aes-256-gcm" },
+    // {"v":"2","ps":"节点 A","add":"example.com","port":443,"id":"uuid-1","aid":0,"scy":"auto",
+    //  "net":"ws","host":"h.example.com","path":"\/ws?ed=2048","tls":"tls","mux":true}
+    { .name = "vmess-escapes",
+      .url = "vmess://eyJ2IjoiMiIsInBzIjoiXHU4MjgyXHU3MGI5IEEiLCJhZGQiOiJleGFtcGxlLmNvbSIsInBvcnQiOjQ0MywiaWQiOiJ1"
+             "dWlkLTEiLCJhaWQiOjAsInNjeSI6ImF1dG8iLCJuZXQiOiJ3cyIsImhvc3QiOiJoLmV4YW1wbGUuY29tIiwicGF0aCI6Ilwvd3M/ZW"
+             "Q9MjA0OCIsInRscyI6InRscyIsIm11eCI6dHJ1ZX0=",
+      .type = PROXY_TYPE_VMESS, .node_name = "节点 A", .address = "example.com", .port = 443, .secret = "uuid-1",
+      .security = "tls", .network = "ws", .host = "h.example.com", .path = "/ws?ed=2048",
+      .mux = PROXY_MUX_DEFAULT_CONCURRENCY },
+    // { "add" : "10.0.0.1" , "port" : "8443", "id" : "uuid-2", "aid" : "2", "net" : "grpc", "path" : "svc", "mux" : 4 }
+    { .name = "vmess-string-numbers",
+      .url = "vmess://eyAiYWRkIiA6ICIxMC4wLjAuMSIgLCAicG9ydCIgOiAiODQ0MyIsICJpZCIgOiAidXVpZC0yIiwgImFpZCIgOiAiMiIsIC"
+             "JuZXQiIDogImdycGMiLCAicGF0aCIgOiAic3ZjIiwgIm11eCIgOiA0IH0",
+      .type = PROXY_TYPE_VMESS, .node_name = "VMess", .address = "10.0.0.1", .port = 8443, .secret = "uuid-2",
+      .network = "grpc", .path = "svc", .alter_id = 2, .mux = 4 },
+    { .name = "vless-percent-decoding",
+      .url = "vless://id%2D1@example.com:8443?type=ws&host=cdn.example.com&path=%2Fws%3Fed%3D2048&security=tls"
+             "&sni=s%2Eexample.com&mux=0#%E8%8A%82%E7%82%B9%201",
+      .type = PROXY_TYPE_VLESS, .node_name = "节点 1", .address = "example.com", .port = 8443, .secret = "id-1",
+      .security = "tls", .network = "ws", .host = "cdn.example.com", .path = "/ws?ed=2048", .sni = "s.example.com",
+      .mux = -1 },
+    { .name = "vless-grpc-reality", .url = "vless://id@example.com?type=grpc&serviceName=svc&security=reality&pbk=key",
+      .type = PROXY_TYPE_VLESS, .node_name = "VLess", .address = "example.com", .port = 443, .secret = "id",
+      .security = "reality", .network = "grpc", .path = "svc" },
+    { .name = "vless-ipv6", .url = "vless://id@[2001:db8::1]:8443#v6",
+      .type = PROXY_TYPE_VLESS, .node_name = "v6", .address = "2001:db8::1", .port = 8443, .secret = "id" },
+    { .name = "trojan-ipv6-default-port", .url = "trojan://p%40ss@[::1]?peer=example.org&type=ws&path=%2Fa%20b#t",
+      .type = PROXY_TYPE_TROJAN, .node_name = "t", .address = "::1", .port = 443, .secret = "p@ss",
+      .network = "ws", .path = "/a b", .sni = "example.org" },
+    { .name = "reject-vless-no-id", .url = "vless://@example.com:443", .type = PROXY_TYPE_UNKNOWN },
+    { .name = "reject-vless-no-at", .url = "vless://example.com:443", .type = PROXY_TYPE_UNKNOWN },
+    // {"add":"example.com","port":443,"ps":"no id"}
+    { .name = "reject-vmess-no-id", .url = "vmess://eyJhZGQiOiJleGFtcGxlLmNvbSIsInBvcnQiOjQ0MywicHMiOiJubyBpZCJ9",
+      .type = PROXY_TYPE_UNKNOWN },
+    { .name = "reject-trojan-bad-port", .url = "trojan://pw@example.com:70000", .type = PROXY_TYPE_UNKNOWN },
+    { .name = "reject-vless-port-text", .url = "vless://id@example.com:https", .type = PROXY_TYPE_UNKNOWN },
+    { .name = "reject-ss-no-port", .url = "ss://YWVzLTI1Ni1nY206cHc@example.com", .type = PROXY_TYPE_UNKNOWN },
+    // {"add":"example.com","port":70000,"id":"u"}
+    { .name = "reject-vmess-bad-port", .url = "vmess://eyJhZGQiOiJleGFtcGxlLmNvbSIsInBvcnQiOjcwMDAwLCJpZCI6InUifQ==",
+      .type = PROXY_TYPE_UNKNOWN },
+    { .name = "reject-reality-no-pbk", .url = "vless://id@example.com:443?security=reality&sid=01",
+      .type = PROXY_TYPE_UNKNOWN },
+    // {"add":"example.com","port":443,"id":"u"
+    { .name = "reject-vmess-truncated", .url = "vmess://eyJhZGQiOiJleGFtcGxlLmNvbSIsInBvcnQiOjQ0MywiaWQiOiJ1Ig==",
+      .type = PROXY_TYPE_UNKNOWN },
+    // {"add":"example.com","port":443,"id":"u","ps":"ab
+    { .name = "reject-vmess-truncated-string",
+      .url = "vmess://eyJhZGQiOiJleGFtcGxlLmNvbSIsInBvcnQiOjQ0MywiaWQiOiJ1IiwicHMiOiJhYg==",
+      .type = PROXY_TYPE_UNKNOWN },
+    { .name = "reject-vmess-not-base64", .url = "vmess://{not base64}", .type = PROXY_TYPE_UNKNOWN },
+    { .name = "reject-unknown-scheme", .url = "socks://example.com:1080", .type = PROXY_TYPE_UNKNOWN },
+};
+
+// 各协议的字段按 ParseCase 的列取出
+static void parsed_fields(const ProxyConfig *config, ParseCase *out) {
+    memset(out, 0, sizeof(*out));
+    out->type = config->type;
+    out->node_name = config->name;
+    out->mux = config->mux;
+
+    switch (config->type) {
+        case PROXY_TYPE_SHADOWSOCKS: {
+            const SSConfig *c = &config->config.ss;
+            out->address = c->server;
+            out->port = c->port;
+            out->secret = c->password;
+            out->security = c->method;
+            break;
+        }
+        case PROXY_TYPE_VMESS: {
+            const VMessConfig *c = &config->config.vmess;
+            out->address = c->address;
+            out->port = c->port;
+            out->secret = c->id;
+            out->security = c->tls;
+            out->network = c->network;
+            out->host = c->host;
+            out->path = c->path;
+            out->sni = c->sni;
+            out->alter_id = c->alter_id;
+            break;
+        }
+        case PROXY_TYPE_VLESS: {
+            const VLessConfig *c = &config->config.vless;
+            out->address = c->address;
+            out->port = c->port;
+            out->secret = c->id;
+            out->security = c->security;
+            out->network = c->network;
+            out->host = c->host;
+            out->path = c->path;
+            out->sni = c->sni;
+            break;
+        }
+        case PROXY_TYPE_TROJAN: {
+            const TrojanConfig *c = &config->config.trojan;
+            out->address = c->address;
+            out->port = c->port;
+            out->secret = c->password;
+            out->network = c->network;
+            out->host = c->host;
+            out->path = c->path;
+            out->sni = c->sni;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void test_parse(gconstpointer data) {
+    const ParseCase *test_case = (const ParseCase*)data;
+    ProxyConfig *config = proxy_parser_parse(test_case->url);
+
+    if (test_case->type == PROXY_TYPE_UNKNOWN) {
+        g_assert_null(config);
+        return;
+    }
+
+    g_assert_nonnull(config);
+    ParseCase got;
+    parsed_fields(config, &got);
+    g_assert_cmpint(got.type, ==, test_case->type);
+    g_assert_cmpstr(got.node_name, ==, test_case->node_name);
+    g_assert_cmpstr(got.address, ==, test_case->address);
+    g_assert_cmpint(got.port, ==, test_case->port);
+    g_assert_cmpstr(got.secret, ==, test_case->secret);
+    g_assert_cmpstr(got.security, ==, test_case->security);
+    g_assert_cmpstr(got.network, ==, test_case->network);
+    g_assert_cmpstr(got.host, ==, test_case->host);
+    g_assert_cmpstr(got.path, ==, test_case->path);
+    g_assert_cmpstr(got.sni, ==, test_case->sni);
+    g_assert_cmpint(got.alter_id, ==, test_case->alter_id);
+    g_assert_cmpint(got.mux, ==, test_case->mux);
+
+    proxy_parser_free(config);
+}
+
+// 节点指纹：同一节点的不同写法指纹相同，凭据或传输参数不同则指纹不同
+// 指纹用于订阅同步时识别已有节点，计算方式改变会让所有节点的状态在升级后丢失，
+// 所以固定几个已知值
+
+typedef struct {
+    const char *name;
+    const char *a;
+    const char *b;
+    gboolean same;
+} FingerprintCase;
+
+static const FingerprintCase fingerprint_cases[] = {
+    { "name-ignored", "trojan://pw@example.com:443#one", "trojan://pw@example.com:443#two", TRUE },
+    { "host-case", "trojan://pw@Example.COM:443", "trojan://pw@example.com:443", TRUE },
+    { "mux-ignored", "vless://id@example.com:443?security=tls&mux=8", "vless://id@example.com:443?security=tls",
+      TRUE },
+    { "default-network", "vless://id@example.com:443?type=tcp&headerType=none",
+      "vless://id@example.com:443", TRUE },
+    { "default-security", "vless://id@example.com:443?security=none", "vless://id@example.com:443", TRUE },
+    { "uuid-case", "vless://ABCDEF@example.com:443", "vless://abcdef@example.com:443", TRUE },
+    { "vmess-default-network",
+      // {"add":"example.com","port":"443","id":"u","net":"tcp","type":"none","ps":"a"}
+      "vmess://eyJhZGQiOiJleGFtcGxlLmNvbSIsInBvcnQiOiI0NDMiLCJpZCI6InUiLCJuZXQiOiJ0Y3AiLCJ0eXBlIjoibm9uZSIsInBzIjoiYSJ9",
+      // {"add":"EXAMPLE.com","port":443,"id":"u","ps":"b"}
+      "vmess://eyJhZGQiOiJFWEFNUExFLmNvbSIsInBvcnQiOjQ0MywiaWQiOiJ1IiwicHMiOiJiIn0", TRUE },
+    { "ss-sip002-legacy", "ss://YWVzLTI1Ni1nY206cHc@example.com:8388#a",
+      // aes-256-gcm:pw@example.com:8388
+      "ss://YWVzLTI1Ni1nY206cHdAZXhhbXBsZS5jb206ODM4OA==#b", TRUE },
+    { "password-case", "trojan://pw@example.com:443", "trojan://PW@example.com:443", FALSE },
+    { "port", "trojan://pw@example.com:443", "trojan://pw@example.com:8443", FALSE },
+    { "protocol", "trojan://id@example.com:443", "vless://id@example.com:443", FALSE },
+    { "path", "vless://id@example.com:443?type=ws&path=%2Fa", "vless://id@example.com:443?type=ws&path=%2Fb",
+      FALSE },
+    { "network", "vless://id@example.com:443?type=ws", "vless://id@example.com:443?type=grpc", FALSE },
+    { "flow", "vless://id@example.com:443?security=tls&flow=xtls-rprx-vision",
+      "vless://id@example.com:443?security=tls", FALSE },
+    { "default-encryption", "vless://id@example.com:443?encryption=none", "vless://id@example.com:443", TRUE },
+    { "encryption", "vless://id@example.com:443?encryption=mlkem768x25519plus.native.0rtt.key",
+      "vless://id@example.com:443", FALSE },
+    { "field-boundary", "vless://id@example.com:443?type=ws&host=ab&path=c",
+      "vless://id@example.com:443?type=ws&host=a&path=bc", FALSE },
+};
+
+typedef struct {
+    const char *url;
+    guint64 fingerprint;
+} KnownFingerprint;
+
+static const KnownFingerprint known_fingerprints[] = {
+    { "ss://YWVzLTI1Ni1nY206cHc@example.com:8388", G_GUINT64_CONSTANT(0x6e7e0eac321d660c) },
+    { "trojan://pw@example.com:443?sni=example.org", G_GUINT64_CONSTANT(0xe7ced967816ff518) },
+    { "vless://id@example.com:443?security=reality&pbk=key&sid=01&type=grpc&serviceName=svc",
+      G_GUINT64_CONSTANT(0x30ddac41c160d66d) },
+};
+
+static guint64 url_fingerprint(const char *url) {
+    ProxyConfig *config = proxy_parser_parse(url);
+    g_assert_nonnull(config);
+
+    guint64 fingerprint = proxy_parser_fingerprint(config);
+    proxy_parser_free(config);
+    return fingerprint;
+}
+
+static void test_fingerprint(gconstpointer data) {
+    const FingerprintCase *test_case = (const FingerprintCase*)data;
+    guint64 a = url_fingerprint(test_case->a);
+    guint64 b = url_fingerprint(test_case->b);
+
+    if (test_case->same) {
+        g_assert_cmphex(a, ==, b);
+    } else {
+        g_assert_cmphex(a, !=, b);
+    }
+}
+
+static void test_fingerprint_known(void) {
+    for (gsize i = 0; i < G_N_ELEMENTS(known_fingerprints); i++) {
+        g_assert_cmphex(url_fingerprint(known_fingerprints[i].url), ==, known_fingerprints[i].fingerprint);
+    }
+}
+
+// 配置哈希：生成器的每个输入都要改变哈希，且改变生成的配置；
+// 哈希相同时生成的配置相同，管理器据此跳过重写和重启
+
+static const char * const hash_nodes[] = {
+    "vless://id@example.com:443?security=tls&fp=firefox#a",
+    "trojan://pw@example.org:443?sni=example.org#b",
+};
+
+static char *changed_direct_cidrs[] = { (char*)PROXY_VPN_SUBNET, (char*)"192.168.0.0/16", NULL };
+static char *block_cidrs[] = { (char*)"10.1.0.0/16", NULL };
+
+// 与默认规则内容相同，也与 NULL 的哈希相同
+static char *default_direct_cidrs[] = { (char*)PROXY_VPN_SUBNET, NULL };
+static const ProxyRouteRules default_routes = { FALSE, TRUE, TRUE, TRUE, default_direct_cidrs, NULL };
+static const ProxyRouteRules direct_routes = { TRUE, TRUE, TRUE, TRUE, default_direct_cidrs, NULL };
+static const ProxyRouteRules no_ads_routes = { FALSE, TRUE, TRUE, FALSE, default_direct_cidrs, NULL };
+static const ProxyRouteRules cidr_routes = { FALSE, TRUE, TRUE, TRUE, changed_direct_cidrs, NULL };
+// 同一个 CIDR 从直连列表移到阻断列表
+static const ProxyRouteRules moved_routes = { FALSE, TRUE, TRUE, TRUE, NULL, block_cidrs };
+static const ProxyRouteRules kept_routes = { FALSE, TRUE, TRUE, TRUE, block_cidrs, NULL };
+
+typedef struct {
+    const char *name;
+    void (*mutate)(ProxyGenOptions *opts, ProxyConfig **configs);
+    gboolean same;
+} HashCase;
+
+static void mutate_none(ProxyGenOptions *opts, ProxyConfig **configs) { (void)opts; (void)configs; }
+static void mutate_port(ProxyGenOptions *opts, ProxyConfig **configs) { (void)configs; opts->local_port++; }
+static void mutate_fakeip(ProxyGenOptions *opts, ProxyConfig **configs) { (void)configs; opts->fakeip = TRUE; }
+static void mutate_api(ProxyGenOptions *opts, ProxyConfig **configs) { (void)configs; opts->api_port = 10085; }
+static void mutate_probe(ProxyGenOptions *opts, ProxyConfig **configs) {
+    (void)configs;
+    opts->probe_url = "https://example.net/generate_204";
+}
+static void mutate_mux(ProxyGenOptions *opts, ProxyConfig **configs) { (void)configs; opts->mux_concurrency = 8; }
+static void mutate_node_mux(ProxyGenOptions *opts, ProxyConfig **configs) { (void)opts; configs[1]->mux = 4; }
+static void mutate_node_encryption(ProxyGenOptions *opts, ProxyConfig **configs) {
+    (void)opts;
+    // 字段指向节点自身的内存块，不单独释放
+    configs[0]->config.vless.encryption = (char*)"mlkem768x25519plus.native.0rtt.key";
+}
+static void mutate_profile(ProxyGenOptions *opts, ProxyConfig **configs) {
+    (void)configs;
+    opts->profile = PROXY_PROFILE_BULK;
+}
+static void mutate_xtls(ProxyGenOptions *opts, ProxyConfig **configs) { (void)configs; opts->xtls = TRUE; }
+static void mutate_geo_lite(ProxyGenOptions *opts, ProxyConfig **configs) { (void)configs; opts->geo_lite = TRUE; }
+static void mutate_final_direct(ProxyGenOptions *opts, ProxyConfig **configs) {
+    (void)configs;
+    opts->routes = &direct_routes;
+}
+static void mutate_no_ads(ProxyGenOptions *opts, ProxyConfig **configs) {
+    (void)configs;
+    opts->routes = &no_ads_routes;
+}
+static void mutate_cidrs(ProxyGenOptions *opts, ProxyConfig **configs) {
+    (void)configs;
+    opts->routes = &cidr_routes;
+}
+static void mutate_default_routes(ProxyGenOptions *opts, ProxyConfig **configs) {
+    (void)configs;
+    opts->routes = &default_routes;
+}
+static void mutate_order(ProxyGenOptions *opts, ProxyConfig **configs) {
+    (void)opts;
+    ProxyConfig *first = configs[0];
+    configs[0] = configs[1];
+    configs[1] = first;
+}
+
+static const HashCase hash_cases[] = {
+    { "unchanged", mutate_none, TRUE },
+    { "explicit-default-routes", mutate_default_routes, TRUE },
+    { "local-port", mutate_port, FALSE },
+    { "fakeip", mutate_fakeip, FALSE },
+    { "api-port", mutate_api, FALSE },
+    { "probe-url", mutate_probe, FALSE },
+    { "mux", mutate_mux, FALSE },
+    { "node-mux", mutate_node_mux, FALSE },
+    { "node-encryption", mutate_node_encryption, FALSE },
+    { "profile", mutate_profile, FALSE },
+    { "xtls", mutate_xtls, FALSE },
+    { "geo-lite", mutate_geo_lite, FALSE },
+    { "final-direct", mutate_final_direct, FALSE },
+    { "no-ads", mutate_no_ads, FALSE },
+    { "cidrs", mutate_cidrs, FALSE },
+    { "node-order", mutate_order, FALSE },
+};
+
+static void parse_hash_nodes(ProxyConfig **configs) {
+    for (gsize i = 0; i < G_N_ELEMENTS(hash_nodes); i++) {
+        configs[i] = proxy_parser_parse(hash_nodes[i]);
+        g_assert_nonnull(configs[i]);
+    }
+}
+
+static void free_hash_nodes(ProxyConfig **configs) {
+    for (gsize i = 0; i < G_N_ELEMENTS(hash_nodes); i++) {
+        proxy_parser_free(configs[i]);
+    }
+}
+
+static void test_config_hash(gconstpointer data) {
+    const HashCase *test_case = (const HashCase*)data;
+    ProxyConfig *configs[G_N_ELEMENTS(hash_nodes)];
+    ProxyGenOptions opts;
+
+    parse_hash_nodes(configs);
+    proxy_parser_gen_options_init(&opts, 10808);
+    guint64 base = proxy_parser_config_hash(configs, G_N_ELEMENTS(configs), &opts);
+    char *base_json = proxy_parser_generate_v2ray_config_multi(configs, G_N_ELEMENTS(configs), &opts);
+
+    test_case->mutate(&opts, configs);
+    guint64 hash = proxy_parser_config_hash(configs, G_N_ELEMENTS(configs), &opts);
+    char *json = proxy_parser_generate_v2ray_config_multi(configs, G_N_ELEMENTS(configs), &opts);
+
+    // 同样的输入再算一次，哈希不依赖指针或未初始化的内存
+    g_assert_cmphex(hash, ==, proxy_parser_config_hash(configs, G_N_ELEMENTS(configs), &opts));
+    if (test_case->same) {
+        g_assert_cmphex(hash, ==, base);
+        g_assert_cmpstr(json, ==, base_json);
+    } else {
+        g_assert_cmphex(hash, !=, base);
+        g_assert_cmpstr(json, !=, base_json);
+    }
+
+    g_free(json);
+    g_free(base_json);
+    free_hash_nodes(configs);
+}
+
+// 节点名称不写入配置，也不在哈希中：改名不需要重启内核
+static void test_config_hash_name(void) {
+    static const char * const renamed[] = {
+        "vless://id@example.com:443?security=tls&fp=firefox#renamed",
+        "trojan://pw@example.org:443?sni=example.org#b",
+    };
+    ProxyConfig *configs[G_N_ELEMENTS(hash_nodes)];
+    ProxyConfig *renamed_configs[G_N_ELEMENTS(renamed)];
+    ProxyGenOptions opts;
+
+    parse_hash_nodes(configs);
+    for (gsize i = 0; i < G_N_ELEMENTS(renamed); i++) {
+        renamed_configs[i] = proxy_parser_parse(renamed[i]);
+    }
+    proxy_parser_gen_options_init(&opts, 10808);
+
+    g_assert_cmphex(proxy_parser_config_hash(configs, G_N_ELEMENTS(configs), &opts), ==,
+                    proxy_parser_config_hash(renamed_configs, G_N_ELEMENTS(renamed_configs), &opts));
+    char *json = proxy_parser_generate_v2ray_config_multi(configs, G_N_ELEMENTS(configs), &opts);
+    char *renamed_json = proxy_parser_generate_v2ray_config_multi(renamed_configs, G_N_ELEMENTS(renamed_configs),
+                                                                  &opts);
+    g_assert_cmpstr(json, ==, renamed_json);
+    g_free(renamed_json);
+    g_free(json);
+
+    // CIDR 在直连和阻断列表之间移动时哈希不同
+    opts.routes = &kept_routes;
+    guint64 kept = proxy_parser_config_hash(configs, G_N_ELEMENTS(configs), &opts);
+    opts.routes = &moved_routes;
+    g_assert_cmphex(kept, !=, proxy_parser_config_hash(configs, G_N_ELEMENTS(configs), &opts));
+
+    for (gsize i = 0; i < G_N_ELEMENTS(renamed); i++) {
+        proxy_parser_free(renamed_configs[i]);
+    }
+    free_hash_nodes(configs);
+}
+
+// 生成的配置：用 json-c 解析后检查代理出站的 streamSettings、mux 和 sockopt
+
+typedef struct {
+    const char *path;           // 相对代理出站的路径，用 . 分隔，数组元素写序号
+    const char *value;          // json_object_get_string 的结果，NULL 表示不应存在
+} OutboundField;
+
+typedef struct {
+    const char *name;
+    const char *url;
+    ProxyProfile profile;
+    int mux_concurrency;
+    gboolean xudp;
+    OutboundField fields[10];   // 以 path 为 NULL 结尾
+} GenerateCase;
+
+static const GenerateCase generate_cases[] = {
+    // {"v":"2","ps":"节点 A","add":"example.com","port":443,"id":"uuid-1","aid":0,"scy":"auto",
+    //  "net":"ws","host":"h.example.com","path":"\/ws?ed=2048","tls":"tls","mux":true}
+    { "vmess-ws-tls",
+      "vmess://eyJ2IjoiMiIsInBzIjoiXHU4MjgyXHU3MGI5IEEiLCJhZGQiOiJleGFtcGxlLmNvbSIsInBvcnQiOjQ0MywiaWQiOiJ1dWlkLTEi"
+      "LCJhaWQiOjAsInNjeSI6ImF1dG8iLCJuZXQiOiJ3cyIsImhvc3QiOiJoLmV4YW1wbGUuY29tIiwicGF0aCI6Ilwvd3M/ZWQ9MjA0OCIsInRs"
+      "cyI6InRscyIsIm11eCI6dHJ1ZX0=",
+      PROXY_PROFILE_DEFAULT, 0, FALSE,
+      { { "protocol", "vmess" },
+        { "settings.vnext.0.users.0.id", "uuid-1" },
+        { "streamSettings.network", "ws" },
+        { "streamSettings.wsSettings.path", "/ws?ed=2048" },
+        { "streamSettings.wsSettings.headers.Host", "h.example.com" },
+        { "streamSettings.security", "tls" },
+        { "streamSettings.tlsSettings.serverName", "h.example.com" },
+        { "streamSettings.sockopt.mark", "255" },
+        { "mux.concurrency", "8" },
+        { NULL, NULL } } },
+    { "vless-reality-vision", "vless://id@example.com:443?security=reality&pbk=key&sid=ab&flow=xtls-rprx-vision",
+      PROXY_PROFILE_DEFAULT, 8, FALSE,
+      { { "protocol", "vless" },
+        { "settings.vnext.0.users.0.flow", "xtls-rprx-vision" },
+        { "settings.vnext.0.users.0.encryption", "none" },
+        { "streamSettings.network", "tcp" },
+        { "streamSettings.security", "reality" },
+        { "streamSettings.realitySettings.publicKey", "key" },
+        { "streamSettings.realitySettings.shortId", "ab" },
+        { "streamSettings.realitySettings.fingerprint", "chrome" },
+        // Vision 与 Mux 不兼容，全局 Mux 不作用于这个节点
+        { "mux", NULL },
+        { NULL, NULL } } },
+    { "vless-grpc-tls", "vless://id@example.com:443?type=grpc&serviceName=svc&mode=multi&security=tls&sni=s.example.com",
+      PROXY_PROFILE_DEFAULT, 0, FALSE,
+      { { "streamSettings.network", "grpc" },
+        { "streamSettings.grpcSettings.serviceName", "svc" },
+        { "streamSettings.grpcSettings.multiMode", "true" },
+        { "streamSettings.tlsSettings.serverName", "s.example.com" },
+        { "streamSettings.tlsSettings.fingerprint", NULL },
+        { "streamSettings.sockopt.mark", "255" },
+        { "mux", NULL },
+        { NULL, NULL } } },
+    { "trojan-ws", "trojan://p%40ss@[2001:db8::1]:8443?peer=example.org&type=ws&host=cdn.example.org&path=%2Fws",
+      PROXY_PROFILE_DEFAULT, 0, FALSE,
+      { { "protocol", "trojan" },
+        { "settings.servers.0.address", "2001:db8::1" },
+        { "settings.servers.0.port", "8443" },
+        { "settings.servers.0.password", "p@ss" },
+        { "streamSettings.network", "ws" },
+        { "streamSettings.wsSettings.headers.Host", "cdn.example.org" },
+        { "streamSettings.security", "tls" },
+        { "streamSettings.tlsSettings.serverName", "example.org" },
+        { NULL, NULL } } },
+    // Trojan 总是使用 TLS，未写 SNI 时由内核使用服务器地址
+    { "trojan-default", "trojan://pw@example.com", PROXY_PROFILE_DEFAULT, 0, FALSE,
+      { { "settings.servers.0.port", "443" },
+        { "streamSettings.network", "tcp" },
+        { "streamSettings.security", "tls" },
+        { "streamSettings.tlsSettings.serverName", NULL },
+        { "streamSettings.sockopt.mark", "255" },
+        { NULL, NULL } } },
+    { "mux-global-xudp", "vless://id@example.com:443?type=ws&path=%2Fws&security=tls", PROXY_PROFILE_DEFAULT, 8, TRUE,
+      { { "mux.enabled", "true" },
+        { "mux.concurrency", "8" },
+        { "mux.xudpConcurrency", "16" },
+        { "mux.xudpProxyUDP443", "reject" },
+        { NULL, NULL } } },
+    // 节点的 mux 参数优先于全局设置
+    { "mux-node-disabled", "trojan://pw@example.com:443?mux=0", PROXY_PROFILE_DEFAULT, 8, TRUE,
+      { { "mux", NULL },
+        { NULL, NULL } } },
+    { "mux-node-concurrency", "trojan://pw@example.com:443?mux=4", PROXY_PROFILE_DEFAULT, 8, TRUE,
+      { { "mux.concurrency", "4" },
+        { "mux.xudpConcurrency", "16" },
+        { NULL, NULL } } },
+    { "mux-node-without-global", "trojan://pw@example.com:443?mux=4", PROXY_PROFILE_DEFAULT, 0, FALSE,
+      { { "mux.concurrency", "4" },
+        { "mux.xudpConcurrency", NULL },
+        { NULL, NULL } } },
+    // Mux 只用于 VMess/VLESS/Trojan
+    { "mux-shadowsocks", "ss://YWVzLTI1Ni1nY206cHc@example.com:8388", PROXY_PROFILE_DEFAULT, 8, TRUE,
+      { { "protocol", "shadowsocks" },
+        { "mux", NULL },
+        { NULL, NULL } } },
+    { "profile-default", "trojan://pw@example.com:443", PROXY_PROFILE_DEFAULT, 0, FALSE,
+      { { "streamSettings.sockopt.mark", "255" },
+        { "streamSettings.sockopt.tcpFastOpen", NULL },
+        { "streamSettings.sockopt.tcpKeepAliveInterval", NULL },
+        { "streamSettings.sockopt.tcpcongestion", NULL },
+        { NULL, NULL } } },
+    { "profile-low-latency", "trojan://pw@example.com:443?type=grpc&serviceName=svc",
+      PROXY_PROFILE_LOW_LATENCY, 0, FALSE,
+      { { "streamSettings.network", "grpc" },
+        { "streamSettings.sockopt.mark", "255" },
+        { "streamSettings.sockopt.tcpFastOpen", "true" },
+        { "streamSettings.sockopt.tcpKeepAliveInterval", "15" },
+        { "streamSettings.sockopt.tcpcongestion", NULL },
+        { NULL, NULL } } },
+    // 没有传输设置的协议也要带上 sockopt
+    { "profile-bulk", "ss://YWVzLTI1Ni1nY206cHc@example.com:8388", PROXY_PROFILE_BULK, 0, FALSE,
+      { { "streamSettings.network", NULL },
+        { "streamSettings.sockopt.mark", "255" },
+        { "streamSettings.sockopt.tcpcongestion", "bbr" },
+        { "streamSettings.sockopt.tcpKeepAliveInterval", "30" },
+        { "streamSettings.sockopt.tcpFastOpen", NULL },
+        { NULL, NULL } } },
+    { "profile-low-memory", "vless://id@example.com:443?security=tls", PROXY_PROFILE_LOW_MEMORY, 0, FALSE,
+      { { "streamSettings.sockopt.mark", "255" },
+        { "streamSettings.sockopt.tcpFastOpen", NULL },
+        { "streamSettings.sockopt.tcpcongestion", NULL },
+        { NULL, NULL } } },
+};
+
+// 按路径取值，数组元素用序号
+static struct json_object* json_path(struct json_object *obj, const char *path) {
+    char **parts = g_strsplit(path, ".", -1);
+
+    for (gsize i = 0; parts[i] && obj; i++) {
+        struct json_object *next = NULL;
+        if (json_object_is_type(obj, json_type_array)) {
+            gsize index = (gsize)atoi(parts[i]);
+            if (index < json_object_array_length(obj)) next = json_object_array_get_idx(obj, index);
+        } else if (!json_object_object_get_ex(obj, parts[i], &next)) {
+            next = NULL;
+        }
+        obj = next;
+    }
+
+    g_strfreev(parts);
+    return obj;
+}
+
+static void test_generate(gconstpointer data) {
+    const GenerateCase *test_case = (const GenerateCase*)data;
+    ProxyConfig *config = proxy_parser_parse(test_case->url);
+    ProxyGenOptions opts;
+
+    g_assert_nonnull(config);
+    proxy_parser_gen_options_init(&opts, 10808);
+    opts.xtls = TRUE;
+    opts.profile = test_case->profile;
+    opts.mux_concurrency = test_case->mux_concurrency;
+    opts.xudp = test_case->xudp;
+
+    char *json = proxy_parser_generate_v2ray_config_multi(&config, 1, &opts);
+    g_assert_nonnull(json);
+    struct json_object *root = json_tokener_parse(json);
+    g_assert_nonnull(root);
+
+    struct json_object *outbound = json_path(root, "outbounds.0");
+    g_assert_cmpstr(json_object_get_string(json_path(outbound, "tag")), ==, PROXY_OUTBOUND_TAG);
+    for (gsize i = 0; test_case->fields[i].path; i++) {
+        struct json_object *value = json_path(outbound, test_case->fields[i].path);
+        if (!test_case->fields[i].value) {
+            g_assert_null(value);
+        } else {
+            g_assert_nonnull(value);
+            g_assert_cmpstr(json_object_get_string(value), ==, test_case->fields[i].value);
+        }
+    }
+
+    json_object_put(root);
+    g_free(json);
+    proxy_parser_free(config);
+}
+
+// 不支持 XTLS 的内核：需要 Vision/REALITY 的节点不生成配置，而不是降级为普通 TLS
+static void test_generate_needs_xtls(void) {
+    static const char * const urls[] = {
+        "vless://id@example.com:443?security=reality&pbk=key&sid=ab",
+        "vless://id@example.com:443?security=tls&flow=xtls-rprx-vision",
+    };
+    ProxyGenOptions opts;
+
+    proxy_parser_gen_options_init(&opts, 10808);
+    for (gsize i = 0; i < G_N_ELEMENTS(urls); i++) {
+        ProxyConfig *config = proxy_parser_parse(urls[i]);
+        g_assert_nonnull(config);
+        g_assert_true(proxy_parser_needs_xtls(config));
+
+        opts.xtls = FALSE;
+        g_assert_null(proxy_parser_generate_v2ray_config_multi(&config, 1, &opts));
+        g_assert_null(proxy_parser_generate_singbox_config(&config, 1, &opts));
+
+        opts.xtls = TRUE;
+        char *json = proxy_parser_generate_v2ray_config_multi(&config, 1, &opts);
+        g_assert_nonnull(json);
+        g_assert_nonnull(strstr(json, i == 0 ? "\"realitySettings\"" : "\"xtls-rprx-vision\""));
+        g_free(json);
+        proxy_parser_free(config);
+    }
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    for (gsize i = 0; i < G_N_ELEMENTS(parse_cases); i++) {
+        char *path = g_strdup_printf("/proxy-parser/parse/%s", parse_cases[i].name);
+        g_test_add_data_func(path, &parse_cases[i], test_parse);
+        g_free(path);
+    }
+    for (gsize i = 0; i < G_N_ELEMENTS(fingerprint_cases); i++) {
+        char *path = g_strdup_printf("/proxy-parser/fingerprint/%s", fingerprint_cases[i].name);
+        g_test_add_data_func(path, &fingerprint_cases[i], test_fingerprint);
+        g_free(path);
+    }
+    g_test_add_func("/proxy-parser/fingerprint/known", test_fingerprint_known);
+    for (gsize i = 0; i < G_N_ELEMENTS(hash_cases); i++) {
+        char *path = g_strdup_printf("/proxy-parser/config-hash/%s", hash_cases[i].name);
+        g_test_add_data_func(path, &hash_cases[i], test_config_hash);
+        g_free(path);
+    }
+    g_test_add_func("/proxy-parser/config-hash/name", test_config_hash_name);
+    for (gsize i = 0; i < G_N_ELEMENTS(generate_cases); i++) {
+        char *path = g_strdup_printf("/proxy-parser/generate/%s", generate_cases[i].name);
+        g_test_add_data_func(path, &generate_cases[i], test_generate);
+        g_free(path);
+    }
+    g_test_add_func("/proxy-parser/generate/needs-xtls", test_generate_needs_xtls);
+
+    return g_test_run();
+}
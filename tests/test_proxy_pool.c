@@ -0,0 +1,247 @@
+#include "../include/proxy_pool.h"
+#include <string.h>
+
+// 节点池的指纹/名称索引：追加、同步（保留已有节点的探测状态）和清空后，
+// 每个节点都能按指纹和名称找到，移除的节点找不到
+// 节点 n 的链接是 trojan://pw<n>@h<n>.example.com:443#名称，指纹只由 n 决定
+
+#define NODE_NONE (-1)
+
+typedef struct {
+    int id;
+    const char *name;
+} NodeSpec;
+
+typedef struct {
+    const char *name;
+    NodeSpec initial[6];        // 先追加的节点，以 NODE_NONE 结尾
+    NodeSpec sync[8];           // 同步的节点，以 NODE_NONE 结尾
+    const char *order;          // 同步后的节点名称，逗号分隔
+    guint added;
+    guint kept;
+    guint removed;
+    guint duplicates;
+    guint failed;
+} SyncCase;
+
+static const SyncCase sync_cases[] = {
+    { "same", { { 1, "a" }, { 2, "b" }, { NODE_NONE, NULL } }, { { 1, "a" }, { 2, "b" }, { NODE_NONE, NULL } },
+      "a,b", 0, 2, 0, 0, 0 },
+    { "reorder-rename", { { 1, "a" }, { 2, "b" }, { 3, "c" }, { NODE_NONE, NULL } },
+      { { 3, "c" }, { 1, "renamed" }, { 4, "d" }, { NODE_NONE, NULL } }, "c,renamed,d", 1, 2, 1, 0, 0 },
+    { "replace-all", { { 1, "a" }, { 2, "b" }, { NODE_NONE, NULL } }, { { 5, "e" }, { NODE_NONE, NULL } },
+      "e", 1, 0, 2, 0, 0 },
+    { "duplicate-in-batch", { { 1, "a" }, { NODE_NONE, NULL } },
+      { { 1, "first" }, { 2, "b" }, { 1, "second" }, { NODE_NONE, NULL } }, "first,b", 1, 1, 0, 1, 0 },
+    { "from-empty", { { NODE_NONE, NULL } }, { { 1, "a" }, { 2, "b" }, { NODE_NONE, NULL } }, "a,b", 2, 0, 0, 0, 0 },
+    { "invalid-lines", { { 1, "a" }, { NODE_NONE, NULL } }, { { 0, NULL }, { 1, "a" }, { NODE_NONE, NULL } },
+      "a", 0, 1, 0, 0, 1 },
+};
+
+// id 为 0 时生成一行无法解析的链接
+static void append_node(GString *text, int id, const char *name) {
+    if (id == 0) {
+        g_string_append(text, "trojan://no-port@\n");
+    } else {
+        g_string_append_printf(text, "trojan://pw%d@h%d.example.com:443#%s\n", id, id, name);
+    }
+}
+
+static char* nodes_text(const NodeSpec *nodes) {
+    GString *text = g_string_new(NULL);
+
+    for (gsize i = 0; nodes[i].id != NODE_NONE; i++) {
+        append_node(text, nodes[i].id, nodes[i].name);
+    }
+    return g_string_free(text, FALSE);
+}
+
+// 探测状态按节点编号设置，同步后可以认出是哪个节点的状态
+static void set_probe_state(ProxyNode *node, int id) {
+    node->state = PROXY_NODE_HEALTHY;
+    node->latency_us = 1000 + id;
+    node->smoothed_us = 2000 + id;
+    node->failures = 1;
+}
+
+static guint64 node_fingerprint(int id) {
+    char *url = g_strdup_printf("trojan://pw%d@h%d.example.com:443", id, id);
+    ProxyConfig *config = proxy_parser_parse(url);
+    g_assert_nonnull(config);
+
+    guint64 fingerprint = proxy_parser_fingerprint(config);
+    proxy_parser_free(config);
+    g_free(url);
+    return fingerprint;
+}
+
+static gboolean spec_has(const NodeSpec *nodes, int id) {
+    for (gsize i = 0; nodes[i].id != NODE_NONE; i++) {
+        if (nodes[i].id == id) return TRUE;
+    }
+    return FALSE;
+}
+
+static void test_sync(gconstpointer data) {
+    const SyncCase *test_case = (const SyncCase*)data;
+    ProxyPool *pool = proxy_pool_new();
+    ProxyPoolImportStats stats;
+
+    char *initial = nodes_text(test_case->initial);
+    proxy_pool_add_text(pool, initial);
+    for (gsize i = 0; test_case->initial[i].id != NODE_NONE; i++) {
+        set_probe_state(proxy_pool_lookup(pool, node_fingerprint(test_case->initial[i].id)),
+                        test_case->initial[i].id);
+    }
+
+    char *sync = nodes_text(test_case->sync);
+    guint generation = pool->generation;
+    g_assert_cmpuint(proxy_pool_sync_text(pool, sync, &stats), ==, test_case->added);
+    g_assert_cmpuint(stats.added, ==, test_case->added);
+    g_assert_cmpuint(stats.kept, ==, test_case->kept);
+    g_assert_cmpuint(stats.removed, ==, test_case->removed);
+    g_assert_cmpuint(stats.duplicates, ==, test_case->duplicates);
+    g_assert_cmpuint(stats.failed, ==, test_case->failed);
+    g_assert_cmpuint(pool->generation, !=, generation);
+
+    GString *order = g_string_new(NULL);
+    for (guint i = 0; i < proxy_pool_size(pool); i++) {
+        ProxyNode *node = &g_array_index(pool->nodes, ProxyNode, i);
+        if (i > 0) g_string_append_c(order, ',');
+        g_string_append(order, node->name);
+
+        g_assert_true(proxy_pool_lookup(pool, node->fingerprint) == node);
+        g_assert_true(proxy_pool_lookup_name(pool, node->name) == node);
+        g_assert_false(node->probing);
+    }
+    g_assert_cmpstr(order->str, ==, test_case->order);
+
+    // 保留下来的节点沿用探测状态，新节点从未探测开始，移除的节点找不到
+    for (int id = 1; id <= 5; id++) {
+        ProxyNode *node = proxy_pool_lookup(pool, node_fingerprint(id));
+        if (!spec_has(test_case->sync, id)) {
+            g_assert_null(node);
+        } else if (spec_has(test_case->initial, id)) {
+            g_assert_cmpint(node->state, ==, PROXY_NODE_HEALTHY);
+            g_assert_cmpint(node->smoothed_us, ==, 2000 + id);
+            g_assert_cmpuint(node->failures, ==, 1);
+        } else {
+            g_assert_cmpint(node->state, ==, PROXY_NODE_UNKNOWN);
+            g_assert_cmpint(node->latency_us, ==, -1);
+        }
+    }
+    for (gsize i = 0; test_case->initial[i].id != NODE_NONE; i++) {
+        const char *name = test_case->initial[i].name;
+        ProxyNode *node = proxy_pool_lookup_name(pool, name);
+        g_assert_true(node == NULL || strcmp(node->name, name) == 0);
+    }
+
+    g_string_free(order, TRUE);
+    g_free(sync);
+    g_free(initial);
+    proxy_pool_free(pool);
+}
+
+// 只有无法解析的行时节点池保持不变
+static void test_sync_nothing_parsed(void) {
+    ProxyPool *pool = proxy_pool_new();
+    ProxyPoolImportStats stats;
+
+    proxy_pool_add_text(pool, "trojan://pw1@h1.example.com:443#a\n");
+    guint generation = pool->generation;
+    g_assert_cmpuint(proxy_pool_sync_text(pool, "trojan://no-port@\nnot a link\n", &stats), ==, 0);
+    g_assert_cmpuint(stats.failed, ==, 2);
+    g_assert_cmpuint(pool->generation, ==, generation);
+    g_assert_cmpuint(proxy_pool_size(pool), ==, 1);
+    g_assert_nonnull(proxy_pool_lookup_name(pool, "a"));
+
+    proxy_pool_free(pool);
+}
+
+// 追加：已有指纹跳过，同名节点按名称只找到第一个
+static void test_append(void) {
+    ProxyPool *pool = proxy_pool_new();
+    ProxyPoolImportStats stats;
+
+    proxy_pool_add_text(pool, "trojan://pw1@h1.example.com:443#same\n");
+    g_assert_cmpuint(proxy_pool_add_text_full(pool,
+                                              "trojan://pw1@H1.example.com:443?type=tcp#other\n"
+                                              "trojan://pw2@h2.example.com:443#same\n", &stats), ==, 1);
+    g_assert_cmpuint(stats.duplicates, ==, 1);
+    g_assert_cmpuint(proxy_pool_size(pool), ==, 2);
+    g_assert_true(proxy_pool_lookup_name(pool, "same") == proxy_pool_lookup(pool, node_fingerprint(1)));
+    g_assert_null(proxy_pool_lookup_name(pool, "other"));
+
+    proxy_pool_clear(pool);
+    g_assert_cmpuint(proxy_pool_size(pool), ==, 0);
+    g_assert_null(proxy_pool_lookup(pool, node_fingerprint(1)));
+    g_assert_null(proxy_pool_lookup_name(pool, "same"));
+
+    proxy_pool_add_text(pool, "trojan://pw2@h2.example.com:443#same\n");
+    g_assert_true(proxy_pool_lookup_name(pool, "same") == proxy_pool_lookup(pool, node_fingerprint(2)));
+
+    proxy_pool_free(pool);
+}
+
+// 节点数超过索引初始容量和并行解析的行数阈值，索引多次扩容后仍然一致；
+// 再次同步（重新导入同一订阅）时探测状态跟随节点
+static void test_sync_large(void) {
+    ProxyPool *pool = proxy_pool_new();
+    ProxyPoolImportStats stats;
+    GString *text = g_string_new(NULL);
+    char name[32];
+
+    for (int id = 1; id <= 400; id++) {
+        g_snprintf(name, sizeof(name), "n%d", id);
+        append_node(text, id, name);
+    }
+    g_assert_cmpuint(proxy_pool_add_text(pool, text->str), ==, 400);
+    for (int id = 1; id <= 400; id += 2) {
+        set_probe_state(proxy_pool_lookup(pool, node_fingerprint(id)), id);
+    }
+
+    // 保留 201..400（倒序），新增 401..600
+    g_string_truncate(text, 0);
+    for (int id = 600; id > 200; id--) {
+        g_snprintf(name, sizeof(name), "m%d", id);
+        append_node(text, id, name);
+    }
+    for (int round = 0; round < 2; round++) {
+        g_assert_cmpuint(proxy_pool_sync_text(pool, text->str, &stats), ==, round == 0 ? 200 : 0);
+        g_assert_cmpuint(stats.kept, ==, round == 0 ? 200 : 400);
+        g_assert_cmpuint(stats.removed, ==, round == 0 ? 200 : 0);
+        g_assert_cmpuint(proxy_pool_size(pool), ==, 400);
+
+        for (int id = 1; id <= 600; id++) {
+            ProxyNode *node = proxy_pool_lookup(pool, node_fingerprint(id));
+            g_snprintf(name, sizeof(name), "m%d", id);
+
+            if (id <= 200) {
+                g_assert_null(node);
+                continue;
+            }
+            g_assert_nonnull(node);
+            g_assert_true(proxy_pool_lookup_name(pool, name) == node);
+            g_assert_cmpuint(node - &g_array_index(pool->nodes, ProxyNode, 0), ==, 600 - id);
+            g_assert_cmpint(node->smoothed_us, ==, id <= 400 && id % 2 ? 2000 + id : 0);
+        }
+    }
+
+    g_string_free(text, TRUE);
+    proxy_pool_free(pool);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    for (gsize i = 0; i < G_N_ELEMENTS(sync_cases); i++) {
+        char *path = g_strdup_printf("/proxy-pool/sync/%s", sync_cases[i].name);
+        g_test_add_data_func(path, &sync_cases[i], test_sync);
+        g_free(path);
+    }
+    g_test_add_func("/proxy-pool/sync/nothing-parsed", test_sync_nothing_parsed);
+    g_test_add_func("/proxy-pool/sync/large", test_sync_large);
+    g_test_add_func("/proxy-pool/append", test_append);
+
+    return g_test_run();
+}
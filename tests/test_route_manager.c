@@ -0,0 +1,113 @@
+#include "../include/route_manager.h"
+#include <string.h>
+
+// 全局模式下编译出的直连网段只有隧道网段 (10.8.0.0/24) 和自定义走VPN网段，
+// 阻断网段只有自定义阻断网段，用来检查网段聚合和阻断覆盖直连的处理
+
+// 测试中不写日志文件
+void log_message(const char *level, const char *format, ...) {
+    (void)level;
+    (void)format;
+}
+
+typedef struct {
+    const char *name;
+    const char *vpn[6];
+    const char *block[4];
+    const char *direct_expected;    // 逗号分隔，NULL 表示没有直连网段
+    const char *block_expected;
+} CompileCase;
+
+static const CompileCase compile_cases[] = {
+    { "tunnel-only", { NULL }, { NULL }, "10.8.0.0/24", NULL },
+    { "adjacent-merge", { "192.168.0.0/24", "192.168.1.0/24", NULL }, { NULL },
+      "10.8.0.0/24,192.168.0.0/23", NULL },
+    { "cascade-merge", { "192.168.0.0/24", "192.168.1.0/24", "192.168.2.0/23", NULL }, { NULL },
+      "10.8.0.0/24,192.168.0.0/22", NULL },
+    { "unsorted-merge", { "192.168.3.0/24", "192.168.2.0/24", "192.168.0.0/23", NULL }, { NULL },
+      "10.8.0.0/24,192.168.0.0/22", NULL },
+    { "unaligned-pair", { "192.168.1.0/24", "192.168.2.0/24", NULL }, { NULL },
+      "10.8.0.0/24,192.168.1.0/24,192.168.2.0/24", NULL },
+    { "covered-and-duplicate", { "10.1.0.0/16", "10.0.0.0/8", "10.0.0.0/8", NULL }, { NULL }, "10.0.0.0/8", NULL },
+    { "host-bits", { "172.16.5.9/16", NULL }, { NULL }, "10.8.0.0/24,172.16.0.0/16", NULL },
+    { "merge-to-default", { "0.0.0.0/1", "128.0.0.0/1", NULL }, { NULL }, "0.0.0.0/0", NULL },
+    { "invalid-skipped", { "192.168.0.0/33", "not-a-cidr", "192.168.0.0/24", NULL }, { NULL },
+      "10.8.0.0/24,192.168.0.0/24", NULL },
+    { "block-merge", { NULL }, { "203.0.113.0/25", "203.0.113.128/25", NULL }, "10.8.0.0/24", "203.0.113.0/24" },
+    { "block-covers-direct", { "192.168.1.0/24", "192.168.2.0/24", NULL }, { "192.168.0.0/16", NULL },
+      "10.8.0.0/24", "192.168.0.0/16" },
+    { "block-inside-direct", { "192.168.0.0/16", NULL }, { "192.168.1.0/24", NULL },
+      "10.8.0.0/24,192.168.0.0/16", "192.168.1.0/24" },
+    { "block-interleaved", { "100.0.0.0/8", "200.1.0.0/16", "200.255.0.0/16", NULL },
+      { "1.0.0.0/8", "200.0.0.0/9", "210.0.0.0/8", NULL },
+      "10.8.0.0/24,100.0.0.0/8,200.255.0.0/16", "1.0.0.0/8,200.0.0.0/9,210.0.0.0/8" },
+    { "block-everything", { "192.168.0.0/16", NULL }, { "0.0.0.0/0", NULL }, NULL, "0.0.0.0/0" },
+};
+
+static void add_cidrs(GPtrArray *array, const char * const *cidrs) {
+    for (gsize i = 0; cidrs[i]; i++) {
+        g_ptr_array_add(array, g_strdup(cidrs[i]));
+    }
+}
+
+static void assert_cidrs(char **cidrs, const char *expected) {
+    if (!expected) {
+        g_assert_null(cidrs);
+        return;
+    }
+
+    g_assert_nonnull(cidrs);
+    char *joined = g_strjoinv(",", cidrs);
+    g_assert_cmpstr(joined, ==, expected);
+    g_free(joined);
+}
+
+static void test_compile(gconstpointer data) {
+    const CompileCase *test_case = (const CompileCase*)data;
+    RouteManager *manager = route_manager_new();
+
+    manager->config->mode = ROUTE_MODE_GLOBAL;
+    add_cidrs(manager->config->custom_vpn_cidrs, test_case->vpn);
+    add_cidrs(manager->config->custom_block_cidrs, test_case->block);
+
+    ProxyRouteRules *rules = route_manager_compile_proxy_rules(manager);
+    g_assert_nonnull(rules);
+    g_assert_false(rules->final_direct);
+    g_assert_false(rules->geoip_cn_direct);
+    g_assert_false(rules->block_ads);
+    assert_cidrs(rules->direct_cidrs, test_case->direct_expected);
+    assert_cidrs(rules->block_cidrs, test_case->block_expected);
+
+    proxy_route_rules_free(rules);
+    route_manager_free(manager);
+}
+
+// PAC 模式：私有网段与隧道网段合并，未指定 GeoIP 文件时引用 geoip:cn
+static void test_compile_pac(void) {
+    RouteManager *manager = route_manager_new();
+
+    add_cidrs(manager->config->custom_direct_cidrs, (const char * const[]){ "10.9.0.0/16", NULL });
+    ProxyRouteRules *rules = route_manager_compile_proxy_rules(manager);
+
+    g_assert_true(rules->geoip_cn_direct);
+    g_assert_true(rules->geosite_cn_direct);
+    g_assert_true(rules->block_ads);
+    assert_cidrs(rules->direct_cidrs, "10.0.0.0/8,127.0.0.0/8,169.254.0.0/16,172.16.0.0/12,192.168.0.0/16");
+    assert_cidrs(rules->block_cidrs, NULL);
+
+    proxy_route_rules_free(rules);
+    route_manager_free(manager);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    for (gsize i = 0; i < G_N_ELEMENTS(compile_cases); i++) {
+        char *path = g_strdup_printf("/route-manager/compile/%s", compile_cases[i].name);
+        g_test_add_data_func(path, &compile_cases[i], test_compile);
+        g_free(path);
+    }
+    g_test_add_func("/route-manager/compile/pac", test_compile_pac);
+
+    return g_test_run();
+}
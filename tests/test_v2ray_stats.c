@@ -0,0 +1,177 @@
+#include "../include/v2ray_stats.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// 本地替身服务器回放的响应帧：服务器 SETTINGS + HEADERS/DATA/trailers，
+// 头部由标准 HPACK 编码器生成（Huffman 编码的名称和值，带索引的字面量）
+
+static const guint8 response_ok[] = {
+    0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0e,
+    0x01, 0x04, 0x00, 0x00, 0x00, 0x01, 0x88, 0x5f, 0x8b, 0x1d, 0x75, 0xd0,
+    0x62, 0x0d, 0x26, 0x3d, 0x4c, 0x4d, 0x65, 0x64, 0x00, 0x00, 0x57, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x52, 0x0a, 0x24,
+    0x0a, 0x20, 0x69, 0x6e, 0x62, 0x6f, 0x75, 0x6e, 0x64, 0x3e, 0x3e, 0x3e,
+    0x61, 0x70, 0x69, 0x3e, 0x3e, 0x3e, 0x74, 0x72, 0x61, 0x66, 0x66, 0x69,
+    0x63, 0x3e, 0x3e, 0x3e, 0x75, 0x70, 0x6c, 0x69, 0x6e, 0x6b, 0x10, 0x2a,
+    0x0a, 0x2a, 0x0a, 0x25, 0x6f, 0x75, 0x74, 0x62, 0x6f, 0x75, 0x6e, 0x64,
+    0x3e, 0x3e, 0x3e, 0x70, 0x72, 0x6f, 0x78, 0x79, 0x3e, 0x3e, 0x3e, 0x74,
+    0x72, 0x61, 0x66, 0x66, 0x69, 0x63, 0x3e, 0x3e, 0x3e, 0x64, 0x6f, 0x77,
+    0x6e, 0x6c, 0x69, 0x6e, 0x6b, 0x10, 0xe8, 0x07, 0x00, 0x00, 0x18, 0x01,
+    0x05, 0x00, 0x00, 0x00, 0x01, 0x40, 0x88, 0x9a, 0xca, 0xc8, 0xb2, 0x12,
+    0x34, 0xda, 0x8f, 0x81, 0x07, 0x40, 0x89, 0x9a, 0xca, 0xc8, 0xb5, 0x25,
+    0x42, 0x07, 0x31, 0x7f, 0x80,
+};
+
+static const guint8 response_unimplemented[] = {
+    0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50,
+    0x01, 0x05, 0x00, 0x00, 0x00, 0x01, 0x88, 0x5f, 0x8b, 0x1d, 0x75, 0xd0,
+    0x62, 0x0d, 0x26, 0x3d, 0x4c, 0x4d, 0x65, 0x64, 0x40, 0x88, 0x9a, 0xca,
+    0xc8, 0xb2, 0x12, 0x34, 0xda, 0x8f, 0x82, 0x08, 0xbf, 0x40, 0x89, 0x9a,
+    0xca, 0xc8, 0xb5, 0x25, 0x42, 0x07, 0x31, 0x7f, 0xa9, 0xb6, 0xae, 0xb5,
+    0x1f, 0xc5, 0x4a, 0x20, 0xb6, 0x77, 0x31, 0x0a, 0xa7, 0x71, 0x58, 0x3f,
+    0x4b, 0x90, 0xf6, 0x15, 0x71, 0xd7, 0x5a, 0xe8, 0x48, 0xd2, 0x85, 0xc8,
+    0x7a, 0x69, 0x1d, 0x52, 0x2f, 0xb9, 0x23, 0x4a, 0x37, 0x16, 0xce, 0xe6,
+    0x21, 0x7f,
+};
+
+static const guint8 response_unavailable[] = {
+    0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x34,
+    0x01, 0x05, 0x00, 0x00, 0x00, 0x01, 0x88, 0x5f, 0x8b, 0x1d, 0x75, 0xd0,
+    0x62, 0x0d, 0x26, 0x3d, 0x4c, 0x4d, 0x65, 0x64, 0x40, 0x88, 0x9a, 0xca,
+    0xc8, 0xb2, 0x12, 0x34, 0xda, 0x8f, 0x82, 0x0b, 0x5f, 0x40, 0x89, 0x9a,
+    0xca, 0xc8, 0xb5, 0x25, 0x42, 0x07, 0x31, 0x7f, 0x8d, 0x21, 0xea, 0xa8,
+    0xa4, 0x49, 0x8f, 0x52, 0x96, 0x16, 0x5b, 0x50, 0x59, 0x3f,
+};
+
+static const guint8 response_unimplemented_continuation[] = {
+    0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x26,
+    0x01, 0x01, 0x00, 0x00, 0x00, 0x01, 0x88, 0x5f, 0x8b, 0x1d, 0x75, 0xd0,
+    0x62, 0x0d, 0x26, 0x3d, 0x4c, 0x4d, 0x65, 0x64, 0x40, 0x88, 0x9a, 0xca,
+    0xc8, 0xb2, 0x12, 0x34, 0xda, 0x8f, 0x82, 0x08, 0xbf, 0x40, 0x89, 0x9a,
+    0xca, 0xc8, 0xb5, 0x25, 0x42, 0x07, 0x31, 0x7f, 0x00, 0x00, 0x26, 0x09,
+    0x04, 0x00, 0x00, 0x00, 0x01, 0xa5, 0xb6, 0xae, 0xb5, 0x1f, 0xc5, 0x4a,
+    0x20, 0xb6, 0x77, 0x31, 0x0a, 0xa7, 0x9b, 0x07, 0xe9, 0x71, 0xd7, 0x5a,
+    0xe8, 0x48, 0xd2, 0x85, 0xc8, 0x7a, 0x69, 0x1d, 0x52, 0x2f, 0xb9, 0x23,
+    0x4a, 0x37, 0x16, 0xce, 0xe6, 0x21, 0x7f,
+};
+
+static const guint8 response_no_status[] = {
+    0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0e,
+    0x01, 0x04, 0x00, 0x00, 0x00, 0x01, 0x88, 0x5f, 0x8b, 0x1d, 0x75, 0xd0,
+    0x62, 0x0d, 0x26, 0x3d, 0x4c, 0x4d, 0x65, 0x64, 0x00, 0x00, 0x2b, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x26, 0x0a, 0x24,
+    0x0a, 0x20, 0x69, 0x6e, 0x62, 0x6f, 0x75, 0x6e, 0x64, 0x3e, 0x3e, 0x3e,
+    0x61, 0x70, 0x69, 0x3e, 0x3e, 0x3e, 0x74, 0x72, 0x61, 0x66, 0x66, 0x69,
+    0x63, 0x3e, 0x3e, 0x3e, 0x75, 0x70, 0x6c, 0x69, 0x6e, 0x6b, 0x10, 0x2a,
+};
+typedef struct {
+    const char *name;
+    const guint8 *response;
+    gsize response_len;
+    gint error_code;            // 期望的 G_IO_ERROR 错误码，-1 表示成功
+    gint64 uplink;              // 成功时 inbound>>>api>>>traffic>>>uplink 的值
+} StatsCase;
+
+static const StatsCase stats_cases[] = {
+    { "ok", response_ok, sizeof(response_ok), -1, 42 },
+    { "unimplemented", response_unimplemented, sizeof(response_unimplemented), G_IO_ERROR_NOT_FOUND, 0 },
+    { "unavailable", response_unavailable, sizeof(response_unavailable), G_IO_ERROR_FAILED, 0 },
+    { "continuation", response_unimplemented_continuation, sizeof(response_unimplemented_continuation),
+      G_IO_ERROR_NOT_FOUND, 0 },
+    { "no-status", response_no_status, sizeof(response_no_status), G_IO_ERROR_INVALID_DATA, 0 },
+};
+
+typedef struct {
+    int listen_fd;
+    const StatsCase *test_case;
+} StandIn;
+
+static gboolean read_exact(int fd, guint8 *buf, gsize len) {
+    while (len > 0) {
+        ssize_t n = read(fd, buf, len);
+        if (n <= 0) return FALSE;
+        buf += n;
+        len -= n;
+    }
+    return TRUE;
+}
+
+// 读完请求（直到流 1 的 DATA 带 END_STREAM）后写出响应，再等客户端关闭连接
+static gpointer stand_in_thread(gpointer data) {
+    StandIn *server = (StandIn*)data;
+    int fd = accept(server->listen_fd, NULL, NULL);
+    guint8 buf[16384];
+
+    g_assert_cmpint(fd, >=, 0);
+    g_assert_true(read_exact(fd, buf, 24));
+    g_assert_cmpint(memcmp(buf, "PRI * HTTP/2.0", 14), ==, 0);
+
+    for (;;) {
+        g_assert_true(read_exact(fd, buf, 9));
+        guint32 len = (buf[0] << 16) | (buf[1] << 8) | buf[2];
+        guint8 type = buf[3];
+        guint8 flags = buf[4];
+        g_assert_cmpuint(len, <=, sizeof(buf));
+        g_assert_true(read_exact(fd, buf, len));
+        if (type == 0x0 && (flags & 0x1)) break;
+    }
+
+    g_assert_cmpint(write(fd, server->test_case->response, server->test_case->response_len), ==,
+                    (ssize_t)server->test_case->response_len);
+    shutdown(fd, SHUT_WR);
+    while (read(fd, buf, sizeof(buf)) > 0) {
+    }
+    close(fd);
+    return NULL;
+}
+
+static void test_query(gconstpointer data) {
+    const StatsCase *test_case = (const StatsCase*)data;
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    StandIn server = { socket(AF_INET, SOCK_STREAM, 0), test_case };
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    g_assert_cmpint(bind(server.listen_fd, (struct sockaddr*)&addr, sizeof(addr)), ==, 0);
+    g_assert_cmpint(listen(server.listen_fd, 1), ==, 0);
+    g_assert_cmpint(getsockname(server.listen_fd, (struct sockaddr*)&addr, &addr_len), ==, 0);
+
+    GThread *thread = g_thread_new("stats-stand-in", stand_in_thread, &server);
+    GError *error = NULL;
+    GPtrArray *stats = v2ray_stats_query(ntohs(addr.sin_port), V2RAY_STATS_PATH_V2RAY, 2000, &error);
+    g_thread_join(thread);
+    close(server.listen_fd);
+
+    if (test_case->error_code >= 0) {
+        g_assert_null(stats);
+        g_assert_error(error, G_IO_ERROR, test_case->error_code);
+        g_error_free(error);
+        return;
+    }
+
+    g_assert_no_error(error);
+    g_assert_nonnull(stats);
+    g_assert_cmpuint(stats->len, ==, 2);
+
+    V2RayStat *stat = g_ptr_array_index(stats, 0);
+    g_assert_cmpstr(stat->name, ==, "inbound>>>api>>>traffic>>>uplink");
+    g_assert_cmpint(stat->value, ==, test_case->uplink);
+    g_ptr_array_unref(stats);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    for (gsize i = 0; i < G_N_ELEMENTS(stats_cases); i++) {
+        char *path = g_strdup_printf("/v2ray-stats/query/%s", stats_cases[i].name);
+        g_test_add_data_func(path, &stats_cases[i], test_query);
+        g_free(path);
+    }
+
+    return g_test_run();
+}